@@ -10,6 +10,7 @@
 #include "core/ConCommand.h"
 #include "core/IFileSystem.h"
 #include "core/IDkCore.h"
+#include "utils/KeyValues.h"
 #include "ConsoleCommands.h"
 
 EXPORTED_INTERFACE(IConsoleCommands, CConsoleCommands);
@@ -240,6 +241,261 @@ DECLARE_CONCOMMAND_FN(seti)
 		g_consoleCommands->PushConVarInitialValue(CMD_ARGV(0), joinArgs.GetData());
 }
 
+// compares text key-values parsing with compiled key-values
+DECLARE_CONCOMMAND_FN(kv_bench)
+{
+	if (CMD_ARGC == 0)
+	{
+		MsgWarning("Usage: kv_bench <listFile> [iterations]\n");
+		return;
+	}
+
+	char* listBuffer = (char*)g_fileSystem->GetFileBuffer(CMD_ARGV(0).ToCString());
+	if (!listBuffer)
+	{
+		MsgError("Can't open '%s'\n", CMD_ARGV(0).ToCString());
+		return;
+	}
+
+	Array<EqString> fileNames(PP_SL);
+	xstrsplit(listBuffer, "\n", fileNames);
+	PPFree(listBuffer);
+
+	for (int i = 0; i < fileNames.numElem(); ++i)
+	{
+		fileNames[i] = fileNames[i].TrimSpaces();
+		if (!fileNames[i].Length())
+			fileNames.removeIndex(i--);
+	}
+
+	const int iterations = CMD_ARGC > 1 ? max(1, atoi(CMD_ARGV(1).ToCString())) : 1;
+
+	CEqTimer timer;
+	timer.GetTime(true);
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		for (const EqString& fileName : fileNames)
+		{
+			KVSection root;
+			KV_LoadFromFile(fileName.ToCString(), -1, &root);
+		}
+	}
+
+	const double textTime = timer.GetTime(true);
+
+	// files that are not in cache yet get compiled
+	for (const EqString& fileName : fileNames)
+	{
+		KVCompiledFile file;
+		file.LoadFromFile(fileName.ToCString());
+	}
+
+	const double firstLoadTime = timer.GetTime(true);
+
+	for (int i = 0; i < iterations; ++i)
+	{
+		for (const EqString& fileName : fileNames)
+		{
+			KVCompiledFile file;
+			file.LoadFromFile(fileName.ToCString());
+		}
+	}
+
+	const double compiledTime = timer.GetTime(true);
+
+	MsgInfo("%d files x %d: text %.2f ms, compiled %.2f ms (first load %.2f ms)\n", 
+		fileNames.numElem(), iterations, textTime * 1000.0, compiledTime * 1000.0, firstLoadTime * 1000.0);
+}
+
+// compares compiled view with source key-values, reports first difference
+static bool KVTest_CompareView(const KVSection* sec, const KVView& view, const char* path)
+{
+	if (!view)
+	{
+		MsgError("  %s: invalid view\n", path);
+		return false;
+	}
+
+	if (strcmp(sec->GetName(), view.GetName()) || sec->type != view.GetType())
+	{
+		MsgError("  %s: name or type differs ('%s' %d, '%s' %d)\n", path, sec->GetName(), sec->type, view.GetName(), view.GetType());
+		return false;
+	}
+
+	if (sec->ValueCount() != view.ValueCount() || sec->KeyCount() != view.KeyCount())
+	{
+		MsgError("  %s: %d values %d keys, view has %d values %d keys\n", path, sec->ValueCount(), sec->KeyCount(), view.ValueCount(), view.KeyCount());
+		return false;
+	}
+
+	for (int i = 0; i < sec->ValueCount(); ++i)
+	{
+		const KVPairValue* value = sec->values[i];
+		const EqString valuePath = EqString::Format("%s[%d]", path, i);
+
+		if (value->type != view.ValueTypeAt(i))
+		{
+			MsgError("  %s: type %d, view has %d\n", valuePath.ToCString(), value->type, view.ValueTypeAt(i));
+			return false;
+		}
+
+		if (value->type == KVPAIR_SECTION)
+		{
+			if (!KVTest_CompareView(value->section, view.ValueSectionAt(i), valuePath.ToCString()))
+				return false;
+			continue;
+		}
+
+		const char* str = KV_GetValueString(sec, i, "");
+		const char* viewStr = view.GetValueString(i, "");
+		if (strcmp(str ? str : "", viewStr ? viewStr : "") || KV_GetValueInt(sec, i) != view.GetValueInt(i)
+			|| KV_GetValueFloat(sec, i) != view.GetValueFloat(i) || KV_GetValueBool(sec, i) != view.GetValueBool(i))
+		{
+			MsgError("  %s: value '%s', view has '%s'\n", valuePath.ToCString(), str, viewStr);
+			return false;
+		}
+	}
+
+	for (int i = 0; i < sec->KeyCount(); ++i)
+	{
+		const KVSection* key = sec->keys[i];
+		const EqString keyPath = EqString::Format("%s/%s", path, key->GetName());
+
+		if (!KVTest_CompareView(key, view.KeyAt(i), keyPath.ToCString()))
+			return false;
+
+		// lookup must find same key as source, first of repeated ones
+		if (sec->FindSection(key->GetName()) == key && !KVTest_CompareView(key, view.FindSection(key->GetName()), keyPath.ToCString()))
+			return false;
+	}
+
+	return true;
+}
+
+static void KVTest_FillSection(KVSection& root)
+{
+	root.SetName("kv_test");
+	root.SetKey("string", "text value");
+	root.SetKey("empty", "");
+	root.SetKey("escaped", "quoted \"text\"\nnew line");
+	root.SetKey("int", -1234567);
+	root.SetKey("float", 3.25f);
+	root.SetKey("bool", true);
+	root.SetKey("vector", Vector3D(1.0f, -2.5f, 1000.0f));
+	root.AddKey("repeated", "first");
+	root.AddKey("repeated", "second");
+
+	KVSection* nested = root.CreateSection("nested");
+	for (int i = 0; i < 32; ++i)
+	{
+		KVSection* item = nested->CreateSection(EqString::Format("item%d", i).ToCString());
+		item->SetKey("index", i);
+		item->SetKey("name", EqString::Format("item %d", i).ToCString());
+		item->CreateSection("deeper")->SetKey("parity", (i & 1) != 0);
+	}
+
+	KVSection* sectionValues = root.CreateSection("sectionValues", nullptr, KVPAIR_SECTION);
+	for (int i = 0; i < 3; ++i)
+	{
+		KVSection* value = sectionValues->CreateSectionValue();
+		value->SetName(EqString::Format("%d", i).ToCString());
+		value->SetKey("value", i * 10);
+		value->CreateSection("inner")->SetKey("text", "inner text");
+	}
+}
+
+// builds compiled key-values, checks views and copies against source, and rejection of broken data
+DECLARE_CONCOMMAND_FN(kv_test)
+{
+	KVSection source;
+	KVTest_FillSection(source);
+
+	CMemoryStream compiled(nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 4096, PP_SL);
+	KV_WriteToStreamCompiled(&compiled, &source, "kv_test.txt", 1, 2);
+
+	ubyte* data = compiled.GetBasePointer();
+	const int dataSize = compiled.GetSize();
+
+	bool result = KVTest_CompareView(&source, KV_GetCompiledView(data, dataSize), "kv_test");
+
+	// copy from view must be same as source
+	if (result)
+	{
+		KVSection copy;
+		KV_GetCompiledView(data, dataSize).CopyTo(&copy);
+
+		CMemoryStream recompiled(nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 4096, PP_SL);
+		KV_WriteToStreamCompiled(&recompiled, &copy, "kv_test.txt", 1, 2);
+
+		if (recompiled.GetSize() != dataSize || memcmp(recompiled.GetBasePointer(), data, dataSize))
+		{
+			MsgError("  compiled copy differs from compiled source\n");
+			result = false;
+		}
+	}
+	MsgInfo("kv_test: round trip %s\n", result ? "OK" : "FAILED");
+
+	// broken blocks are rejected, walking the ones that pass must stay in bounds
+	bool rejectResult = true;
+	if (KV_GetCompiledView(data, dataSize - 1))
+	{
+		MsgError("  truncated block was accepted\n");
+		rejectResult = false;
+	}
+
+	Array<ubyte> broken(PP_SL);
+	broken.append(data, dataSize);
+	broken[dataSize - 1] = 'x';
+	if (KV_GetCompiledView(broken.ptr(), dataSize))
+	{
+		MsgError("  unterminated string table was accepted\n");
+		rejectResult = false;
+	}
+
+	int numAccepted = 0;
+	for (int i = 0; i < 2000; ++i)
+	{
+		memcpy(broken.ptr(), data, dataSize);
+		for (int j = 0; j < 4; ++j)
+			broken[rand() % dataSize] = rand() & 255;
+
+		const KVView root = KV_GetCompiledView(broken.ptr(), dataSize);
+		if (!root)
+			continue;
+
+		KVSection copy;
+		root.CopyTo(&copy);
+		++numAccepted;
+	}
+	MsgInfo("kv_test: broken blocks %s (%d of 2000 random ones had valid structure)\n", rejectResult ? "OK" : "FAILED", numAccepted);
+
+	// text file is compiled and cached on first load, second load is from cache
+	const char* fileName = "kv_test.txt";
+	{
+		IFilePtr file = g_fileSystem->Open(fileName, "wb", SP_MOD);
+		if (!file)
+		{
+			MsgError("kv_test: can't write '%s'\n", fileName);
+			return;
+		}
+		KV_WriteToStream(file, &source);
+	}
+
+	// compiled root is named by file like sections of text files
+	KVSection text;
+	bool fileResult = KV_LoadFromFile(fileName, SP_MOD, &text) != nullptr;
+	text.SetName(fileName);
+	for (int i = 0; i < 2 && fileResult; ++i)
+	{
+		KVCompiledFile compiledFile;
+		fileResult = compiledFile.LoadFromFile(fileName, SP_MOD) && KVTest_CompareView(&text, compiledFile.GetRoot(), fileName);
+	}
+	g_fileSystem->FileRemove(fileName, SP_MOD);
+
+	MsgInfo("kv_test: compiled file %s\n", fileResult ? "OK" : "FAILED");
+}
+
 static void fncfgfiles_variants(const ConCommandBase* cmd, Array<EqString>& list, const char* query)
 {
 	CFileSystemFind fsFind("cfg/*.cfg", SP_MOD);
@@ -259,6 +515,8 @@ DECLARE_CMD_VARIANTS_F(togglevar, "Toggles ConVar value", cvar_list_collect, CV_
 DECLARE_CMD_VARIANTS_F(set, "Sets cvar value", cvar_list_collect, CV_UNREGISTERED);
 DECLARE_CMD_VARIANTS_F(seti, "Sets cvar value before it gets initialized", cvar_list_collect, CV_UNREGISTERED | CV_INVISIBLE);
 DECLARE_CMD_VARIANTS_F(revertvar, "Reverts cvar to it's default value", cvar_list_collect, CV_UNREGISTERED);
+DECLARE_CMD_F(kv_bench, "Measures loading time of key-values files listed in text file. Usage: kv_bench <listFile> [iterations]", CV_UNREGISTERED);
+DECLARE_CMD_F(kv_test, "Checks compiled key-values against source key-values", CV_UNREGISTERED);
 
 
 void SplitCommandForValidArguments(const char* command, Array<EqString>& commands)
@@ -341,6 +599,8 @@ void CConsoleCommands::RegisterCommands()
 	ConCommandBase::Register(&set);
 	ConCommandBase::Register(&seti);
 	ConCommandBase::Register(&revertvar);
+	ConCommandBase::Register(&kv_bench);
+	ConCommandBase::Register(&kv_test);
 }
 
 const ConVar* CConsoleCommands::FindCvar(const char* name)
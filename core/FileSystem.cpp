@@ -125,6 +125,23 @@ uint32 CFile::GetCRC32()
 	return nCRC;
 }
 
+void* CFile::GetMappedData()
+{
+	if (!m_mapping.IsMapped())
+		m_mapping.Map(m_osFile, 0, GetSize());
+
+	return m_mapping.GetData();
+}
+
+bool CFile::DetachMappedData(COSFileMapping& mapping)
+{
+	if (!m_mapping.IsMapped())
+		return false;
+
+	mapping = std::move(m_mapping);
+	return true;
+}
+
 //------------------------------------------------------------------------------
 // Main filesystem code
 //------------------------------------------------------------------------------
@@ -529,6 +546,55 @@ bool CFileSystem::FileExist(const char* filename, int searchFlags) const
 	return WalkOverSearchPaths(searchFlags, filename, walkFileFunc);
 }
 
+bool CFileSystem::GetFileStat(const char* filename, int& outSize, int64& outModTime, int searchFlags)
+{
+	EqString basePath = m_basePath;
+	if (basePath.Length() > 0) // FIXME: is that correct?
+		basePath.Append(CORRECT_PATH_SEPARATOR);
+
+	auto walkFileFunc = [&](EqString filePath, ESearchPath searchPath, int spFlags, bool writePath) -> bool
+	{
+		struct stat st;
+		if (stat(filePath, &st) == 0)
+		{
+			if (st.st_mode & S_IFDIR)
+				return false;
+
+			outSize = st.st_size;
+			outModTime = st.st_mtime;
+			return true;
+		}
+
+		// packaged files can't change without package being changed
+		for (int j = m_fsPackages.numElem() - 1; j >= 0; j--)
+		{
+			CBasePackageReader* fsPacakage = m_fsPackages[j];
+
+			if (!(spFlags & fsPacakage->GetSearchPath()))
+				continue;
+
+			EqString pkgFileName;
+			if (!fsPacakage->GetInternalFileName(pkgFileName, filePath.ToCString() + basePath.Length()))
+				continue;
+
+			if (stat(fsPacakage->GetPackageFilename(), &st) != 0)
+				continue;
+
+			IFilePtr file = fsPacakage->Open(pkgFileName, COSFile::READ);
+			if (!file)
+				continue;
+
+			outSize = file->GetSize();
+			outModTime = st.st_mtime;
+			return true;
+		}
+
+		return false;
+	};
+
+	return WalkOverSearchPaths(searchFlags, filename, walkFileFunc);
+}
+
 EqString CFileSystem::GetSearchPath(ESearchPath search, int directoryId) const
 {
 	EqString searchPath;
@@ -34,9 +34,13 @@ public:
 	VirtStreamType_e	GetType() const { return VS_TYPE_FILE; }
 
 	const char*			GetName() const { return m_name; }
+
+	void*				GetMappedData();
+	bool				DetachMappedData(COSFileMapping& mapping);
 protected:
 	EqString			m_name;
 	COSFile				m_osFile;
+	COSFileMapping		m_mapping;
 };
 
 //------------------------------------------------------------------------------
@@ -92,6 +96,7 @@ public:
 	bool						FileCopy(const char* filename, const char* dest_file, bool overWrite, ESearchPath search);
 	bool						FileExist(const char* filename, int searchFlags = -1) const;
 	void						FileRemove(const char* filename, ESearchPath search ) const;
+	bool						GetFileStat(const char* filename, int& outSize, int64& outModTime, int searchFlags = -1);
 
 	// The next ones are deprecated and will be removed
 
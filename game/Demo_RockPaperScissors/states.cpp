@@ -48,7 +48,7 @@ namespace EqStateMgr
 bool InitRegisterStates()
 {
 	g_parallelJobs->Init(elementsOf(s_jobTypes), s_jobTypes);
-	g_audioSystem->Init();
+	InitAudioSystem();
 
 #ifdef ENABLE_MULTIPLAYER
 	Networking::InitNetworking();
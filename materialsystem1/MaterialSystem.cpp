@@ -31,6 +31,7 @@
 
 using namespace Threading;
 CEqMutex s_matSystemMutex;
+static CEqMutex s_prefetchMutex;
 
 DECLARE_INTERNAL_SHADERS()
 
@@ -80,6 +81,31 @@ DECLARE_CMD(mat_releaseUnused, "Releases unused materials",0)
 	s_matsystem.ReleaseUnusedMaterials();
 }
 
+DECLARE_CMD(mat_prefetch, "Loads materials listed in file (one per line) on job threads", 0)
+{
+	if (CMD_ARGC == 0)
+	{
+		MsgWarning("Usage: mat_prefetch <material list file>\n");
+		return;
+	}
+
+	char* listBuffer = (char*)g_fileSystem->GetFileBuffer(CMD_ARGV(0));
+	if (!listBuffer)
+	{
+		MsgError("Can't open material list '%s'\n", CMD_ARGV(0).ToCString());
+		return;
+	}
+
+	Array<EqString> materialNames(PP_SL);
+	xstrsplit(listBuffer, "\n", materialNames);
+	PPFree(listBuffer);
+
+	for (int i = 0; i < materialNames.numElem(); i++)
+		materialNames[i] = materialNames[i].TrimChar('\r', true, true);
+
+	s_matsystem.PrefetchMaterials(materialNames);
+}
+
 //
 // Threaded material loader
 //
@@ -161,6 +187,11 @@ protected:
 static CEqMatSystemThreadedLoader s_threadedMaterialLoader;
 static CTextureLoader s_textureLoader;
 
+DECLARE_CMD(r_textureResidency, "Print resident and evicted texture memory", 0)
+{
+	s_textureLoader.PrintResidencyInfo();
+}
+
 //---------------------------------------------------------------------------
 
 CMaterialSystem::CMaterialSystem()
@@ -366,6 +397,9 @@ void CMaterialSystem::Shutdown()
 
 	// shutdown thread first
 	s_threadedMaterialLoader.StopThread(true);
+	WaitAllMaterialsLoaded();
+	m_prefetchMaterials.clear(true);
+	s_textureLoader.Shutdown();
 
 	m_globalMaterialVars.variableMap.clear(true);
 	m_globalMaterialVars.variables.clear(true);
@@ -844,6 +878,72 @@ int CMaterialSystem::GetLoadingQueue() const
 	return s_threadedMaterialLoader.GetCount();
 }
 
+// parses materials and resolves their shaders and textures on job threads
+void CMaterialSystem::PrefetchMaterials(ArrayCRef<EqString> materialNames)
+{
+	if (!materialNames.numElem())
+		return;
+
+	{
+		CScopedMutex m(s_prefetchMutex);
+
+		// progress starts over once previous materials are ready
+		if (m_prefetchReady == m_prefetchTotal)
+			m_prefetchReady = m_prefetchTotal = 0;
+
+		m_prefetchTotal += materialNames.numElem();
+	}
+
+	const bool useJobs = g_parallelJobs->IsInitialized();
+
+	for (int i = 0; i < materialNames.numElem(); ++i)
+	{
+		auto prefetchJob = [this, materialName = materialNames[i]](void*, int) {
+			PROF_EVENT("MatSystem Prefetch Material");
+
+			IMaterialPtr material = GetMaterial(materialName);
+			if (material)
+				((CMaterial*)material.Ptr())->PrefetchShaderAndTextures();
+
+			CScopedMutex m(s_prefetchMutex);
+			if (material)
+				m_prefetchMaterials.append(material);
+			else
+				++m_prefetchReady;
+		};
+
+		if (useJobs)
+			g_parallelJobs->AddJob(JOB_TYPE_ANY, prefetchJob);
+		else
+			prefetchJob(nullptr, 0);
+	}
+
+	if (useJobs)
+		g_parallelJobs->Submit();
+}
+
+bool CMaterialSystem::GetPrefetchProgress(int& numReady, int& numTotal)
+{
+	CScopedMutex m(s_prefetchMutex);
+
+	for (int i = 0; i < m_prefetchMaterials.numElem(); )
+	{
+		const int state = m_prefetchMaterials[i]->GetState();
+		if (state == MATERIAL_LOAD_OK || state == MATERIAL_LOAD_ERROR)
+		{
+			m_prefetchMaterials.fastRemoveIndex(i);
+			++m_prefetchReady;
+		}
+		else
+			++i;
+	}
+
+	numReady = m_prefetchReady;
+	numTotal = m_prefetchTotal;
+
+	return numReady == numTotal;
+}
+
 void CMaterialSystem::SetShaderParameterOverriden(int param, bool set)
 {
 	if(set)
@@ -903,7 +1003,8 @@ bool CMaterialSystem::BindMaterial(IMaterial* pMaterial, int flags)
 	CMaterial* pSetupMaterial = (CMaterial*)pMaterial;
 
 	// proxy update is dirty if material was not bound to this frame
-	if (pSetupMaterial->m_frameBound != m_frame)
+	const bool firstBindInFrame = (pSetupMaterial->m_frameBound != m_frame);
+	if (firstBindInFrame)
 		pSetupMaterial->UpdateProxy(m_proxyDeltaTime);
 
 	pSetupMaterial->m_frameBound = m_frame;
@@ -911,6 +1012,16 @@ bool CMaterialSystem::BindMaterial(IMaterial* pMaterial, int flags)
 	// it's now a more critical section to the material
 	pSetupMaterial->DoLoadShaderAndTextures();
 
+	// keep material textures resident
+	if (firstBindInFrame && pSetupMaterial->GetState() == MATERIAL_LOAD_OK)
+	{
+		for (const MatVarData& var : pSetupMaterial->m_vars.variables)
+		{
+			if (var.texture)
+				s_textureLoader.TouchTexture(var.texture);
+		}
+	}
+
 	// set the current material
 	IMaterial* setMaterial = pMaterial;
 
@@ -982,6 +1093,10 @@ void CMaterialSystem::WaitAllMaterialsLoaded()
 {
 	if (m_config.threadedloader && s_threadedMaterialLoader.IsRunning())
 		s_threadedMaterialLoader.WaitForThread();
+
+	int numReady, numTotal;
+	while (!GetPrefetchProgress(numReady, numTotal))
+		Threading::YieldCurrentThread();
 }
 
 // transform operations
@@ -1118,6 +1233,8 @@ bool CMaterialSystem::EndFrame()
 	m_shaderAPI->Flush();
 	m_shaderAPI->ResetCounters();
 
+	s_textureLoader.StreamTextures(m_frame);
+
 	m_renderLibrary->EndFrame();
 
 	m_frame++;
@@ -112,6 +112,9 @@ public:
 	void							PutMaterialToLoadingQueue(const IMaterialPtr& pMaterial);
 	int								GetLoadingQueue() const;
 
+	void							PrefetchMaterials(ArrayCRef<EqString> materialNames);
+	bool							GetPrefetchProgress(int& numReady, int& numTotal);
+
 	void							ReloadAllMaterials();
 	void							ReleaseUnusedMaterials();
 
@@ -223,6 +226,10 @@ private:
 	Array<ShaderProxyFactory>		m_proxyFactoryList{ PP_SL };
 
 	Map<int, IMaterial*>			m_loadedMaterials{ PP_SL };			// loaded material list
+
+	Array<IMaterialPtr>				m_prefetchMaterials{ PP_SL };		// prefetched materials which are not ready yet
+	int								m_prefetchReady{ 0 };
+	int								m_prefetchTotal{ 0 };
 	ECullMode						m_cullMode{ CULL_BACK };			// culling mode. For shaders. TODO: remove, and check matrix handedness.
 
 	CDynamicMesh					m_dynamicMesh;
@@ -9,6 +9,7 @@
 #include "core/ConVar.h"
 #include "core/IConsoleCommands.h"
 #include "core/IFileSystem.h"
+#include "core/IEqParallelJobs.h"
 
 #include "imaging/ImageLoader.h"
 
@@ -16,6 +17,8 @@
 #include "materialsystem1/renderers/IShaderAPI.h"
 #include "TextureLoader.h"
 
+using namespace Threading;
+
 #define TEXTURE_DEFAULT_EXTENSION		".dds"
 #define TEXTURE_SECONDARY_EXTENSION		".tga"
 #define TEXTURE_ANIMATED_EXTENSION		".ati"			// ATI - Animated Texture Index file
@@ -23,6 +26,13 @@
 DECLARE_CVAR(r_reportTextureLoading, "0", "Echo textrue loading", 0);
 DECLARE_CVAR(r_skipTextureLoading, "0", nullptr, CV_CHEAT);
 DECLARE_CVAR(r_noMip, "0", nullptr, CV_CHEAT);
+DECLARE_CVAR(r_textureStreaming, "1", "Stream larger mipmaps of asynchronously loaded textures gradually", CV_ARCHIVE);
+DECLARE_CVAR(r_textureStreamingBaseSize, "64", "Size of largest mipmap streamed texture is initially created with", CV_ARCHIVE);
+DECLARE_CVAR(r_textureStreamingBudget, "4096", "Streamed texture upload budget per frame, in kilobytes", CV_ARCHIVE);
+DECLARE_CVAR(r_textureMemoryBudget, "0", "Texture memory budget in megabytes. Least recently used textures are reduced to base size when exceeded. 0 is unlimited", CV_ARCHIVE);
+DECLARE_CVAR(r_textureEvictFrames, "120", "Number of frames texture has to be unused before it's top mipmaps can be evicted", CV_ARCHIVE);
+
+static thread_local TextureLoadBatch* s_threadLoadBatch = nullptr;
 
 static void AnimGetImagesForTextureName(Array<EqString>& textureNames, const char* pszFileName)
 {
@@ -93,9 +103,53 @@ void CTextureLoader::Initialize(const char* texturePath, const char* textureSRCP
 	m_textureSRCPath.Path_FixSlashes();
 }
 
+void CTextureLoader::Shutdown()
+{
+	CScopedMutex m(m_streamingMutex);
+	m_streamingTextures.clear(true);
+	{
+		CScopedMutex mt(m_touchedMutex);
+		m_touchedTextures.clear(true);
+	}
+	m_residentSize = 0;
+}
+
+// checks format support and converts image for renderer
+static bool PrepareImageForUpload(CImage* img, const char* fileName)
+{
+	const ShaderAPICaps& caps = g_renderAPI->GetCaps();
+
+	if (!caps.textureFormatsSupported[img->GetFormat()])
+	{
+		MsgWarning("Texture has unsupported format: %s\n", fileName);
+		return false;
+	}
+
+	if (g_renderAPI->GetShaderAPIClass() == SHADERAPI_DIRECT3D9)
+	{
+		if (img->GetFormat() == FORMAT_RGB8 || img->GetFormat() == FORMAT_RGBA8)
+			img->SwapChannels(0, 2); // convert to BGR
+
+		// Convert if needed and upload datas
+		if (img->GetFormat() == FORMAT_RGB8) // as the D3DFMT_X8R8G8B8 used
+			img->Convert(FORMAT_RGBA8);
+	}
+
+	return true;
+}
+
 ITexturePtr CTextureLoader::LoadTextureFromFileSync(const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags)
 {
-	HOOK_TO_CVAR(r_allowSourceTextures);
+	// batched textures are loaded on job threads, null on error can't be reported before texture is returned
+	if (s_threadLoadBatch && !(nFlags & TEXFLAG_NULL_ON_ERROR))
+	{
+		ITexturePtr texture;
+		Future<ITexturePtr> future = StartTextureLoading(pszFileName, samplerParams, nFlags, texture);
+		if (!future.HasResult())
+			s_threadLoadBatch->append(future);
+
+		return texture ? texture : g_renderAPI->GetErrorTexture();
+	}
 
 	bool isJustCreated = false;
 	ITexturePtr texture = g_renderAPI->FindOrCreateTexture(pszFileName, isJustCreated);
@@ -106,24 +160,26 @@ ITexturePtr CTextureLoader::LoadTextureFromFileSync(const char* pszFileName, con
 	if (!isJustCreated)
 		return texture;
 
-	if (r_skipTextureLoading.GetBool())
+	if (r_skipTextureLoading.GetBool() || !InitTextureFromFile(texture, pszFileName, samplerParams, nFlags))
 	{
 		if (nFlags & TEXFLAG_NULL_ON_ERROR)
 			texture = nullptr;
 		else
 			texture->GenerateErrorTexture(nFlags);
-
-		return texture;
 	}
 
+	return texture;
+}
+
+bool CTextureLoader::InitTextureFromFile(ITexture* texture, const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags)
+{
+	HOOK_TO_CVAR(r_allowSourceTextures);
+
 	PROF_EVENT("Load Texture from file");
 
 	Array<EqString> textureNames(PP_SL);
 	AnimGetImagesForTextureName(textureNames, pszFileName);
 
-	EqString texNameStr(pszFileName);
-	texNameStr.Path_FixSlashes();
-
 	Array<CImage::PTR_T> imgList(PP_SL);
 
 	// load frames
@@ -148,23 +204,8 @@ ITexturePtr CTextureLoader::LoadTextureFromFileSync(const char* pszFileName, con
 
 		if (isLoaded)
 		{
-			const ShaderAPICaps& caps = g_renderAPI->GetCaps();
-
-			if(!caps.textureFormatsSupported[img->GetFormat()])
-			{
-				MsgWarning("Texture has unsupported format: %s\n", texturePathExt.ToCString());
+			if (!PrepareImageForUpload(img, texturePathExt))
 				continue;
-			}
-
-			if (g_renderAPI->GetShaderAPIClass() == SHADERAPI_DIRECT3D9)
-			{
-				if (img->GetFormat() == FORMAT_RGB8 || img->GetFormat() == FORMAT_RGBA8)
-					img->SwapChannels(0, 2); // convert to BGR
-
-				// Convert if needed and upload datas
-				if (img->GetFormat() == FORMAT_RGB8) // as the D3DFMT_X8R8G8B8 used
-					img->Convert(FORMAT_RGBA8);
-			}
 
 			imgList.append(img);
 
@@ -177,26 +218,484 @@ ITexturePtr CTextureLoader::LoadTextureFromFileSync(const char* pszFileName, con
 		}
 	}
 
-	const ShaderAPICaps& caps = g_renderAPI->GetCaps();
-	caps.maxTextureAnisotropicLevel;
-
 	// initialize texture
 	if (!imgList.numElem() || !texture->Init(samplerParams, imgList, nFlags | TEXFLAG_PROGRESSIVE_LODS))
+		return false;
+
+	// DDS textures can have top mipmaps evicted and streamed back
+	const CImage* img = imgList[0];
+	if (textureNames.numElem() == 1 && img->GetMipMapCount() > 1 && !r_noMip.GetBool())
 	{
-		if (nFlags & TEXFLAG_NULL_ON_ERROR)
-			texture = nullptr;
-		else
-			texture->GenerateErrorTexture(nFlags);
+		EqString texturePathExt;
+		CombinePath(texturePathExt, m_texturePath.ToCString(), textureNames[0].ToCString());
+		texturePathExt.Append(TEXTURE_DEFAULT_EXTENSION);
+
+		if (g_fileSystem->FileExist(texturePathExt))
+			AddStreamingTexture(texture, img, -1, texturePathExt, samplerParams, nFlags);
 	}
 
-	return texture;
+	return true;
+}
+
+// registers texture for streaming and residency management
+void CTextureLoader::AddStreamingTexture(ITexture* texture, const CImage* image, int residentMip, const char* fileName, const SamplerStateParams& samplerParams, int nFlags)
+{
+	HOOK_TO_CVAR(r_loadmiplevel);
+
+	const int numMips = image->GetMipMapCount();
+
+	StreamingTexture streaming;
+	streaming.texture = ITexturePtr(texture);
+	streaming.samplerParams = samplerParams;
+	streaming.fileName = fileName;
+	streaming.flags = (nFlags & ~TEXFLAG_PROGRESSIVE_LODS) | TEXFLAG_NOQUALITYLOD;	// quality mip is handled by streaming
+	streaming.width = image->GetWidth();
+	streaming.height = image->GetHeight();
+	streaming.numMips = numMips;
+	streaming.qualityMip = (nFlags & TEXFLAG_NOQUALITYLOD) ? 0 : clamp(r_loadmiplevel->GetInt(), 0, numMips - 1);
+	streaming.residentMip = (residentMip < 0) ? streaming.qualityMip : residentMip;
+	streaming.fullSize = image->GetMipMappedSize(0, numMips);
+	streaming.qualitySize = image->GetMipMappedSize(streaming.qualityMip, numMips - streaming.qualityMip);
+	streaming.residentSize = image->GetMipMappedSize(streaming.residentMip, numMips - streaming.residentMip);
+
+	CScopedMutex m(m_streamingMutex);
+
+	auto it = m_streamingTextures.find(texture);
+	if (!it.atEnd())
+	{
+		m_residentSize -= it->residentSize;
+		m_streamingTextures.remove(it);
+	}
+
+	m_residentSize += streaming.residentSize;
+	m_streamingTextures.insert(texture, streaming);
+}
+
+// creates texture from smallest mipmaps of DDS file and registers it for streaming
+bool CTextureLoader::InitStreamingTexture(ITexture* texture, const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags)
+{
+	HOOK_TO_CVAR(r_loadmiplevel);
+
+	if (r_noMip.GetBool())
+		return false;
+
+	// animated textures are loaded at once
+	Array<EqString> textureNames(PP_SL);
+	AnimGetImagesForTextureName(textureNames, pszFileName);
+
+	if (textureNames.numElem() != 1)
+		return false;
+
+	PROF_EVENT("Load Streaming Texture from file");
+
+	EqString texturePathExt;
+	CombinePath(texturePathExt, m_texturePath.ToCString(), textureNames[0].ToCString());
+	texturePathExt.Append(TEXTURE_DEFAULT_EXTENSION);
+
+	IFilePtr file = g_fileSystem->Open(texturePathExt, "rb");
+	if (!file)
+		return false;
+
+	CImage::PTR_T header = CRefPtr_new(CImage);
+	header->SetName(textureNames[0].ToCString());
+
+	if (!header->LoadDDSfromHandle(file, LOAD_HEADER_ONLY))
+		return false;
+
+	const int numMips = header->GetMipMapCount();
+	const int qualityMip = (nFlags & TEXFLAG_NOQUALITYLOD) ? 0 : clamp(r_loadmiplevel->GetInt(), 0, numMips - 1);
+
+	// start with mipmap that fits base size
+	const int baseSize = max(1, r_textureStreamingBaseSize.GetInt());
+	int firstMip = qualityMip;
+	while (firstMip < numMips - 1 && max(header->GetWidth(firstMip), header->GetHeight(firstMip)) > baseSize)
+		++firstMip;
+
+	// small enough to be loaded at once
+	if (firstMip == qualityMip)
+		return false;
+
+	CImage::PTR_T img = CRefPtr_new(CImage);
+	img->SetName(textureNames[0].ToCString());
+
+	file->Seek(0, VS_SEEK_SET);
+	if (!img->LoadDDSfromHandle(file, 0, firstMip) || !PrepareImageForUpload(img, texturePathExt))
+		return false;
+
+	file = nullptr;
+
+	// quality mip is handled by streaming
+	const int streamingFlags = (nFlags & ~TEXFLAG_PROGRESSIVE_LODS) | TEXFLAG_NOQUALITYLOD;
+	if (!texture->Init(samplerParams, ArrayCRef<CImage::PTR_T>(&img, 1), streamingFlags))
+		return false;
+
+	if (r_reportTextureLoading.GetBool())
+		MsgInfo("Texture loaded: %s (streaming %dx%d of %dx%d)\n", texturePathExt.ToCString(), img->GetWidth(), img->GetHeight(), header->GetWidth(), header->GetHeight());
+
+	// header has no pixels but provides sizes of full mipmap chain
+	if (img->GetFormat() != header->GetFormat())
+		header->GetFormat(img->GetFormat());
+
+	AddStreamingTexture(texture, header, firstMip, texturePathExt, samplerParams, nFlags);
+
+	return true;
 }
 
 Future<ITexturePtr> CTextureLoader::LoadTextureFromFile(const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags)
 {
-	PROF_EVENT("Load Texture from file");
+	ITexturePtr texture;
+	return StartTextureLoading(pszFileName, samplerParams, nFlags, texture);
+}
+
+// creates texture object and starts loading it on job thread
+Future<ITexturePtr> CTextureLoader::StartTextureLoading(const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags, ITexturePtr& texture)
+{
+	Promise<ITexturePtr> promise;
+	Future<ITexturePtr> future;
+	{
+		// texture must not be found before it's future is registered
+		CScopedMutex m(m_loadingMutex);
+
+		bool isJustCreated = false;
+		texture = g_renderAPI->FindOrCreateTexture(pszFileName, isJustCreated);
+
+		if (!texture)
+		{
+			if (nFlags & TEXFLAG_NULL_ON_ERROR)
+				return Future<ITexturePtr>::Failure(-1, "Unable to create texture");
+
+			return Future<ITexturePtr>::Succeed(ITexturePtr(g_renderAPI->GetErrorTexture()));
+		}
+
+		if (!isJustCreated)
+		{
+			// still loading for someone else
+			auto it = m_loadingTextures.find(texture.Ptr());
+			if (!it.atEnd())
+				return *it;
+
+			return Future<ITexturePtr>::Succeed(ITexturePtr(texture));
+		}
+
+		future = promise.CreateFuture();
+		m_loadingTextures.insert(texture.Ptr(), future);
+	}
+
+	auto loadTextureJob = [this, promise, texture, fileName = EqString(pszFileName), samplerParams, nFlags](void*, int) {
+		defer{
+			CScopedMutex m(m_loadingMutex);
+			m_loadingTextures.remove(texture.Ptr());
+		};
+
+		bool isLoaded = false;
+		if (!r_skipTextureLoading.GetBool())
+		{
+			// mipmaps are spooled by jobs, without them texture is loaded whole
+			isLoaded = r_textureStreaming.GetBool() && g_parallelJobs->IsInitialized() && InitStreamingTexture(texture, fileName, samplerParams, nFlags);
+			if (!isLoaded)
+				isLoaded = InitTextureFromFile(texture, fileName, samplerParams, nFlags);
+		}
+
+		if (!isLoaded)
+		{
+			if (nFlags & TEXFLAG_NULL_ON_ERROR)
+			{
+				promise.SetError(-1, EqString::Format("Can't load texture %s", fileName.ToCString()));
+				return;
+			}
+
+			texture->GenerateErrorTexture(nFlags);
+		}
+
+		promise.SetResult(ITexturePtr(texture));
+	};
+
+	if (g_parallelJobs->IsInitialized())
+	{
+		// any job thread picks it up, hosts don't need dedicated threads for textures
+		g_parallelJobs->AddJob(JOB_TYPE_ANY, loadTextureJob);
+		g_parallelJobs->Submit();
+	}
+	else
+	{
+		loadTextureJob(nullptr, 0);
+	}
+
+	return future;
+}
+
+void CTextureLoader::RequestTextureSize(const ITexture* texture, int screenSize)
+{
+	CScopedMutex m(m_streamingMutex);
+
+	auto it = m_streamingTextures.find(texture);
+	if (it.atEnd())
+		return;
+
+	// largest request during frame is taken
+	StreamingTexture& streaming = *it;
+	if (screenSize <= 0 || streaming.frameRequestedSize == 0)
+		streaming.frameRequestedSize = 0;
+	else
+		streaming.frameRequestedSize = max(streaming.frameRequestedSize, screenSize);
+}
+
+void CTextureLoader::SetThreadLoadBatch(TextureLoadBatch* batch)
+{
+	s_threadLoadBatch = batch;
+}
+
+void CTextureLoader::TouchTexture(const ITexture* texture)
+{
+	// materials can be bound from other threads, frames are stamped by StreamTextures
+	CScopedMutex m(m_touchedMutex);
+	m_touchedTextures.append(texture);
+}
+
+// mipmap that fits streaming base size
+int CTextureLoader::GetBaseMip(const StreamingTexture& streaming) const
+{
+	const int baseSize = max(1, r_textureStreamingBaseSize.GetInt());
+
+	int mip = streaming.qualityMip;
+	while (mip < streaming.numMips - 1 && max(streaming.width >> mip, streaming.height >> mip) > baseSize)
+		++mip;
+
+	return mip;
+}
+
+int CTextureLoader::GetWantedMip(const StreamingTexture& streaming, uint frame) const
+{
+	// evicted texture is streamed back once used again
+	if (streaming.evicted)
+		return streaming.residentMip;
+
+	if (streaming.requestedSize <= 0)
+		return streaming.qualityMip;
+
+	// smallest mipmap that still covers requested size
+	int mip = streaming.qualityMip;
+	while (mip < streaming.numMips - 1 && max(streaming.width >> (mip + 1), streaming.height >> (mip + 1)) >= streaming.requestedSize)
+		++mip;
+
+	return mip;
+}
+
+void CTextureLoader::SpoolTextureMips(StreamingTexture& streaming, int firstMip)
+{
+	streaming.loadingMip = firstMip;
+
+	const ITexture* texture = streaming.texture.Ptr();
+	g_parallelJobs->AddJob(JOB_TYPE_ANY, [this, texture, fileName = streaming.fileName, firstMip](void*, int) {
+		PROF_EVENT("Spool Texture Mipmaps");
+
+		CImage::PTR_T img = CRefPtr_new(CImage);
+		const bool isLoaded = img->LoadDDS(fileName, 0, firstMip) && PrepareImageForUpload(img, fileName);
+
+		CScopedMutex m(m_streamingMutex);
+
+		auto it = m_streamingTextures.find(texture);
+		if (it.atEnd() || it->loadingMip != firstMip)
+			return;
+
+		if (!isLoaded)
+		{
+			MsgError("Can't stream texture \"%s\"\n", fileName.ToCString());
+
+			// keep what is loaded
+			if (firstMip < it->residentMip)
+				it->qualityMip = it->residentMip;
+
+			it->evicted = false;
+			it->loadingMip = -1;
+			return;
+		}
+
+		it->loadedImage = img;
+	});
+}
+
+// reduces least recently used textures to base size until resident size fits budget
+int CTextureLoader::EvictTextures(uint frame)
+{
+	const int64 budget = (int64)r_textureMemoryBudget.GetInt() * 1024 * 1024;
+	if (budget <= 0 || m_residentSize <= budget)
+		return 0;
+
+	const uint evictFrames = max(1, r_textureEvictFrames.GetInt());
+
+	Array<StreamingTexture*> candidates(PP_SL);
+	for (auto it = m_streamingTextures.begin(); !it.atEnd(); ++it)
+	{
+		StreamingTexture& streaming = *it;
+
+		// textures not bound by materials are never evicted
+		if (streaming.loadingMip != -1 || !streaming.lastUsedFrame || frame - streaming.lastUsedFrame < evictFrames)
+			continue;
+
+		if (streaming.residentMip >= GetBaseMip(streaming))
+			continue;
+
+		candidates.append(&streaming);
+	}
+
+	if (!candidates.numElem())
+		return 0;
+
+	quickSort(candidates, [](StreamingTexture* const& a, StreamingTexture* const& b) {
+		return (int)(a->lastUsedFrame - b->lastUsedFrame);
+	});
+
+	int64 residentSize = m_residentSize;
+	int numEvicted = 0;
+	for (; numEvicted < candidates.numElem() && residentSize > budget; ++numEvicted)
+	{
+		StreamingTexture& streaming = *candidates[numEvicted];
+		const int baseMip = GetBaseMip(streaming);
 
-	// TODO: stream lods gradually
+		SpoolTextureMips(streaming, baseMip);
+		streaming.evicted = true;
 
-	return Future<ITexturePtr>::Failure(-1, "None");
-}
\ No newline at end of file
+		residentSize -= streaming.residentSize - (streaming.fullSize >> (2 * baseMip));
+	}
+
+	return numEvicted;
+}
+
+void CTextureLoader::StreamTextures(uint frame)
+{
+	if (!m_streamingTextures.size())
+	{
+		CScopedMutex mt(m_touchedMutex);
+		m_touchedTextures.clear();
+		return;
+	}
+
+	PROF_EVENT("Stream Textures");
+
+	const int uploadBudget = r_textureStreamingBudget.GetInt() * 1024;
+	const int64 memoryBudget = (int64)r_textureMemoryBudget.GetInt() * 1024 * 1024;
+	const uint evictFrames = max(1, r_textureEvictFrames.GetInt());
+
+	int uploadedSize = 0;
+	int spooledSize = 0;
+	int numEvicted = 0;
+
+	{
+		CScopedMutex m(m_streamingMutex);
+
+		{
+			CScopedMutex mt(m_touchedMutex);
+			for (const ITexture* texture : m_touchedTextures)
+			{
+				auto it = m_streamingTextures.find(texture);
+				if (!it.atEnd())
+					it->lastUsedFrame = frame;
+			}
+			m_touchedTextures.clear();
+		}
+
+		for (auto it = m_streamingTextures.begin(); !it.atEnd();)
+		{
+			StreamingTexture& streaming = *it;
+
+			// nobody holds texture anymore
+			if (streaming.texture->Ref_Count() == 1 && streaming.loadingMip == -1)
+			{
+				m_residentSize -= streaming.residentSize;
+				it = m_streamingTextures.remove(it);
+				continue;
+			}
+
+			if (streaming.frameRequestedSize >= 0)
+			{
+				streaming.requestedSize = streaming.frameRequestedSize;
+				streaming.frameRequestedSize = -1;
+			}
+
+			if (streaming.loadedImage && uploadedSize < uploadBudget)
+			{
+				PROF_EVENT("Upload Texture Mipmaps");
+
+				CImage::PTR_T img = streaming.loadedImage;
+				streaming.loadedImage = nullptr;
+
+				const int imageSize = img->GetMipMappedSize(0, img->GetMipMapCount());
+				if (streaming.texture->Init(streaming.samplerParams, ArrayCRef<CImage::PTR_T>(&img, 1), streaming.flags))
+				{
+					m_residentSize += imageSize - streaming.residentSize;
+					streaming.residentSize = imageSize;
+					streaming.residentMip = streaming.loadingMip;
+				}
+				else if (streaming.loadingMip < streaming.residentMip)
+				{
+					streaming.qualityMip = streaming.residentMip;
+				}
+
+				streaming.loadingMip = -1;
+				uploadedSize += imageSize;
+			}
+
+			// used again after eviction
+			if (streaming.evicted && streaming.loadingMip == -1 && frame - streaming.lastUsedFrame < evictFrames)
+				streaming.evicted = false;
+
+			// one mipmap at a time so texture sharpens gradually
+			if (streaming.loadingMip == -1 && spooledSize < uploadBudget && GetWantedMip(streaming, frame) < streaming.residentMip)
+			{
+				const int nextMip = streaming.residentMip - 1;
+				const int nextSize = streaming.fullSize >> (2 * nextMip);
+
+				if (memoryBudget <= 0 || m_residentSize + nextSize - streaming.residentSize <= memoryBudget)
+				{
+					SpoolTextureMips(streaming, nextMip);
+					spooledSize += nextSize;
+				}
+			}
+
+			++it;
+		}
+
+		numEvicted = EvictTextures(frame);
+	}
+
+	if (spooledSize || numEvicted)
+		g_parallelJobs->Submit();
+}
+
+void CTextureLoader::PrintResidencyInfo() const
+{
+	CScopedMutex m(m_streamingMutex);
+
+	int64 qualitySize = 0;
+	int64 evictedSize = 0;
+	int numEvicted = 0;
+	int numStreaming = 0;
+
+	for (auto it = m_streamingTextures.begin(); !it.atEnd(); ++it)
+	{
+		const StreamingTexture& streaming = *it;
+		qualitySize += streaming.qualitySize;
+
+		if (streaming.evicted)
+		{
+			evictedSize += max(0, streaming.qualitySize - streaming.residentSize);
+			++numEvicted;
+		}
+		else if (streaming.residentMip > streaming.qualityMip || streaming.loadingMip != -1)
+		{
+			++numStreaming;
+		}
+	}
+
+	const int64 budget = (int64)r_textureMemoryBudget.GetInt() * 1024 * 1024;
+
+	MsgInfo("Managed textures: %d, resident %.2f MB of %.2f MB at full quality\n", m_streamingTextures.size(), m_residentSize / (1024.0f * 1024.0f), qualitySize / (1024.0f * 1024.0f));
+	MsgInfo("  evicted: %d textures, %.2f MB\n", numEvicted, evictedSize / (1024.0f * 1024.0f));
+	MsgInfo("  streaming: %d textures\n", numStreaming);
+
+	if (budget > 0)
+		MsgInfo("  budget: %.2f MB\n", budget / (1024.0f * 1024.0f));
+	else
+		MsgInfo("  budget: unlimited\n");
+}
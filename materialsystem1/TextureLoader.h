@@ -14,10 +14,67 @@ class CTextureLoader : public ITextureLoader
 {
 public:
 	void				Initialize(const char* texturePath, const char* textureSRCPath);
+	void				Shutdown();
 
 	ITexturePtr			LoadTextureFromFileSync(const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags = 0);
 	Future<ITexturePtr>	LoadTextureFromFile(const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags = 0);
 
+	void				RequestTextureSize(const ITexture* texture, int screenSize);
+	void				SetThreadLoadBatch(TextureLoadBatch* batch);
+
+	// marks texture as used by material bound in current frame
+	void				TouchTexture(const ITexture* texture);
+
+	// uploads loaded mipmaps within per-frame budget, spools next ones and evicts least recently used textures
+	void				StreamTextures(uint frame);
+
+	void				PrintResidencyInfo() const;
+
 	EqString			m_texturePath;
 	EqString			m_textureSRCPath;
-};
\ No newline at end of file
+
+protected:
+	struct StreamingTexture
+	{
+		ITexturePtr			texture;
+		SamplerStateParams	samplerParams;
+		EqString			fileName;
+		CImage::PTR_T		loadedImage;			// mipmaps ready for upload
+		int					flags{ 0 };
+		int					width{ 0 };				// dimensions of full resolution
+		int					height{ 0 };
+		int					numMips{ 0 };
+		int					fullSize{ 0 };			// size of all mipmaps in bytes
+		int					qualitySize{ 0 };		// size of mipmaps allowed by texture quality
+		int					residentSize{ 0 };		// size of uploaded mipmaps
+		int					qualityMip{ 0 };		// largest mipmap allowed by texture quality
+		int					residentMip{ 0 };		// largest uploaded mipmap
+		int					loadingMip{ -1 };		// mipmap being spooled
+		int					requestedSize{ 0 };		// screen size in pixels, 0 is full resolution
+		int					frameRequestedSize{ -1 };	// largest request since last update
+		uint				lastUsedFrame{ 0 };		// 0 if never used by material
+		bool				evicted{ false };
+	};
+
+	Future<ITexturePtr>	StartTextureLoading(const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags, ITexturePtr& texture);
+
+	bool				InitTextureFromFile(ITexture* texture, const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags);
+	bool				InitStreamingTexture(ITexture* texture, const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags);
+
+	void				AddStreamingTexture(ITexture* texture, const CImage* image, int residentMip, const char* fileName, const SamplerStateParams& samplerParams, int nFlags);
+
+	int					GetBaseMip(const StreamingTexture& streaming) const;
+	int					GetWantedMip(const StreamingTexture& streaming, uint frame) const;
+	int					EvictTextures(uint frame);
+	void				SpoolTextureMips(StreamingTexture& streaming, int firstMip);
+
+	Map<const ITexture*, Future<ITexturePtr>>	m_loadingTextures{ PP_SL };	// textures being loaded on job threads
+	Threading::CEqMutex						m_loadingMutex;
+
+	Map<const ITexture*, StreamingTexture>	m_streamingTextures{ PP_SL };
+	mutable Threading::CEqMutex				m_streamingMutex;
+	int64									m_residentSize{ 0 };
+
+	Array<const ITexture*>					m_touchedTextures{ PP_SL };	// used since last update, stamped in batch
+	Threading::CEqMutex						m_touchedMutex;
+};
@@ -15,6 +15,7 @@
 #include "utils/KeyValues.h"
 #include "materialvar.h"
 #include "materialsystem1/IMaterialSystem.h"
+#include "materialsystem1/ITextureLoader.h"
 #include "material.h"
 
 DECLARE_CVAR(r_allowSourceTextures, "0", "enable materials and textures loading from source paths", 0);
@@ -342,6 +343,10 @@ bool CMaterial::LoadShaderAndTextures()
 
 bool CMaterial::DoLoadShaderAndTextures()
 {
+	// prefetch completes loading
+	if (Atomic::Load(m_pendingTextures))
+		return false;
+
 	IShaderAPI* renderAPI = g_matSystem->GetShaderAPI();
 	InitShader(renderAPI);
 
@@ -371,6 +376,65 @@ bool CMaterial::DoLoadShaderAndTextures()
 	return true;
 }
 
+bool CMaterial::PrefetchShaderAndTextures()
+{
+	if (m_state != MATERIAL_LOAD_NEED_LOAD)
+		return false;
+
+	// pending counter holds one extra reference until all texture loads are issued
+	if (Atomic::CompareExchange(m_pendingTextures, 0, 1) != 0)
+		return false;
+
+	IShaderAPI* renderAPI = g_matSystem->GetShaderAPI();
+	InitShader(renderAPI);
+
+	IMaterialSystemShader* shader = m_shader;
+	if (!shader)
+	{
+		Atomic::Exchange(m_pendingTextures, 0);
+		return true;
+	}
+
+	Atomic::Exchange(m_state, MATERIAL_LOAD_INQUEUE);
+
+	TextureLoadBatch textureLoads(PP_SL);
+	if (!shader->IsInitialized() && !shader->IsError())
+	{
+		PROF_EVENT("MatSystem Prefetch Material Shader and Textures");
+
+		g_texLoader->SetThreadLoadBatch(&textureLoads);
+		shader->InitTextures(renderAPI);
+		g_texLoader->SetThreadLoadBatch(nullptr);
+
+		shader->InitShader(renderAPI);
+	}
+
+	Atomic::Add(m_pendingTextures, textureLoads.numElem());
+
+	for (Future<ITexturePtr>& future : textureLoads)
+	{
+		future.AddCallback([material = IMaterialPtr(this)](const FutureResult<ITexturePtr>&) {
+			((CMaterial*)material.Ptr())->OnPrefetchTextureLoaded();
+		});
+	}
+
+	OnPrefetchTextureLoaded();
+	return true;
+}
+
+void CMaterial::OnPrefetchTextureLoaded()
+{
+	if (Atomic::Decrement(m_pendingTextures) > 0)
+		return;
+
+	if (m_shader->IsInitialized())
+		Atomic::Exchange(m_state, MATERIAL_LOAD_OK);
+	else if (m_shader->IsError())
+		Atomic::Exchange(m_state, MATERIAL_LOAD_ERROR);
+	else
+		ASSERT_FAIL("please check shader '%s' (%s) for initialization (not error, not initialized)", m_szShaderName.ToCString(), m_shader->GetName());
+}
+
 // waits for material loading
 void CMaterial::WaitForLoading() const
 {
@@ -46,6 +46,9 @@ public:
 	bool					LoadShaderAndTextures();
 	void					WaitForLoading() const;
 
+	// loads shader while textures are loaded by job threads, material is ready once all of them are loaded
+	bool					PrefetchShaderAndTextures();
+
 // material var operations
 	MatVarProxyUnk			FindMaterialVar(const char* pszVarName) const;
 	MatVarProxyUnk			GetMaterialVar(const char* pszVarName, const char* defaultValue);
@@ -66,6 +69,7 @@ private:
 
 protected:
 	bool					DoLoadShaderAndTextures();
+	void					OnPrefetchTextureLoaded();
 
 	EqString				m_szMaterialName;
 	EqString				m_szShaderName;
@@ -78,6 +82,7 @@ protected:
 
 	int						m_state{ MATERIAL_LOAD_ERROR };	// FIXME: may be interlocked?
 	int						m_nameHash{ 0 };
+	volatile int			m_pendingTextures{ 0 };			// prefetched textures not loaded yet
 
 	uint					m_frameBound{ 0 };
 	bool					m_loadFromDisk{ false };
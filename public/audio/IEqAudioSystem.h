@@ -200,3 +200,6 @@ public:
 };
 
 extern IEqAudioSystem* g_audioSystem;
+
+// selects audio backend and initializes it
+void InitAudioSystem();
@@ -76,6 +76,9 @@ public:
 	virtual EqString		FindFilePath(const char* filename, int searchFlags = -1) const = 0;
 	virtual bool			FileExist(const char* filename, int searchFlags = -1) const = 0;
 	virtual void			FileRemove(const char* filename, ESearchPath search ) const = 0;
+
+	// retrieves file size and modification time without reading it; packaged files report package modification time
+	virtual bool			GetFileStat(const char* filename, int& outSize, int64& outModTime, int searchFlags = -1) = 0;
 	virtual bool			FileCopy(const char* filename, const char* dest_file, bool overWrite, ESearchPath search) = 0;
 
 	// The next ones are deprecated and will be removed
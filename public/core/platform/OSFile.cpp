@@ -5,6 +5,7 @@
 #include <Windows.h>
 #else
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -277,3 +278,99 @@ bool COSFile::Flush()
 	return fsync((int)(intptr_t)m_fp) == 0;
 #endif
 }
+
+//------------------------------------------------------------------------------
+
+COSFileMapping::COSFileMapping(COSFileMapping&& r) noexcept
+{
+	m_view = r.m_view;
+	m_data = r.m_data;
+	m_viewSize = r.m_viewSize;
+	m_size = r.m_size;
+	r.m_view = nullptr;
+	r.m_data = nullptr;
+	r.m_viewSize = 0;
+	r.m_size = 0;
+}
+
+COSFileMapping::~COSFileMapping()
+{
+	Unmap();
+}
+
+COSFileMapping& COSFileMapping::operator=(COSFileMapping&& r) noexcept
+{
+	Unmap();
+
+	m_view = r.m_view;
+	m_data = r.m_data;
+	m_viewSize = r.m_viewSize;
+	m_size = r.m_size;
+	r.m_view = nullptr;
+	r.m_data = nullptr;
+	r.m_viewSize = 0;
+	r.m_size = 0;
+
+	return *this;
+}
+
+bool COSFileMapping::Map(const COSFile& file, size_t offset, size_t size)
+{
+	Unmap();
+
+	if (!file.IsOpen() || !size)
+		return false;
+
+#ifdef _WIN32
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+
+	const size_t viewOffset = offset - (offset % sysInfo.dwAllocationGranularity);
+	const size_t viewSize = size + (offset - viewOffset);
+
+	// view holds reference to mapping object so handle can be closed right away
+	HANDLE mappingHandle = CreateFileMappingA((HANDLE)file.m_fp, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (!mappingHandle)
+		return false;
+
+	LARGE_INTEGER li;
+	li.QuadPart = viewOffset;
+	void* view = MapViewOfFile(mappingHandle, FILE_MAP_COPY, li.HighPart, li.LowPart, viewSize);
+	CloseHandle(mappingHandle);
+
+	if (!view)
+		return false;
+#else
+	const size_t pageSize = sysconf(_SC_PAGESIZE);
+	const size_t viewOffset = offset - (offset % pageSize);
+	const size_t viewSize = size + (offset - viewOffset);
+
+	void* view = mmap(nullptr, viewSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, (int)(intptr_t)file.m_fp, viewOffset);
+	if (view == MAP_FAILED)
+		return false;
+#endif
+
+	m_view = view;
+	m_viewSize = viewSize;
+	m_data = (ubyte*)view + (offset - viewOffset);
+	m_size = size;
+
+	return true;
+}
+
+void COSFileMapping::Unmap()
+{
+	if (!m_view)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_view);
+#else
+	munmap(m_view, m_viewSize);
+#endif
+
+	m_view = nullptr;
+	m_data = nullptr;
+	m_viewSize = 0;
+	m_size = 0;
+}
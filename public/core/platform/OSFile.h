@@ -2,6 +2,7 @@
 
 class COSFile
 {
+	friend class COSFileMapping;
 public:
 	enum EFlags
 	{
@@ -39,4 +40,32 @@ private:
 
 	COSFile(const COSFile&) = delete;
 	COSFile& operator=(const COSFile&) = delete;
-};
\ No newline at end of file
+};
+
+// Copy-on-write memory mapping of file region.
+// Pages are shared with system file cache until written to
+class COSFileMapping
+{
+public:
+	COSFileMapping() = default;
+	COSFileMapping(COSFileMapping&& r) noexcept;
+	~COSFileMapping();
+
+	COSFileMapping& operator=(COSFileMapping&& r) noexcept;
+
+	bool	Map(const COSFile& file, size_t offset, size_t size);
+	void	Unmap();
+	bool	IsMapped() const { return m_data != nullptr; }
+
+	void*	GetData() const { return m_data; }
+	size_t	GetSize() const { return m_size; }
+
+private:
+	void*	m_view{ nullptr };		// start of mapped pages
+	void*	m_data{ nullptr };		// requested offset
+	size_t	m_viewSize{ 0 };
+	size_t	m_size{ 0 };
+
+	COSFileMapping(const COSFileMapping&) = delete;
+	COSFileMapping& operator=(const COSFileMapping&) = delete;
+};
@@ -68,6 +68,30 @@ CBasePackageReader* CDPKFileStream::GetHostPackage() const
 	return (CBasePackageReader*)m_host;
 }
 
+void* CDPKFileStream::GetMappedData()
+{
+	if (m_info.numBlocks)
+		return nullptr;
+
+	// mapping starts at page boundary, data at unaligned offset can't be used in place
+	if (m_info.offset & 3)
+		return nullptr;
+
+	if (!m_mapping.IsMapped())
+		m_mapping.Map(m_osFile, m_info.offset, m_info.size);
+
+	return m_mapping.GetData();
+}
+
+bool CDPKFileStream::DetachMappedData(COSFileMapping& mapping)
+{
+	if (!m_mapping.IsMapped())
+		return false;
+
+	mapping = std::move(m_mapping);
+	return true;
+}
+
 void CDPKFileStream::DecodeBlock(int blockIdx)
 {
 	if (m_curBlockIdx == blockIdx)
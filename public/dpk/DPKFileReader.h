@@ -58,6 +58,10 @@ public:
 
 	CBasePackageReader* GetHostPackage() const;
 
+	// only files stored without compression and encryption can be mapped
+	void*				GetMappedData();
+	bool				DetachMappedData(COSFileMapping& mapping);
+
 protected:
 	void				DecodeBlock(int block);
 
@@ -82,6 +86,7 @@ protected:
 	int						m_curBlockIdx;
 
 	COSFile					m_osFile;
+	COSFileMapping			m_mapping;
 	int						m_curPos;
 };
 
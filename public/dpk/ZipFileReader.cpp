@@ -18,6 +18,9 @@ CZipFileStream::CZipFileStream(const char* fileName, unzFile zip, CZipFileReader
 	: m_name(fileName), m_zipHandle(zip), m_host(host)
 {
 	unzGetCurrentFileInfo(m_zipHandle, &m_finfo, nullptr, 0, nullptr, 0, nullptr, 0);
+
+	// position moves as file is read so must be taken while file was just opened
+	m_dataOffset = unzGetCurrentFileZStreamPos64(m_zipHandle);
 }
 
 CZipFileStream::~CZipFileStream()
@@ -31,6 +34,37 @@ CBasePackageReader* CZipFileStream::GetHostPackage() const
 	return (CBasePackageReader*)m_host;
 }
 
+void* CZipFileStream::GetMappedData()
+{
+	constexpr const uLong ZIP_FLAG_ENCRYPTED = 1;
+
+	if (m_finfo.compression_method != 0 || (m_finfo.flag & ZIP_FLAG_ENCRYPTED) || !m_dataOffset)
+		return nullptr;
+
+	// mapping starts at page boundary, data at unaligned offset can't be used in place
+	if (m_dataOffset & 3)
+		return nullptr;
+
+	if (!m_mapping.IsMapped())
+	{
+		if (!m_mappedFile.IsOpen() && !m_mappedFile.Open(m_host->GetPackageFilename(), COSFile::OPEN_EXIST | COSFile::READ))
+			return nullptr;
+
+		m_mapping.Map(m_mappedFile, m_dataOffset, m_finfo.uncompressed_size);
+	}
+
+	return m_mapping.GetData();
+}
+
+bool CZipFileStream::DetachMappedData(COSFileMapping& mapping)
+{
+	if (!m_mapping.IsMapped())
+		return false;
+
+	mapping = std::move(m_mapping);
+	return true;
+}
+
 // reads data from virtual stream
 size_t CZipFileStream::Read(void *dest, size_t count, size_t size)
 {
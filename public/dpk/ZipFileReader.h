@@ -51,11 +51,18 @@ public:
 
 	CBasePackageReader* GetHostPackage() const;
 
+	// only stored files can be mapped
+	void*				GetMappedData();
+	bool				DetachMappedData(COSFileMapping& mapping);
+
 protected:
 
 	EqString			m_name;
 	unzFile				m_zipHandle;
 	unz_file_info		m_finfo;
+	uint64				m_dataOffset{ 0 };		// offset of file data in zip package
+	COSFile				m_mappedFile;
+	COSFileMapping		m_mapping;
 
 	CZipFileReader*		m_host;
 };
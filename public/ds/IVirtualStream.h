@@ -9,6 +9,8 @@
 #pragma once
 #include "ds/refcounted.h"
 
+class COSFileMapping;
+
 enum VirtStreamType_e
 {
 	VS_TYPE_MEMORY = 0,
@@ -92,6 +94,13 @@ public:
 
 	// returns name of stream or file
 	virtual const char*			GetName() const = 0;
+
+	// returns copy-on-write memory mapping of whole stream contents or nullptr if stream can't be mapped.
+	// Mapping is at least 4 byte aligned and valid while stream is referenced
+	virtual void*				GetMappedData() { return nullptr; }
+
+	// moves mapping made by GetMappedData out of stream so stream and it's file handle can be released
+	virtual bool				DetachMappedData(COSFileMapping& mapping) { return false; }
 };
 
 // provide default implementation
@@ -0,0 +1,137 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Bounded lock-free multiple producer single consumer queue
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Ring buffer where every cell has sequence number telling
+// whether it's ready to be written by producer or read by consumer.
+// Push can be called from any thread, Pop only from one thread at a time.
+template<typename T>
+class MPSCQueue
+{
+public:
+	MPSCQueue(const PPSourceLine& sl, int capacity)
+	{
+		ASSERT_MSG((capacity & (capacity - 1)) == 0, "MPSCQueue capacity must be power of two");
+
+		m_cells = PPNewSL(sl) Cell[capacity];
+		m_mask = capacity - 1;
+
+		for (int i = 0; i < capacity; ++i)
+			m_cells[i].sequence = i;
+	}
+
+	~MPSCQueue()
+	{
+		delete[] m_cells;
+	}
+
+	int		GetCapacity() const { return m_mask + 1; }
+
+	// returns false if queue is full
+	bool	Push(const T& value);
+	bool	Push(T&& value);
+
+	// returns false if queue is empty
+	bool	Pop(T& value);
+
+private:
+	MPSCQueue(const MPSCQueue& other) = delete;
+	void operator=(const MPSCQueue& other) = delete;
+
+	struct Cell
+	{
+		volatile uint32	sequence{ 0 };
+		T		value;
+	};
+
+	Cell*	BeginPush();
+
+	Cell*			m_cells{ nullptr };
+	uint32			m_mask{ 0 };
+
+	// producers and consumer positions are kept on different cache lines
+	alignas(64) uint32	m_pushPos{ 0 };
+	alignas(64) uint32	m_popPos{ 0 };
+};
+
+template<typename T>
+inline typename MPSCQueue<T>::Cell* MPSCQueue<T>::BeginPush()
+{
+	uint32 pos = Atomic::Load(m_pushPos);
+	for (;;)
+	{
+		Cell& cell = m_cells[pos & m_mask];
+		// RMW for full barrier so value isn't written before consumer has released the cell
+		const int diff = (int)(Atomic::Add(cell.sequence, 0) - pos);
+
+		if (diff == 0)
+		{
+			// try to claim the cell
+			const uint32 oldPos = Atomic::CompareExchange(m_pushPos, pos, pos + 1);
+			if (oldPos == pos)
+				return &cell;
+			pos = oldPos;
+		}
+		else if (diff < 0)
+		{
+			// consumer hasn't released the cell yet
+			return nullptr;
+		}
+		else
+		{
+			pos = Atomic::Load(m_pushPos);
+		}
+	}
+}
+
+template<typename T>
+inline bool MPSCQueue<T>::Push(const T& value)
+{
+	Cell* cell = BeginPush();
+	if (!cell)
+		return false;
+
+	cell->value = value;
+
+	// RMW for full barrier so sequence is not published before value
+	Atomic::Increment(cell->sequence);
+	return true;
+}
+
+template<typename T>
+inline bool MPSCQueue<T>::Push(T&& value)
+{
+	Cell* cell = BeginPush();
+	if (!cell)
+		return false;
+
+	cell->value = std::move(value);
+
+	// RMW for full barrier so sequence is not published before value
+	Atomic::Increment(cell->sequence);
+	return true;
+}
+
+template<typename T>
+inline bool MPSCQueue<T>::Pop(T& value)
+{
+	Cell& cell = m_cells[m_popPos & m_mask];
+
+	// RMW for full barrier so value is not read before sequence
+	const uint32 sequence = Atomic::Add(cell.sequence, 0);
+	if ((int)(sequence - (m_popPos + 1)) < 0)
+		return false;
+
+	value = std::move(cell.value);
+
+	// cell can be written again on next lap (sequence becomes m_popPos + m_mask + 1).
+	// RMW for full barrier so producer doesn't overwrite value being read
+	Atomic::Add(cell.sequence, m_mask);
+	++m_popPos;
+	return true;
+}
@@ -111,6 +111,10 @@ struct studioMotionData_t
 		{
 			int				numFrames{ 0 };
 			animframe_t*	keyFrames{ nullptr };
+
+			// compressed track, used instead of keyFrames
+			const animtrack_t*	track{ nullptr };
+			const ubyte*		trackData{ nullptr };
 		}*		bones{ nullptr };
 	}*animations{ nullptr };
 
@@ -127,6 +131,10 @@ struct studioMotionData_t
 	posecontroller_t*	poseControllers{ nullptr };
 
 	animframe_t*		frames{ nullptr };
+
+	// compressed tracks
+	animtrack_t*		tracks{ nullptr };
+	ubyte*				trackData{ nullptr };
 };
 
 struct studioJoint_t
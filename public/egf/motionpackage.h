@@ -8,7 +8,8 @@
 #pragma once
 
 #define ANIMFILE_IDENT				MCHAR4('E','Q','M','P')
-#define ANIMFILE_VERSION			6
+#define ANIMFILE_VERSION			7
+#define ANIMFILE_MIN_VERSION		6	// packages without compressed tracks
 
 // use tag ANIMCA_VERSION change
 
@@ -27,8 +28,18 @@ enum EAnimLumps
 	ANIMFILE_ANIMATIONFRAMES		= 4,		// uncompressed animation frames
 	ANIMFILE_UNCOMPRESSEDFRAMESIZE	= 5,		// compressed frame size info
 	ANIMFILE_COMPRESSEDFRAMES		= 6,		// compressed animation frames
+	ANIMFILE_COMPRESSEDTRACKS		= 7,		// animtrack_t for each bone of each animation
+	ANIMFILE_COMPRESSEDTRACKDATA	= 8,		// packed keys of compressed tracks
 
-	ANIMFILE_LUMPS					= 7,
+	ANIMFILE_LUMPS					= 9,
+};
+
+// compressed track flags
+enum EAnimTrackFlags
+{
+	ANIMTRACK_CONSTANT_ROTATION		= (1 << 0),	// only single rotation key stored
+	ANIMTRACK_CONSTANT_POSITION		= (1 << 1),	// no position keys, position is posMin
+	ANIMTRACK_KEYFRAME_INDICES		= (1 << 2),	// keys were reduced, frame index of each key is stored
 };
 
 
@@ -48,7 +59,7 @@ struct animationdesc_s
 {
 	char	name[44];
 
-	int		firstFrame;	// first frame, first bone in ANIMCA_ANIMATIONFRAMES
+	int		firstFrame;	// first frame, first bone in ANIMCA_ANIMATIONFRAMES or first track in ANIMFILE_COMPRESSEDTRACKS
 	int		numFrames;	// NOTE: this is not a bone frame count, but you can compute it by multipling it on bone count.
 };
 ALIGNED_TYPE(animationdesc_s, 4) animationdesc_t;
@@ -101,6 +112,21 @@ struct animframe_s
 };
 ALIGNED_TYPE(animframe_s, 4) animframe_t;
 
+// compressed animation track for single bone.
+// Key data at dataOffset: uint16 frame index[numKeys] (if ANIMTRACK_KEYFRAME_INDICES),
+// smallest-three quaternion uint16[3] (one if ANIMTRACK_CONSTANT_ROTATION, otherwise numKeys),
+// position uint16[3][numKeys] quantized in posMin..posMin+posRange (unless ANIMTRACK_CONSTANT_POSITION)
+struct animtrack_s
+{
+	int			flags;		// EAnimTrackFlags
+	int			numKeys;
+	int			dataOffset;	// offset in ANIMFILE_COMPRESSEDTRACKDATA
+
+	Vector3D	posMin;
+	Vector3D	posRange;
+};
+ALIGNED_TYPE(animtrack_s, 4) animtrack_t;
+
 // pose controllers
 struct posecontroller_s
 {
@@ -23,6 +23,8 @@ static constexpr const uint8 EGF_INVALID_IDX = 0xff;
 enum EStudioFlags
 {
 	STUDIO_FLAG_NEW_VERTEX_FMT	= (1 << 0),
+	STUDIO_FLAG_ANIM_LOD		= (1 << 1),	// bone lodMask and LOD animUpdateInterval are valid
+	STUDIO_FLAG_PACKED_VERTS	= (1 << 2),	// position/uv and TBN streams are packed, unpacked on load
 };
 
 enum EStudioLODFlags
@@ -105,7 +107,8 @@ struct studioLodParams_s
 {
 	float			distance;
 	ubyte			flags;
-	ubyte			unused[3];
+	ubyte			animUpdateInterval;	// frames between animation updates, 0 for default
+	ubyte			unused[2];
 };
 ALIGNED_TYPE(studioLodParams_s, 4) studioLodParams_t;
 
@@ -170,6 +173,46 @@ struct studioVertexColor_s
 };
 ALIGNED_TYPE(studioVertexColor_s, 4) studioVertexColor_t;
 
+// Packed vertex streams (STUDIO_FLAG_PACKED_VERTS)
+// mesh vertex data starts with bounds that positions are quantized to
+//
+// Only file size is reduced. Loader expands packed streams to the float layout,
+// so packed model is copied to heap instead of being used from file mapping.
+// POS_UV + TBN is 24 bytes instead of 56, unpacking costs ~50 ns per vertex,
+// which pays off when model is read at less than ~600 MB/s (HDD, compressed packages)
+struct studioPackedVertexBounds_s
+{
+	Vector3D		mins;
+	Vector3D		size;
+};
+ALIGNED_TYPE(studioPackedVertexBounds_s, 4) studioPackedVertexBounds_t;
+
+struct studioPackedPosUv_s
+{
+	uint16			point[3];		// unorm16 in mesh bounds
+	uint16			unused;
+	half			texCoord[2];
+};
+ALIGNED_TYPE(studioPackedPosUv_s, 4) studioPackedPosUv_t;
+
+struct studioPackedTBN_s
+{
+	int16			normal[2];		// octahedral snorm16
+	int16			tangent[2];		// octahedral snorm16
+	int16			binormalSign;	// binormal = cross(normal, tangent) * sign
+	int16			unused;
+};
+ALIGNED_TYPE(studioPackedTBN_s, 4) studioPackedTBN_t;
+
+// vertex size in packed stream layout
+inline int Studio_PackedVertexSize(int vertexType)
+{
+	return ((vertexType & STUDIO_VERTFLAG_POS_UV) ? sizeof(studioPackedPosUv_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_TBN) ? sizeof(studioPackedTBN_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_BONEWEIGHT) ? sizeof(studioBoneWeight_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_COLOR) ? sizeof(studioVertexColor_t) : 0);
+}
+
 // Vertex descriptor (EGF version <= 13)
 struct studioVertexDesc_s
 {
@@ -293,6 +336,7 @@ struct studioBoneDesc_s
 	char					name[MAX_MODEL_PART_NAME_LENGTH];	//Bone name
 
     int8					parent;		//Parent bone index
+	uint8					lodMask;	//LODs which use this bone for skinning or attachments
 
     Vector3D				rotation;	//Starting rotation
     Vector3D				position;	//Starting position
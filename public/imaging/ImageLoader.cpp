@@ -7,7 +7,9 @@
 
 #include "core/core_common.h"
 #include "core/IFileSystem.h"
+#include "core/IEqParallelJobs.h"
 #include "math/Vector.h"
+#include "math/Simd.h"
 
 #include "ImageLoader.h"
 
@@ -190,6 +192,168 @@ inline void _SwapChannels(DATA_TYPE* pixels, int nPixels, const int channels, co
 	} while (--nPixels);
 }
 
+static void _SwapChannelsUByte(ubyte* pixels, int nPixels, const int channels, const int ch0, const int ch1)
+{
+	int i = 0;
+#if defined(EQ_SIMD_SSE)
+	if (channels == 4)
+	{
+		// swap bytes within 32 bit pixels by mask and shift
+		const int lo = min(ch0, ch1);
+		const int hi = max(ch0, ch1);
+		const __m128i maskLo = _mm_set1_epi32((int)(0xFFu << (lo * 8)));
+		const __m128i maskHi = _mm_set1_epi32((int)(0xFFu << (hi * 8)));
+		const __m128i keep = _mm_set1_epi32((int)~((0xFFu << (lo * 8)) | (0xFFu << (hi * 8))));
+		const __m128i shift = _mm_cvtsi32_si128((hi - lo) * 8);
+
+		for (; i + 4 <= nPixels; i += 4)
+		{
+			__m128i* p = (__m128i*)(pixels + i * 4);
+			const __m128i v = _mm_loadu_si128(p);
+			const __m128i lower = _mm_sll_epi32(_mm_and_si128(v, maskLo), shift);
+			const __m128i upper = _mm_srl_epi32(_mm_and_si128(v, maskHi), shift);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(v, keep), _mm_or_si128(lower, upper)));
+		}
+	}
+#elif defined(EQ_SIMD_NEON)
+	if (channels == 4)
+	{
+		for (; i + 16 <= nPixels; i += 16)
+		{
+			uint8x16x4_t v = vld4q_u8(pixels + i * 4);
+			const uint8x16_t t = v.val[ch0];
+			v.val[ch0] = v.val[ch1];
+			v.val[ch1] = t;
+			vst4q_u8(pixels + i * 4, v);
+		}
+	}
+	else if (channels == 3)
+	{
+		for (; i + 16 <= nPixels; i += 16)
+		{
+			uint8x16x3_t v = vld3q_u8(pixels + i * 3);
+			const uint8x16_t t = v.val[ch0];
+			v.val[ch0] = v.val[ch1];
+			v.val[ch1] = t;
+			vst3q_u8(pixels + i * 3, v);
+		}
+	}
+#endif
+	if (i < nPixels)
+		_SwapChannels(pixels + i * channels, nPixels - i, channels, ch0, ch1);
+}
+
+static void _ConvertRGB8ToRGBA8(ubyte* dest, const ubyte* src, int nPixels)
+{
+	int i = 0;
+#if defined(EQ_SIMD_NEON)
+	for (; i + 16 <= nPixels; i += 16)
+	{
+		const uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+		uint8x16x4_t rgba;
+		rgba.val[0] = rgb.val[0];
+		rgba.val[1] = rgb.val[1];
+		rgba.val[2] = rgb.val[2];
+		rgba.val[3] = vdupq_n_u8(255);
+		vst4q_u8(dest + i * 4, rgba);
+	}
+#else
+	// 4 byte reads, last pixel must not read past the source
+	for (; i + 1 < nPixels; ++i)
+	{
+		uint32 pixel;
+		memcpy(&pixel, src + i * 3, sizeof(pixel));
+		pixel |= 0xFF000000u;
+		memcpy(dest + i * 4, &pixel, sizeof(pixel));
+	}
+#endif
+	for (; i < nPixels; ++i)
+	{
+		dest[i * 4 + 0] = src[i * 3 + 0];
+		dest[i * 4 + 1] = src[i * 3 + 1];
+		dest[i * 4 + 2] = src[i * 3 + 2];
+		dest[i * 4 + 3] = 255;
+	}
+}
+
+//-------------------------------------------------------------------------
+// Image processing is split into independent items (pixel ranges, rows or mip chains)
+// which are processed by job threads and calling thread together.
+//-------------------------------------------------------------------------
+
+static constexpr const int IMAGE_JOB_MIN_PIXELS = 64 * 1024;	// smallest amount of work worth a job item
+static constexpr const int IMAGE_JOB_MAX_ITEMS = 64;
+
+struct ImageJobState : RefCountedObject<ImageJobState>
+{
+	EqFunction<void(int)>	func;
+	Threading::CEqSignal	doneSignal;
+	int						numItems{ 0 };
+	volatile int			nextItem{ 0 };
+	volatile int			doneItems{ 0 };
+};
+
+static void ProcessImageJobItems(ImageJobState& state)
+{
+	while (true)
+	{
+		const int item = Atomic::Increment(state.nextItem) - 1;
+		if (item >= state.numItems)
+			break;
+
+		state.func(item);
+
+		if (Atomic::Increment(state.doneItems) == state.numItems)
+			state.doneSignal.Raise();
+	}
+}
+
+static void ImageParallelFor(int numItems, const EqFunction<void(int)>& func)
+{
+	int numJobs = 0;
+	if (numItems > 1 && g_parallelJobs->IsInitialized())
+		numJobs = min(g_parallelJobs->GetJobThreadsCount(), numItems - 1);
+
+	if (numJobs <= 0)
+	{
+		for (int i = 0; i < numItems; ++i)
+			func(i);
+		return;
+	}
+
+	// jobs may start after all items are taken so state must outlive this call
+	CRefPtr<ImageJobState> state = CRefPtr_new(ImageJobState);
+	state->func = func;
+	state->numItems = numItems;
+
+	for (int i = 0; i < numJobs; ++i)
+	{
+		g_parallelJobs->AddJob(JOB_TYPE_ANY, [state](void*, int) {
+			ProcessImageJobItems(*state.Ptr());
+		});
+	}
+	g_parallelJobs->Submit();
+
+	ProcessImageJobItems(*state.Ptr());
+
+	if (Atomic::Load(state->doneItems) < numItems)
+		state->doneSignal.Wait();
+}
+
+// splits pixels into ranges processed as func(firstPixel, numPixels)
+static void ImageParallelRanges(int nPixels, const EqFunction<void(int, int)>& func)
+{
+	const int numItems = clamp(nPixels / IMAGE_JOB_MIN_PIXELS, 1, IMAGE_JOB_MAX_ITEMS);
+	const int rangeSize = (nPixels + numItems - 1) / numItems;
+
+	ImageParallelFor(numItems, [&](int item) {
+		const int first = item * rangeSize;
+		const int count = min(rangeSize, nPixels - first);
+		if (count > 0)
+			func(first, count);
+	});
+}
+
 
 /* ---------------------------------------------- */
 
@@ -409,7 +573,7 @@ EImageType CImage::GetImageType() const
 	return IMAGE_TYPE_INVALID;
 }
 
-bool CImage::LoadDDS(const char* fileName, uint flags)
+bool CImage::LoadDDS(const char* fileName, uint flags, int firstMipMap)
 {
 	IFilePtr file;
 	if (!(file = g_fileSystem->Open(fileName, "rb")))
@@ -417,7 +581,7 @@ bool CImage::LoadDDS(const char* fileName, uint flags)
 
 	SetName(fileName);
 
-	return LoadDDSfromHandle(file, flags);
+	return LoadDDSfromHandle(file, flags, firstMipMap);
 }
 
 #ifndef NO_JPEG
@@ -446,7 +610,7 @@ bool CImage::LoadTGA(const char* fileName)
 }
 #endif
 
-bool CImage::LoadDDSfromHandle(IFilePtr fileHandle, uint flags)
+bool CImage::LoadDDSfromHandle(IFilePtr fileHandle, uint flags, int firstMipMap)
 {
 	DDSHeader header;
 
@@ -552,12 +716,30 @@ bool CImage::LoadDDSfromHandle(IFilePtr fileHandle, uint flags)
 		}
 	}
 
+	if (flags & LOAD_HEADER_ONLY)
+		return true;
+
+	// skipped mipmaps are stored first
+	firstMipMap = clamp(firstMipMap, 0, m_nMipMaps - 1);
+	const int skipSize = GetMipMappedSize(0, firstMipMap);
+	if (firstMipMap > 0)
+	{
+		m_nWidth = GetWidth(firstMipMap);
+		m_nHeight = GetHeight(firstMipMap);
+		if (!IsCube())
+			m_nDepth = GetDepth(firstMipMap);
+		m_nMipMaps -= firstMipMap;
+	}
+
 	int size = GetMipMappedSize(0, m_nMipMaps);
 	m_pPixels = PPNew ubyte[size];
 	if (IsCube())
 	{
 		for (int face = 0; face < 6; face++)
 		{
+			if (skipSize > 0)
+				fileHandle->Seek(skipSize / 6, VS_SEEK_CUR);
+
 			for (int mipMapLevel = 0; mipMapLevel < m_nMipMaps; mipMapLevel++)
 			{
 				int faceSize = GetMipMappedSize(mipMapLevel, 1) / 6;
@@ -572,7 +754,12 @@ bool CImage::LoadDDSfromHandle(IFilePtr fileHandle, uint flags)
 		}
 	}
 	else
+	{
+		if (skipSize > 0)
+			fileHandle->Seek(skipSize, VS_SEEK_CUR);
+
 		fileHandle->Read(m_pPixels, 1, size);
+	}
 
 	if ((m_nFormat == FORMAT_RGB8 || m_nFormat == FORMAT_RGBA8) && header.ddpfPixelFormat.dwBBitMask == 0xFF)
 	{
@@ -1200,6 +1387,106 @@ void BuildMipMap(DATA_TYPE* dst, const DATA_TYPE* src, const uint w, const uint
 	}
 }
 
+// 2x2 box filter of 8 bit 2D image, gives same results as BuildMipMap
+static void BuildMipMap2DUByte(ubyte* dst, const ubyte* src, const int w, const int h, const int c, ushort* rowSums)
+{
+	const int rowSize = w * c;
+	const int dstWidth = w >> 1;
+
+	for (int y = 0; y < h; y += 2)
+	{
+		const ubyte* row0 = src + y * rowSize;
+		const ubyte* row1 = row0 + rowSize;
+
+		// vertical pass is independent of channel count
+		int i = 0;
+#if defined(EQ_SIMD_SSE)
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= rowSize; i += 16)
+		{
+			const __m128i a = _mm_loadu_si128((const __m128i*)(row0 + i));
+			const __m128i b = _mm_loadu_si128((const __m128i*)(row1 + i));
+			_mm_storeu_si128((__m128i*)(rowSums + i), _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+			_mm_storeu_si128((__m128i*)(rowSums + i + 8), _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+		}
+#elif defined(EQ_SIMD_NEON)
+		for (; i + 16 <= rowSize; i += 16)
+		{
+			const uint8x16_t a = vld1q_u8(row0 + i);
+			const uint8x16_t b = vld1q_u8(row1 + i);
+			vst1q_u16(rowSums + i, vaddl_u8(vget_low_u8(a), vget_low_u8(b)));
+			vst1q_u16(rowSums + i + 8, vaddl_u8(vget_high_u8(a), vget_high_u8(b)));
+		}
+#endif
+		for (; i < rowSize; ++i)
+			rowSums[i] = row0[i] + row1[i];
+
+		ubyte* dstRow = dst + (y >> 1) * dstWidth * c;
+		int x = 0;
+
+		if (c == 4)
+		{
+			// each 128 bit register holds two source pixels
+#if defined(EQ_SIMD_SSE)
+			for (; x + 4 <= dstWidth; x += 4)
+			{
+				const __m128i* sums = (const __m128i*)(rowSums + x * 8);
+				const __m128i p0 = _mm_loadu_si128(sums);
+				const __m128i p1 = _mm_loadu_si128(sums + 1);
+				const __m128i p2 = _mm_loadu_si128(sums + 2);
+				const __m128i p3 = _mm_loadu_si128(sums + 3);
+				const __m128i o0 = _mm_add_epi16(p0, _mm_srli_si128(p0, 8));
+				const __m128i o1 = _mm_add_epi16(p1, _mm_srli_si128(p1, 8));
+				const __m128i o2 = _mm_add_epi16(p2, _mm_srli_si128(p2, 8));
+				const __m128i o3 = _mm_add_epi16(p3, _mm_srli_si128(p3, 8));
+				const __m128i lo = _mm_srli_epi16(_mm_unpacklo_epi64(o0, o1), 2);
+				const __m128i hi = _mm_srli_epi16(_mm_unpacklo_epi64(o2, o3), 2);
+				_mm_storeu_si128((__m128i*)(dstRow + x * 4), _mm_packus_epi16(lo, hi));
+			}
+#elif defined(EQ_SIMD_NEON)
+			for (; x + 4 <= dstWidth; x += 4)
+			{
+				const ushort* sums = rowSums + x * 8;
+				const uint16x8_t p0 = vld1q_u16(sums);
+				const uint16x8_t p1 = vld1q_u16(sums + 8);
+				const uint16x8_t p2 = vld1q_u16(sums + 16);
+				const uint16x8_t p3 = vld1q_u16(sums + 24);
+				const uint16x8_t lo = vcombine_u16(vadd_u16(vget_low_u16(p0), vget_high_u16(p0)), vadd_u16(vget_low_u16(p1), vget_high_u16(p1)));
+				const uint16x8_t hi = vcombine_u16(vadd_u16(vget_low_u16(p2), vget_high_u16(p2)), vadd_u16(vget_low_u16(p3), vget_high_u16(p3)));
+				vst1q_u8(dstRow + x * 4, vcombine_u8(vshrn_n_u16(lo, 2), vshrn_n_u16(hi, 2)));
+			}
+#endif
+		}
+
+		for (; x < dstWidth; ++x)
+		{
+			const ushort* sums = rowSums + x * 2 * c;
+			for (int j = 0; j < c; ++j)
+				dstRow[x * c + j] = (sums[j] + sums[c + j]) >> 2;
+		}
+	}
+}
+
+// 2x2 box filter of RGBA32F 2D image
+static void BuildMipMap2DRGBA32F(float* dst, const float* src, const int w, const int h)
+{
+	const int rowSize = w * 4;
+	const Simd4f quarter = simdSplat(0.25f);
+
+	for (int y = 0; y < h; y += 2)
+	{
+		const float* row0 = src + y * rowSize;
+		const float* row1 = row0 + rowSize;
+
+		for (int x = 0; x < rowSize; x += 8)
+		{
+			const Simd4f sum = (simdLoad(row0 + x) + simdLoad(row0 + x + 4)) + (simdLoad(row1 + x) + simdLoad(row1 + x + 4));
+			simdStore(dst, sum * quarter);
+			dst += 4;
+		}
+	}
+}
+
 bool CImage::CreateMipMaps(const int mipMaps)
 {
 	if (IsCompressedFormat(m_nFormat))
@@ -1246,43 +1533,74 @@ bool CImage::CreateMipMaps(const int mipMaps)
 	int nChannels = GetChannelCount(m_nFormat);
 
 
-	int n = IsCube() ? 6 : 1;
+	if (!IsPlainFormat(m_nFormat))
+		return true;
+
+	const int n = IsCube() ? 6 : 1;
+	const int numChains = m_nArraySize * n;
+	const bool isFloat = IsFloatFormat(m_nFormat);
+	const bool isUShort = !isFloat && m_nFormat >= FORMAT_I16;
 
-	for (int arraySlice = 0; arraySlice < m_nArraySize; arraySlice++)
+	// levels depend on previous ones, while array slices, cube faces and row bands are independent
+	for (int level = 1; level < m_nMipMaps; level++)
 	{
-		ubyte* src = GetPixels(0, arraySlice);
-		ubyte* dst = GetPixels(1, arraySlice);
+		const int w = GetWidth(level - 1);
+		const int h = GetHeight(level - 1);
+		const int d = GetDepth(level - 1);
 
-		for (int level = 1; level < m_nMipMaps; level++)
-		{
-			int w = GetWidth(level - 1);
-			int h = GetHeight(level - 1);
-			int d = GetDepth(level - 1);
+		const int srcSize = GetMipMappedSize(level - 1, 1) / n;
+		const int dstSize = GetMipMappedSize(level, 1) / n;
+
+		// 2D levels are split into bands of rows
+		const bool is2D = (d == 1 && w >= 2 && h >= 2);
+		const int dstRows = h >> 1;
+		const int numBands = is2D ? clamp((w >> 1) * dstRows / IMAGE_JOB_MIN_PIXELS, 1, dstRows) : 1;
 
-			int srcSize = GetMipMappedSize(level - 1, 1) / n;
-			int dstSize = GetMipMappedSize(level, 1) / n;
+		const int srcRowSize = w * nChannels;
+		const int dstRowSize = (w >> 1) * nChannels;
 
-			for (int i = 0; i < n; i++)
+		ImageParallelFor(numChains * numBands, [&](int item) {
+			const int chain = item / numBands;
+			const int band = item % numBands;
+
+			const ubyte* src = GetPixels(level - 1, chain / n) + (chain % n) * srcSize;
+			ubyte* dst = GetPixels(level, chain / n) + (chain % n) * dstSize;
+
+			if (!is2D)
 			{
-				if (IsPlainFormat(m_nFormat))
-				{
-					if (IsFloatFormat(m_nFormat))
-					{
-						BuildMipMap((float*)dst, (float*)src, w, h, d, nChannels);
-					}
-					else if (m_nFormat >= FORMAT_I16)
-					{
-						BuildMipMap((ushort*)dst, (ushort*)src, w, h, d, nChannels);
-					}
-					else
-					{
-						BuildMipMap(dst, src, w, h, d, nChannels);
-					}
-				}
-				src += srcSize;
-				dst += dstSize;
+				if (isFloat)
+					BuildMipMap((float*)dst, (const float*)src, w, h, d, nChannels);
+				else if (isUShort)
+					BuildMipMap((ushort*)dst, (const ushort*)src, w, h, d, nChannels);
+				else
+					BuildMipMap(dst, src, w, h, d, nChannels);
+				return;
 			}
-		}
+
+			const int firstRow = band * dstRows / numBands;
+			const int bandRows = (band + 1) * dstRows / numBands - firstRow;
+
+			if (isFloat)
+			{
+				const float* bandSrc = (const float*)src + firstRow * 2 * srcRowSize;
+				float* bandDst = (float*)dst + firstRow * dstRowSize;
+
+				if (nChannels == 4 && m_nFormat > FORMAT_RGBA16F)
+					BuildMipMap2DRGBA32F(bandDst, bandSrc, w, bandRows * 2);
+				else
+					BuildMipMap(bandDst, bandSrc, w, bandRows * 2, 1, nChannels);
+			}
+			else if (isUShort)
+			{
+				BuildMipMap((ushort*)dst + firstRow * dstRowSize, (const ushort*)src + firstRow * 2 * srcRowSize, w, bandRows * 2, 1, nChannels);
+			}
+			else
+			{
+				ushort* rowSums = PPNew ushort[srcRowSize];
+				BuildMipMap2DUByte(dst + firstRow * dstRowSize, src + firstRow * 2 * srcRowSize, w, bandRows * 2, nChannels, rowSums);
+				delete[] rowSums;
+			}
+		});
 	}
 
 	return true;
@@ -1324,22 +1642,22 @@ bool CImage::Convert(const ETextureFormat newFormat)
 		newPixels = PPNew ubyte[GetMipMappedSize(0, m_nMipMaps, newFormat) * m_nArraySize];
 		float* dest = (float*)newPixels;
 
-		bool writeAlpha = (newFormat == FORMAT_RGBA32F);
-		ubyte* src = m_pPixels;
-		do
-		{
-			*((Vector3D*)dest) = rgbeToRGB(src).rgb();
-			if (writeAlpha)
-			{
-				dest[3] = 1.0f;
-				dest += 4;
-			}
-			else
+		const bool writeAlpha = (newFormat == FORMAT_RGBA32F);
+		const int destChannels = writeAlpha ? 4 : 3;
+
+		ImageParallelRanges(nPixels, [&](int firstPixel, int numPixels) {
+			const ubyte* src = m_pPixels + firstPixel * 4;
+			float* dst = dest + firstPixel * destChannels;
+			do
 			{
-				dest += 3;
-			}
-			src += 4;
-		} while (--nPixels);
+				*((Vector3D*)dst) = rgbeToRGB((ubyte*)src).rgb();
+				if (writeAlpha)
+					dst[3] = 1.0f;
+
+				dst += destChannels;
+				src += 4;
+			} while (--numPixels);
+		});
 
 	}
 	else
@@ -1350,115 +1668,111 @@ bool CImage::Convert(const ETextureFormat newFormat)
 		if (m_nFormat == newFormat)
 			return true;
 
-		ubyte* src = m_pPixels;
-		ubyte* dest = newPixels = PPNew ubyte[GetMipMappedSize(0, m_nMipMaps, newFormat) * m_nArraySize];
+		newPixels = PPNew ubyte[GetMipMappedSize(0, m_nMipMaps, newFormat) * m_nArraySize];
 
 		if (m_nFormat == FORMAT_RGB8 && newFormat == FORMAT_RGBA8)
 		{
 			// Fast path for RGB->RGBA8
-			do
-			{
-				dest[0] = src[0];
-				dest[1] = src[1];
-				dest[2] = src[2];
-				dest[3] = 255;
-				dest += 4;
-				src += 3;
-			} while (--nPixels);
-
+			ImageParallelRanges(nPixels, [&](int firstPixel, int numPixels) {
+				_ConvertRGB8ToRGBA8(newPixels + firstPixel * 4, m_pPixels + firstPixel * 3, numPixels);
+			});
 		}
 		else
 		{
-			int srcSize = GetBytesPerPixel(m_nFormat);
-			int nSrcChannels = GetChannelCount(m_nFormat);
-
-			int destSize = GetBytesPerPixel(newFormat);
-			int nDestChannels = GetChannelCount(newFormat);
+			const int srcSize = GetBytesPerPixel(m_nFormat);
+			const int nSrcChannels = GetChannelCount(m_nFormat);
 
-			do
-			{
-				float rgba[4];
+			const int destSize = GetBytesPerPixel(newFormat);
+			const int nDestChannels = GetChannelCount(newFormat);
 
-				if (IsFloatFormat(m_nFormat))
+			ImageParallelRanges(nPixels, [&](int firstPixel, int numPixels) {
+				const ubyte* src = m_pPixels + firstPixel * srcSize;
+				ubyte* dest = newPixels + firstPixel * destSize;
+				do
 				{
-					if (m_nFormat <= FORMAT_RGBA16F)
+					float rgba[4];
+
+					if (IsFloatFormat(m_nFormat))
+					{
+						if (m_nFormat <= FORMAT_RGBA16F)
+						{
+							for (int i = 0; i < nSrcChannels; i++)
+								rgba[i] = ((half*)src)[i];
+						}
+						else
+						{
+							for (int i = 0; i < nSrcChannels; i++)
+								rgba[i] = ((float*)src)[i];
+						}
+					}
+					else if (m_nFormat >= FORMAT_I16 && m_nFormat <= FORMAT_RGBA16)
 					{
 						for (int i = 0; i < nSrcChannels; i++)
-							rgba[i] = ((half*)src)[i];
+							rgba[i] = ((ushort*)src)[i] * (1.0f / 65535.0f);
 					}
 					else
 					{
 						for (int i = 0; i < nSrcChannels; i++)
-							rgba[i] = ((float*)src)[i];
+							rgba[i] = src[i] * (1.0f / 255.0f);
 					}
-				}
-				else if (m_nFormat >= FORMAT_I16 && m_nFormat <= FORMAT_RGBA16)
-				{
-					for (int i = 0; i < nSrcChannels; i++)
-						rgba[i] = ((ushort*)src)[i] * (1.0f / 65535.0f);
-				}
-				else
-				{
-					for (int i = 0; i < nSrcChannels; i++)
-						rgba[i] = src[i] * (1.0f / 255.0f);
-				}
 
-				if (nSrcChannels < 4)
-					rgba[3] = 1.0f;
+					if (nSrcChannels < 4)
+						rgba[3] = 1.0f;
 
-				if (nSrcChannels == 1)
-					rgba[2] = rgba[1] = rgba[0];
+					if (nSrcChannels == 1)
+						rgba[2] = rgba[1] = rgba[0];
 
-				if (nDestChannels == 1)	rgba[0] = 0.30f * rgba[0] + 0.59f * rgba[1] + 0.11f * rgba[2];
+					if (nDestChannels == 1)	rgba[0] = 0.30f * rgba[0] + 0.59f * rgba[1] + 0.11f * rgba[2];
 
-				if (IsFloatFormat(newFormat))
-				{
-					if (newFormat <= FORMAT_RGBA32F)
+					if (IsFloatFormat(newFormat))
 					{
-						if (newFormat <= FORMAT_RGBA16F)
+						if (newFormat <= FORMAT_RGBA32F)
 						{
-							for (int i = 0; i < nDestChannels; i++)
-								((half*)dest)[i] = rgba[i];
+							if (newFormat <= FORMAT_RGBA16F)
+							{
+								for (int i = 0; i < nDestChannels; i++)
+									((half*)dest)[i] = rgba[i];
+							}
+							else
+							{
+								for (int i = 0; i < nDestChannels; i++)
+									((float*)dest)[i] = rgba[i];
+							}
 						}
 						else
 						{
-							for (int i = 0; i < nDestChannels; i++)
-								((float*)dest)[i] = rgba[i];
+							if (newFormat == FORMAT_RGBE8)
+							{
+								*(uint32*)dest = rgbToRGBE8(MColor(rgba[0], rgba[1], rgba[2]));
+							}
+							else
+							{
+								*(uint32*)dest = rgbToRGB9E5(MColor(rgba[0], rgba[1], rgba[2]));
+							}
 						}
 					}
+					else if (newFormat >= FORMAT_I16 && newFormat <= FORMAT_RGBA16)
+					{
+						for (int i = 0; i < nDestChannels; i++)	((ushort*)dest)[i] = (ushort)(65535 * saturate(rgba[i]) + 0.5f);
+					}
+					else if (/*isPackedFormat(newFormat)*/newFormat == FORMAT_RGB10A2)
+					{
+						*(uint*)dest =
+							(uint(1023.0f * saturate(rgba[0]) + 0.5f) << 22) |
+							(uint(1023.0f * saturate(rgba[1]) + 0.5f) << 12) |
+							(uint(1023.0f * saturate(rgba[2]) + 0.5f) << 2) |
+							(uint(3.0f * saturate(rgba[3]) + 0.5f));
+					}
 					else
 					{
-						if (newFormat == FORMAT_RGBE8)
-						{
-							*(uint32*)dest = rgbToRGBE8(MColor(rgba[0], rgba[1], rgba[2]));
-						}
-						else
-						{
-							*(uint32*)dest = rgbToRGB9E5(MColor(rgba[0], rgba[1], rgba[2]));
-						}
+						for (int i = 0; i < nDestChannels; i++)
+							dest[i] = (unsigned char)(255 * saturate(rgba[i]) + 0.5f);
 					}
-				}
-				else if (newFormat >= FORMAT_I16 && newFormat <= FORMAT_RGBA16)
-				{
-					for (int i = 0; i < nDestChannels; i++)	((ushort*)dest)[i] = (ushort)(65535 * saturate(rgba[i]) + 0.5f);
-				}
-				else if (/*isPackedFormat(newFormat)*/newFormat == FORMAT_RGB10A2)
-				{
-					*(uint*)dest =
-						(uint(1023.0f * saturate(rgba[0]) + 0.5f) << 22) |
-						(uint(1023.0f * saturate(rgba[1]) + 0.5f) << 12) |
-						(uint(1023.0f * saturate(rgba[2]) + 0.5f) << 2) |
-						(uint(3.0f * saturate(rgba[3]) + 0.5f));
-				}
-				else
-				{
-					for (int i = 0; i < nDestChannels; i++)
-						dest[i] = (unsigned char)(255 * saturate(rgba[i]) + 0.5f);
-				}
 
-				src += srcSize;
-				dest += destSize;
-			} while (--nPixels);
+					src += srcSize;
+					dest += destSize;
+				} while (--numPixels);
+			});
 		}
 	}
 
@@ -1477,12 +1791,14 @@ bool CImage::SwapChannels(const int ch0, const int ch1)
 	uint nPixels = GetPixelCount(0, m_nMipMaps) * m_nArraySize;
 	uint nChannels = GetChannelCount(m_nFormat);
 
-	if (m_nFormat <= FORMAT_RGBA8)
-		_SwapChannels((unsigned char*)m_pPixels, nPixels, nChannels, ch0, ch1);
-	else if (m_nFormat <= FORMAT_RGBA16F)
-		_SwapChannels((unsigned short*)m_pPixels, nPixels, nChannels, ch0, ch1);
-	else
-		_SwapChannels((float*)m_pPixels, nPixels, nChannels, ch0, ch1);
+	ImageParallelRanges(nPixels, [&](int firstPixel, int numPixels) {
+		if (m_nFormat <= FORMAT_RGBA8)
+			_SwapChannelsUByte(m_pPixels + firstPixel * nChannels, numPixels, nChannels, ch0, ch1);
+		else if (m_nFormat <= FORMAT_RGBA16F)
+			_SwapChannels((unsigned short*)m_pPixels + firstPixel * nChannels, numPixels, nChannels, ch0, ch1);
+		else
+			_SwapChannels((float*)m_pPixels + firstPixel * nChannels, numPixels, nChannels, ch0, ch1);
+	});
 
 	return true;
 }
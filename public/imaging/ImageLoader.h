@@ -17,7 +17,8 @@ class IVirtualStream;
 // Image loading flags
 enum EImageLoadingFlags
 {
-	DONT_LOAD_MIPMAPS = 0x1
+	DONT_LOAD_MIPMAPS = 0x1,
+	LOAD_HEADER_ONLY = 0x2,		// only reads dimensions, format and mipmap count
 };
 
 #define ALL_MIPMAPS				127
@@ -77,7 +78,8 @@ public:
 		m_pExtraData = (unsigned char*)data;
 	}
 
-	bool			LoadDDS(const char* fileName, uint flags = 0);
+	// firstMipMap skips larger mipmaps so the image begins at lower resolution
+	bool			LoadDDS(const char* fileName, uint flags = 0, int firstMipMap = 0);
 #ifndef NO_JPEG
 	bool			LoadJPEG(const char* fileName);
 #endif // NO_JPEG
@@ -85,7 +87,7 @@ public:
 	bool			LoadTGA(const char* fileName);
 #endif // NO_TGA
 
-	bool			LoadDDSfromHandle(IVirtualStreamPtr fileHandle, uint flags = 0);
+	bool			LoadDDSfromHandle(IVirtualStreamPtr fileHandle, uint flags = 0, int firstMipMap = 0);
 #ifndef NO_JPEG
 	bool			LoadJPEGfromHandle(IVirtualStreamPtr fileHandle);
 #endif // NO_JPEG
@@ -145,6 +145,12 @@ public:
 	virtual void					WaitAllMaterialsLoaded() = 0;
 	virtual int						GetLoadingQueue() const = 0;
 
+	// loads materials and their textures on job threads, material becomes ready when all it's textures are loaded
+	virtual void					PrefetchMaterials(ArrayCRef<EqString> materialNames) = 0;
+
+	// prefetched material counters for loading screens, returns true when all are ready
+	virtual bool					GetPrefetchProgress(int& numReady, int& numTotal) = 0;
+
 	virtual void					ReloadAllMaterials() = 0;
 	virtual void					ReleaseUnusedMaterials() = 0;
 	virtual void					FreeMaterial(IMaterial* pMaterial) = 0;
@@ -12,6 +12,8 @@ using ITexturePtr = CRefPtr<ITexture>;
 
 struct SamplerStateParams;
 
+using TextureLoadBatch = Array<Future<ITexturePtr>>;
+
 class ITextureLoader : public IEqCoreModule
 {
 public:
@@ -20,7 +22,15 @@ public:
 	bool			IsInitialized() const { return true; }
 
 	virtual ITexturePtr			LoadTextureFromFileSync(const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags = 0) = 0;
+	// returns texture with it's smallest mipmaps loaded, larger mipmaps are streamed in over the next frames
 	virtual Future<ITexturePtr>	LoadTextureFromFile(const char* pszFileName, const SamplerStateParams& samplerParams, int nFlags = 0) = 0;
+
+	// limits streamed texture resolution to it's size on screen in pixels. 0 streams full resolution
+	virtual void				RequestTextureSize(const ITexture* texture, int screenSize) = 0;
+
+	// while batch is set, LoadTextureFromFileSync on calling thread returns texture at once and loads it on job thread.
+	// Textures are ready when all futures of the batch are resolved
+	virtual void				SetThreadLoadBatch(TextureLoadBatch* batch) = 0;
 };
 
 INTERFACE_SINGLETON(ITextureLoader, CTextureLoader, g_texLoader)
@@ -0,0 +1,216 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Portable 4-wide float SIMD helpers (SSE2 / NEON / scalar)
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define EQ_SIMD_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define EQ_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+static constexpr const int SIMD_WIDTH = 4;
+
+// rounds element count up to the SIMD width
+inline int SimdAlignCount(int count)
+{
+	return (count + (SIMD_WIDTH - 1)) & ~(SIMD_WIDTH - 1);
+}
+
+struct Simd4f
+{
+#if defined(EQ_SIMD_SSE)
+	__m128		v;
+#elif defined(EQ_SIMD_NEON)
+	float32x4_t	v;
+#else
+	float		v[4];
+#endif
+};
+
+#if defined(EQ_SIMD_SSE)
+
+inline Simd4f simdLoad(const float* p)					{ return { _mm_loadu_ps(p) }; }
+inline void simdStore(float* p, const Simd4f& a)		{ _mm_storeu_ps(p, a.v); }
+inline Simd4f simdSplat(float x)						{ return { _mm_set1_ps(x) }; }
+inline Simd4f simdSet(float x, float y, float z, float w) { return { _mm_setr_ps(x, y, z, w) }; }
+
+inline Simd4f operator+(const Simd4f& a, const Simd4f& b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Simd4f operator-(const Simd4f& a, const Simd4f& b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Simd4f operator*(const Simd4f& a, const Simd4f& b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Simd4f operator/(const Simd4f& a, const Simd4f& b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Simd4f operator-(const Simd4f& a)				{ return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+
+inline Simd4f simdMin(const Simd4f& a, const Simd4f& b)	{ return { _mm_min_ps(a.v, b.v) }; }
+inline Simd4f simdMax(const Simd4f& a, const Simd4f& b)	{ return { _mm_max_ps(a.v, b.v) }; }
+inline Simd4f simdSqrt(const Simd4f& a)					{ return { _mm_sqrt_ps(a.v) }; }
+inline Simd4f simdRound(const Simd4f& a)				{ return { _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)) }; }
+
+// approximate 1/sqrt(x) refined with one Newton-Raphson step
+inline Simd4f simdRsqrt(const Simd4f& a)
+{
+	const __m128 e = _mm_rsqrt_ps(a.v);
+	const __m128 half = _mm_mul_ps(a.v, _mm_set1_ps(0.5f));
+	return { _mm_mul_ps(e, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(half, _mm_mul_ps(e, e)))) };
+}
+
+// same bit trick as rsqrtf() so results match the scalar code
+inline Simd4f simdRsqrtFast(const Simd4f& a)
+{
+	const __m128 half = _mm_mul_ps(a.v, _mm_set1_ps(0.5f));
+	const __m128i i = _mm_sub_epi32(_mm_set1_epi32(0x5f3759df), _mm_srai_epi32(_mm_castps_si128(a.v), 1));
+	const __m128 e = _mm_castsi128_ps(i);
+	return { _mm_mul_ps(e, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(half, _mm_mul_ps(e, e)))) };
+}
+
+// comparisons return lane masks for simdSelect
+inline Simd4f simdCmpLt(const Simd4f& a, const Simd4f& b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline Simd4f simdCmpGt(const Simd4f& a, const Simd4f& b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline Simd4f simdSelect(const Simd4f& mask, const Simd4f& a, const Simd4f& b)
+{
+	return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+}
+
+// (a0, b0, a1, b1) and (a2, b2, a3, b3)
+inline Simd4f simdInterleaveLo(const Simd4f& a, const Simd4f& b) { return { _mm_unpacklo_ps(a.v, b.v) }; }
+inline Simd4f simdInterleaveHi(const Simd4f& a, const Simd4f& b) { return { _mm_unpackhi_ps(a.v, b.v) }; }
+
+// converts 8 floats to 8 int16 with saturation
+inline void simdStoreInt16Sat(short* p, const Simd4f& lo, const Simd4f& hi)
+{
+	_mm_storeu_si128((__m128i*)p, _mm_packs_epi32(_mm_cvtps_epi32(lo.v), _mm_cvtps_epi32(hi.v)));
+}
+
+#elif defined(EQ_SIMD_NEON)
+
+inline Simd4f simdLoad(const float* p)					{ return { vld1q_f32(p) }; }
+inline void simdStore(float* p, const Simd4f& a)		{ vst1q_f32(p, a.v); }
+inline Simd4f simdSplat(float x)						{ return { vdupq_n_f32(x) }; }
+inline Simd4f simdSet(float x, float y, float z, float w) { const float t[4] = { x, y, z, w }; return { vld1q_f32(t) }; }
+
+inline Simd4f operator+(const Simd4f& a, const Simd4f& b) { return { vaddq_f32(a.v, b.v) }; }
+inline Simd4f operator-(const Simd4f& a, const Simd4f& b) { return { vsubq_f32(a.v, b.v) }; }
+inline Simd4f operator*(const Simd4f& a, const Simd4f& b) { return { vmulq_f32(a.v, b.v) }; }
+inline Simd4f operator-(const Simd4f& a)				{ return { vnegq_f32(a.v) }; }
+
+#if defined(__aarch64__)
+inline Simd4f operator/(const Simd4f& a, const Simd4f& b) { return { vdivq_f32(a.v, b.v) }; }
+inline Simd4f simdSqrt(const Simd4f& a)					{ return { vsqrtq_f32(a.v) }; }
+#else
+inline Simd4f operator/(const Simd4f& a, const Simd4f& b)
+{
+	float32x4_t r = vrecpeq_f32(b.v);
+	r = vmulq_f32(vrecpsq_f32(b.v, r), r);
+	r = vmulq_f32(vrecpsq_f32(b.v, r), r);
+	return { vmulq_f32(a.v, r) };
+}
+inline Simd4f simdSqrt(const Simd4f& a)
+{
+	// sqrt(x) = x * rsqrt(x), zero must stay zero
+	float32x4_t e = vrsqrteq_f32(a.v);
+	e = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a.v, e), e), e);
+	e = vmulq_f32(vrsqrtsq_f32(vmulq_f32(a.v, e), e), e);
+	const uint32x4_t zero = vceqq_f32(a.v, vdupq_n_f32(0.0f));
+	return { vbslq_f32(zero, a.v, vmulq_f32(a.v, e)) };
+}
+#endif
+
+inline Simd4f simdMin(const Simd4f& a, const Simd4f& b)	{ return { vminq_f32(a.v, b.v) }; }
+inline Simd4f simdMax(const Simd4f& a, const Simd4f& b)	{ return { vmaxq_f32(a.v, b.v) }; }
+
+inline Simd4f simdRound(const Simd4f& a)
+{
+	const float32x4_t bias = vbslq_f32(vcltq_f32(a.v, vdupq_n_f32(0.0f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+	return { vcvtq_f32_s32(vcvtq_s32_f32(vaddq_f32(a.v, bias))) };
+}
+
+inline Simd4f simdRsqrt(const Simd4f& a)
+{
+	const float32x4_t e = vrsqrteq_f32(a.v);
+	return { vmulq_f32(vrsqrtsq_f32(vmulq_f32(a.v, e), e), e) };
+}
+
+inline Simd4f simdRsqrtFast(const Simd4f& a)
+{
+	const float32x4_t half = vmulq_f32(a.v, vdupq_n_f32(0.5f));
+	const int32x4_t i = vsubq_s32(vdupq_n_s32(0x5f3759df), vshrq_n_s32(vreinterpretq_s32_f32(a.v), 1));
+	const float32x4_t e = vreinterpretq_f32_s32(i);
+	return { vmulq_f32(e, vsubq_f32(vdupq_n_f32(1.5f), vmulq_f32(half, vmulq_f32(e, e)))) };
+}
+
+inline Simd4f simdCmpLt(const Simd4f& a, const Simd4f& b) { return { vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)) }; }
+inline Simd4f simdCmpGt(const Simd4f& a, const Simd4f& b) { return { vreinterpretq_f32_u32(vcgtq_f32(a.v, b.v)) }; }
+inline Simd4f simdSelect(const Simd4f& mask, const Simd4f& a, const Simd4f& b)
+{
+	return { vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v) };
+}
+
+inline Simd4f simdInterleaveLo(const Simd4f& a, const Simd4f& b) { return { vzipq_f32(a.v, b.v).val[0] }; }
+inline Simd4f simdInterleaveHi(const Simd4f& a, const Simd4f& b) { return { vzipq_f32(a.v, b.v).val[1] }; }
+
+inline void simdStoreInt16Sat(short* p, const Simd4f& lo, const Simd4f& hi)
+{
+	// round to nearest like SSE cvtps
+	const int32x4_t ilo = vcvtq_s32_f32(vaddq_f32(lo.v, vbslq_f32(vcltq_f32(lo.v, vdupq_n_f32(0.0f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f))));
+	const int32x4_t ihi = vcvtq_s32_f32(vaddq_f32(hi.v, vbslq_f32(vcltq_f32(hi.v, vdupq_n_f32(0.0f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f))));
+	vst1q_s16(p, vcombine_s16(vqmovn_s32(ilo), vqmovn_s32(ihi)));
+}
+
+#else // scalar fallback
+
+#define SIMD_SCALAR_OP(expr) Simd4f r; for (int i = 0; i < 4; ++i) { r.v[i] = (expr); } return r;
+
+inline Simd4f simdLoad(const float* p)					{ SIMD_SCALAR_OP(p[i]) }
+inline void simdStore(float* p, const Simd4f& a)		{ for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+inline Simd4f simdSplat(float x)						{ SIMD_SCALAR_OP(x) }
+inline Simd4f simdSet(float x, float y, float z, float w) { return { { x, y, z, w } }; }
+
+inline Simd4f operator+(const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP(a.v[i] + b.v[i]) }
+inline Simd4f operator-(const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP(a.v[i] - b.v[i]) }
+inline Simd4f operator*(const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP(a.v[i] * b.v[i]) }
+inline Simd4f operator/(const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP(a.v[i] / b.v[i]) }
+inline Simd4f operator-(const Simd4f& a)				{ SIMD_SCALAR_OP(-a.v[i]) }
+
+inline Simd4f simdMin(const Simd4f& a, const Simd4f& b)	{ SIMD_SCALAR_OP(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline Simd4f simdMax(const Simd4f& a, const Simd4f& b)	{ SIMD_SCALAR_OP(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+inline Simd4f simdSqrt(const Simd4f& a)					{ SIMD_SCALAR_OP(sqrtf(a.v[i])) }
+inline Simd4f simdRsqrt(const Simd4f& a)				{ SIMD_SCALAR_OP(1.0f / sqrtf(a.v[i])) }
+inline Simd4f simdRound(const Simd4f& a)				{ SIMD_SCALAR_OP(roundf(a.v[i])) }
+inline Simd4f simdRsqrtFast(const Simd4f& a)			{ SIMD_SCALAR_OP(rsqrtf(a.v[i])) }
+
+inline Simd4f simdCmpLt(const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP(a.v[i] < b.v[i] ? 1.0f : 0.0f) }
+inline Simd4f simdCmpGt(const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP(a.v[i] > b.v[i] ? 1.0f : 0.0f) }
+inline Simd4f simdSelect(const Simd4f& mask, const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP(mask.v[i] != 0.0f ? a.v[i] : b.v[i]) }
+
+inline Simd4f simdInterleaveLo(const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP((i & 1) ? b.v[i >> 1] : a.v[i >> 1]) }
+inline Simd4f simdInterleaveHi(const Simd4f& a, const Simd4f& b) { SIMD_SCALAR_OP((i & 1) ? b.v[2 + (i >> 1)] : a.v[2 + (i >> 1)]) }
+
+inline void simdStoreInt16Sat(short* p, const Simd4f& lo, const Simd4f& hi)
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		const float x = i < 4 ? lo.v[i] : hi.v[i - 4];
+		p[i] = (short)(x < -32768.0f ? -32768 : (x > 32767.0f ? 32767 : (int)lrintf(x)));
+	}
+}
+
+#undef SIMD_SCALAR_OP
+
+#endif
+
+// a * b + c
+inline Simd4f simdMadd(const Simd4f& a, const Simd4f& b, const Simd4f& c)
+{
+	return a * b + c;
+}
+
+inline Simd4f simdClamp(const Simd4f& x, const Simd4f& lo, const Simd4f& hi)
+{
+	return simdMin(simdMax(x, lo), hi);
+}
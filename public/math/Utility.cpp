@@ -391,4 +391,51 @@ Vector3D UnpackNormal(float value)
 	normal.y = fmodf(floor(value / c_precisionp1), c_precisionp1) / c_precision;
 	normal.z = floor(value / (c_precisionp1 * c_precisionp1)) / c_precision;
 	return normal;
-}
\ No newline at end of file
+}
+
+static float OctahedralSign(float value)
+{
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+Vector2D PackNormalOctahedral(const Vector3D& normal)
+{
+	const float invL1Norm = 1.0f / max(fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z), F_EPS);
+	const Vector2D p(normal.x * invL1Norm, normal.y * invL1Norm);
+
+	// lower hemisphere is folded over diagonals
+	if (normal.z < 0.0f)
+		return Vector2D((1.0f - fabsf(p.y)) * OctahedralSign(p.x), (1.0f - fabsf(p.x)) * OctahedralSign(p.y));
+
+	return p;
+}
+
+Vector3D UnpackNormalOctahedral(const Vector2D& value)
+{
+	Vector3D normal(value.x, value.y, 1.0f - fabsf(value.x) - fabsf(value.y));
+	if (normal.z < 0.0f)
+	{
+		normal.x = (1.0f - fabsf(value.y)) * OctahedralSign(value.x);
+		normal.y = (1.0f - fabsf(value.x)) * OctahedralSign(value.y);
+	}
+
+	return normalize(normal);
+}
+
+static int16 PackSnorm16(float value)
+{
+	return (int16)floorf(clamp(value, -1.0f, 1.0f) * 32767.0f + 0.5f);
+}
+
+void PackNormalOctahedralSnorm16(const Vector3D& dir, int16 packed[2])
+{
+	const float dirLength = length(dir);
+	const Vector2D oct = PackNormalOctahedral(dirLength > F_EPS ? dir / dirLength : Vector3D(0.0f, 0.0f, 1.0f));
+	packed[0] = PackSnorm16(oct.x);
+	packed[1] = PackSnorm16(oct.y);
+}
+
+Vector3D UnpackNormalOctahedralSnorm16(const int16 packed[2])
+{
+	return UnpackNormalOctahedral(Vector2D(max(packed[0] / 32767.0f, -1.0f), max(packed[1] / 32767.0f, -1.0f)));
+}
@@ -101,6 +101,14 @@ float VecAngleDiff(const Vector2D& dirA, const Vector2D& dirB);
 float PackNormal(const Vector3D& normal);
 Vector3D UnpackNormal(float value);
 
+// octahedral unit vector encoding, result is in [-1..1] range
+Vector2D PackNormalOctahedral(const Vector3D& normal);
+Vector3D UnpackNormalOctahedral(const Vector2D& value);
+
+// octahedral encoding quantized to snorm16, zero length direction is stored as +Z
+void PackNormalOctahedralSnorm16(const Vector3D& dir, int16 packed[2]);
+Vector3D UnpackNormalOctahedralSnorm16(const int16 packed[2]);
+
 #define f3_f(c) (dot(round((c) * 255.0), Vector3D(65536.0, 256.0, 1.0)))
 #define f_f3(f) (fract((f) / Vector3D(16777216.0, 65536.0, 256.0)))
 
@@ -46,7 +46,8 @@ static EKVPairType KV_ResolvePairType( const char* string )
 static int KV_ReadProcessString( const char* pszStr, char* dest, int maxLength = INT_MAX )
 {
 	// convert some symbols to special ones
-	size_t processLen = min(strlen( pszStr ), maxLength);
+	// don't look past maxLength, string may be not terminated until end of the buffer
+	size_t processLen = strnlen( pszStr, maxLength );
 
 	const char* ptr = pszStr;
 	char* ptrTemp = dest;
@@ -112,19 +113,131 @@ static int KV_ReadProcessString( const char* pszStr, char* dest, int maxLength =
 #define KV_ESCAPE_SYMBOL			'\\'
 
 #define KV_IDENT_BINARY				MCHAR4('B','K','V','S')
+#define KV_IDENT_COMPILED			MCHAR4('B','K','V','C')
+
+#define KV_COMPILED_VERSION			3
+#define KV_COMPILED_CACHE_FOLDER	"KVCache"
 
 #define IsKVBufferEOF()				((pData - pszBuffer) > bufferSize-1)
 #define IsKVArrayEndOrSeparator(c)	((c) == KV_ARRAY_SEPARATOR || (c) == KV_ARRAY_END)
 #define IsKVWhitespace(c)			(isspace(c) || (c) == KV_STRING_NEWLINE || (c) == KV_STRING_CARRIAGERETURN)
 
+#define KV_ARENA_STRING_BLOCK		(16 * 1024)
+
 //-----------------------------------------------------------------------------------------
+// Document memory. Nodes are pooled, strings are never freed until arena is released
 
-KVPairValue::~KVPairValue()
+struct KVArena
+{
+	MemoryPool<KVSection, 256>		sections{ PP_SL };
+	MemoryPool<KVPairValue, 1024>	values{ PP_SL };
+
+	Array<char*>					stringBlocks{ PP_SL };
+	char*							stringPtr{ nullptr };
+	int								stringSpace{ 0 };
+
+	~KVArena()
+	{
+		for (char* block : stringBlocks)
+			PPFree(block);
+	}
+
+	char* AllocString(int size)
+	{
+		if (size > stringSpace)
+		{
+			// long strings get their own block so current one is still used
+			if (size > KV_ARENA_STRING_BLOCK / 4)
+			{
+				char* block = (char*)PPAlloc(size);
+				stringBlocks.append(block);
+				return block;
+			}
+
+			stringPtr = (char*)PPAlloc(KV_ARENA_STRING_BLOCK);
+			stringSpace = KV_ARENA_STRING_BLOCK;
+			stringBlocks.append(stringPtr);
+		}
+
+		char* str = stringPtr;
+		stringPtr += size;
+		stringSpace -= size;
+
+		return str;
+	}
+};
+
+static KVSection* KV_AllocSection(KVArena* arena)
+{
+	if (!arena)
+		return PPNew KVSection();
+
+	KVSection* section = new(arena->sections.allocate()) KVSection();
+	section->arena = arena;
+
+	return section;
+}
+
+static void KV_FreeSection(KVSection* section)
 {
-	PPFree(value);
+	if (!section)
+		return;
+
+	if (section->arena && !section->arenaOwner)
+	{
+		KVArena* arena = section->arena;
+		section->~KVSection();
+		arena->sections.deallocate(section);
+		return;
+	}
+
 	delete section;
 }
 
+static KVPairValue* KV_AllocValue(KVArena* arena)
+{
+	if (!arena)
+		return PPNew KVPairValue();
+
+	KVPairValue* value = new(arena->values.allocate()) KVPairValue();
+	value->arena = arena;
+
+	return value;
+}
+
+static void KV_FreeValue(KVPairValue* value)
+{
+	if (value->arena)
+	{
+		KVArena* arena = value->arena;
+		value->~KVPairValue();
+		arena->values.deallocate(value);
+		return;
+	}
+
+	delete value;
+}
+
+// root section of parsed document creates arena for it's contents
+static void KV_InitArena(KVSection* section)
+{
+	if (section->arena)
+		return;
+
+	section->arena = PPNew KVArena();
+	section->arenaOwner = true;
+}
+
+//-----------------------------------------------------------------------------------------
+
+KVPairValue::~KVPairValue()
+{
+	if (!arena)
+		PPFree(value);
+
+	KV_FreeSection(section);
+}
+
 void KVPairValue::SetFrom(KVPairValue* from)
 {
 	ASSERT(from != nullptr);
@@ -156,14 +269,15 @@ void KVPairValue::SetStringValue( const char* pszValue, int len /* = -1*/)
 {
 	if(value)
 	{
-		PPFree(value);
+		if (!arena)
+			PPFree(value);
 		value = nullptr;
 	}
 
 	if (len < 0)
 		len = strlen(pszValue);
 
-	value = (char*)PPAlloc(len+1);
+	value = arena ? arena->AllocString(len + 1) : (char*)PPAlloc(len + 1);
 	strncpy(value, pszValue, len);
 	value[len] = 0;
 }
@@ -174,7 +288,8 @@ void KVPairValue::SetFromString( const char* pszValue )
 
 	SetStringValue( pszValue );
 
-	SAFE_DELETE(section);
+	KV_FreeSection(section);
+	section = nullptr;
 
 	if(type == KVPAIR_INT)
 	{
@@ -396,15 +511,23 @@ void KVSection::Cleanup()
 	ClearValues();
 
 	for(int i = 0; i < keys.numElem(); i++)
-		delete keys[i];
+		KV_FreeSection(keys[i]);
 
 	keys.clear();
+	RebuildKeysIndex();
+
+	if (arenaOwner)
+	{
+		delete arena;
+		arena = nullptr;
+		arenaOwner = false;
+	}
 }
 
 void KVSection::ClearValues()
 {
 	for(int i = 0; i < values.numElem(); i++)
-		delete values[i];
+		KV_FreeValue(values[i]);
 
 	values.clear();
 }
@@ -427,8 +550,7 @@ const char*	KVSection::GetName() const
 
 KVPairValue* KVSection::CreateValue()
 {
-	// TODO: pool
-	KVPairValue* val = PPNew KVPairValue();
+	KVPairValue* val = KV_AllocValue(arena);
 
 	val->type = type;
 
@@ -442,20 +564,20 @@ KVSection* KVSection::CreateSectionValue()
 	if(type != KVPAIR_SECTION)
 		return nullptr;
 
-	// TODO: pool
-	KVPairValue* val = PPNew KVPairValue();
+	KVPairValue* val = KV_AllocValue(arena);
 
 	val->type = type;
 
 	values.append(val);
 
-	val->section = PPNew KVSection();
+	val->section = KV_AllocSection(arena);
 	return val->section;
 }
 
 KVSection* KVSection::Clone() const
 {
 	KVSection* newKey = PPNew KVSection();
+	KV_InitArena(newKey);
 
 	CopyTo(newKey);
 
@@ -467,7 +589,7 @@ void KVSection::CopyTo(KVSection* dest) const
 	CopyValuesTo(dest);
 
 	for(int i = 0; i < keys.numElem(); i++)
-		dest->AddKey(keys[i]->GetName(), keys[i]->Clone());
+		dest->AddKey(keys[i]->GetName(), keys[i]);
 }
 
 void KVSection::CopyValuesTo(KVSection* dest) const
@@ -867,7 +989,16 @@ KVSection* KVSection::FindSection(const char* pszName, int nFlags) const
 {
 	const int hash = StringToHash(pszName, true);
 
-	for(int i = 0; i < keys.numElem(); i++)
+	// index gives first key with this name, rest is checked for flags as usual
+	int firstKey = 0;
+	if (m_numIndexedKeys && m_numIndexedKeys == keys.numElem())
+	{
+		firstKey = FindIndexedKey(hash);
+		if (firstKey == -1)
+			return nullptr;
+	}
+
+	for(int i = firstKey; i < keys.numElem(); i++)
 	{
 		if((nFlags & KV_FLAG_SECTION) && keys[i]->keys.numElem() == 0)
 			continue;
@@ -889,11 +1020,12 @@ KVSection* KVSection::FindSection(const char* pszName, int nFlags) const
 // adds new keybase
 KVSection* KVSection::CreateSection( const char* pszName, const char* pszValue, EKVPairType pairType)
 {
-	KVSection* pKeyBase = PPNew KVSection;
+	KVSection* pKeyBase = KV_AllocSection(arena);
 	pKeyBase->SetName(pszName);
 	pKeyBase->type = pairType;
 
 	keys.append( pKeyBase );
+	IndexKeys(keys.numElem() - 1);
 
 	if(pszValue != nullptr)
 	{
@@ -908,7 +1040,10 @@ KVSection* KVSection::CreateSection( const char* pszName, const char* pszValue,
 void KVSection::AddSection(KVSection* keyBase)
 {
 	if(keyBase != nullptr)
+	{
 		keys.append( keyBase );
+		IndexKeys(keys.numElem() - 1);
+	}
 }
 
 // removes key base by name
@@ -921,15 +1056,17 @@ void KVSection::RemoveSectionByName( const char* name, bool removeAll )
 		if(keys[i]->nameHash == strHash)
 		//if(!stricmp(keys[i]->name, name))
 		{
-			delete keys[i];
+			KV_FreeSection(keys[i]);
 			keys.removeIndex(i);
 
 			if(removeAll)
 				i--;
 			else
-				return;
+				break;
 		}
 	}
+
+	RebuildKeysIndex();
 }
 
 void KVSection::RemoveSection(KVSection* base)
@@ -938,13 +1075,72 @@ void KVSection::RemoveSection(KVSection* base)
 	{
 		if(keys[i] == base)
 		{
-			delete keys[i];
+			KV_FreeSection(keys[i]);
 			keys.removeIndex(i);
+			RebuildKeysIndex();
 			return;
 		}
 	}
 }
 
+// adds keys starting from firstKey to lookup index
+void KVSection::IndexKeys(int firstKey)
+{
+	if (keys.numElem() < KV_KEYS_INDEX_MIN)
+		return;
+
+	// keep table at most half full
+	if (keys.numElem() * 2 > m_keysIndex.numElem())
+	{
+		RebuildKeysIndex();
+		return;
+	}
+
+	const int mask = m_keysIndex.numElem() - 1;
+	for (int i = firstKey; i < keys.numElem(); ++i)
+	{
+		const int nameHash = keys[i]->nameHash;
+
+		int slot = nameHash & mask;
+		while (m_keysIndex[slot].keyIdx != -1 && m_keysIndex[slot].nameHash != nameHash)
+			slot = (slot + 1) & mask;
+
+		// only first key with same name is indexed
+		if (m_keysIndex[slot].keyIdx == -1)
+			m_keysIndex[slot] = { nameHash, i };
+	}
+
+	m_numIndexedKeys = keys.numElem();
+}
+
+void KVSection::RebuildKeysIndex()
+{
+	m_keysIndex.clear();
+	m_numIndexedKeys = 0;
+
+	if (keys.numElem() < KV_KEYS_INDEX_MIN)
+		return;
+
+	int tableSize = KV_KEYS_INDEX_MIN * 2;
+	while (tableSize < keys.numElem() * 4)
+		tableSize <<= 1;
+
+	m_keysIndex.assureSizeEmplace(tableSize, KeyIndexEntry{ 0, -1 });
+	IndexKeys(0);
+}
+
+int KVSection::FindIndexedKey(int nameHash) const
+{
+	const int mask = m_keysIndex.numElem() - 1;
+	for (int slot = nameHash & mask; m_keysIndex[slot].keyIdx != -1; slot = (slot + 1) & mask)
+	{
+		if (m_keysIndex[slot].nameHash == nameHash)
+			return m_keysIndex[slot].keyIdx;
+	}
+
+	return -1;
+}
+
 void KVSection::MergeFrom(const KVSection* base, bool recursive)
 {
 	if(base == nullptr)
@@ -1265,6 +1461,7 @@ KVSection* KV_ParseSectionV2(const char* pszBuffer, int bufferSize, const char*
 		if (!rootSection)
 			rootSection = PPNew KVSection;
 
+		KV_InitArena(rootSection);
 		sectionStack.append(rootSection);
 	}
 
@@ -1347,6 +1544,7 @@ KVSection* KV_ParseSectionV3( const char* pszBuffer, int bufferSize, const char*
 		if (!rootSection)
 			rootSection = PPNew KVSection;
 
+		KV_InitArena(rootSection);
 		sectionStack.append(rootSection);
 	}
 
@@ -1569,6 +1767,7 @@ KVSection* KV_LoadFromStream(IVirtualStream* stream, KVSection* pParseTo)
 
 	bool isUTF8 = false;
 	bool isBinary = false;
+	bool isCompiled = false;
 
 	if (byteordermark == 0xbbef)
 	{
@@ -1592,6 +1791,11 @@ KVSection* KV_LoadFromStream(IVirtualStream* stream, KVSection* pParseTo)
 			isBinary = true;
 			isUTF8 = true;
 		}
+		else if (ident == KV_IDENT_COMPILED)
+		{
+			isCompiled = true;
+			isUTF8 = true;
+		}
 	}
 
 	// load as stream
@@ -1599,6 +1803,16 @@ KVSection* KV_LoadFromStream(IVirtualStream* stream, KVSection* pParseTo)
 
 	if (isBinary)
 		pBase = KV_ParseBinary(_buffer, fileSize, pParseTo);
+	else if (isCompiled)
+	{
+		const KVView root = KV_GetCompiledView(_buffer, fileSize);
+		if (root)
+		{
+			pBase = pParseTo ? pParseTo : PPNew KVSection();
+			KV_InitArena(pBase);
+			root.CopyTo(pBase);
+		}
+	}
 	else
 		pBase = KV_ParseSection(_buffer, fileSize, stream->GetName(), pParseTo, 0);
 
@@ -1701,10 +1915,12 @@ void KV_ReadBinaryValue(IVirtualStream* stream, KVSection* addTo)
 	}
 	else if(binValue.type == KVPAIR_SECTION)
 	{
-		KVSection* parsed = KV_ReadBinaryBase(stream, nullptr);
+		KVSection* parsed = KV_AllocSection(addTo->arena);
 
-		if(parsed)
+		if(KV_ReadBinaryBase(stream, parsed))
 			addTo->AddValue(parsed);
+		else
+			KV_FreeSection(parsed);
 	}
 }
 
@@ -1721,7 +1937,10 @@ KVSection* KV_ReadBinaryBase(IVirtualStream* stream, KVSection* pParseTo)
 	}
 
 	if(!pParseTo)
+	{
 		pParseTo = PPNew KVSection();
+		KV_InitArena(pParseTo);
+	}
 
 	// read name after keybase header
 	char* nameTemp = (char*)stackalloc(binBase.nameLen+1);
@@ -1742,8 +1961,12 @@ KVSection* KV_ReadBinaryBase(IVirtualStream* stream, KVSection* pParseTo)
 	// read nested keybases as well
 	for(int i = 0; i < binBase.keyCount; i++)
 	{
-		KVSection* parsed = KV_ReadBinaryBase(stream, nullptr);
-		pParseTo->AddSection(parsed);
+		KVSection* parsed = KV_AllocSection(pParseTo->arena);
+
+		if(KV_ReadBinaryBase(stream, parsed))
+			pParseTo->AddSection(parsed);
+		else
+			KV_FreeSection(parsed);
 	}
 
 	return pParseTo;
@@ -1820,6 +2043,635 @@ void KV_WriteToStreamBinary(IVirtualStream* outStream, const KVSection* base)
 	}
 }
 
+//-----------------------------------------------------------------------------------------------------
+// COMPILED
+
+struct kvcompiledhdr_s
+{
+	int		ident;			// it must be identified by KV_IDENT_COMPILED
+	int		version;
+	int		size;			// size of whole block including header
+
+	int		sourceName;		// text file that was compiled, string offset
+	int		sourceSize;
+	uint32	sourceModTime;
+
+	int		numSections;
+	int		numValues;
+	int		stringsSize;
+
+	// next after header:
+	// - sections, first is root
+	// - values
+	// - strings
+};
+ALIGNED_TYPE(kvcompiledhdr_s, 4) kvcompiledhdr_t;
+
+struct kvcompiledsection_s
+{
+	int		name;			// offset in strings
+	int		nameHash;
+	int		type;			// EKVPairType
+	int		line;
+
+	int		firstValue;
+	int		numValues;
+
+	int		firstKey;		// nested sections are stored next to each other
+	int		numKeys;
+};
+ALIGNED_TYPE(kvcompiledsection_s, 4) kvcompiledsection_t;
+
+struct kvcompiledvalue_s
+{
+	int		type;			// EKVPairType
+
+	union
+	{
+		int		nValue;
+		int		bValue;
+		float	fValue;
+	};
+
+	int		string;			// offset in strings, -1 if value has no string
+	int		section;		// section index if KVPAIR_SECTION
+};
+ALIGNED_TYPE(kvcompiledvalue_s, 4) kvcompiledvalue_t;
+
+static const kvcompiledsection_t* KV_CompiledSections(const kvcompiledhdr_t* hdr)
+{
+	return (const kvcompiledsection_t*)(hdr + 1);
+}
+
+static const kvcompiledvalue_t* KV_CompiledValues(const kvcompiledhdr_t* hdr)
+{
+	return (const kvcompiledvalue_t*)(KV_CompiledSections(hdr) + hdr->numSections);
+}
+
+static const char* KV_CompiledString(const kvcompiledhdr_t* hdr, int offset)
+{
+	if (offset < 0)
+		return nullptr;
+
+	return (const char*)(KV_CompiledValues(hdr) + hdr->numValues) + offset;
+}
+
+struct KVCompileState
+{
+	Array<kvcompiledsection_t>	sections{ PP_SL };
+	Array<kvcompiledvalue_t>	values{ PP_SL };
+	Array<char>					strings{ PP_SL };
+	Map<int, int>				stringOffsets{ PP_SL };
+
+	Array<const KVSection*>		pending{ PP_SL };		// source of allocated sections
+
+	int AddString(const char* str)
+	{
+		if (!str)
+			return -1;
+
+		// most of names and values are repeated
+		const int hash = StringToHash(str);
+		auto it = stringOffsets.find(hash);
+		if (!it.atEnd() && !strcmp(&strings[*it], str))
+			return *it;
+
+		const int offset = strings.numElem();
+		strings.append(str, strlen(str) + 1);
+
+		if (it.atEnd())
+			stringOffsets.insert(hash, offset);
+
+		return offset;
+	}
+
+	int AllocSection(const KVSection* src)
+	{
+		pending.append(src);
+		return sections.append(kvcompiledsection_t{});
+	}
+
+	void CompileSection(int index)
+	{
+		const KVSection* src = pending[index];
+
+		kvcompiledsection_t section;
+		section.name = AddString(src->name);
+		section.nameHash = src->nameHash;
+		section.type = src->type;
+		section.line = src->line;
+		section.firstValue = values.numElem();
+		section.numValues = src->values.numElem();
+
+		for (int i = 0; i < src->values.numElem(); ++i)
+		{
+			const KVPairValue* srcValue = src->values[i];
+
+			kvcompiledvalue_t value;
+			value.type = srcValue->type;
+			value.nValue = 0;
+			value.string = AddString(srcValue->value);
+			value.section = -1;
+
+			if (srcValue->type == KVPAIR_INT)
+				value.nValue = srcValue->nValue;
+			else if (srcValue->type == KVPAIR_FLOAT)
+				value.fValue = srcValue->fValue;
+			else if (srcValue->type == KVPAIR_BOOL)
+				value.bValue = srcValue->bValue ? 1 : 0;
+			else if (srcValue->type == KVPAIR_SECTION && srcValue->section)
+				value.section = AllocSection(srcValue->section);
+
+			values.append(value);
+		}
+
+		// allocated at once so nested sections are contiguous
+		section.firstKey = sections.numElem();
+		section.numKeys = src->keys.numElem();
+
+		for (int i = 0; i < src->keys.numElem(); ++i)
+			AllocSection(src->keys[i]);
+
+		sections[index] = section;
+	}
+};
+
+// writes key-values in compiled form
+void KV_WriteToStreamCompiled(IVirtualStream* outStream, const KVSection* base, const char* sourceName, int sourceSize, uint32 sourceModTime)
+{
+	KVCompileState state;
+	state.AllocSection(base);
+
+	for (int i = 0; i < state.pending.numElem(); ++i)
+		state.CompileSection(i);
+
+	const int sourceNameOffset = state.AddString(sourceName);
+
+	// keep block size aligned
+	while (state.strings.numElem() & 3)
+		state.strings.append('\0');
+
+	kvcompiledhdr_t hdr;
+	hdr.ident = KV_IDENT_COMPILED;
+	hdr.version = KV_COMPILED_VERSION;
+	hdr.sourceName = sourceNameOffset;
+	hdr.sourceSize = sourceSize;
+	hdr.sourceModTime = sourceModTime;
+	hdr.numSections = state.sections.numElem();
+	hdr.numValues = state.values.numElem();
+	hdr.stringsSize = state.strings.numElem();
+	hdr.size = sizeof(kvcompiledhdr_t)
+		+ hdr.numSections * sizeof(kvcompiledsection_t)
+		+ hdr.numValues * sizeof(kvcompiledvalue_t)
+		+ hdr.stringsSize;
+
+	outStream->Write(&hdr, 1, sizeof(hdr));
+	outStream->Write(state.sections.ptr(), hdr.numSections, sizeof(kvcompiledsection_t));
+	outStream->Write(state.values.ptr(), hdr.numValues, sizeof(kvcompiledvalue_t));
+	outStream->Write(state.strings.ptr(), 1, hdr.stringsSize);
+}
+
+//
+// Checks every index and string offset so views never read outside of block.
+// Sections must form a tree where each nested section is stored after it's owner
+//
+static bool KV_ValidateCompiled(const kvcompiledhdr_t* hdr)
+{
+	const kvcompiledsection_t* sections = KV_CompiledSections(hdr);
+	const kvcompiledvalue_t* values = KV_CompiledValues(hdr);
+	const char* strings = KV_CompiledString(hdr, 0);
+
+	// strings are used as C strings
+	if (hdr->stringsSize > 0 && strings[hdr->stringsSize - 1] != '\0')
+		return false;
+
+	auto isValidString = [hdr](int offset) {
+		return offset >= -1 && offset < hdr->stringsSize;
+	};
+
+	if (!isValidString(hdr->sourceName))
+		return false;
+
+	// each section except root must be referenced once
+	Array<ubyte> referenced(PP_SL);
+	referenced.setNum(hdr->numSections);
+	memset(referenced.ptr(), 0, hdr->numSections);
+	referenced[0] = 1;
+
+	auto referenceSection = [&](int owner, int index) {
+		if (index <= owner || index >= hdr->numSections || referenced[index])
+			return false;
+		referenced[index] = 1;
+		return true;
+	};
+
+	for (int i = 0; i < hdr->numSections; ++i)
+	{
+		const kvcompiledsection_t& section = sections[i];
+
+		if (!isValidString(section.name) || (uint)section.type >= KVPAIR_TYPES)
+			return false;
+
+		if (section.firstValue < 0 || section.numValues < 0 || section.numValues > hdr->numValues - section.firstValue)
+			return false;
+
+		if (section.numKeys < 0 || (section.numKeys > 0 && (section.firstKey <= i || section.numKeys > hdr->numSections - section.firstKey)))
+			return false;
+
+		for (int j = 0; j < section.numKeys; ++j)
+		{
+			if (!referenceSection(i, section.firstKey + j))
+				return false;
+		}
+
+		for (int j = section.firstValue; j < section.firstValue + section.numValues; ++j)
+		{
+			const kvcompiledvalue_t& value = values[j];
+
+			if (!isValidString(value.string) || (uint)value.type >= KVPAIR_TYPES)
+				return false;
+
+			if (value.section != -1 && (value.type != KVPAIR_SECTION || !referenceSection(i, value.section)))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// returns root of compiled key-values, invalid view if data is not valid
+KVView KV_GetCompiledView(const void* data, int dataSize)
+{
+	const kvcompiledhdr_t* hdr = (const kvcompiledhdr_t*)data;
+
+	if (!hdr || dataSize < (int)sizeof(kvcompiledhdr_t))
+		return KVView();
+
+	if (hdr->ident != KV_IDENT_COMPILED || hdr->version != KV_COMPILED_VERSION)
+		return KVView();
+
+	if (hdr->numSections <= 0 || hdr->numValues < 0 || hdr->stringsSize < 0)
+		return KVView();
+
+	const int64 expectedSize = (int64)sizeof(kvcompiledhdr_t)
+		+ (int64)hdr->numSections * sizeof(kvcompiledsection_t)
+		+ (int64)hdr->numValues * sizeof(kvcompiledvalue_t)
+		+ hdr->stringsSize;
+
+	if (hdr->size != expectedSize || hdr->size > dataSize)
+		return KVView();
+
+	if (!KV_ValidateCompiled(hdr))
+		return KVView();
+
+	return KVView(hdr, 0);
+}
+
+//-------------------------------------------------------------
+
+const char* KVView::GetName() const
+{
+	return KV_CompiledString(m_hdr, KV_CompiledSections(m_hdr)[m_section].name);
+}
+
+int KVView::GetNameHash() const
+{
+	return KV_CompiledSections(m_hdr)[m_section].nameHash;
+}
+
+int KVView::GetLine() const
+{
+	return KV_CompiledSections(m_hdr)[m_section].line;
+}
+
+EKVPairType KVView::GetType() const
+{
+	return (EKVPairType)KV_CompiledSections(m_hdr)[m_section].type;
+}
+
+KVView KVView::FindSection(const char* pszName, int nFlags) const
+{
+	if (!m_hdr)
+		return KVView();
+
+	const int hash = StringToHash(pszName, true);
+
+	const kvcompiledsection_t* sections = KV_CompiledSections(m_hdr);
+	const kvcompiledsection_t& section = sections[m_section];
+
+	for (int i = section.firstKey; i < section.firstKey + section.numKeys; ++i)
+	{
+		const kvcompiledsection_t& key = sections[i];
+
+		if ((nFlags & KV_FLAG_SECTION) && key.numKeys == 0)
+			continue;
+
+		if ((nFlags & KV_FLAG_NOVALUE) && key.numValues > 0)
+			continue;
+
+		if ((nFlags & KV_FLAG_ARRAY) && key.numValues <= 1)
+			continue;
+
+		if (key.nameHash == hash)
+			return KVView(m_hdr, i);
+	}
+
+	return KVView();
+}
+
+int KVView::KeyCount() const
+{
+	return m_hdr ? KV_CompiledSections(m_hdr)[m_section].numKeys : 0;
+}
+
+KVView KVView::KeyAt(int idx) const
+{
+	const kvcompiledsection_t& section = KV_CompiledSections(m_hdr)[m_section];
+	ASSERT(idx >= 0 && idx < section.numKeys);
+
+	return KVView(m_hdr, section.firstKey + idx);
+}
+
+int KVView::ValueCount() const
+{
+	return m_hdr ? KV_CompiledSections(m_hdr)[m_section].numValues : 0;
+}
+
+EKVPairType KVView::ValueTypeAt(int idx) const
+{
+	const kvcompiledsection_t& section = KV_CompiledSections(m_hdr)[m_section];
+	ASSERT(idx >= 0 && idx < section.numValues);
+
+	return (EKVPairType)KV_CompiledValues(m_hdr)[section.firstValue + idx].type;
+}
+
+KVView KVView::ValueSectionAt(int idx) const
+{
+	const kvcompiledsection_t& section = KV_CompiledSections(m_hdr)[m_section];
+	ASSERT(idx >= 0 && idx < section.numValues);
+
+	const kvcompiledvalue_t& value = KV_CompiledValues(m_hdr)[section.firstValue + idx];
+	if (value.section < 0)
+		return KVView();
+
+	return KVView(m_hdr, value.section);
+}
+
+const char* KVView::GetValueString(int nIndex, const char* pszDefault) const
+{
+	if (nIndex < 0 || nIndex >= ValueCount())
+		return pszDefault;
+
+	const kvcompiledvalue_t& value = KV_CompiledValues(m_hdr)[KV_CompiledSections(m_hdr)[m_section].firstValue + nIndex];
+	return KV_CompiledString(m_hdr, value.string);
+}
+
+int KVView::GetValueInt(int nIndex, int nDefault) const
+{
+	if (nIndex < 0 || nIndex >= ValueCount())
+		return nDefault;
+
+	const kvcompiledvalue_t& value = KV_CompiledValues(m_hdr)[KV_CompiledSections(m_hdr)[m_section].firstValue + nIndex];
+
+	if (value.type == KVPAIR_INT)
+		return value.nValue;
+	else if (value.type == KVPAIR_FLOAT)
+		return value.fValue;
+	else if (value.type == KVPAIR_BOOL)
+		return value.bValue ? 1 : 0;
+
+	return value.string >= 0 ? atoi(KV_CompiledString(m_hdr, value.string)) : nDefault;
+}
+
+float KVView::GetValueFloat(int nIndex, float fDefault) const
+{
+	if (nIndex < 0 || nIndex >= ValueCount())
+		return fDefault;
+
+	const kvcompiledvalue_t& value = KV_CompiledValues(m_hdr)[KV_CompiledSections(m_hdr)[m_section].firstValue + nIndex];
+
+	if (value.type == KVPAIR_FLOAT)
+		return value.fValue;
+	else if (value.type == KVPAIR_INT)
+		return value.nValue;
+	else if (value.type == KVPAIR_BOOL)
+		return value.bValue ? 1 : 0;
+
+	return value.string >= 0 ? atof(KV_CompiledString(m_hdr, value.string)) : fDefault;
+}
+
+bool KVView::GetValueBool(int nIndex, bool bDefault) const
+{
+	if (nIndex < 0 || nIndex >= ValueCount())
+		return bDefault;
+
+	const kvcompiledvalue_t& value = KV_CompiledValues(m_hdr)[KV_CompiledSections(m_hdr)[m_section].firstValue + nIndex];
+
+	if (value.type == KVPAIR_BOOL)
+		return value.bValue;
+	else if (value.type == KVPAIR_FLOAT)
+		return value.fValue > 0.0f;
+
+	return value.string >= 0 ? atoi(KV_CompiledString(m_hdr, value.string)) > 0 : bDefault;
+}
+
+Vector2D KVView::GetVector2D(int nIndex, const Vector2D& vDefault) const
+{
+	return Vector2D(GetValueFloat(nIndex, vDefault.x), GetValueFloat(nIndex + 1, vDefault.y));
+}
+
+Vector3D KVView::GetVector3D(int nIndex, const Vector3D& vDefault) const
+{
+	return Vector3D(GetValueFloat(nIndex, vDefault.x), GetValueFloat(nIndex + 1, vDefault.y), GetValueFloat(nIndex + 2, vDefault.z));
+}
+
+Vector4D KVView::GetVector4D(int nIndex, const Vector4D& vDefault) const
+{
+	return Vector4D(GetValueFloat(nIndex, vDefault.x), GetValueFloat(nIndex + 1, vDefault.y), 
+		GetValueFloat(nIndex + 2, vDefault.z), GetValueFloat(nIndex + 3, vDefault.w));
+}
+
+void KVView::CopyTo(KVSection* dest) const
+{
+	const kvcompiledsection_t& section = KV_CompiledSections(m_hdr)[m_section];
+	const kvcompiledvalue_t* values = KV_CompiledValues(m_hdr);
+
+	dest->SetName(GetName());
+	dest->type = (EKVPairType)section.type;
+	dest->line = section.line;
+	dest->unicode = true;
+
+	for (int i = section.firstValue; i < section.firstValue + section.numValues; ++i)
+	{
+		const kvcompiledvalue_t& value = values[i];
+
+		KVPairValue* val = dest->CreateValue();
+		val->type = (EKVPairType)value.type;
+
+		if (value.string >= 0)
+			val->SetStringValue(KV_CompiledString(m_hdr, value.string));
+
+		if (value.type == KVPAIR_INT)
+			val->nValue = value.nValue;
+		else if (value.type == KVPAIR_FLOAT)
+			val->fValue = value.fValue;
+		else if (value.type == KVPAIR_BOOL)
+			val->bValue = value.bValue != 0;
+		else if (value.type == KVPAIR_SECTION && value.section >= 0)
+		{
+			val->section = KV_AllocSection(dest->arena);
+			KVView(m_hdr, value.section).CopyTo(val->section);
+		}
+	}
+
+	for (int i = 0; i < section.numKeys; ++i)
+	{
+		KVSection* key = KV_AllocSection(dest->arena);
+		KVView(m_hdr, section.firstKey + i).CopyTo(key);
+		dest->AddSection(key);
+	}
+}
+
+//-------------------------------------------------------------
+
+KVCompiledFile::~KVCompiledFile()
+{
+	Reset();
+}
+
+void KVCompiledFile::Reset()
+{
+	m_root = KVView();
+	m_file = nullptr;
+
+	PPFree(m_buffer);
+	m_buffer = nullptr;
+}
+
+bool KVCompiledFile::InitFromFile(const IVirtualStreamPtr& file)
+{
+	const int fileSize = file->GetSize();
+
+	// views read header and sections in place, mapping must be aligned like them
+	const void* data = file->GetMappedData();
+	if (data && ((uintptr_t)data & (alignof(kvcompiledhdr_t) - 1)) == 0)
+	{
+		m_file = file;
+	}
+	else
+	{
+		m_buffer = (ubyte*)PPAlloc(fileSize);
+		file->Read(m_buffer, 1, fileSize);
+		data = m_buffer;
+	}
+
+	m_root = KV_GetCompiledView(data, fileSize);
+	if (!m_root)
+	{
+		Reset();
+		return false;
+	}
+
+	return true;
+}
+
+//
+// Loads compiled key-values file in place.
+// Text files are compiled and put into cache so next loads don't parse them,
+// cache is matched by source path, size and modification time
+//
+bool KVCompiledFile::LoadFromFile(const char* pszFileName, int nSearchFlags)
+{
+	Reset();
+
+	int sourceSize = 0;
+	int64 sourceModTime = 0;
+	if (!g_fileSystem->GetFileStat(pszFileName, sourceSize, sourceModTime, nSearchFlags))
+	{
+		DevMsg(1, "Can't open key-values file '%s'\n", pszFileName);
+		return false;
+	}
+
+	const EqString cacheFileName = EqString::Format(KV_COMPILED_CACHE_FOLDER "/%x.kvc", StringToHash(pszFileName, true));
+
+	// compiled source files never have cache
+	{
+		IFilePtr cacheFile = g_fileSystem->Open(cacheFileName.ToCString(), "rb", SP_MOD);
+		if (cacheFile && InitFromFile(cacheFile))
+		{
+			// cache name is a hash of path, other file may have the same one
+			const kvcompiledhdr_t* hdr = m_root.m_hdr;
+			const char* cacheSourceName = KV_CompiledString(hdr, hdr->sourceName);
+			if (cacheSourceName && !stricmp(cacheSourceName, pszFileName)
+				&& hdr->sourceSize == sourceSize && hdr->sourceModTime == (uint32)sourceModTime)
+				return true;
+
+			Reset();
+		}
+	}
+
+	IFilePtr file = g_fileSystem->Open(pszFileName, "rb", nSearchFlags);
+	if (!file)
+	{
+		DevMsg(1, "Can't open key-values file '%s'\n", pszFileName);
+		return false;
+	}
+
+	uint ident = 0;
+	file->Read(&ident, 1, sizeof(ident));
+	file->Seek(0, VS_SEEK_SET);
+
+	if (ident == KV_IDENT_COMPILED)
+	{
+		if (InitFromFile(file))
+			return true;
+
+		MsgError("Invalid compiled key-values file '%s'\n", pszFileName);
+		return false;
+	}
+
+	KVSection root;
+	{
+		CMemoryStream sourceStream(PPSourceLine::Make(pszFileName, 0));
+		sourceStream.Open(nullptr, VS_OPEN_WRITE | VS_OPEN_READ, file->GetSize());
+		sourceStream.AppendStream(file);
+		sourceStream.Seek(0, VS_SEEK_SET);
+		file = nullptr;
+
+		if (!KV_LoadFromStream(&sourceStream, &root))
+			return false;
+	}
+	root.SetName(_Es(pszFileName).Path_Strip_Path().ToCString());
+
+	CMemoryStream compiled(nullptr, VS_OPEN_WRITE | VS_OPEN_READ, sourceSize, PP_SL);
+	KV_WriteToStreamCompiled(&compiled, &root, pszFileName, sourceSize, (uint32)sourceModTime);
+
+	// game directory is the write path, unlike root which may be read-only
+	g_fileSystem->MakeDir(KV_COMPILED_CACHE_FOLDER, SP_MOD);
+	{
+		IFilePtr cacheFile = g_fileSystem->Open(cacheFileName.ToCString(), "wb", SP_MOD);
+		if (!cacheFile || cacheFile->Write(compiled.GetBasePointer(), compiled.GetSize(), 1) != (size_t)compiled.GetSize())
+			MsgWarning("Can't write key-values cache '%s' for '%s'\n", cacheFileName.ToCString(), pszFileName);
+	}
+
+	m_buffer = (ubyte*)PPAlloc(compiled.GetSize());
+	memcpy(m_buffer, compiled.GetBasePointer(), compiled.GetSize());
+	m_root = KV_GetCompiledView(m_buffer, compiled.GetSize());
+
+	return true;
+}
+
+// copies contents into regular key-values section
+bool KVCompiledFile::CopyTo(KVSection* dest) const
+{
+	if (!m_root)
+		return false;
+
+	KV_InitArena(dest);
+	m_root.CopyTo(dest);
+	return true;
+}
+
 //----------------------------------------------------------------------------------------------
 
 //
@@ -46,6 +46,9 @@ enum EKVPairType
 // tune this (depends on size of used memory)
 #define KV_MAX_NAME_LENGTH		128
 
+// sections with this number of keys get lookup index
+#define KV_KEYS_INDEX_MIN		16
+
 enum KVSearchFlags_e
 {
 	KV_FLAG_SECTION = (1 << 0),
@@ -53,6 +56,8 @@ enum KVSearchFlags_e
 	KV_FLAG_ARRAY	= (1 << 2)
 };
 
+struct KVArena;
+
 //
 // KeyValues typed value holder
 //
@@ -62,6 +67,7 @@ struct KVPairValue
 	{
 		value = nullptr;
 		section = nullptr;
+		arena = nullptr;
 		type = KVPAIR_STRING;
 	}
 
@@ -80,6 +86,8 @@ struct KVPairValue
 
 	char*				value;
 
+	KVArena*			arena;		// value and string memory is owned by document arena
+
 	// sets string value
 	void				SetStringValue(const char* pszValue, int len = -1);
 	void				SetFromString(const char* pszValue);
@@ -239,6 +247,26 @@ struct KVSection
 	// the nested keys
 	Array<KVSection*>		keys{ PP_SL };
 	bool					unicode;
+
+	// nested sections, values and strings are allocated from arena of document.
+	// Arena is released by the section which created it
+	KVArena*				arena{ nullptr };
+	bool					arenaOwner{ false };
+
+private:
+	struct KeyIndexEntry
+	{
+		int		nameHash;
+		int		keyIdx;
+	};
+
+	void					IndexKeys(int firstKey);
+	void					RebuildKeysIndex();
+	int						FindIndexedKey(int nameHash) const;
+
+	// open addressing hash table of first key index with name hash
+	Array<KeyIndexEntry>	m_keysIndex{ PP_SL };
+	int						m_numIndexedKeys{ 0 };
 };
 
 // special wrapper class
@@ -268,6 +296,85 @@ private:
 	KVSection	m_root;
 };
 
+//---------------------------------------------------------------------------------------------------------
+// Compiled KeyValues
+//---------------------------------------------------------------------------------------------------------
+
+struct kvcompiledhdr_s;
+
+//
+// Read-only view of compiled key-values section.
+// Sections, values and strings are stored in single block
+// which is used in place, even from memory mapped file
+//
+class KVView
+{
+public:
+	KVView() = default;
+
+	bool				IsValid() const { return m_hdr != nullptr; }
+	explicit			operator bool() const { return m_hdr != nullptr; }
+
+	const char*			GetName() const;
+	int					GetNameHash() const;
+	int					GetLine() const;
+	EKVPairType			GetType() const;
+
+	// searches for nested section, see KVSection::FindSection
+	KVView				FindSection(const char* pszName, int nFlags = 0) const;
+
+	int					KeyCount() const;
+	KVView				KeyAt(int idx) const;
+
+	int					ValueCount() const;
+	EKVPairType			ValueTypeAt(int idx) const;
+	KVView				ValueSectionAt(int idx) const;
+
+	const char*			GetValueString(int nIndex = 0, const char* pszDefault = "") const;
+	int					GetValueInt(int nIndex = 0, int nDefault = 0) const;
+	float				GetValueFloat(int nIndex = 0, float fDefault = 0.0f) const;
+	bool				GetValueBool(int nIndex = 0, bool bDefault = false) const;
+	Vector2D			GetVector2D(int nIndex = 0, const Vector2D& vDefault = vec2_zero) const;
+	Vector3D			GetVector3D(int nIndex = 0, const Vector3D& vDefault = vec3_zero) const;
+	Vector4D			GetVector4D(int nIndex = 0, const Vector4D& vDefault = vec4_zero) const;
+
+	// builds regular key-values from view
+	void				CopyTo(KVSection* dest) const;
+
+private:
+	KVView(const kvcompiledhdr_s* hdr, int section) : m_hdr(hdr), m_section(section) {}
+
+	friend class KVCompiledFile;
+	friend KVView		KV_GetCompiledView(const void* data, int dataSize);
+
+	const kvcompiledhdr_s*	m_hdr{ nullptr };
+	int						m_section{ 0 };
+};
+
+//
+// Compiled key-values file.
+// Text files are compiled on first load and stored in cache
+//
+class KVCompiledFile
+{
+public:
+	~KVCompiledFile();
+
+	void				Reset();
+
+	bool				LoadFromFile(const char* pszFileName, int nSearchFlags = -1);
+
+	KVView				GetRoot() const { return m_root; }
+	bool				CopyTo(KVSection* dest) const;
+
+private:
+	bool				InitFromFile(const IVirtualStreamPtr& file);
+
+	IVirtualStreamPtr	m_file;					// kept open while data is used from file mapping
+	ubyte*				m_buffer{ nullptr };
+	KVView				m_root;
+};
+
 //---------------------------------------------------------------------------------------------------------
 // KEYVALUES API Functions
 //---------------------------------------------------------------------------------------------------------
@@ -309,6 +416,9 @@ void			KV_WriteToStreamV3(IVirtualStream* outStream, const KVSection* section, i
 
 void			KV_WriteToStreamBinary(IVirtualStream* outStream, const KVSection* base);
 
+void			KV_WriteToStreamCompiled(IVirtualStream* outStream, const KVSection* base, const char* sourceName = nullptr, int sourceSize = 0, uint32 sourceModTime = 0);
+KVView			KV_GetCompiledView(const void* data, int dataSize);
+
 //-----------------------------------------------------------------------------------------------------
 // KeyValues value helpers
 //-----------------------------------------------------------------------------------------------------
@@ -0,0 +1,352 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Triangle list optimization for post-transform vertex cache,
+//				overdraw and vertex fetch
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "ds/sort.h"
+#include "math/Vector.h"
+#include "MeshOptimizer.h"
+
+namespace MeshOptimizer
+{
+
+static constexpr const int VCACHE_SIZE = 32;			// simulated LRU cache size
+static constexpr const int VCACHE_MAX_VALENCE = 64;
+
+struct VertexScoreTable
+{
+	VertexScoreTable()
+	{
+		for (int i = 0; i < VCACHE_SIZE; ++i)
+		{
+			// vertices of last triangle get fixed score so it's not repeated
+			cacheScore[i] = (i < 3) ? 0.75f : powf(1.0f - (i - 3) * (1.0f / (VCACHE_SIZE - 3)), 1.5f);
+		}
+
+		valenceScore[0] = 0.0f;
+		for (int i = 1; i < VCACHE_MAX_VALENCE; ++i)
+		{
+			// vertices with few triangles left are preferred to get rid of them
+			valenceScore[i] = 2.0f / sqrtf((float)i);
+		}
+	}
+
+	float Get(int cachePos, int remainingTris) const
+	{
+		if (remainingTris == 0)
+			return -1.0f;
+
+		const float score = valenceScore[min(remainingTris, VCACHE_MAX_VALENCE - 1)];
+		return (cachePos >= 0) ? score + cacheScore[cachePos] : score;
+	}
+
+	float	cacheScore[VCACHE_SIZE];
+	float	valenceScore[VCACHE_MAX_VALENCE];
+};
+
+void OptimizeVertexCache(ArrayRef<int32> indices, int numVertices)
+{
+	static const VertexScoreTable scoreTable;
+
+	const int numTris = indices.numElem() / 3;
+	if (numTris < 2)
+		return;
+
+	// triangles referencing vertex, active ones are stored first
+	Array<int> vertexTriOffsets(PP_SL);
+	Array<int> remainingTris(PP_SL);
+	Array<int> vertexTris(PP_SL);
+
+	vertexTriOffsets.assureSizeEmplace(numVertices + 1, 0);
+	remainingTris.assureSizeEmplace(numVertices, 0);
+	vertexTris.setNum(numTris * 3);
+
+	for (int i = 0; i < numTris * 3; ++i)
+		++remainingTris[indices[i]];
+
+	for (int i = 0; i < numVertices; ++i)
+		vertexTriOffsets[i + 1] = vertexTriOffsets[i] + remainingTris[i];
+
+	{
+		Array<int> fillCount(PP_SL);
+		fillCount.assureSizeEmplace(numVertices, 0);
+
+		for (int i = 0; i < numTris * 3; ++i)
+		{
+			const int vertex = indices[i];
+			vertexTris[vertexTriOffsets[vertex] + fillCount[vertex]++] = i / 3;
+		}
+	}
+
+	Array<int> cachePos(PP_SL);
+	Array<float> vertexScores(PP_SL);
+	cachePos.assureSizeEmplace(numVertices, -1);
+	vertexScores.setNum(numVertices);
+
+	for (int i = 0; i < numVertices; ++i)
+		vertexScores[i] = scoreTable.Get(-1, remainingTris[i]);
+
+	Array<float> triScores(PP_SL);
+	Array<bool> triAdded(PP_SL);
+	triScores.setNum(numTris);
+	triAdded.assureSizeEmplace(numTris, false);
+
+	int bestTri = 0;
+	for (int i = 0; i < numTris; ++i)
+	{
+		triScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		if (triScores[i] > triScores[bestTri])
+			bestTri = i;
+	}
+
+	Array<int32> output(PP_SL);
+	output.reserve(numTris * 3);
+
+	int cache[VCACHE_SIZE + 3];
+	int cacheSize = 0;
+	int nextInputTri = 0;
+
+	for (int n = 0; n < numTris; ++n)
+	{
+		if (bestTri == -1)
+		{
+			// no candidates in cache, continue with next triangle in input order
+			while (triAdded[nextInputTri])
+				++nextInputTri;
+			bestTri = nextInputTri;
+		}
+
+		const int32* tri = &indices[bestTri * 3];
+		triAdded[bestTri] = true;
+
+		output.append(tri[0]);
+		output.append(tri[1]);
+		output.append(tri[2]);
+
+		// move triangle out of active triangles of it's vertices
+		for (int i = 0; i < 3; ++i)
+		{
+			const int vertex = tri[i];
+			int* activeTris = &vertexTris[vertexTriOffsets[vertex]];
+			const int lastActive = --remainingTris[vertex];
+
+			for (int j = 0; j <= lastActive; ++j)
+			{
+				if (activeTris[j] == bestTri)
+				{
+					QuickSwap(activeTris[j], activeTris[lastActive]);
+					break;
+				}
+			}
+		}
+
+		// triangle vertices go to the front of LRU cache
+		int newCache[VCACHE_SIZE + 3];
+		int newCacheSize = 0;
+		for (int i = 0; i < 3; ++i)
+			newCache[newCacheSize++] = tri[i];
+
+		for (int i = 0; i < cacheSize; ++i)
+		{
+			const int vertex = cache[i];
+			if (vertex != tri[0] && vertex != tri[1] && vertex != tri[2])
+				newCache[newCacheSize++] = vertex;
+		}
+
+		for (int i = 0; i < newCacheSize; ++i)
+		{
+			const int vertex = newCache[i];
+			cachePos[vertex] = (i < VCACHE_SIZE) ? i : -1;
+			vertexScores[vertex] = scoreTable.Get(cachePos[vertex], remainingTris[vertex]);
+		}
+
+		// rescore triangles of vertices which cache position has changed
+		bestTri = -1;
+		float bestScore = -1.0f;
+
+		for (int i = 0; i < newCacheSize; ++i)
+		{
+			const int vertex = newCache[i];
+			const int* activeTris = &vertexTris[vertexTriOffsets[vertex]];
+
+			for (int j = 0; j < remainingTris[vertex]; ++j)
+			{
+				const int triIdx = activeTris[j];
+				const int32* triIndices = &indices[triIdx * 3];
+				const float score = vertexScores[triIndices[0]] + vertexScores[triIndices[1]] + vertexScores[triIndices[2]];
+				triScores[triIdx] = score;
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTri = triIdx;
+				}
+			}
+		}
+
+		cacheSize = min(newCacheSize, VCACHE_SIZE);
+		memcpy(cache, newCache, cacheSize * sizeof(int));
+	}
+
+	memcpy(indices.ptr(), output.ptr(), output.numElem() * sizeof(int32));
+}
+
+void OptimizeOverdraw(ArrayRef<int32> indices, ArrayCRef<Vector3D> positions)
+{
+	const int numTris = indices.numElem() / 3;
+	if (numTris < 2)
+		return;
+
+	struct Cluster
+	{
+		int		firstTri;
+		int		numTris;
+		float	sortKey;
+	};
+
+	Array<Cluster> clusters(PP_SL);
+
+	// new cluster starts on triangle which misses cache completely
+	{
+		Array<int> cacheTime(PP_SL);
+		cacheTime.assureSizeEmplace(positions.numElem(), -ACMR_CACHE_SIZE - 1);
+
+		int time = 0;
+		for (int i = 0; i < numTris; ++i)
+		{
+			int misses = 0;
+			for (int j = 0; j < 3; ++j)
+			{
+				const int vertex = indices[i * 3 + j];
+				if (time - cacheTime[vertex] >= ACMR_CACHE_SIZE)
+				{
+					cacheTime[vertex] = ++time;
+					++misses;
+				}
+			}
+
+			if (i == 0 || misses == 3)
+				clusters.append({ i, 0, 0.0f });
+
+			clusters.back().numTris++;
+		}
+	}
+
+	if (clusters.numElem() < 2)
+		return;
+
+	// area weighted centroids and normals
+	Array<Vector3D> clusterCenters(PP_SL);
+	Array<Vector3D> clusterNormals(PP_SL);
+	clusterCenters.assureSizeEmplace(clusters.numElem(), vec3_zero);
+	clusterNormals.assureSizeEmplace(clusters.numElem(), vec3_zero);
+
+	Vector3D meshCenter = vec3_zero;
+	float meshArea = 0.0f;
+
+	for (int i = 0; i < clusters.numElem(); ++i)
+	{
+		const Cluster& cluster = clusters[i];
+		float clusterArea = 0.0f;
+
+		for (int j = cluster.firstTri; j < cluster.firstTri + cluster.numTris; ++j)
+		{
+			const Vector3D& p0 = positions[indices[j * 3]];
+			const Vector3D& p1 = positions[indices[j * 3 + 1]];
+			const Vector3D& p2 = positions[indices[j * 3 + 2]];
+
+			const Vector3D normal = cross(p1 - p0, p2 - p0);
+			const float area = length(normal);
+
+			clusterCenters[i] += (p0 + p1 + p2) * (area / 3.0f);
+			clusterNormals[i] += normal;
+			clusterArea += area;
+		}
+
+		meshCenter += clusterCenters[i];
+		meshArea += clusterArea;
+
+		if (clusterArea > F_EPS)
+			clusterCenters[i] /= clusterArea;
+	}
+
+	if (meshArea > F_EPS)
+		meshCenter /= meshArea;
+
+	// clusters facing away from mesh center are more likely to occlude others
+	for (int i = 0; i < clusters.numElem(); ++i)
+	{
+		const float normalLength = length(clusterNormals[i]);
+		clusters[i].sortKey = (normalLength > F_EPS) ? dot(clusterCenters[i] - meshCenter, clusterNormals[i] / normalLength) : 0.0f;
+	}
+
+	quickSort(clusters, [](const Cluster& a, const Cluster& b) {
+		if (a.sortKey == b.sortKey)
+			return a.firstTri - b.firstTri;
+		return (a.sortKey > b.sortKey) ? -1 : 1;
+	});
+
+	Array<int32> output(PP_SL);
+	output.reserve(indices.numElem());
+
+	for (const Cluster& cluster : clusters)
+		output.append(&indices[cluster.firstTri * 3], cluster.numTris * 3);
+
+	memcpy(indices.ptr(), output.ptr(), output.numElem() * sizeof(int32));
+}
+
+int OptimizeVertexFetch(ArrayRef<int32> indices, int numVertices, Array<int>& remapTable)
+{
+	remapTable.clear();
+	remapTable.assureSizeEmplace(numVertices, -1);
+
+	int numUsed = 0;
+	for (int i = 0; i < indices.numElem(); ++i)
+	{
+		int& newIndex = remapTable[indices[i]];
+		if (newIndex == -1)
+			newIndex = numUsed++;
+
+		indices[i] = newIndex;
+	}
+
+	// unreferenced vertices are moved to the end
+	int nextIndex = numUsed;
+	for (int i = 0; i < numVertices; ++i)
+	{
+		if (remapTable[i] == -1)
+			remapTable[i] = nextIndex++;
+	}
+
+	return numUsed;
+}
+
+float CalcACMR(ArrayCRef<int32> indices, int numVertices, int cacheSize)
+{
+	const int numTris = indices.numElem() / 3;
+	if (!numTris)
+		return 0.0f;
+
+	Array<int> cacheTime(PP_SL);
+	cacheTime.assureSizeEmplace(numVertices, -cacheSize - 1);
+
+	int time = 0;
+	int misses = 0;
+	for (int i = 0; i < indices.numElem(); ++i)
+	{
+		const int vertex = indices[i];
+		if (time - cacheTime[vertex] >= cacheSize)
+		{
+			cacheTime[vertex] = ++time;
+			++misses;
+		}
+	}
+
+	return (float)misses / (float)numTris;
+}
+
+}
@@ -0,0 +1,31 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Triangle list optimization for post-transform vertex cache,
+//				overdraw and vertex fetch
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+namespace MeshOptimizer
+{
+
+// FIFO cache size used to measure ACMR
+static constexpr const int ACMR_CACHE_SIZE = 16;
+
+// reorders triangles for post-transform vertex cache (Forsyth's linear-speed algorithm)
+void		OptimizeVertexCache(ArrayRef<int32> indices, int numVertices);
+
+// reorders clusters of cache optimized triangles so outward facing ones are drawn first.
+// Clusters are split where vertex cache is restarted so cache efficiency is preserved
+void		OptimizeOverdraw(ArrayRef<int32> indices, ArrayCRef<Vector3D> positions);
+
+// remaps vertices in order they are first referenced by indices.
+// remapTable receives new index of each old vertex, returns number of used vertices
+int			OptimizeVertexFetch(ArrayRef<int32> indices, int numVertices, Array<int>& remapTable);
+
+// average number of cache misses per triangle
+float		CalcACMR(ArrayCRef<int32> indices, int numVertices, int cacheSize = ACMR_CACHE_SIZE);
+
+};
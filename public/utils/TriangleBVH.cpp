@@ -0,0 +1,295 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Triangle bounding volume hierarchy
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "math/Utility.h"
+#include "TriangleBVH.h"
+
+static constexpr const int BVH_SAH_BINS = 12;
+static constexpr const int BVH_MAX_DEPTH = 48;
+
+static float BoxSurfaceArea(const BoundingBox& box)
+{
+	if (box.IsEmpty())
+		return 0.0f;
+
+	const Vector3D size = box.GetSize();
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static Vector3D TriangleCenter(const CTriangleBVH::Triangle& tri)
+{
+	return (tri.v0 + tri.v1 + tri.v2) * (1.0f / 3.0f);
+}
+
+void CTriangleBVH::Clear()
+{
+	m_nodes.clear(true);
+	m_triangles.clear(true);
+	m_maxDepth = 0;
+}
+
+void CTriangleBVH::Build(ArrayCRef<Triangle> triangles)
+{
+	Clear();
+
+	if (!triangles.numElem())
+		return;
+
+	m_triangles.append(triangles.ptr(), triangles.numElem());
+
+	// binary tree never has more than 2N-1 nodes
+	m_nodes.reserve(triangles.numElem() * 2);
+	m_nodes.append(Node());
+	BuildNode(0, 0, m_triangles.numElem(), 0);
+}
+
+const BoundingBox& CTriangleBVH::GetBoundingBox() const
+{
+	static BoundingBox emptyBox;
+	if (IsEmpty())
+		return emptyBox;
+
+	return m_nodes[0].bbox;
+}
+
+void CTriangleBVH::BuildNode(int nodeIdx, int first, int count, int depth)
+{
+	m_maxDepth = max(m_maxDepth, depth);
+
+	BoundingBox nodeBox;
+	BoundingBox centerBox;
+	for (int i = first; i < first + count; ++i)
+	{
+		const Triangle& tri = m_triangles[i];
+		nodeBox.AddVertex(tri.v0);
+		nodeBox.AddVertex(tri.v1);
+		nodeBox.AddVertex(tri.v2);
+		centerBox.AddVertex(TriangleCenter(tri));
+	}
+
+	{
+		Node& node = m_nodes[nodeIdx];
+		node.bbox = nodeBox;
+		node.first = first;
+		node.count = count;
+	}
+
+	if (count <= MAX_LEAF_TRIANGLES || depth >= BVH_MAX_DEPTH)
+		return;
+
+	// pick the longest centroid axis
+	const Vector3D centerSize = centerBox.GetSize();
+	int axis = 0;
+	if (centerSize.y > centerSize[axis]) axis = 1;
+	if (centerSize.z > centerSize[axis]) axis = 2;
+
+	// all centroids are in one point, nothing to split
+	if (centerSize[axis] <= F_EPS)
+		return;
+
+	// binned SAH split
+	struct Bin
+	{
+		BoundingBox	bbox;
+		int			count{ 0 };
+	} bins[BVH_SAH_BINS];
+
+	const float binScale = BVH_SAH_BINS / centerSize[axis];
+	const float axisMin = centerBox.minPoint[axis];
+
+	auto getBinIndex = [&](const Triangle& tri) {
+		const int binIdx = (int)((TriangleCenter(tri)[axis] - axisMin) * binScale);
+		return clamp(binIdx, 0, BVH_SAH_BINS - 1);
+	};
+
+	for (int i = first; i < first + count; ++i)
+	{
+		const Triangle& tri = m_triangles[i];
+		Bin& bin = bins[getBinIndex(tri)];
+		bin.bbox.AddVertex(tri.v0);
+		bin.bbox.AddVertex(tri.v1);
+		bin.bbox.AddVertex(tri.v2);
+		++bin.count;
+	}
+
+	float leftArea[BVH_SAH_BINS - 1];
+	int leftCount[BVH_SAH_BINS - 1];
+	{
+		BoundingBox box;
+		int num = 0;
+		for (int i = 0; i < BVH_SAH_BINS - 1; ++i)
+		{
+			if (bins[i].count)
+				box.Merge(bins[i].bbox);
+			num += bins[i].count;
+			leftArea[i] = BoxSurfaceArea(box);
+			leftCount[i] = num;
+		}
+	}
+
+	float bestCost = F_INFINITY;
+	int bestSplit = -1;
+	{
+		BoundingBox box;
+		int num = 0;
+		for (int i = BVH_SAH_BINS - 1; i > 0; --i)
+		{
+			if (bins[i].count)
+				box.Merge(bins[i].bbox);
+			num += bins[i].count;
+
+			const float cost = leftArea[i - 1] * leftCount[i - 1] + BoxSurfaceArea(box) * num;
+			if (cost < bestCost && leftCount[i - 1] > 0 && num > 0)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// splitting is not worth it
+	if (bestSplit == -1 || bestCost >= BoxSurfaceArea(nodeBox) * count)
+	{
+		if (count <= MAX_LEAF_TRIANGLES * 4)
+			return;
+
+		// too many triangles in leaf, fall back to the middle split
+		bestSplit = BVH_SAH_BINS / 2;
+	}
+
+	// partition triangles in place
+	int left = first;
+	int right = first + count - 1;
+	while (left <= right)
+	{
+		if (getBinIndex(m_triangles[left]) < bestSplit)
+			++left;
+		else
+			QuickSwap(m_triangles[left], m_triangles[right--]);
+	}
+
+	int leftNum = left - first;
+	if (leftNum == 0 || leftNum == count)
+		leftNum = count / 2;
+
+	// children are always allocated next to each other
+	const int leftChild = m_nodes.append(Node());
+	m_nodes.append(Node());
+
+	{
+		Node& node = m_nodes[nodeIdx];
+		node.first = leftChild;
+		node.count = 0;
+	}
+
+	BuildNode(leftChild, first, leftNum, depth + 1);
+	BuildNode(leftChild + 1, first + leftNum, count - leftNum, depth + 1);
+}
+
+float CTriangleBVH::TraceRay(const Vector3D& rayStart, const Vector3D& rayDir, int64& hitUserId, bool twoSided) const
+{
+	hitUserId = -1;
+
+	if (IsEmpty())
+		return F_INFINITY;
+
+	float bestDist = F_INFINITY;
+
+	int stack[BVH_MAX_DEPTH * 2 + 2];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+
+		float tnear, tfar;
+		if (!node.bbox.IntersectsRay(rayStart, rayDir, tnear, tfar) || tnear > bestDist)
+			continue;
+
+		if (node.count == 0)
+		{
+			// visit nearest child first
+			const Node& leftNode = m_nodes[node.first];
+			const Node& rightNode = m_nodes[node.first + 1];
+
+			const float leftDist = dot(leftNode.bbox.GetCenter() - rayStart, rayDir);
+			const float rightDist = dot(rightNode.bbox.GetCenter() - rayStart, rayDir);
+
+			if (leftDist < rightDist)
+			{
+				stack[stackSize++] = node.first + 1;
+				stack[stackSize++] = node.first;
+			}
+			else
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; ++i)
+		{
+			const Triangle& tri = m_triangles[i];
+
+			float dist = F_INFINITY;
+			if (IsRayIntersectsTriangle(tri.v0, tri.v1, tri.v2, rayStart, rayDir, dist, twoSided))
+			{
+				if (dist < bestDist && dist > 0)
+				{
+					bestDist = dist;
+					hitUserId = tri.userId;
+				}
+			}
+		}
+	}
+
+	return bestDist;
+}
+
+int CTriangleBVH::QueryBox(const BoundingBox& box, Array<int>& triangleIndices) const
+{
+	if (IsEmpty())
+		return 0;
+
+	const int startCount = triangleIndices.numElem();
+
+	int stack[BVH_MAX_DEPTH * 2 + 2];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (!node.bbox.Intersects(box))
+			continue;
+
+		if (node.count == 0)
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; ++i)
+		{
+			const Triangle& tri = m_triangles[i];
+
+			BoundingBox triBox;
+			triBox.AddVertex(tri.v0);
+			triBox.AddVertex(tri.v1);
+			triBox.AddVertex(tri.v2);
+
+			if (triBox.Intersects(box))
+				triangleIndices.append(i);
+		}
+	}
+
+	return triangleIndices.numElem() - startCount;
+}
@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Triangle bounding volume hierarchy
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+//-------------------------------------------------------------------------
+// Static triangle BVH used for ray picking and box queries
+// Triangles are copied and reordered so leaves are contiguous in memory
+//-------------------------------------------------------------------------
+class CTriangleBVH
+{
+public:
+	static constexpr const int MAX_LEAF_TRIANGLES = 4;
+
+	struct Triangle
+	{
+		Vector3D	v0;
+		Vector3D	v1;
+		Vector3D	v2;
+		int64		userId{ -1 };
+	};
+
+	struct Node
+	{
+		BoundingBox	bbox;
+		int			first{ 0 };		// leaf: first triangle; inner: left child index (right is next)
+		int			count{ 0 };		// leaf: triangle count; inner: 0
+	};
+
+	CTriangleBVH() = default;
+
+	void					Clear();
+	void					Build(ArrayCRef<Triangle> triangles);
+
+	bool					IsEmpty() const { return m_nodes.numElem() == 0; }
+	const BoundingBox&		GetBoundingBox() const;
+
+	// returns closest hit distance along rayDir or F_INFINITY. Hits behind ray start are ignored
+	float					TraceRay(const Vector3D& rayStart, const Vector3D& rayDir, int64& hitUserId, bool twoSided = true) const;
+
+	// collects triangles which bounds intersects the box. Returns number of added triangles
+	int						QueryBox(const BoundingBox& box, Array<int>& triangleIndices) const;
+
+	const Triangle&			GetTriangle(int index) const { return m_triangles[index]; }
+	int						GetTriangleCount() const { return m_triangles.numElem(); }
+	int						GetNodeCount() const { return m_nodes.numElem(); }
+
+private:
+	void					BuildNode(int nodeIdx, int first, int count, int depth);
+
+	Array<Node>				m_nodes{ PP_SL };
+	Array<Triangle>			m_triangles{ PP_SL };
+	int						m_maxDepth{ 0 };
+};
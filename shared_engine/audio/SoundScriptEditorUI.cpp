@@ -1532,7 +1532,9 @@ void CSoundScriptEditor::DrawScriptEditor(bool& open)
 											continue;
 
 										const int nameHash = StringToHash(desc.name);
-										currentInputs[nameHash] = emitter->inputs[nodeId];
+										SoundNodeInput& input = currentInputs[nameHash];
+										for (int i = 0; i < SoundNodeDesc::MAX_ARRAY_IDX; ++i)
+											input.values[i] = (i < desc.input.valueCount) ? emitter->GetInputValue(nodeId, i) : 0.0f;
 									}
 								}
 							}
@@ -1588,8 +1590,8 @@ void CSoundScriptEditor::DrawScriptEditor(bool& open)
 
 							if (modified)
 							{
-								currentEmit.obj->SetVolume(emitter, playbackVolume);
-								currentEmit.obj->SetPitch(emitter, playbackPitch);
+								currentEmit.obj->SetVolume(currentEmit.emitId, playbackVolume);
+								currentEmit.obj->SetPitch(currentEmit.emitId, playbackPitch);
 							}
 
 							ImGui::SameLine();
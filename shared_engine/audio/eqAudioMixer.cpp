@@ -0,0 +1,262 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Audio mixing routines
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "math/Simd.h"
+#include "source/snd_source.h"
+#include "eqAudioMixer.h"
+
+static int GetLoopRegionIdx(int offsetInSamples, int* points, int regionCount)
+{
+	for (int i = 0; i < regionCount; ++i)
+	{
+		if (offsetInSamples >= points[i * 2]) //&& offsetInSamples <= points[i*2+1])
+			return i;
+	}
+	return -1;
+}
+
+int WrapAroundSampleOffset(int sampleOffset, const ISoundSource* sample, bool looping)
+{
+	const int sampleCount = sample->GetSampleCount();
+
+	if (looping)
+	{
+		int loopPoints[SOUND_SOURCE_MAX_LOOP_REGIONS * 2];
+		const int numLoopRegions = sample->GetLoopRegions(loopPoints);
+
+		const int loopRegionIdx = GetLoopRegionIdx(sampleOffset, loopPoints, numLoopRegions);
+		const int sampleMin = (loopRegionIdx == -1) ? 0 : loopPoints[loopRegionIdx * 2];
+		const int sampleMax = (loopRegionIdx == -1) ? sampleCount : loopPoints[loopRegionIdx * 2 + 1];
+
+		const int sampleRange = sampleMax - sampleMin;
+		
+		if(sampleRange > 0)
+			sampleOffset = sampleMin + ((sampleOffset - sampleMin) % sampleRange);
+		else
+			sampleOffset = sampleMin;
+	}
+	else
+		sampleOffset = min(sampleOffset, sampleCount);
+
+	return sampleOffset;
+}
+
+void AudioMix_ToFloat(const void* in, int bitwidth, int channels, int numFrames, float* left, float* right)
+{
+	if (bitwidth == 16)
+	{
+		const short* samples = (const short*)in;
+		if (channels == 1)
+		{
+			for (int i = 0; i < numFrames; ++i)
+				left[i] = samples[i];
+		}
+		else
+		{
+			for (int i = 0; i < numFrames; ++i)
+			{
+				left[i] = samples[i * 2];
+				right[i] = samples[i * 2 + 1];
+			}
+		}
+	}
+	else if (bitwidth == 8)
+	{
+		const uint8* samples = (const uint8*)in;
+		if (channels == 1)
+		{
+			for (int i = 0; i < numFrames; ++i)
+				left[i] = (samples[i] - 128) * 256.0f;
+		}
+		else
+		{
+			for (int i = 0; i < numFrames; ++i)
+			{
+				left[i] = (samples[i * 2] - 128) * 256.0f;
+				right[i] = (samples[i * 2 + 1] - 128) * 256.0f;
+			}
+		}
+	}
+}
+
+void AudioMix_Resample(const float* in, float position, float step, float* out, int numOutFrames)
+{
+	if (step == 1.0f && position == 0.0f)
+	{
+		memcpy(out, in, numOutFrames * sizeof(float));
+		return;
+	}
+
+	const Simd4f laneOffsets = simdSet(0.0f, step, step * 2.0f, step * 3.0f);
+
+	int i = 0;
+	for (; i + SIMD_WIDTH <= numOutFrames; i += SIMD_WIDTH)
+	{
+		const float basePos = position + i * step;
+		float lanePos[SIMD_WIDTH];
+		simdStore(lanePos, simdSplat(basePos) + laneOffsets);
+
+		const int i0 = (int)lanePos[0];
+		const int i1 = (int)lanePos[1];
+		const int i2 = (int)lanePos[2];
+		const int i3 = (int)lanePos[3];
+
+		const Simd4f a = simdSet(in[i0], in[i1], in[i2], in[i3]);
+		const Simd4f b = simdSet(in[i0 + 1], in[i1 + 1], in[i2 + 1], in[i3 + 1]);
+		const Simd4f frac = simdLoad(lanePos) - simdSet((float)i0, (float)i1, (float)i2, (float)i3);
+
+		simdStore(out + i, simdMadd(b - a, frac, a));
+	}
+
+	for (; i < numOutFrames; ++i)
+	{
+		const float pos = position + i * step;
+		const int idx = (int)pos;
+		const float frac = pos - idx;
+		out[i] = in[idx] + (in[idx + 1] - in[idx]) * frac;
+	}
+}
+
+void AudioMix_AddRamp(const float* in, float gainStart, float gainEnd, float* out, int numFrames)
+{
+	const float gainStep = numFrames > 0 ? (gainEnd - gainStart) / numFrames : 0.0f;
+
+	Simd4f gain = simdSet(gainStart, gainStart + gainStep, gainStart + gainStep * 2.0f, gainStart + gainStep * 3.0f);
+	const Simd4f gainInc = simdSplat(gainStep * SIMD_WIDTH);
+
+	int i = 0;
+	for (; i + SIMD_WIDTH <= numFrames; i += SIMD_WIDTH)
+	{
+		simdStore(out + i, simdMadd(simdLoad(in + i), gain, simdLoad(out + i)));
+		gain = gain + gainInc;
+	}
+
+	for (; i < numFrames; ++i)
+		out[i] += in[i] * (gainStart + gainStep * i);
+}
+
+void AudioMix_ToInt16Stereo(const float* left, const float* right, int numFrames, short* out)
+{
+	int i = 0;
+	for (; i + SIMD_WIDTH <= numFrames; i += SIMD_WIDTH)
+	{
+		const Simd4f l = simdLoad(left + i);
+		const Simd4f r = simdLoad(right + i);
+		simdStoreInt16Sat(out + i * 2, simdInterleaveLo(l, r), simdInterleaveHi(l, r));
+	}
+
+	for (; i < numFrames; ++i)
+	{
+		out[i * 2] = (short)clamp((int)lrintf(left[i]), SHRT_MIN, SHRT_MAX);
+		out[i * 2 + 1] = (short)clamp((int)lrintf(right[i]), SHRT_MIN, SHRT_MAX);
+	}
+}
+
+void AudioMix_ToInt16(const float* in, int numSamples, short* out)
+{
+	int i = 0;
+	for (; i + SIMD_WIDTH * 2 <= numSamples; i += SIMD_WIDTH * 2)
+		simdStoreInt16Sat(out + i, simdLoad(in + i), simdLoad(in + i + SIMD_WIDTH));
+
+	for (; i < numSamples; ++i)
+		out[i] = (short)clamp((int)lrintf(in[i]), SHRT_MIN, SHRT_MAX);
+}
+
+//-----------------------------------------------------------------
+
+int AudioMix_MixStreams(ArrayRef<AudioMixStream> streams, AudioMixBuffers& buffers, int outFrequency, int outChannels, float pitch, bool looping, short* out, int numFrames)
+{
+	int numMixed = 0;
+	while (numMixed < numFrames)
+	{
+		const int blockFrames = min(numFrames - numMixed, AUDIOMIX_BLOCK_FRAMES);
+		int numValidFrames = 0;
+
+		memset(buffers.mixLeft, 0, blockFrames * sizeof(float));
+		memset(buffers.mixRight, 0, blockFrames * sizeof(float));
+
+		for (AudioMixStream& stream : streams)
+		{
+			ISoundSource* sample = stream.sample;
+			if (!sample)
+				continue;
+
+			const int sampleCount = sample->GetSampleCount();
+			if (!looping && stream.curPos >= sampleCount)
+				continue;
+
+			const ISoundSource::Format& fmt = sample->GetFormat();
+			const float step = clamp(pitch * (float)fmt.frequency / (float)outFrequency, 0.001f, AUDIOMIX_MAX_STEP);
+			const float volume = min(stream.volume, 1.0f);
+
+			const int numInFrames = (int)(stream.curFrac + (blockFrames - 1) * step) + 2;
+			int streamFrames = blockFrames;
+
+			if (volume > 0.0f)
+			{
+				const int numRead = sample->GetSamples(buffers.pcm, numInFrames, stream.curPos, looping);
+				AudioMix_ToFloat(buffers.pcm, fmt.bitwidth, fmt.channels, numRead, buffers.inLeft, buffers.inRight);
+
+				// sample ended, the rest is silence
+				if (numRead < numInFrames)
+				{
+					memset(buffers.inLeft + numRead, 0, (numInFrames - numRead) * sizeof(float));
+					memset(buffers.inRight + numRead, 0, (numInFrames - numRead) * sizeof(float));
+					streamFrames = clamp((int)ceilf((numRead - stream.curFrac) / step), 0, blockFrames);
+				}
+
+				AudioMix_Resample(buffers.inLeft, stream.curFrac, step, buffers.resampled, blockFrames);
+
+				if (outChannels == 2)
+				{
+					AudioMix_AddRamp(buffers.resampled, volume, volume, buffers.mixLeft, blockFrames);
+
+					if (fmt.channels == 2)
+						AudioMix_Resample(buffers.inRight, stream.curFrac, step, buffers.resampled, blockFrames);
+
+					AudioMix_AddRamp(buffers.resampled, volume, volume, buffers.mixRight, blockFrames);
+				}
+				else if (fmt.channels == 2)
+				{
+					// downmix
+					AudioMix_AddRamp(buffers.resampled, volume * 0.5f, volume * 0.5f, buffers.mixLeft, blockFrames);
+					AudioMix_Resample(buffers.inRight, stream.curFrac, step, buffers.resampled, blockFrames);
+					AudioMix_AddRamp(buffers.resampled, volume * 0.5f, volume * 0.5f, buffers.mixLeft, blockFrames);
+				}
+				else
+					AudioMix_AddRamp(buffers.resampled, volume, volume, buffers.mixLeft, blockFrames);
+			}
+			else if (!looping)
+			{
+				// update playback progress still but don't mix
+				streamFrames = clamp((int)ceilf((sampleCount - stream.curPos - stream.curFrac) / step), 0, blockFrames);
+			}
+
+			numValidFrames = max(numValidFrames, streamFrames);
+
+			const float advance = stream.curFrac + blockFrames * step;
+			const int advanceFrames = (int)advance;
+			stream.curFrac = advance - advanceFrames;
+			stream.curPos = WrapAroundSampleOffset(stream.curPos + advanceFrames, sample, looping);
+		}
+
+		short* blockOut = out + numMixed * outChannels;
+		if (outChannels == 2)
+			AudioMix_ToInt16Stereo(buffers.mixLeft, buffers.mixRight, numValidFrames, blockOut);
+		else
+			AudioMix_ToInt16(buffers.mixLeft, numValidFrames, blockOut);
+
+		numMixed += numValidFrames;
+
+		// all streams have ended
+		if (numValidFrames < blockFrames)
+			break;
+	}
+
+	return numMixed;
+}
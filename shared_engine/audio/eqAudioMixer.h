@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Audio mixing routines
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+class ISoundSource;
+
+#define AUDIOMIX_BLOCK_FRAMES		256		// frames mixed at once by AudioMix_MixStreams
+#define AUDIOMIX_MAX_STEP			8.0f	// highest input to output frequency ratio
+
+// Mixing is done on planar float buffers in 16 bit sample range.
+// Buffers are processed 4 samples at time, tails are handled separately.
+
+// wraps sample offset around the loop region or clamps to the sample length
+int		WrapAroundSampleOffset(int sampleOffset, const ISoundSource* sample, bool looping);
+
+// converts interleaved 8 bit (unsigned) or 16 bit PCM frames to planar float.
+// right is ignored for mono input
+void	AudioMix_ToFloat(const void* in, int bitwidth, int channels, int numFrames, float* left, float* right);
+
+// linear interpolation of input starting at fractional position [0..1) with given step.
+// Input must hold (int)(position + (numOutFrames - 1) * step) + 2 frames
+void	AudioMix_Resample(const float* in, float position, float step, float* out, int numOutFrames);
+
+// out += in * gain, gain goes linearly from gainStart to gainEnd over the block
+void	AudioMix_AddRamp(const float* in, float gainStart, float gainEnd, float* out, int numFrames);
+
+// interleaves planar stereo and converts to 16 bit with saturation
+void	AudioMix_ToInt16Stereo(const float* left, const float* right, int numFrames, short* out);
+
+// converts float samples to 16 bit with saturation
+void	AudioMix_ToInt16(const float* in, int numSamples, short* out);
+
+//-----------------------------------------------------------------
+
+// sample playback state
+struct AudioMixStream
+{
+	ISoundSource*	sample{ nullptr };
+	int				curPos{ 0 };
+	float			curFrac{ 0.0f };		// position between samples when resampling
+	float			volume{ 1.0f };
+};
+
+// scratch space of AudioMix_MixStreams, large enough to not allocate anything during mixing
+struct AudioMixBuffers
+{
+	static constexpr const int MAX_INPUT_FRAMES = (int)(AUDIOMIX_BLOCK_FRAMES * AUDIOMIX_MAX_STEP) + 2;
+
+	ubyte	pcm[MAX_INPUT_FRAMES * 2 * sizeof(short)];
+	float	inLeft[MAX_INPUT_FRAMES];
+	float	inRight[MAX_INPUT_FRAMES];
+	float	resampled[AUDIOMIX_BLOCK_FRAMES];
+	float	mixLeft[AUDIOMIX_BLOCK_FRAMES];
+	float	mixRight[AUDIOMIX_BLOCK_FRAMES];
+};
+
+// resamples streams to output frequency and mixes them into interleaved 16 bit frames.
+// Returns number of frames written, which is less than numFrames when all streams have ended
+int		AudioMix_MixStreams(ArrayRef<AudioMixStream> streams, AudioMixBuffers& buffers, int outFrequency, int outChannels, float pitch, bool looping, short* out, int numFrames);
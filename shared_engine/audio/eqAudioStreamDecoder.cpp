@@ -0,0 +1,440 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Streamed sample decoding ahead of playback.
+//				Voices only consume PCM decoded by spool audio jobs
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/ConVar.h"
+#include "core/ConCommand.h"
+#include "core/IEqParallelJobs.h"
+#include "math/Random.h"
+
+#include "source/snd_source.h"
+#include "eqAudioMixer.h"
+#include "eqAudioStreamDecoder.h"
+
+using namespace Threading;
+
+DECLARE_CVAR(snd_stream_lookahead, "0.5", "Seconds of streamed sound decoded ahead of playback", CV_ARCHIVE);
+
+static constexpr const int STREAM_MIN_LOOKAHEAD_FRAMES = 16384;
+static constexpr const int STREAM_DECODE_PARTS = 4;		// ring is refilled when this part of it is free
+
+CAudioStreamReader::CAudioStreamReader(ISoundSource* sample, int lookAheadFrames)
+	: m_sample(sample)
+{
+	const ISoundSource::Format& fmt = sample->GetFormat();
+	m_sampleSize = fmt.channels * (fmt.bitwidth >> 3);
+
+	// power of two so ring positions may overflow
+	m_capacity = STREAM_MIN_LOOKAHEAD_FRAMES;
+	while (m_capacity < lookAheadFrames)
+		m_capacity <<= 1;
+
+	m_buffer.setNum(m_capacity * m_sampleSize);
+}
+
+void CAudioStreamReader::Seek(int samplePos, bool looping)
+{
+	m_seekPos = samplePos;
+	m_seekLooping = looping;
+
+	m_expectedPos = samplePos;
+	m_expectedLooping = looping;
+	m_primed = false;
+
+	// RMW for full barrier, decoder sees seek position once it sees new generation
+	m_voiceSeekGen = Atomic::Increment(m_seekGen);
+}
+
+int CAudioStreamReader::Read(void* out, int numFrames, int samplePos, bool looping)
+{
+	ASSERT(numFrames <= m_capacity);
+
+	if (samplePos != m_expectedPos || looping != m_expectedLooping)
+	{
+		// voice was rewound or looping has changed, data already decoded is not valid anymore
+		Seek(samplePos, looping);
+		return 0;
+	}
+
+	// RMW for full barrier so positions reset by decoder are not read before generation
+	if (Atomic::Add(m_decodeGen, 0) != m_voiceSeekGen)
+		return 0;
+
+	const uint32 readPos = Atomic::Add(m_readPos, 0);
+
+	// RMW for full barrier so data is not read before position
+	const int numAvailable = (int)(Atomic::Add(m_writePos, 0) - readPos);
+	if (numAvailable < numFrames)
+	{
+		if (!Atomic::Add(m_ended, 0))
+			return 0;
+		numFrames = numAvailable;
+	}
+
+	if (numFrames <= 0)
+		return 0;
+
+	const int ringPos = readPos & (m_capacity - 1);
+	const int numFirst = min(numFrames, m_capacity - ringPos);
+
+	memcpy(out, m_buffer.ptr() + ringPos * m_sampleSize, numFirst * m_sampleSize);
+	if (numFirst < numFrames)
+		memcpy((ubyte*)out + numFirst * m_sampleSize, m_buffer.ptr(), (numFrames - numFirst) * m_sampleSize);
+
+	// RMW for full barrier so decoder doesn't overwrite data before it's copied
+	Atomic::Add(m_readPos, (uint32)numFrames);
+
+	m_expectedPos = WrapAroundSampleOffset(samplePos + numFrames, m_sample, looping);
+	m_primed = true;
+
+	return numFrames;
+}
+
+bool CAudioStreamReader::IsEnded()
+{
+	if (Atomic::Add(m_decodeGen, 0) != m_voiceSeekGen)
+		return false;
+
+	return Atomic::Add(m_ended, 0) && Atomic::Add(m_writePos, 0) == Atomic::Add(m_readPos, 0);
+}
+
+int CAudioStreamReader::Decode(int minFrames)
+{
+	if (Atomic::Load(m_detached))
+		return 0;
+
+	// RMW for full barrier so seek position is not read before generation
+	const uint32 seekGen = Atomic::Add(m_seekGen, 0);
+	const uint32 decodeGen = Atomic::Add(m_decodeGen, 0);
+	if (seekGen != decodeGen)
+	{
+		m_decodePos = m_seekPos;
+		m_decodeLooping = m_seekLooping;
+
+		// voice is not reading until generations match
+		Atomic::Exchange(m_readPos, 0u);
+		Atomic::Exchange(m_writePos, 0u);
+		Atomic::Exchange(m_ended, 0);
+
+		// only decoder writes generation, RMW publishes reset positions with it
+		Atomic::CompareExchange(m_decodeGen, decodeGen, seekGen);
+
+		// voice waits for data
+		minFrames = 0;
+	}
+
+	if (Atomic::Add(m_ended, 0))
+		return 0;
+
+	// RMW for full barrier so ring is not written before voice has copied data out
+	uint32 writePos = Atomic::Add(m_writePos, 0);
+	int numFree = m_capacity - (int)(writePos - Atomic::Add(m_readPos, 0));
+	if (numFree <= 0 || numFree < minFrames)
+		return 0;
+
+	const int maxPartFrames = m_capacity / STREAM_DECODE_PARTS;
+
+	int numDecoded = 0;
+	while (numFree > 0)
+	{
+		const int ringPos = writePos & (m_capacity - 1);
+		const int numToRead = min(min(numFree, m_capacity - ringPos), maxPartFrames);
+		const int numRead = m_sample->GetSamples(m_buffer.ptr() + ringPos * m_sampleSize, numToRead, m_decodePos, m_decodeLooping);
+
+		m_decodePos = WrapAroundSampleOffset(m_decodePos + numRead, m_sample, m_decodeLooping);
+		writePos += numRead;
+		numFree -= numRead;
+		numDecoded += numRead;
+
+		// publish each part so voice does not wait for whole ring.
+		// RMW for full barrier so position is not published before data
+		Atomic::Add(m_writePos, (uint32)numRead);
+
+		if (numRead < numToRead)
+		{
+			Atomic::Exchange(m_ended, 1);
+			break;
+		}
+
+		// voice has stopped meanwhile
+		if (Atomic::Load(m_detached))
+			break;
+	}
+
+	return numDecoded * m_sampleSize;
+}
+
+//-----------------------------------------------
+
+CAudioStreamDecoder::CAudioStreamDecoder()
+{
+	m_jobDone.Raise();
+}
+
+void CAudioStreamDecoder::Shutdown()
+{
+	m_jobDone.Wait();
+
+	CScopedMutex m(m_mutex);
+	for (CAudioStreamReader* reader : m_readers)
+		reader->Detach();
+
+	m_readers.clear(true);
+	m_jobReaders.clear(true);
+}
+
+CAudioStreamReaderPtr CAudioStreamDecoder::CreateReader(ISoundSource* sample)
+{
+	const int lookAheadFrames = (int)(snd_stream_lookahead.GetFloat() * sample->GetFormat().frequency);
+	CAudioStreamReaderPtr reader = CRefPtr_new(CAudioStreamReader, sample, lookAheadFrames);
+
+	CScopedMutex m(m_mutex);
+	m_readers.append(reader);
+
+	return reader;
+}
+
+// doesn't wait for decode job, reader is released by it
+void CAudioStreamDecoder::DestroyReader(CAudioStreamReader* reader)
+{
+	reader->Detach();
+
+	CScopedMutex m(m_mutex);
+	for (int i = 0; i < m_readers.numElem(); ++i)
+	{
+		if (m_readers[i] == reader)
+		{
+			m_readers.fastRemoveIndex(i);
+			break;
+		}
+	}
+}
+
+void CAudioStreamDecoder::OnSampleDeleted(ISoundSource* sample)
+{
+	if (sample->IsStreaming())
+		m_jobDone.Wait();
+}
+
+void CAudioStreamDecoder::Update()
+{
+	if (!m_readers.numElem())
+		return;
+
+	if (Atomic::CompareExchange(m_jobPending, 0, 1) != 0)
+		return;
+
+	m_jobDone.Clear();
+	g_parallelJobs->AddJob(JOB_TYPE_SPOOL_AUDIO, [this](void*, int i) {
+		DecodeJob();
+
+		// raised before pending flag is reset so next job can't be cleared by this one
+		m_jobDone.Raise();
+		Atomic::Store(m_jobPending, 0);
+	});
+	g_parallelJobs->Submit();
+}
+
+void CAudioStreamDecoder::DecodeJob()
+{
+	PROF_EVENT("Audio Stream Decode Job");
+
+	{
+		CScopedMutex m(m_mutex);
+		m_jobReaders.append(m_readers);
+	}
+
+	int64 numDecodedBytes = 0;
+	for (CAudioStreamReader* reader : m_jobReaders)
+		numDecodedBytes += reader->Decode(reader->m_capacity / STREAM_DECODE_PARTS);
+
+	// readers which were destroyed meanwhile are freed here
+	m_jobReaders.clear();
+
+	Atomic::Add(m_decodedBytes, numDecodedBytes);
+}
+
+//-----------------------------------------------
+// Stream reader test
+//-----------------------------------------------
+
+// each frame holds it's own index so voice can check what it reads
+class CSoundSource_StreamTest : public ISoundSource
+{
+public:
+	CSoundSource_StreamTest(int numFrames)
+		: m_numFrames(numFrames)
+	{
+		SetFilename("_stream_test");
+
+		m_format.dataFormat = FORMAT_PCM;
+		m_format.frequency = 44100;
+		m_format.channels = 1;
+		m_format.bitwidth = 16;
+	}
+
+	static short	FrameValue(int frame) { return (short)(frame & 0x7fff); }
+
+	int GetSamples(void* out, int samplesToRead, int startOffset, bool loop) const
+	{
+		short* outFrames = (short*)out;
+
+		int numRead = 0;
+		int offset = startOffset;
+		while (numRead < samplesToRead)
+		{
+			if (offset >= m_numFrames)
+			{
+				if (!loop)
+					break;
+				offset = 0;
+			}
+			outFrames[numRead++] = FrameValue(offset++);
+		}
+		return numRead;
+	}
+
+	void*			GetDataPtr(int& dataSize) const	{ dataSize = 0; return nullptr; }
+	const Format&	GetFormat() const				{ return m_format; }
+	int				GetSampleCount() const			{ return m_numFrames; }
+	int				GetLoopRegions(int* samplePos) const { return 0; }
+	bool			IsStreaming() const				{ return true; }
+
+private:
+	bool			Load() { return true; }
+	void			Unload() {}
+
+	Format			m_format;
+	int				m_numFrames{ 0 };
+};
+
+// decodes reader on it's own thread instead of spool audio jobs
+class CAudioStreamTestDecoder : public CEqThread
+{
+public:
+	int Run()
+	{
+		while (!Atomic::Add(stop, 0))
+		{
+			if (!reader->Decode(reader->m_capacity / STREAM_DECODE_PARTS))
+				Platform_Sleep(0);
+		}
+		return 0;
+	}
+
+	CAudioStreamReader*	reader{ nullptr };
+	volatile int32		stop{ 0 };
+};
+
+// reads block from voice side, waiting for decoder. Returns number of frames or -1 on timeout
+static int StreamTest_ReadBlock(CAudioStreamReader* reader, short* out, int numFrames, int samplePos, bool looping)
+{
+	for (int i = 0; i < 100000; ++i)
+	{
+		const int numRead = reader->Read(out, numFrames, samplePos, looping);
+		if (numRead > 0 || reader->IsEnded())
+			return numRead;
+
+		Platform_Sleep(0);
+	}
+	return -1;
+}
+
+DECLARE_CMD(snd_stream_test, "Stream reader test, decoder thread fills ring while voice reads and seeks. Arguments: [number of blocks]", 0)
+{
+	const int numBlocks = CMD_ARGC > 0 ? max(1, atoi(CMD_ARGV(0).ToCString())) : 20000;
+	const int blockFrames = 441;
+	const int sampleFrames = 100003;	// not multiple of block size so loop wraps inside of block
+
+	CSoundSource_StreamTest sample(sampleFrames);
+	CAudioStreamReaderPtr reader = CRefPtr_new(CAudioStreamReader, &sample, STREAM_MIN_LOOKAHEAD_FRAMES);
+
+	CAudioStreamTestDecoder decoder;
+	decoder.reader = reader;
+	decoder.StartThread("StreamTestDecoder");
+
+	short block[blockFrames];
+	bool result = true;
+
+	// looping playback with seeks
+	int samplePos = 0;
+	int numSeeks = 0;
+	for (int i = 0; i < numBlocks && result; ++i)
+	{
+		if (RandomInt(0, 200) == 0)
+		{
+			samplePos = RandomInt(0, sampleFrames - 1);
+			++numSeeks;
+		}
+
+		const int numRead = StreamTest_ReadBlock(reader, block, blockFrames, samplePos, true);
+		if (numRead != blockFrames)
+		{
+			MsgError("  block %d at %d: read %d frames of %d\n", i, samplePos, numRead, blockFrames);
+			result = false;
+			break;
+		}
+
+		for (int j = 0; j < numRead; ++j)
+		{
+			const int expected = CSoundSource_StreamTest::FrameValue((samplePos + j) % sampleFrames);
+			if (block[j] != expected)
+			{
+				MsgError("  block %d at %d: frame %d is %d, expected %d\n", i, samplePos, j, block[j], expected);
+				result = false;
+				break;
+			}
+		}
+
+		samplePos = WrapAroundSampleOffset(samplePos + numRead, &sample, true);
+	}
+
+	// non-looping playback reaches the end
+	if (result)
+	{
+		samplePos = sampleFrames - blockFrames * 10 - 7;
+		int numTotal = 0;
+		for (;;)
+		{
+			const int numRead = StreamTest_ReadBlock(reader, block, blockFrames, samplePos, false);
+			if (numRead < 0)
+			{
+				MsgError("  non-looping read timed out at %d\n", samplePos);
+				result = false;
+				break;
+			}
+
+			if (numRead == 0)
+				break;
+
+			for (int j = 0; j < numRead; ++j)
+			{
+				if (block[j] != CSoundSource_StreamTest::FrameValue(samplePos + j))
+				{
+					MsgError("  non-looping frame %d is wrong\n", samplePos + j);
+					result = false;
+					break;
+				}
+			}
+
+			samplePos += numRead;
+			numTotal += numRead;
+		}
+
+		if (result && (numTotal != blockFrames * 10 + 7 || !reader->IsEnded()))
+		{
+			MsgError("  non-looping playback read %d frames, expected %d\n", numTotal, blockFrames * 10 + 7);
+			result = false;
+		}
+	}
+
+	Atomic::Exchange(decoder.stop, 1);
+	decoder.StopThread(true);
+
+	MsgInfo("snd_stream_test: %d blocks, %d seeks %s\n", numBlocks, numSeeks, result ? "OK" : "FAILED");
+}
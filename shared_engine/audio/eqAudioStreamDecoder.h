@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Streamed sample decoding ahead of playback.
+//				Voices only consume PCM decoded by spool audio jobs
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+class ISoundSource;
+
+// Ring buffer of PCM frames decoded ahead of voice playback position.
+// Read is called by the voice on audio update thread,
+// Decode is only called by decoder job.
+class CAudioStreamReader : public RefCountedObject<CAudioStreamReader>
+{
+	friend class CAudioStreamDecoder;
+	friend class CAudioStreamTestDecoder;
+public:
+	CAudioStreamReader(ISoundSource* sample, int lookAheadFrames);
+
+	ISoundSource*	GetSample() const { return m_sample; }
+
+	// reads numFrames or what's left before end of non-looping sample.
+	// Returns 0 if decoder has not yet caught up with samplePos.
+	int				Read(void* out, int numFrames, int samplePos, bool looping);
+
+	// all frames of non-looping sample have been read
+	bool			IsEnded();
+
+	// has been giving data since last seek
+	bool			IsPrimed() const { return m_primed; }
+
+protected:
+	void			Seek(int samplePos, bool looping);
+	int				Decode(int minFrames);
+	void			Detach() { Atomic::Store(m_detached, 1); }
+
+	ISoundSource*	m_sample{ nullptr };
+
+	Array<ubyte>	m_buffer{ PP_SL };
+	int				m_capacity{ 0 };			// in frames
+	int				m_sampleSize{ 0 };
+
+	// ring positions are in frames and never wrap to zero
+	volatile uint32	m_readPos{ 0 };
+	volatile uint32	m_writePos{ 0 };
+	volatile int32	m_ended{ 0 };
+	volatile int32	m_detached{ 0 };			// voice has released reader, decoder skips it
+
+	// seek is requested by voice and applied by decoder when generations differ
+	volatile uint32	m_seekGen{ 0 };
+	volatile uint32	m_decodeGen{ 0 };
+	int				m_seekPos{ 0 };
+	bool			m_seekLooping{ false };
+
+	// decoder job state
+	int				m_decodePos{ 0 };
+	bool			m_decodeLooping{ false };
+
+	// voice state
+	int				m_expectedPos{ -1 };
+	bool			m_expectedLooping{ false };
+	bool			m_primed{ false };
+	uint32			m_voiceSeekGen{ 0 };		// last generation requested by voice, m_seekGen is only read by decoder
+};
+
+using CAudioStreamReaderPtr = CRefPtr<CAudioStreamReader>;
+
+// Keeps readers of playing streamed voices filled using JOB_TYPE_SPOOL_AUDIO jobs.
+// Only one decode job is running at a time, so streamed samples are never decoded concurrently.
+class CAudioStreamDecoder
+{
+public:
+	CAudioStreamDecoder();
+
+	void					Shutdown();
+
+	CAudioStreamReaderPtr	CreateReader(ISoundSource* sample);
+	void					DestroyReader(CAudioStreamReader* reader);
+
+	// sample can't be freed while decode job is using it
+	void					OnSampleDeleted(ISoundSource* sample);
+
+	// starts decode job if there is none running. Called each audio update
+	void					Update();
+
+	void					OnUnderrun() { Atomic::Increment(m_numUnderruns); }
+
+	int						GetReaderCount() const { return m_readers.numElem(); }
+	int						GetUnderrunCount() const { return Atomic::Load(m_numUnderruns); }
+	int						GetDecodedKBytes() const { return (int)(Atomic::Load(m_decodedBytes) / 1024); }
+
+private:
+	void					DecodeJob();
+
+	Threading::CEqMutex			m_mutex;
+	Array<CAudioStreamReaderPtr>	m_readers{ PP_SL };
+	Array<CAudioStreamReaderPtr>	m_jobReaders{ PP_SL };
+
+	Threading::CEqSignal		m_jobDone{ true };
+	volatile int32				m_jobPending{ 0 };
+	volatile int32				m_numUnderruns{ 0 };
+	volatile int64				m_decodedBytes{ 0 };
+};
@@ -18,6 +18,7 @@
 #include "render/IDebugOverlay.h"
 
 #include "eqAudioSystemAL.h"
+#include "eqAudioSystemSW.h"
 #include "source/snd_al_source.h"
 
 using namespace Threading;
@@ -78,42 +79,6 @@ static bool ALCheckError(const char* op, ...)
 	return true;
 }
 
-static int GetLoopRegionIdx(int offsetInSamples, int* points, int regionCount)
-{
-	for (int i = 0; i < regionCount; ++i)
-	{
-		if (offsetInSamples >= points[i * 2]) //&& offsetInSamples <= points[i*2+1])
-			return i;
-	}
-	return -1;
-}
-
-static int WrapAroundSampleOffset(int sampleOffset, const ISoundSource* sample, bool looping)
-{
-	const int sampleCount = sample->GetSampleCount();
-
-	if (looping)
-	{
-		int loopPoints[SOUND_SOURCE_MAX_LOOP_REGIONS * 2];
-		const int numLoopRegions = sample->GetLoopRegions(loopPoints);
-
-		const int loopRegionIdx = GetLoopRegionIdx(sampleOffset, loopPoints, numLoopRegions);
-		const int sampleMin = (loopRegionIdx == -1) ? 0 : loopPoints[loopRegionIdx * 2];
-		const int sampleMax = (loopRegionIdx == -1) ? sampleCount : loopPoints[loopRegionIdx * 2 + 1];
-
-		const int sampleRange = sampleMax - sampleMin;
-		
-		if(sampleRange > 0)
-			sampleOffset = sampleMin + ((sampleOffset - sampleMin) % sampleRange);
-		else
-			sampleOffset = sampleMin;
-	}
-	else
-		sampleOffset = min(sampleOffset, sampleCount);
-
-	return sampleOffset;
-}
-
 //---------------------------------------------------------
 // AL COMMON
 
@@ -223,7 +188,7 @@ static LPALBUFFERCALLBACKSOFT alBufferCallbackSOFT;
 
 void snd_hrtf_changed(ConVar* pVar, char const* pszOldValue)
 {
-	if(!g_audioSystem)
+	if(g_audioSystem != &s_audioSystemAL)
 		return;
 
 	((CEqAudioSystemAL*)g_audioSystem)->UpdateDeviceHRTF();
@@ -232,6 +197,24 @@ void snd_hrtf_changed(ConVar* pVar, char const* pszOldValue)
 DECLARE_CVAR(snd_device, "0", nullptr, CV_ARCHIVE);
 DECLARE_CVAR_CHANGE(snd_hrtf, "0", snd_hrtf_changed, nullptr, CV_ARCHIVE);
 DECLARE_CVAR(snd_debug, "0", nullptr, CV_CHEAT);
+DECLARE_CVAR(snd_software, "0", "Use software mixer without audio device output", CV_ARCHIVE);
+
+// selects audio backend, software mixer is used when requested or if there is no audio device
+void InitAudioSystem()
+{
+	if (!snd_software.GetBool())
+	{
+		s_audioSystemAL.Init();
+		if (s_audioSystemAL.HasDevice())
+		{
+			g_audioSystem = &s_audioSystemAL;
+			return;
+		}
+	}
+
+	g_audioSystem = g_audioSystemSW;
+	g_audioSystem->Init();
+}
 
 //---------------------------------------------------------
 
@@ -260,7 +243,7 @@ bool CEqAudioSystemAL::InitContext()
 	const char* devices = (char*)alcGetString(nullptr, ALC_DEVICE_SPECIFIER);
 
 	// go through device list (each device terminated with a single NULL, list terminated with double NULL)
-	while ((*devices) != '\0')
+	while (devices && (*devices) != '\0')
 	{
 		tempListChars.append(devices);
 
@@ -268,6 +251,12 @@ bool CEqAudioSystemAL::InitContext()
 		devices += strlen(devices) + 1;
 	}
 
+	if (!tempListChars.numElem())
+	{
+		MsgWarning("No audio devices found\n");
+		return false;
+	}
+
 	if (snd_device.GetInt() >= tempListChars.numElem())
 	{
 		MsgWarning("snd_device: Invalid audio device selected, reset to 0\n");
@@ -553,6 +542,8 @@ void CEqAudioSystemAL::Shutdown()
 	StopAllSounds();
 	DestroyEffects();
 
+	m_streamDecoder.Shutdown();
+
 	// clear voices
 	m_sources.clear(true);
 
@@ -714,6 +705,7 @@ void CEqAudioSystemAL::OnSampleDeleted(ISoundSource* sampleSource)
 
 	// stop voices using that sample
 	SuspendSourcesWithSample(sampleSource);
+	m_streamDecoder.OnSampleDeleted(sampleSource);
 
 	DevMsg(DEVMSG_SOUND, "freeing sample %s\n", sampleSource->GetFilename());
 
@@ -802,6 +794,9 @@ void CEqAudioSystemAL::EndUpdate()
 		}
 	}
 
+	// decode streams ahead while voices are playing what's queued
+	m_streamDecoder.Update();
+
 	// setup orientation parameters
 	const float orient[] = { m_listener.orientF.x,  m_listener.orientF.y,  m_listener.orientF.z, -m_listener.orientU.x, -m_listener.orientU.y, -m_listener.orientU.z };
 
@@ -840,6 +835,8 @@ void CEqAudioSystemAL::EndUpdate()
 		debugoverlay->Text(color_white, "-----SOUND STATISTICS-----");
 		debugoverlay->Text(color_white, "  sources: %d, (%d allocated)", playing, m_sources.numElem());
 		debugoverlay->Text(color_white, "  samples: %d, mem: %d kbytes (non-streamed)", m_samples.size(), sampleMem / 1024);
+		debugoverlay->Text(color_white, "  streams: %d, underruns: %d, decoded: %d kbytes",
+			m_streamDecoder.GetReaderCount(), m_streamDecoder.GetUnderrunCount(), m_streamDecoder.GetDecodedKBytes());
 	}
 
 	m_begunUpdate = false;
@@ -1001,7 +998,10 @@ void CEqAudioSourceAL::UpdateParams(const Params& params, int overrideUpdateFlag
 	if (mask & UPDATE_DO_REWIND)
 	{
 		for (int i = 0; i < m_streams.numElem(); ++i)
+		{
 			m_streams[i].curPos = 0;
+			m_streams[i].curFrac = 0.0f;
+		}
 
 #ifdef USE_ALSOFT_BUFFER_CALLBACK
 		if(!alBufferCallbackSOFT && !isStreaming)
@@ -1046,10 +1046,10 @@ void CEqAudioSourceAL::UpdateParams(const Params& params, int overrideUpdateFlag
 					alSourceUnqueueBuffers(thisSource, 1, &qbuffer);
 
 				for (int i = 0; i < EQSND_STREAM_BUFFER_COUNT; i++)
-				{
-					if (!QueueStreamChannel(m_buffers[i]))
-						break; // too short
-				}
+					m_freeBuffers[i] = m_buffers[i];
+				m_numFreeBuffers = EQSND_STREAM_BUFFER_COUNT;
+
+				QueueStreamBuffers();
 				ALCheckError("queue buffers");
 			}
 
@@ -1070,6 +1070,7 @@ void CEqAudioSourceAL::SetSamplePlaybackPosition(int sourceIdx, float seconds)
 		{
 			const ISoundSource::Format& fmt = m_streams[i].sample->GetFormat();
 			m_streams[i].curPos = WrapAroundSampleOffset(seconds * fmt.frequency, m_streams[i].sample, m_looping);
+			m_streams[i].curFrac = 0.0f;
 		}
 		return;
 	}
@@ -1078,6 +1079,7 @@ void CEqAudioSourceAL::SetSamplePlaybackPosition(int sourceIdx, float seconds)
 		return;
 	const ISoundSource::Format& fmt = m_streams[sourceIdx].sample->GetFormat();
 	m_streams[sourceIdx].curPos = WrapAroundSampleOffset(seconds * fmt.frequency, m_streams[sourceIdx].sample, m_looping);
+	m_streams[sourceIdx].curFrac = 0.0f;
 }
 
 float CEqAudioSourceAL::GetSamplePlaybackPosition(int sourceIdx)
@@ -1229,6 +1231,10 @@ bool CEqAudioSourceAL::InitSource()
 	alGenBuffers(EQSND_STREAM_BUFFER_COUNT, m_buffers);
 	ALCheckError("gen stream buffer");
 
+	for (int i = 0; i < EQSND_STREAM_BUFFER_COUNT; i++)
+		m_freeBuffers[i] = m_buffers[i];
+	m_numFreeBuffers = EQSND_STREAM_BUFFER_COUNT;
+
 	return true;
 }
 
@@ -1238,12 +1244,20 @@ void CEqAudioSourceAL::Release()
 	m_channel = -1;
 	m_state = STOPPED;
 
+	if (m_streamReader)
+	{
+		m_owner->m_streamDecoder.DestroyReader(m_streamReader);
+		m_streamReader = nullptr;
+	}
+	m_streamStarving = false;
+
 	if (m_source != AL_NONE)
 	{
 		EmptyBuffers();
 
 		alDeleteBuffers(EQSND_STREAM_BUFFER_COUNT, m_buffers);
 		alDeleteSources(1, &m_source);
+		m_numFreeBuffers = 0;
 
 		m_source = AL_NONE;
 		m_streams.clear();
@@ -1321,15 +1335,12 @@ bool CEqAudioSourceAL::DoUpdate()
 				// dequeue and get buffer
 				ALuint buffer;
 				alSourceUnqueueBuffers(m_source, 1, &buffer);
-
-				if (!QueueStreamChannel(buffer))
-				{
-					m_state = STOPPED;
-					break;
-				}
+				m_freeBuffers[m_numFreeBuffers++] = buffer;
 			}
 
-			if (sourceState != AL_PLAYING)
+			if (!QueueStreamBuffers())
+				m_state = STOPPED;
+			else if (sourceState != AL_PLAYING && m_numFreeBuffers < EQSND_STREAM_BUFFER_COUNT)
 				alSourcePlay(m_source);
 		}
 	}
@@ -1373,62 +1384,6 @@ static ALsizei AL_APIENTRY SoundSourceSampleDataCallback(void* userPtr, void* da
 	return audioSrc->GetSampleBuffer(data, size);
 }
 
-// mix 8 bit into 16 bit mono sound
-static int MixMono8(float volume, const uint8* in, int numInSamples, short* out, int numOutSamples)
-{
-	const int maxSamples = min(numInSamples, numOutSamples);
-	for (int i = 0; i < maxSamples; ++i)
-	{
-		const float src_val = ((short)in[i] * 256 - SHRT_MAX) * volume;
-		const int result = (((SHRT_MAX - out[i]) * src_val) / SHRT_MAX) + out[i];
-		out[i] = clamp(result, SHRT_MIN, SHRT_MAX);
-	}
-
-	return maxSamples;
-}
-
-// mix 8 bit stereo into 16 bit stereo
-static int MixStereo8(float volume, const uint8* in, int numInSamples, short* out, int numOutSamples)
-{
-	const int maxSamples = 2 * min(numInSamples, numOutSamples);
-	for (int i = 0; i < maxSamples; ++i)
-	{
-		const float src_val = ((short)in[i] * 256 - SHRT_MAX) * volume;
-		const int result = (((SHRT_MAX - out[i]) * src_val) / SHRT_MAX) + out[i];
-		out[i] = clamp(result, SHRT_MIN, SHRT_MAX);
-	}
-
-	return maxSamples;
-}
-
-// mix 16 bit mono into 16 bit mono sound
-static int MixMono16(float volume, const short* in, int numInSamples, short* out, int numOutSamples)
-{
-	const int maxSamples = min(numInSamples, numOutSamples);
-	for (int i = 0; i < maxSamples; ++i)
-	{
-		const float src_val = in[i] * volume;
-		const int result = (((SHRT_MAX - out[i]) * src_val) / SHRT_MAX) + out[i];
-		out[i] = clamp(result, SHRT_MIN, SHRT_MAX);
-	}
-
-	return maxSamples;
-}
-
-// mix 16 bit stereo into 16 bit stereo
-static int MixStereo16(float volume, const short* in, int numInSamples, short* out, int numOutSamples)
-{
-	const int maxSamples = 2 * min(numInSamples, numOutSamples);
-	for (int i = 0; i < maxSamples; ++i)
-	{
-		const float src_val = in[i] * volume;
-		const int result = (((SHRT_MAX - out[i]) * src_val) / SHRT_MAX) + out[i];
-		out[i] = clamp(result, SHRT_MIN, SHRT_MAX);
-	}
-
-	return maxSamples;
-}
-
 ALsizei CEqAudioSourceAL::GetSampleBuffer(void* data, ALsizei size)
 {
 	const bool looping = m_looping;
@@ -1454,66 +1409,12 @@ ALsizei CEqAudioSourceAL::GetSampleBuffer(void* data, ALsizei size)
 		return samplesRead * sampleSize;
 	}
 
-	// TODO: perform sample rate conversion
-
-	// silence before mix
-	memset(data, 0, size);
-	
 	// We are mixing always into 16 bit no matter what
 	const int sizeOfChannels = sizeof(short) * m_bufferChannels;
-	const int numSamplesToRead = size / sizeOfChannels;
-	int numRead = 0;
-
-	// we can mix up to 8 samples simultaneously
-	for(int i = 0; i < m_streams.numElem(); ++i)
-	{
-		ISoundSource* sample = m_streams[i].sample;
-		const float sampleVolume = min(m_streams[i].volume, 1.0f);
-
-		int loopPoints[SOUND_SOURCE_MAX_LOOP_REGIONS * 2];
-		const int numLoopRegions = sample->GetLoopRegions(loopPoints);
-
-		if (sampleVolume <= 0.0f)
-		{
-			// update playback progress still but don't mix
-			m_streams[i].curPos = WrapAroundSampleOffset(m_streams[i].curPos + numSamplesToRead, sample, looping);
-			numRead = max(numRead, numSamplesToRead);
-			continue;
-		}
-
-		const ISoundSource::Format& fmt = sample->GetFormat();
-		const int sampleUnit = (fmt.bitwidth >> 3);
-		const int sampleSize = sampleUnit;
-		const int sampleCount = sample->GetSampleCount();
-
-		const int streamPos = m_streams[i].curPos;
-		int samplesRead = 0;
-		if (sampleUnit == sizeof(uint8))
-		{
-			uint8* tmpSamples = (uint8*)stackalloc(numSamplesToRead * sampleSize * fmt.channels);
-			samplesRead = sample->GetSamples(tmpSamples, numSamplesToRead, streamPos, looping);
-
-			if(fmt.channels == 1)
-				MixMono8(sampleVolume, tmpSamples, samplesRead, (int16*)data, size);
-			else if(fmt.channels == 2)
-				MixStereo8(sampleVolume, tmpSamples, samplesRead, (int16*)data, size);
-		}
-		else if (sampleUnit == sizeof(uint16))
-		{
-			int16* tmpSamples = (int16*)stackalloc(numSamplesToRead * sampleSize * fmt.channels);
-			samplesRead = sample->GetSamples(tmpSamples, numSamplesToRead, streamPos, looping);
+	const int numMixed = AudioMix_MixStreams(m_streams, m_owner->m_mixBuffers,
+		m_bufferFrequency, m_bufferChannels, 1.0f, looping, (short*)data, size / sizeOfChannels);
 
-			if (fmt.channels == 1)
-				MixMono16(sampleVolume, tmpSamples, samplesRead, (int16*)data, size);
-			else if (fmt.channels == 2)
-				MixStereo16(sampleVolume, tmpSamples, samplesRead, (int16*)data, size);
-		}
-		
-		m_streams[i].curPos = WrapAroundSampleOffset(streamPos + samplesRead, sample, looping);
-		numRead = max(numRead, samplesRead);
-	}
-
-	return numRead * sizeOfChannels;
+	return numMixed * sizeOfChannels;
 }
 
 void CEqAudioSourceAL::SetupSample(const ISoundSource* sample)
@@ -1544,6 +1445,10 @@ void CEqAudioSourceAL::SetupSample(const ISoundSource* sample)
 			alSourcei(m_source, AL_BUFFER, alSource->m_alBuffer);
 		}
 	}
+	else
+	{
+		m_streamReader = m_owner->m_streamDecoder.CreateReader(stream.sample);
+	}
 }
 
 void CEqAudioSourceAL::SetupSamples(ArrayCRef<const ISoundSource*> samples)
@@ -1568,6 +1473,7 @@ void CEqAudioSourceAL::SetupSamples(ArrayCRef<const ISoundSource*> samples)
 	}
 
 	m_bufferChannels = fmt.channels;
+	m_bufferFrequency = fmt.frequency;
 
 	if (!m_streams.front().sample->IsStreaming())
 	{
@@ -1614,36 +1520,62 @@ void CEqAudioSourceAL::SetupSamples(ArrayCRef<const ISoundSource*> samples)
 			alSourcei(m_source, AL_BUFFER, alSource->m_alBuffer);
 		}
 	}
-
+	else
+	{
+		m_streamReader = m_owner->m_streamDecoder.CreateReader(m_streams.front().sample);
+	}
 }
 
-bool CEqAudioSourceAL::QueueStreamChannel(ALuint buffer)
+// fills free stream buffers with decoded data.
+// Returns false when stream has ended and everything queued was played
+bool CEqAudioSourceAL::QueueStreamBuffers()
 {
 	static ubyte pcmBuffer[EQSND_STREAM_BUFFER_SIZE];
 
 	SourceStream& mainStream = GetSourceStream();
 	ISoundSource* sample = mainStream.sample;
-	const int streamPos = mainStream.curPos;
 
 	const ISoundSource::Format& fmt = sample->GetFormat();
 	ALenum alFormat = GetSoundSourceFormatAsALEnum(fmt);
 	const int sampleSize = (fmt.bitwidth >> 3) * fmt.channels;
 
-	// read sample data and update AL buffers
-	const int numRead = sample->GetSamples(pcmBuffer, EQSND_STREAM_BUFFER_SIZE / sampleSize, streamPos, m_looping);
-
-	if (numRead > 0)
+	while (m_numFreeBuffers > 0)
 	{
+		const int streamPos = mainStream.curPos;
+
+		// only takes what decoder job has already prepared
+		const int numRead = m_streamReader->Read(pcmBuffer, EQSND_STREAM_BUFFER_SIZE / sampleSize, streamPos, m_looping);
+		if (numRead <= 0)
+			break;
+
 		mainStream.curPos = WrapAroundSampleOffset(streamPos + numRead, sample, m_looping);
 
 		// upload to specific buffer
+		const ALuint buffer = m_freeBuffers[--m_numFreeBuffers];
 		alBufferData(buffer, alFormat, pcmBuffer, numRead * sampleSize, fmt.frequency);
 
 		// queue after uploading
 		alSourceQueueBuffers(m_source, 1, &buffer);
 	}
 
-	return numRead > 0;
+	if (m_numFreeBuffers < EQSND_STREAM_BUFFER_COUNT)
+	{
+		m_streamStarving = false;
+		return true;
+	}
+
+	if (m_streamReader->IsEnded())
+		return false;
+
+	// source has played everything while decoder hasn't caught up
+	if (m_streamReader->IsPrimed() && !m_streamStarving)
+		m_owner->m_streamDecoder.OnUnderrun();
+	m_streamStarving = true;
+
+	// don't wait for next update to get decoder going
+	m_owner->m_streamDecoder.Update();
+
+	return true;
 }
 
 // dequeues buffers
@@ -1664,6 +1596,10 @@ void CEqAudioSourceAL::EmptyBuffers()
 		while (numQueued--)
 			alSourceUnqueueBuffers(m_source, 1, &qbuffer);
 
+		for (int i = 0; i < EQSND_STREAM_BUFFER_COUNT; i++)
+			m_freeBuffers[i] = m_buffers[i];
+		m_numFreeBuffers = EQSND_STREAM_BUFFER_COUNT;
+
 		// make silent buffer (this also removes callback)
 		for (int i = 0; i < EQSND_STREAM_BUFFER_COUNT; i++)
 			alBufferData(m_buffers[i], AL_FORMAT_MONO16, (short*)_silence, BUFFER_SILENCE_SIZE, 8000);
@@ -7,6 +7,8 @@
 
 #pragma once
 #include "audio/IEqAudioSystem.h"
+#include "eqAudioMixer.h"
+#include "eqAudioStreamDecoder.h"
 
 //-----------------------------------------------------------------
 
@@ -31,6 +33,8 @@ public:
 	void						Init();
 	void						Shutdown();
 
+	bool						HasDevice() const { return !m_noSound; }
+
 	CRefPtr<IEqAudioSource>		CreateSource();
 	void						DestroySource(IEqAudioSource* source);
 
@@ -114,6 +118,9 @@ private:
 		Vector3D orientU{ vec3_up };
 	} m_listener;
 
+	AudioMixBuffers							m_mixBuffers;		// used by AL mixer thread for multi-sample sources
+	CAudioStreamDecoder						m_streamDecoder;	// decodes streamed samples ahead of voices
+
 	ALCcontext*								m_ctx{ nullptr };
 	ALCdevice*								m_dev{ nullptr };
 	bool									m_noSound{ true };
@@ -152,14 +159,9 @@ public:
 
 protected:
 
-	struct SourceStream
-	{
-		ISoundSource*	sample{ nullptr };
-		int				curPos{ 0 };
-		float			volume{ 1.0f };
-	};
+	using SourceStream = AudioMixStream;
 
-	bool					QueueStreamChannel(ALuint buffer);
+	bool					QueueStreamBuffers();
 	void					SetupSample(const ISoundSource* sample);
 	void					SetupSamples(ArrayCRef<const ISoundSource*> samples);
 
@@ -176,7 +178,11 @@ protected:
 	FixedArray<SourceStream, EQSND_SAMPLE_COUNT> m_streams;
 
 	ALuint					m_buffers[EQSND_STREAM_BUFFER_COUNT]{ 0 };
+	ALuint					m_freeBuffers[EQSND_STREAM_BUFFER_COUNT]{ 0 };	// stream buffers not queued on source
+	int						m_numFreeBuffers{ 0 };
+	CAudioStreamReaderPtr	m_streamReader;
 	ALuint					m_bufferChannels{ 0 };
+	ALuint					m_bufferFrequency{ 0 };
 	ALuint					m_source{ 0 };
 	ALuint					m_filter{ 0 };
 
@@ -191,4 +197,5 @@ protected:
 	bool					m_releaseOnStop{ true };
 	bool					m_forceStop{ false };
 	bool					m_looping{ false };
+	bool					m_streamStarving{ false };
 };
@@ -0,0 +1,955 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Equilibrium Engine software mixer audio system.
+//				Doesn't need audio device, output goes to null sink or WAV file
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/ConVar.h"
+#include "core/ConCommand.h"
+#include "math/Random.h"
+#include "math/Simd.h"
+#include "render/IDebugOverlay.h"
+#include "utils/riff.h"
+
+#include "eqAudioSystemSW.h"
+#include "eqAudioMixer.h"
+#include "source/snd_source.h"
+
+using namespace Threading;
+
+static CEqAudioSystemSW s_audioSystemSW;
+CEqAudioSystemSW* g_audioSystemSW = &s_audioSystemSW;
+
+DECLARE_CVAR(snd_sw_debug, "0", "Show software mixer statistics", CV_CHEAT);
+
+DECLARE_CMD(snd_sw_record, "Records software mixer output to WAV file. Stops recording if no file specified", 0)
+{
+	g_audioSystemSW->SetWaveOutput(CMD_ARGC > 0 ? CMD_ARGV(0).ToCString() : nullptr);
+}
+
+// mixer doesn't catch up after stalls longer than this
+#define SW_MAX_PENDING_FRAMES		(EQSND_SW_FREQUENCY / 10)
+
+//---------------------------------------------------------
+
+CEqAudioSystemSW::CEqAudioSystemSW()
+{
+}
+
+CEqAudioSystemSW::~CEqAudioSystemSW()
+{
+}
+
+void CEqAudioSystemSW::Init()
+{
+	Msg("Audio device: software mixer, %d Hz stereo\n", EQSND_SW_FREQUENCY);
+
+	m_mixerChannels.setNum(EQSND_SW_MIXER_CHANNELS);
+	m_outputBuffer.setNum(EQSND_SW_BLOCK_SIZE * 2);
+
+	m_pendingFrames = 0.0;
+	m_timer.GetTime(true);
+}
+
+void CEqAudioSystemSW::Shutdown()
+{
+	StopAllSounds();
+	CloseWaveOutput();
+
+	// clear voices
+	m_sources.clear(true);
+	m_newSources.clear(true);
+
+	// delete sample sources
+	m_samples.clear(true);
+
+	m_mixLeft.clear(true);
+	m_mixRight.clear(true);
+	m_inputLeft.clear(true);
+	m_inputRight.clear(true);
+	m_resampled.clear(true);
+	m_readBuffer.clear(true);
+	m_outputBuffer.clear(true);
+}
+
+CRefPtr<IEqAudioSource> CEqAudioSystemSW::CreateSource()
+{
+	CRefPtr<CEqAudioSourceSW> source = CRefPtr_new(CEqAudioSourceSW, this);
+
+	// mixer picks it up on next update
+	CScopedMutex m(m_mutex);
+	m_newSources.append(source);
+
+	return static_cast<CRefPtr<IEqAudioSource>>(source);
+}
+
+// sources list is only touched by update and mixer,
+// others create sources through m_newSources
+void CEqAudioSystemSW::AddNewSources()
+{
+	CScopedMutex m(m_mutex);
+	if (!m_newSources.numElem())
+		return;
+
+	m_sources.append(m_newSources);
+	m_newSources.clear();
+}
+
+void CEqAudioSystemSW::DestroySource(IEqAudioSource* source)
+{
+	if (!source)
+		return;
+
+	CEqAudioSourceSW* src = (CEqAudioSourceSW*)source;
+
+	src->m_releaseOnStop = true;
+	src->m_forceStop = true;
+}
+
+void CEqAudioSystemSW::StopAllSounds(int chanId /*= -1*/)
+{
+	AddNewSources();
+
+	for (int i = 0; i < m_sources.numElem(); i++)
+	{
+		CEqAudioSourceSW* source = m_sources[i].Ptr();
+		if (chanId == -1 || source->m_channel == chanId)
+			source->m_forceStop = true;
+	}
+}
+
+void CEqAudioSystemSW::PauseAllSounds(int chanId /*= -1*/)
+{
+	AddNewSources();
+
+	IEqAudioSource::Params param;
+	param.set_state(IEqAudioSource::PAUSED);
+
+	for (int i = 0; i < m_sources.numElem(); i++)
+	{
+		CEqAudioSourceSW* source = m_sources[i].Ptr();
+		if (chanId == -1 || source->m_channel == chanId)
+			source->UpdateParams(param);
+	}
+}
+
+void CEqAudioSystemSW::ResumeAllSounds(int chanId /*= -1*/)
+{
+	AddNewSources();
+
+	IEqAudioSource::Params param;
+	param.set_state(IEqAudioSource::PLAYING);
+
+	for (int i = 0; i < m_sources.numElem(); i++)
+	{
+		CEqAudioSourceSW* source = m_sources[i].Ptr();
+		if (chanId == -1 || source->m_channel == chanId)
+			source->UpdateParams(param);
+	}
+}
+
+void CEqAudioSystemSW::ResetMixer(int chanId)
+{
+	if (!m_mixerChannels.inRange(chanId))
+		return;
+
+	m_mixerChannels[chanId] = MixerChannel_t();
+}
+
+void CEqAudioSystemSW::SetChannelVolume(int chanId, float value)
+{
+	if (!m_mixerChannels.inRange(chanId))
+		return;
+
+	m_mixerChannels[chanId].volume = value;
+}
+
+void CEqAudioSystemSW::SetChannelPitch(int chanId, float value)
+{
+	if (!m_mixerChannels.inRange(chanId))
+		return;
+
+	m_mixerChannels[chanId].pitch = value;
+}
+
+void CEqAudioSystemSW::SetMasterVolume(float value)
+{
+	m_masterVolume = value;
+}
+
+void CEqAudioSystemSW::SetListener(const Vector3D& position,
+	const Vector3D& velocity,
+	const Vector3D& forwardVec,
+	const Vector3D& upVec)
+{
+	m_listener.position = position;
+	m_listener.velocity = velocity;
+	m_listener.orientF = forwardVec;
+	m_listener.orientU = upVec;
+}
+
+const Vector3D& CEqAudioSystemSW::GetListenerPosition() const
+{
+	return m_listener.position;
+}
+
+// loads sample source data
+ISoundSourcePtr CEqAudioSystemSW::GetSample(const char* filename)
+{
+	{
+		const int nameHash = StringToHash(filename, true);
+		CScopedMutex m(m_mutex);
+		auto it = m_samples.find(nameHash);
+		if (!it.atEnd())
+			return ISoundSourcePtr(*it);
+	}
+
+	ISoundSourcePtr sampleSource = ISoundSource::CreateSound(filename);
+
+	if (sampleSource)
+	{
+		const ISoundSource::Format& fmt = sampleSource->GetFormat();
+
+		if (fmt.dataFormat != ISoundSource::FORMAT_PCM || fmt.bitwidth > 16)	// not PCM or 32 bit
+		{
+			MsgWarning("Sound '%s' has unsupported format!\n", filename);
+			return nullptr;
+		}
+		else if (fmt.channels > 2)
+		{
+			MsgWarning("Sound '%s' has unsupported channel count (%d)!\n", filename, fmt.channels);
+			return nullptr;
+		}
+
+		AddSample(sampleSource);
+	}
+
+	return sampleSource;
+}
+
+void CEqAudioSystemSW::AddSample(ISoundSource* sample)
+{
+	const int nameHash = sample->GetNameHash();
+
+	CScopedMutex m(m_mutex);
+	ASSERT_MSG(m_samples.find(nameHash).atEnd(), "Audio sample '%s' is already registered\n", sample->GetFilename());
+
+	m_samples.insert(nameHash, sample);
+}
+
+void CEqAudioSystemSW::OnSampleDeleted(ISoundSource* sampleSource)
+{
+	if (!sampleSource)
+		return;
+
+	// stop voices using that sample
+	SuspendSourcesWithSample(sampleSource);
+
+	DevMsg(DEVMSG_SOUND, "freeing sample %s\n", sampleSource->GetFilename());
+
+	CScopedMutex m(m_mutex);
+	m_samples.remove(sampleSource->GetNameHash());
+}
+
+void CEqAudioSystemSW::SuspendSourcesWithSample(ISoundSource* sample)
+{
+	auto suspendSources = [sample](ArrayCRef<CRefPtr<CEqAudioSourceSW>> sources) {
+		for (int i = 0; i < sources.numElem(); i++)
+		{
+			CEqAudioSourceSW* src = sources[i].Ptr();
+
+			for (int j = 0; j < src->m_streams.numElem(); ++j)
+			{
+				if (src->m_streams[j].sample == sample)
+				{
+					src->Release();
+					break;
+				}
+			}
+		}
+	};
+
+	suspendSources(m_sources);
+
+	CScopedMutex m(m_mutex);
+	suspendSources(m_newSources);
+}
+
+//-----------------------------------------------
+
+void CEqAudioSystemSW::BeginUpdate()
+{
+	ASSERT(m_begunUpdate == false);
+	m_begunUpdate = true;
+}
+
+void CEqAudioSystemSW::EndUpdate()
+{
+	PROF_EVENT("AudioSystemSW EndUpdate");
+	ASSERT(m_begunUpdate);
+
+	AddNewSources();
+
+	for (int i = 0; i < m_sources.numElem(); i++)
+	{
+		CEqAudioSourceSW* src = m_sources[i].Ptr();
+
+		if (src->m_forceStop)
+		{
+			src->Release();
+			src->m_forceStop = false;
+		}
+
+		if (!src->DoUpdate())
+		{
+			if (src->m_releaseOnStop)
+			{
+				m_sources.fastRemoveIndex(i);
+				i--;
+			}
+		}
+	}
+
+	// there is no device clock, output is produced for the time passed since last update
+	m_pendingFrames = min(m_pendingFrames + m_timer.GetTime(true) * EQSND_SW_FREQUENCY, (double)SW_MAX_PENDING_FRAMES);
+
+	CEqTimer mixTimer;
+	while (m_pendingFrames >= EQSND_SW_BLOCK_SIZE)
+	{
+		MixFrames(m_outputBuffer.ptr(), EQSND_SW_BLOCK_SIZE);
+		m_pendingFrames -= EQSND_SW_BLOCK_SIZE;
+
+		if (m_waveFile)
+		{
+			const int blockSize = EQSND_SW_BLOCK_SIZE * 2 * sizeof(short);
+			m_waveFile->Write(m_outputBuffer.ptr(), 1, blockSize);
+			m_waveDataSize += blockSize;
+		}
+	}
+	m_mixTime = mixTimer.GetTime();
+
+	if (snd_sw_debug.GetBool())
+	{
+		uint playing = 0;
+		for (int i = 0; i < m_sources.numElem(); i++)
+			playing += (m_sources[i]->GetState() == IEqAudioSource::PLAYING);
+
+		debugoverlay->Text(color_white, "-----SOFTWARE MIXER-----");
+		debugoverlay->Text(color_white, "  sources: %d, (%d allocated)", playing, m_sources.numElem());
+		debugoverlay->Text(color_white, "  mix time: %.2f ms", m_mixTime * 1000.0);
+		debugoverlay->Text(color_white, "  recording: %s", m_waveFile ? m_waveFile->GetName() : "no");
+	}
+
+	m_begunUpdate = false;
+}
+
+//-----------------------------------------------
+
+void CEqAudioSystemSW::MixFrames(short* output, int numFrames)
+{
+	PROF_EVENT("AudioSystemSW Mix");
+
+	AddNewSources();
+
+	const int bufferSize = SimdAlignCount(numFrames);
+	m_mixLeft.setNum(bufferSize, false);
+	m_mixRight.setNum(bufferSize, false);
+	m_resampled.setNum(bufferSize, false);
+
+	memset(m_mixLeft.ptr(), 0, bufferSize * sizeof(float));
+	memset(m_mixRight.ptr(), 0, bufferSize * sizeof(float));
+
+	for (int i = 0; i < m_sources.numElem(); i++)
+	{
+		CEqAudioSourceSW* src = m_sources[i].Ptr();
+		if (src->m_state != IEqAudioSource::PLAYING || !src->m_streams.numElem())
+			continue;
+
+		MixSource(src, numFrames);
+	}
+
+	AudioMix_ToInt16Stereo(m_mixLeft.ptr(), m_mixRight.ptr(), numFrames, output);
+}
+
+// AL_INVERSE_DISTANCE_CLAMPED
+static float SW_DistanceGain(float distance, float referenceDistance, float rolloff)
+{
+	distance = max(distance, referenceDistance);
+
+	const float denom = referenceDistance + rolloff * (distance - referenceDistance);
+	return denom > F_EPS ? referenceDistance / denom : 1.0f;
+}
+
+static float SW_ConeGain(const IEqAudioSource::Params& params, const Vector3D& toListener)
+{
+	if (params.coneAngles.y >= 360.0f || lengthSqr(params.direction) <= F_EPS)
+		return 1.0f;
+
+	const float angle = RAD2DEG(acosf(clamp(dot(normalize(params.direction), toListener), -1.0f, 1.0f))) * 2.0f;
+
+	if (angle <= params.coneAngles.x)
+		return 1.0f;
+
+	if (angle >= params.coneAngles.y)
+		return params.volume.y;
+
+	const float t = (angle - params.coneAngles.x) / max(params.coneAngles.y - params.coneAngles.x, F_EPS);
+	return lerp(1.0f, params.volume.y, t);
+}
+
+void CEqAudioSystemSW::MixSource(CEqAudioSourceSW* source, int numFrames)
+{
+	const IEqAudioSource::Params& params = source->m_params;
+
+	MixerChannel_t mixChannel;
+	if (m_mixerChannels.inRange(source->m_channel))
+		mixChannel = m_mixerChannels[source->m_channel];
+
+	// stereo samples are not spatialized, same as in OpenAL
+	const float flatGain = clamp(params.volume.x * mixChannel.volume * m_masterVolume, 0.0f, 2.0f);
+
+	float gain = flatGain;
+	float pan = 0.0f;
+	bool spatial = false;
+
+	// relative sources at listener are 2D
+	if (!params.relative || lengthSqr(params.position) > F_EPS)
+	{
+		Vector3D relPos;
+		if (params.relative)
+		{
+			relPos = params.position;
+			pan = relPos.x;
+		}
+		else
+		{
+			const Vector3D listenerRight = cross(m_listener.orientU, m_listener.orientF);
+			relPos = params.position - m_listener.position;
+			pan = dot(relPos, listenerRight);
+		}
+
+		const float distance = length(relPos);
+		if (distance > F_EPS)
+		{
+			pan /= distance;
+			gain *= SW_ConeGain(params, -relPos / distance);
+		}
+		else
+			pan = 0.0f;
+
+		gain *= SW_DistanceGain(distance, params.referenceDistance, params.rolloff);
+		spatial = true;
+	}
+
+	// AL_MAX_GAIN
+	gain = clamp(gain, 0.0f, 2.0f);
+
+	// equal power panning
+	const float panGains[2] = {
+		spatial ? sqrtf(0.5f * (1.0f - pan)) : 1.0f,
+		spatial ? sqrtf(0.5f * (1.0f + pan)) : 1.0f,
+	};
+
+	const bool looping = params.looping;
+	const float pitch = clamp(params.pitch * mixChannel.pitch, 0.01f, EQSND_SW_MAX_PITCH);
+
+	// inaudible sources only update playback progress
+	const bool silent = gain <= F_EPS && source->m_gains[0] <= F_EPS && source->m_gains[1] <= F_EPS
+		&& flatGain <= F_EPS && source->m_flatGain <= F_EPS;
+
+	int numStopped = 0;
+	for (int i = 0; i < source->m_streams.numElem(); ++i)
+	{
+		CEqAudioSourceSW::SourceStream& stream = source->m_streams[i];
+		ISoundSource* sample = stream.sample;
+
+		if (!sample)
+		{
+			++numStopped;
+			continue;
+		}
+
+		const ISoundSource::Format& fmt = sample->GetFormat();
+		const float step = pitch * (float)fmt.frequency / (float)EQSND_SW_FREQUENCY;
+		const float streamVolume = min(stream.volume, 1.0f);
+
+		if (!silent && streamVolume > 0.0f)
+		{
+			const int sampleSize = (fmt.bitwidth >> 3) * fmt.channels;
+			const int numInFrames = (int)(stream.curFrac + (numFrames - 1) * step) + 2;
+			const int inputSize = SimdAlignCount(numInFrames);
+
+			m_readBuffer.setNum(numInFrames * sampleSize, false);
+			m_inputLeft.setNum(inputSize, false);
+			m_inputRight.setNum(inputSize, false);
+
+			const int numRead = sample->GetSamples(m_readBuffer.ptr(), numInFrames, stream.curPos, looping);
+			AudioMix_ToFloat(m_readBuffer.ptr(), fmt.bitwidth, fmt.channels, numRead, m_inputLeft.ptr(), m_inputRight.ptr());
+
+			// sample ended, the rest is silence
+			for (int j = numRead; j < numInFrames; ++j)
+			{
+				m_inputLeft[j] = 0.0f;
+				m_inputRight[j] = 0.0f;
+			}
+
+			// mono sources are panned, stereo ones are played as is
+			const bool stereo = (fmt.channels == 2);
+			const float leftGain = stereo ? flatGain * streamVolume : gain * streamVolume * panGains[0];
+			const float rightGain = stereo ? flatGain * streamVolume : gain * streamVolume * panGains[1];
+			const float prevLeftGain = (stereo ? source->m_flatGain : source->m_gains[0]) * streamVolume;
+			const float prevRightGain = (stereo ? source->m_flatGain : source->m_gains[1]) * streamVolume;
+
+			AudioMix_Resample(m_inputLeft.ptr(), stream.curFrac, step, m_resampled.ptr(), numFrames);
+			AudioMix_AddRamp(m_resampled.ptr(), prevLeftGain, leftGain, m_mixLeft.ptr(), numFrames);
+
+			if (stereo)
+				AudioMix_Resample(m_inputRight.ptr(), stream.curFrac, step, m_resampled.ptr(), numFrames);
+
+			AudioMix_AddRamp(m_resampled.ptr(), prevRightGain, rightGain, m_mixRight.ptr(), numFrames);
+		}
+
+		const float advance = stream.curFrac + numFrames * step;
+		const int advanceFrames = (int)advance;
+		stream.curFrac = advance - advanceFrames;
+
+		if (!looping && stream.curPos + advanceFrames >= sample->GetSampleCount())
+			++numStopped;
+
+		stream.curPos = WrapAroundSampleOffset(stream.curPos + advanceFrames, sample, looping);
+	}
+
+	// stream volumes are applied separately
+	source->m_gains[0] = gain * panGains[0];
+	source->m_gains[1] = gain * panGains[1];
+	source->m_flatGain = flatGain;
+
+	if (numStopped == source->m_streams.numElem())
+		source->m_state = IEqAudioSource::STOPPED;
+}
+
+//-----------------------------------------------
+
+void CEqAudioSystemSW::SetWaveOutput(const char* fileName)
+{
+	CloseWaveOutput();
+
+	if (!fileName || !*fileName)
+		return;
+
+	m_waveFile = g_fileSystem->Open(fileName, "wb");
+	if (!m_waveFile)
+	{
+		MsgError("Can't open '%s' for writing\n", fileName);
+		return;
+	}
+
+	// sizes are written when file is closed
+	RIFFhdr_t riffHdr;
+	riffHdr.Id = RIFF_ID;
+	riffHdr.Size = 0;
+	riffHdr.Type = WAVE_ID;
+	m_waveFile->Write(&riffHdr, 1, sizeof(riffHdr));
+
+	struct {
+		ushort	format;
+		ushort	channels;
+		uint	samplesPerSec;
+		uint	bytesPerSec;
+		ushort	blockAlign;
+		ushort	bitsPerSample;
+	} fmtHdr;
+
+	fmtHdr.format = ISoundSource::FORMAT_PCM;
+	fmtHdr.channels = 2;
+	fmtHdr.samplesPerSec = EQSND_SW_FREQUENCY;
+	fmtHdr.blockAlign = fmtHdr.channels * sizeof(short);
+	fmtHdr.bytesPerSec = EQSND_SW_FREQUENCY * fmtHdr.blockAlign;
+	fmtHdr.bitsPerSample = 16;
+
+	RIFFchunk_t chunk;
+	chunk.Id = MCHAR4('f', 'm', 't', ' ');
+	chunk.Size = sizeof(fmtHdr);
+	m_waveFile->Write(&chunk, 1, sizeof(chunk));
+	m_waveFile->Write(&fmtHdr, 1, sizeof(fmtHdr));
+
+	chunk.Id = MCHAR4('d', 'a', 't', 'a');
+	chunk.Size = 0;
+	m_waveFile->Write(&chunk, 1, sizeof(chunk));
+
+	m_waveDataSize = 0;
+
+	MsgInfo("Recording audio to '%s'\n", fileName);
+}
+
+void CEqAudioSystemSW::CloseWaveOutput()
+{
+	if (!m_waveFile)
+		return;
+
+	const int dataSizeOffset = m_waveFile->Tell() - m_waveDataSize - sizeof(int);
+	const int riffSize = m_waveFile->Tell() - sizeof(RIFFchunk_t);
+
+	m_waveFile->Seek(sizeof(int), VS_SEEK_SET);
+	m_waveFile->Write(&riffSize, 1, sizeof(int));
+
+	m_waveFile->Seek(dataSizeOffset, VS_SEEK_SET);
+	m_waveFile->Write(&m_waveDataSize, 1, sizeof(int));
+
+	MsgInfo("Audio recording finished, %.2f seconds\n", m_waveDataSize / (float)(EQSND_SW_FREQUENCY * 2 * sizeof(short)));
+
+	m_waveFile = nullptr;
+	m_waveDataSize = 0;
+}
+
+//----------------------------------------------------------------------------------------------
+// Sound source
+//----------------------------------------------------------------------------------------------
+
+CEqAudioSourceSW::CEqAudioSourceSW(CEqAudioSystemSW* owner)
+	: m_owner(owner)
+{
+}
+
+CEqAudioSourceSW::~CEqAudioSourceSW()
+{
+	Release();
+}
+
+void CEqAudioSourceSW::Setup(int chanId, const ISoundSource* sample, UpdateCallback fnCallback /*= nullptr*/)
+{
+	Release();
+
+	m_callback = fnCallback;
+	m_channel = chanId;
+	m_releaseOnStop = !m_callback;
+	m_params = Params();
+
+	ASSERT_MSG(sample, "SetupSample - No samples");
+
+	SourceStream& stream = m_streams.append();
+	stream.sample = const_cast<ISoundSource*>(sample);
+}
+
+void CEqAudioSourceSW::Setup(int chanId, ArrayCRef<const ISoundSource*> samples, UpdateCallback fnCallback /*= nullptr*/)
+{
+	Release();
+
+	m_callback = fnCallback;
+	m_channel = chanId;
+	m_releaseOnStop = !m_callback;
+	m_params = Params();
+
+	ASSERT_MSG(samples.numElem() > 0, "SetupSample - No samples");
+	ASSERT_MSG(samples.numElem() < EQSND_SW_SAMPLE_COUNT, "SetupSamples - exceeding EQSND_SW_SAMPLE_COUNT (%d), required %d", EQSND_SW_SAMPLE_COUNT, samples.numElem());
+
+	for (int i = 0; i < samples.numElem(); ++i)
+	{
+		SourceStream& stream = m_streams.append();
+		stream.sample = const_cast<ISoundSource*>(samples[i]);
+	}
+}
+
+void CEqAudioSourceSW::Release()
+{
+	m_callback = nullptr;
+	m_channel = -1;
+	m_state = STOPPED;
+	m_gains[0] = 0.0f;
+	m_gains[1] = 0.0f;
+	m_flatGain = 0.0f;
+
+	m_streams.clear();
+}
+
+void CEqAudioSourceSW::GetParams(Params& params) const
+{
+	params = m_params;
+	params.updateFlags = 0;
+	params.state = m_state;
+	params.channel = m_channel;
+	params.releaseOnStop = m_releaseOnStop;
+}
+
+void CEqAudioSourceSW::UpdateParams(const Params& params, int overrideUpdateFlags)
+{
+	int mask = overrideUpdateFlags == -1 ? params.updateFlags : overrideUpdateFlags;
+
+	if (mask & UPDATE_CHANNEL)
+	{
+		m_channel = params.channel;
+		mask &= ~UPDATE_CHANNEL;
+	}
+
+	// is that source needs setup again?
+	if (mask == 0 || !m_streams.numElem())
+		return;
+
+	m_params.merge(params, mask);
+	m_params.updateFlags = 0;
+
+	if (mask & UPDATE_DO_REWIND)
+	{
+		for (int i = 0; i < m_streams.numElem(); ++i)
+		{
+			m_streams[i].curPos = 0;
+			m_streams[i].curFrac = 0.0f;
+		}
+	}
+
+	if (mask & UPDATE_RELEASE_ON_STOP)
+		m_releaseOnStop = params.releaseOnStop;
+
+	if (mask & UPDATE_STATE)
+		m_state = params.state;
+}
+
+void CEqAudioSourceSW::SetSamplePlaybackPosition(int sourceIdx, float seconds)
+{
+	const bool looping = m_params.looping;
+	for (int i = 0; i < m_streams.numElem(); ++i)
+	{
+		if (sourceIdx != -1 && sourceIdx != i)
+			continue;
+
+		SourceStream& stream = m_streams[i];
+		const ISoundSource::Format& fmt = stream.sample->GetFormat();
+		stream.curPos = WrapAroundSampleOffset(seconds * fmt.frequency, stream.sample, looping);
+		stream.curFrac = 0.0f;
+	}
+}
+
+float CEqAudioSourceSW::GetSamplePlaybackPosition(int sourceIdx)
+{
+	if (!m_streams.inRange(sourceIdx))
+		return 0.0f;
+
+	const SourceStream& stream = m_streams[sourceIdx];
+	return (stream.curPos + stream.curFrac) / (float)stream.sample->GetFormat().frequency;
+}
+
+void CEqAudioSourceSW::SetSampleVolume(int sourceIdx, float volume)
+{
+	if (sourceIdx == -1)
+	{
+		for (int i = 0; i < m_streams.numElem(); ++i)
+			m_streams[i].volume = volume;
+
+		return;
+	}
+
+	if (m_streams.inRange(sourceIdx))
+		m_streams[sourceIdx].volume = volume;
+}
+
+float CEqAudioSourceSW::GetSampleVolume(int sourceIdx)
+{
+	if (m_streams.inRange(sourceIdx))
+		return m_streams[sourceIdx].volume;
+	return 0.0f;
+}
+
+int	CEqAudioSourceSW::GetSampleCount() const
+{
+	return m_streams.numElem();
+}
+
+// updates user parameters, returns false if source can be removed
+bool CEqAudioSourceSW::DoUpdate()
+{
+	if (m_callback)
+	{
+		Params params;
+		GetParams(params);
+
+		m_callback(this, params);
+
+		UpdateParams(params);
+	}
+
+	if (!m_streams.numElem())
+		return (m_releaseOnStop == false);
+
+	// release channel if stopped
+	if (m_releaseOnStop && m_state == STOPPED)
+		Release();
+
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------
+// Mixer benchmarks
+//----------------------------------------------------------------------------------------------
+
+// looped sine tone generated in memory
+class CSoundSource_BenchTone : public ISoundSource
+{
+public:
+	CSoundSource_BenchTone(const char* name, int frequency, int channels, int bitwidth, float toneHz)
+	{
+		SetFilename(name);
+
+		m_format.dataFormat = FORMAT_PCM;
+		m_format.frequency = frequency;
+		m_format.channels = channels;
+		m_format.bitwidth = bitwidth;
+
+		const int sampleSize = channels * (bitwidth >> 3);
+		m_numSamples = frequency;
+		m_data.setNum(m_numSamples * sampleSize);
+
+		for (int i = 0; i < m_numSamples; ++i)
+		{
+			const float value = sinf(i * toneHz * 2.0f * M_PI_F / frequency) * 0.5f;
+			for (int ch = 0; ch < channels; ++ch)
+			{
+				if (bitwidth == 16)
+					((short*)m_data.ptr())[i * channels + ch] = (short)(value * SHRT_MAX);
+				else
+					m_data[i * channels + ch] = (ubyte)(128 + value * 127);
+			}
+		}
+	}
+
+	int GetSamples(void* out, int samplesToRead, int startOffset, bool loop) const
+	{
+		const int sampleSize = m_format.channels * (m_format.bitwidth >> 3);
+
+		int numSamplesRead = 0;
+		int currentOffset = startOffset;
+		while (numSamplesRead < samplesToRead)
+		{
+			const int numToRead = min(samplesToRead - numSamplesRead, m_numSamples - currentOffset);
+			memcpy((ubyte*)out + numSamplesRead * sampleSize, m_data.ptr() + currentOffset * sampleSize, numToRead * sampleSize);
+			numSamplesRead += numToRead;
+
+			if (!loop)
+				break;
+			currentOffset = 0;
+		}
+
+		return numSamplesRead;
+	}
+
+	void*			GetDataPtr(int& dataSize) const	{ dataSize = m_data.numElem(); return (void*)m_data.ptr(); }
+	const Format&	GetFormat() const				{ return m_format; }
+	int				GetSampleCount() const			{ return m_numSamples; }
+	int				GetLoopRegions(int* samplePos) const { return 0; }
+	bool			IsStreaming() const				{ return false; }
+
+private:
+	bool			Load() { return true; }
+	void			Unload() {}
+
+	Array<ubyte>	m_data{ PP_SL };
+	Format			m_format;
+	int				m_numSamples{ 0 };
+};
+
+#define BENCH_TONE_COUNT	4
+
+// different formats so conversion and resampling paths are used
+static void CreateBenchTones(ISoundSourcePtr tones[BENCH_TONE_COUNT])
+{
+	tones[0] = ISoundSourcePtr(CRefPtr_new(CSoundSource_BenchTone, "_bench_22k_mono16", 22050, 1, 16, 220.0f));
+	tones[1] = ISoundSourcePtr(CRefPtr_new(CSoundSource_BenchTone, "_bench_44k_mono16", 44100, 1, 16, 440.0f));
+	tones[2] = ISoundSourcePtr(CRefPtr_new(CSoundSource_BenchTone, "_bench_32k_stereo16", 32000, 2, 16, 330.0f));
+	tones[3] = ISoundSourcePtr(CRefPtr_new(CSoundSource_BenchTone, "_bench_11k_mono8", 11025, 1, 8, 110.0f));
+}
+
+DECLARE_CMD(snd_sw_bench, "Software mixer benchmark. Arguments: [number of sources] [number of 10ms blocks]", 0)
+{
+	const int numSources = CMD_ARGC > 0 ? max(1, atoi(CMD_ARGV(0).ToCString())) : 512;
+	const int numBlocks = CMD_ARGC > 1 ? max(1, atoi(CMD_ARGV(1).ToCString())) : 500;
+
+	CEqAudioSystemSW mixer;
+	mixer.Init();
+	mixer.SetListener(vec3_zero, vec3_zero, vec3_forward, vec3_up);
+
+	ISoundSourcePtr tones[BENCH_TONE_COUNT];
+	CreateBenchTones(tones);
+
+	for (int i = 0; i < numSources; ++i)
+	{
+		CRefPtr<IEqAudioSource> source = mixer.CreateSource();
+		source->Setup(0, tones[i % BENCH_TONE_COUNT].Ptr(), nullptr);
+
+		IEqAudioSource::Params params;
+		params.set_position(Vector3D(RandomFloat(-50.0f, 50.0f), RandomFloat(-5.0f, 5.0f), RandomFloat(-50.0f, 50.0f)));
+		params.set_relative(false);
+		params.set_looping(true);
+		params.set_pitch(RandomFloat(0.8f, 1.2f));
+		params.set_referenceDistance(5.0f);
+		params.set_state(IEqAudioSource::PLAYING);
+		source->UpdateParams(params);
+	}
+
+	short output[EQSND_SW_BLOCK_SIZE * 2];
+
+	// warm up buffers
+	mixer.MixFrames(output, EQSND_SW_BLOCK_SIZE);
+
+	CEqTimer timer;
+	double totalTime = 0.0;
+	double worstTime = 0.0;
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		timer.GetTime(true);
+		mixer.MixFrames(output, EQSND_SW_BLOCK_SIZE);
+
+		const double blockTime = timer.GetTime();
+		totalTime += blockTime;
+		worstTime = max(worstTime, blockTime);
+	}
+
+	const double avgTime = totalTime / numBlocks;
+	MsgInfo("snd_sw_bench: %d sources, %d blocks: %.3f ms per 10 ms block (worst %.3f ms), %.1f%% of real time\n",
+		numSources, numBlocks, avgTime * 1000.0, worstTime * 1000.0, avgTime * 100.0 / 0.01);
+
+	mixer.Shutdown();
+}
+
+DECLARE_CMD(snd_mix_bench, "Multi-sample source mixer benchmark. Arguments: [number of voices] [number of 10ms blocks]", 0)
+{
+	const int numVoices = CMD_ARGC > 0 ? max(1, atoi(CMD_ARGV(0).ToCString())) : 512;
+	const int numBlocks = CMD_ARGC > 1 ? max(1, atoi(CMD_ARGV(1).ToCString())) : 500;
+
+	ISoundSourcePtr tones[BENCH_TONE_COUNT];
+	CreateBenchTones(tones);
+
+	Array<AudioMixStream> streams(PP_SL);
+	streams.setNum(numVoices);
+	for (int i = 0; i < numVoices; ++i)
+	{
+		streams[i].sample = tones[i % BENCH_TONE_COUNT].Ptr();
+		streams[i].volume = RandomFloat(0.1f, 1.0f);
+	}
+
+	AudioMixBuffers* buffers = PPNew AudioMixBuffers;
+	short output[EQSND_SW_BLOCK_SIZE * 2];
+
+	CEqTimer timer;
+	double totalTime = 0.0;
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		timer.GetTime(true);
+
+		// same grouping as in multi-sample sources
+		for (int j = 0; j < numVoices; j += EQSND_SW_SAMPLE_COUNT)
+		{
+			ArrayRef<AudioMixStream> voices(&streams[j], min(EQSND_SW_SAMPLE_COUNT, numVoices - j));
+			AudioMix_MixStreams(voices, *buffers, EQSND_SW_FREQUENCY, 2, 1.0f, true, output, EQSND_SW_BLOCK_SIZE);
+		}
+
+		totalTime += timer.GetTime();
+	}
+
+	delete buffers;
+
+	const double avgTime = totalTime / numBlocks;
+	MsgInfo("snd_mix_bench: %d voices, %d blocks: %.3f ms per 10 ms block, %.1f voices per ms\n",
+		numVoices, numBlocks, avgTime * 1000.0, numVoices / (avgTime * 1000.0));
+}
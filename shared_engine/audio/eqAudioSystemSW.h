@@ -0,0 +1,172 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Equilibrium Engine software mixer audio system.
+//				Doesn't need audio device, output goes to null sink or WAV file
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "audio/IEqAudioSystem.h"
+#include "core/IFileSystem.h"
+#include "eqAudioMixer.h"
+
+//-----------------------------------------------------------------
+
+#define EQSND_SW_FREQUENCY				44100
+#define EQSND_SW_BLOCK_SIZE				(EQSND_SW_FREQUENCY / 100)	// 10 ms of frames
+#define EQSND_SW_MIXER_CHANNELS			16
+#define EQSND_SW_SAMPLE_COUNT			8
+#define EQSND_SW_MAX_PITCH				8.0f
+
+//-----------------------------------------------------------------
+
+class CEqAudioSourceSW;
+
+// Audio system, mixes voices on CPU
+class CEqAudioSystemSW : public IEqAudioSystem
+{
+	friend class CEqAudioSourceSW;
+public:
+	CEqAudioSystemSW();
+	~CEqAudioSystemSW();
+
+	void						Init();
+	void						Shutdown();
+
+	CRefPtr<IEqAudioSource>		CreateSource();
+	void						DestroySource(IEqAudioSource* source);
+
+	void						BeginUpdate();
+	void						EndUpdate();
+
+	void						StopAllSounds(int chanId = -1);
+	void						PauseAllSounds(int chanId = -1);
+	void						ResumeAllSounds(int chanId = -1);
+
+	void						ResetMixer(int chanId);
+	void						SetChannelVolume(int chanId, float value);
+	void						SetChannelPitch(int chanId, float value);
+
+	void						SetMasterVolume(float value);
+
+	// sets listener properties
+	void						SetListener(const Vector3D& position,
+											const Vector3D& velocity,
+											const Vector3D& forwardVec,
+											const Vector3D& upVec);
+
+	const Vector3D&				GetListenerPosition() const;
+
+	// loads sample source data
+	ISoundSourcePtr				GetSample(const char* filename);
+	void						AddSample(ISoundSource* sample);
+	void						OnSampleDeleted(ISoundSource* sample);
+
+	// effects are not supported by software mixer
+	audioEffectId_t				FindEffect(const char* name) const { return EFFECT_ID_NONE; }
+	void						SetEffect(int slot, audioEffectId_t effect) {}
+	int							GetEffectSlotCount() const { return 0; }
+
+	// mixes playing sources into 16 bit stereo frames at EQSND_SW_FREQUENCY
+	void						MixFrames(short* output, int numFrames);
+
+	// starts writing mixed output to WAV file, nullptr stops it
+	void						SetWaveOutput(const char* fileName);
+
+private:
+	struct MixerChannel_t
+	{
+		float		volume{ 1.0f };
+		float		pitch{ 1.0f };
+	};
+
+	void			MixSource(CEqAudioSourceSW* source, int numFrames);
+	void			AddNewSources();
+	void			SuspendSourcesWithSample(ISoundSource* sample);
+	void			CloseWaveOutput();
+
+	FixedArray<MixerChannel_t, EQSND_SW_MIXER_CHANNELS>	m_mixerChannels;
+
+	Array<CRefPtr<CEqAudioSourceSW>>	m_sources{ PP_SL };		// tracked sources, owned by update
+	Array<CRefPtr<CEqAudioSourceSW>>	m_newSources{ PP_SL };	// created since last update, guarded by m_mutex
+	Map<int, ISoundSource*>				m_samples{ PP_SL };
+
+	// planar buffers, sized for SIMD
+	Array<float>						m_mixLeft{ PP_SL };
+	Array<float>						m_mixRight{ PP_SL };
+	Array<float>						m_inputLeft{ PP_SL };
+	Array<float>						m_inputRight{ PP_SL };
+	Array<float>						m_resampled{ PP_SL };
+	Array<ubyte>						m_readBuffer{ PP_SL };
+	Array<short>						m_outputBuffer{ PP_SL };
+
+	struct Listener
+	{
+		Vector3D position{ vec3_zero };
+		Vector3D velocity{ vec3_zero };
+		Vector3D orientF{ vec3_forward };
+		Vector3D orientU{ vec3_up };
+	} m_listener;
+
+	Threading::CEqMutex					m_mutex;
+	CEqTimer							m_timer;
+	IFilePtr							m_waveFile;
+	int									m_waveDataSize{ 0 };
+	double								m_pendingFrames{ 0.0 };		// time passed since last mix in frames
+	double								m_mixTime{ 0.0 };			// time spent on last update mix
+	float								m_masterVolume{ 1.0f };
+	bool								m_begunUpdate{ false };
+};
+
+//-----------------------------------------------------------------
+// Sound source
+
+class CEqAudioSourceSW : public IEqAudioSource
+{
+	friend class CEqAudioSystemSW;
+public:
+	CEqAudioSourceSW(CEqAudioSystemSW* owner);
+	~CEqAudioSourceSW();
+
+	void					Setup(int chanId, const ISoundSource* sample, UpdateCallback fnCallback = nullptr);
+	void					Setup(int chanId, ArrayCRef<const ISoundSource*> samples, UpdateCallback fnCallback = nullptr);
+	void					Release();
+
+	// full scale
+	void					GetParams(Params& params) const;
+	void					UpdateParams(const Params& params, int overrideUpdateFlags = -1);
+
+	void					SetSamplePlaybackPosition(int sourceIdx, float seconds);
+	float					GetSamplePlaybackPosition(int sourceIdx);
+	void					SetSampleVolume(int sourceIdx, float volume);
+	float					GetSampleVolume(int sourceIdx);
+	int						GetSampleCount() const;
+
+	// atomic
+	State					GetState() const { return m_state; }
+	bool					IsLooping() const { return m_params.looping; }
+
+protected:
+	using SourceStream = AudioMixStream;
+
+	bool					DoUpdate();
+
+	CEqAudioSystemSW*		m_owner{ nullptr };
+
+	FixedArray<SourceStream, EQSND_SW_SAMPLE_COUNT> m_streams;
+
+	UpdateCallback			m_callback;
+	Params					m_params;
+
+	State					m_state{ State::STOPPED };
+
+	float					m_gains[2]{ 0.0f, 0.0f };	// left and right gains of last mix, ramped to avoid clicks
+	float					m_flatGain{ 0.0f };			// gain of last mix for stereo samples which are not spatialized
+
+	int						m_channel{ -1 };			// mixer channel index
+	bool					m_releaseOnStop{ true };
+	bool					m_forceStop{ false };
+};
+
+extern CEqAudioSystemSW* g_audioSystemSW;
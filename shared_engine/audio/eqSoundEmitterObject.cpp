@@ -4,6 +4,7 @@
 #include "eqSoundEmitterObject.h"
 #include "eqSoundEmitterPrivateTypes.h"
 #include "eqSoundEmitterSystem.h"
+#include "eqSoundVoiceManager.h"
 
 using namespace Threading;
 
@@ -52,17 +53,19 @@ int CSoundingObject::EmitSound(int uniqueId, EmitParams* ep)
 	return g_sounds->EmitSoundInternal(ep, uniqueId & StringHashMask, this);
 }
 
-bool CSoundingObject::UpdateEmitters(const Vector3D& listenerPos)
+bool CSoundingObject::UpdateEmitters(CSoundVoiceManager& voices)
 {
+	// emitters that didn't change are handled by voice manager
+	if (!Atomic::Exchange(m_emittersChanged, 0))
+		return true;
+
 	CScopedMutex m(m_mutex);
 
-	// update emitters manually if they are in virtual state
 	for (auto it = m_emitters.begin(); !it.atEnd(); ++it)
 	{
 		bool needDelete = false;
 		SoundEmitterData* emitter = *it;
-		IEqAudioSource::Params& virtualParams = emitter->virtualParams;
-		const SoundScriptDesc* script = emitter->script;
+		const IEqAudioSource::Params& virtualParams = emitter->virtualParams;
 
 		if (emitter->soundSource != nullptr)
 		{
@@ -70,33 +73,25 @@ bool CSoundingObject::UpdateEmitters(const Vector3D& listenerPos)
 		}
 		else
 		{
-			bool isAudible = true;
-			if (!virtualParams.relative)
-			{
-				const float distToSound = lengthSqr(virtualParams.position - listenerPos);
-				const float maxDistSqr = M_SQR(script->maxDistance);
-				isAudible = distToSound < maxDistSqr;
-			}
-
-			if (!isAudible && virtualParams.releaseOnStop)
-			{
-				needDelete = true;
-			}
-			else
-			{
-				// switch emitter between virtual and real here
-				if (g_sounds->SwitchSourceState(emitter, !isAudible))
-					needDelete = emitter->soundSource == nullptr;
-			}
+			// virtual sound that lost it's voice or finished playing
+			needDelete = virtualParams.releaseOnStop && (emitter->voiceDropped || virtualParams.state == IEqAudioSource::STOPPED);
 		}
 
 		if(needDelete)
 		{
+			voices.RemoveEmitter(emitter);
 			StopEmitter(emitter, true);
 			m_emitters.remove(it);
 		}
+		else
+		{
+			voices.UpdateEmitter(emitter);
+		}
 	}
 
+	for (SoundEmitterData* del = m_deleteList; del; del = del->delNext)
+		voices.RemoveEmitter(del);
+
 	FlushOldEmitters();
 
 	return m_emitters.size() > 0;
@@ -140,19 +135,9 @@ int	CSoundingObject::GetEmitterSampleId(int uniqueId) const
 
 void CSoundingObject::SetEmitterSampleId(int uniqueId, int sampleId)
 {
-	SoundEmitterData* emitter = FindEmitter(uniqueId);
-
-	if (emitter && emitter->sampleId != sampleId)
-	{
-		emitter->sampleId = sampleId;
-
-		if (emitter->virtualParams.state == IEqAudioSource::PLAYING)
-		{
-			// this will restart emitter safely
-			g_sounds->SwitchSourceState(emitter, true);
-			g_sounds->SwitchSourceState(emitter, false);
-		}
-	}
+	SoundCommand cmd(SOUND_CMD_SET_SAMPLE_ID, this, uniqueId);
+	cmd.intValue = sampleId;
+	g_sounds->PushCommand(cmd);
 }
 
 const IEqAudioSource::State CSoundingObject::GetEmitterState(int uniqueId) const
@@ -166,215 +151,106 @@ const IEqAudioSource::State CSoundingObject::GetEmitterState(int uniqueId) const
 
 void CSoundingObject::SetEmitterState(int uniqueId, IEqAudioSource::State state, bool rewindOnPlay)
 {
-	if (uniqueId != ID_ALL)
-	{
-		SetEmitterState(FindEmitter(uniqueId), state, rewindOnPlay);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetEmitterState(emitter, state, rewindOnPlay);
-	}
+	SoundCommand cmd(SOUND_CMD_SET_STATE, this, uniqueId);
+	cmd.intValue = state;
+	cmd.flag = rewindOnPlay;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::StopEmitter(int uniqueId, bool destroy /*= false*/)
 {
-	if (uniqueId != ID_ALL)
-	{
-		CScopedMutex m(m_mutex);
-		const auto it = m_emitters.find(uniqueId);
-		if (it.atEnd())
-			return;
-
-		SoundEmitterData* emitter = *it;
-
-		if (destroy)
-			m_emitters.remove(it);
-
-		StopEmitter(emitter, destroy);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			StopEmitter(emitter, destroy);
-	}
-
-	if (destroy)
-	{
-		CScopedMutex m(m_mutex);
-		m_emitters.clear();
-	}
+	SoundCommand cmd(SOUND_CMD_STOP, this, uniqueId);
+	cmd.flag = destroy;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::PauseEmitter(int uniqueId)
 {
-	if (uniqueId != ID_ALL)
-	{
-		PauseEmitter(FindEmitter(uniqueId));
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			PauseEmitter(emitter);
-	}
+	SoundCommand cmd(SOUND_CMD_PAUSE, this, uniqueId);
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::PlayEmitter(int uniqueId, bool rewind /*= false*/)
 {
-	if (uniqueId != ID_ALL)
-	{
-		PlayEmitter(FindEmitter(uniqueId), rewind);
-		return;
-	}
+	SoundCommand cmd(SOUND_CMD_PLAY, this, uniqueId);
+	cmd.flag = rewind;
+	g_sounds->PushCommand(cmd);
+}
 
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			PlayEmitter(emitter, rewind);
-	}
+void CSoundingObject::StartLoop(int uniqueId, float fadeInTime)
+{
+	SoundCommand cmd(SOUND_CMD_START_LOOP, this, uniqueId);
+	cmd.values[0] = fadeInTime;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::StopLoop(int uniqueId, float fadeOutTime) 
 {
-	if (uniqueId != ID_ALL)
-	{
-		StopLoop(FindEmitter(uniqueId), fadeOutTime);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			StopLoop(emitter, fadeOutTime);
-	}
+	SoundCommand cmd(SOUND_CMD_STOP_LOOP, this, uniqueId);
+	cmd.values[0] = fadeOutTime;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetPosition(int uniqueId, const Vector3D& position)
 {
-	if (uniqueId != ID_ALL)
-	{
-		SetPosition(FindEmitter(uniqueId), position);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetPosition(emitter, position);
-	}
+	SoundCommand cmd(SOUND_CMD_SET_POSITION, this, uniqueId);
+	*(Vector3D*)cmd.values = position;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetVelocity(int uniqueId, const Vector3D& velocity)
 {
-	if (uniqueId != ID_ALL)
-	{
-		SetVelocity(FindEmitter(uniqueId), velocity);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetVelocity(emitter, velocity);
-	}
+	SoundCommand cmd(SOUND_CMD_SET_VELOCITY, this, uniqueId);
+	*(Vector3D*)cmd.values = velocity;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetConeProperties(int uniqueId, const Vector3D& direction, float innerRadus, float outerRadius, float outerVolume, float outerVolumeHf)
 {
-	if (uniqueId != ID_ALL)
-	{
-		SetConeProperties(FindEmitter(uniqueId), direction, innerRadus, outerRadius, outerVolume, outerVolumeHf);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetConeProperties(emitter, direction, innerRadus, outerRadius, outerVolume, outerVolumeHf);
-	}
+	SoundCommand cmd(SOUND_CMD_SET_CONE, this, uniqueId);
+	*(Vector3D*)cmd.values = direction;
+	cmd.values[3] = innerRadus;
+	cmd.values[4] = outerRadius;
+	cmd.values[5] = outerVolume;
+	cmd.values[6] = outerVolumeHf;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetPitch(int uniqueId, float pitch)
 {
-	if (uniqueId != ID_ALL)
-	{
-		CScopedMutex m(m_mutex);
-		const auto it = m_emitters.find(uniqueId);
-		if (it.atEnd())
-			return;
-
-		SetPitch(*it, pitch);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetPitch(emitter, pitch);
-	}
+	SoundCommand cmd(SOUND_CMD_SET_PITCH, this, uniqueId);
+	cmd.values[0] = pitch;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetVolume(int uniqueId, float volume)
 {
-	if (uniqueId != ID_ALL)
-	{
-		SetVolume(FindEmitter(uniqueId), volume);
-		return;
-	}
-
-	for (auto emitter : m_emitters)
-		SetVolume(emitter, volume);
+	SoundCommand cmd(SOUND_CMD_SET_VOLUME, this, uniqueId);
+	cmd.values[0] = volume;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetSampleVolume(int uniqueId, int waveId, float volume)
 {
-	if (uniqueId != ID_ALL)
-	{
-		SetSampleVolume(FindEmitter(uniqueId), waveId, volume);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetSampleVolume(emitter, waveId, volume);
-	}
+	SoundCommand cmd(SOUND_CMD_SET_SAMPLE_VOLUME, this, uniqueId);
+	cmd.intValue = waveId;
+	cmd.values[0] = volume;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetSamplePlaybackPosition(int uniqueId, int waveId, float seconds)
 {
-	if (uniqueId != ID_ALL)
-	{
-		SetSamplePlaybackPosition(FindEmitter(uniqueId), waveId, seconds);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetSamplePlaybackPosition(emitter, waveId, seconds);
-	}
+	SoundCommand cmd(SOUND_CMD_SET_SAMPLE_POSITION, this, uniqueId);
+	cmd.intValue = waveId;
+	cmd.values[0] = seconds;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetParams(int uniqueId, const IEqAudioSource::Params& params)
 {
-	if (uniqueId != ID_ALL)
-	{
-		SetParams(FindEmitter(uniqueId), params);
-		return;
-	}
-
-	{
-		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetParams(emitter, params);
-	}
+	SoundCommand cmd(SOUND_CMD_SET_PARAMS, this, uniqueId);
+	cmd.params = params;
+	g_sounds->PushCommand(cmd);
 }
 
 void CSoundingObject::SetInputValue(int uniqueId, const char* name, float value)
@@ -385,17 +261,122 @@ void CSoundingObject::SetInputValue(int uniqueId, const char* name, float value)
 
 void CSoundingObject::SetInputValue(int uniqueId, int inputNameHash, float value)
 {
-	if (uniqueId != ID_ALL)
+	SoundCommand cmd(SOUND_CMD_SET_INPUT, this, uniqueId);
+	cmd.intValue = inputNameHash;
+	cmd.values[0] = value;
+	g_sounds->PushCommand(cmd);
+}
+
+// executed by sound emitter system update
+void CSoundingObject::ExecuteCommand(const SoundCommand& cmd)
+{
+	if (cmd.type == SOUND_CMD_STOP)
 	{
-		SetInputValue(FindEmitter(uniqueId), inputNameHash, value);
+		StopEmitterById(cmd.uniqueId, cmd.flag);
 		return;
 	}
 
+	// emitters are never modified outside update so no lock is needed
+	if (cmd.uniqueId != ID_ALL)
+	{
+		const auto it = m_emitters.find(cmd.uniqueId);
+		if (!it.atEnd())
+			ExecuteCommand(*it, cmd);
+		return;
+	}
+
+	for (auto emitter : m_emitters)
+		ExecuteCommand(emitter, cmd);
+}
+
+void CSoundingObject::ExecuteCommand(SoundEmitterData* emitter, const SoundCommand& cmd)
+{
+	switch (cmd.type)
+	{
+		case SOUND_CMD_SET_STATE:
+			SetEmitterState(emitter, (IEqAudioSource::State)cmd.intValue, cmd.flag);
+			break;
+		case SOUND_CMD_PLAY:
+			PlayEmitter(emitter, cmd.flag);
+			break;
+		case SOUND_CMD_PAUSE:
+			PauseEmitter(emitter);
+			break;
+		case SOUND_CMD_START_LOOP:
+			StartLoop(emitter, cmd.values[0]);
+			break;
+		case SOUND_CMD_STOP_LOOP:
+			StopLoop(emitter, cmd.values[0]);
+			break;
+		case SOUND_CMD_SET_SAMPLE_ID:
+		{
+			if (emitter->sampleId == cmd.intValue)
+				break;
+
+			emitter->sampleId = cmd.intValue;
+
+			if (emitter->virtualParams.state == IEqAudioSource::PLAYING)
+			{
+				// this will restart emitter safely
+				g_sounds->SwitchSourceState(emitter, true);
+				g_sounds->SwitchSourceState(emitter, false);
+			}
+			break;
+		}
+		case SOUND_CMD_SET_POSITION:
+			SetPosition(emitter, *(const Vector3D*)cmd.values);
+			break;
+		case SOUND_CMD_SET_VELOCITY:
+			SetVelocity(emitter, *(const Vector3D*)cmd.values);
+			break;
+		case SOUND_CMD_SET_CONE:
+			SetConeProperties(emitter, *(const Vector3D*)cmd.values, cmd.values[3], cmd.values[4], cmd.values[5], cmd.values[6]);
+			break;
+		case SOUND_CMD_SET_PITCH:
+			SetPitch(emitter, cmd.values[0]);
+			break;
+		case SOUND_CMD_SET_VOLUME:
+			SetVolume(emitter, cmd.values[0]);
+			break;
+		case SOUND_CMD_SET_SAMPLE_POSITION:
+			SetSamplePlaybackPosition(emitter, cmd.intValue, cmd.values[0]);
+			break;
+		case SOUND_CMD_SET_SAMPLE_VOLUME:
+			SetSampleVolume(emitter, cmd.intValue, cmd.values[0]);
+			break;
+		case SOUND_CMD_SET_PARAMS:
+			SetParams(emitter, cmd.params);
+			break;
+		case SOUND_CMD_SET_INPUT:
+			SetInputValue(emitter, cmd.intValue, cmd.values[0]);
+			break;
+	}
+}
+
+void CSoundingObject::StopEmitterById(int uniqueId, bool destroy)
+{
+	if (uniqueId != ID_ALL)
 	{
 		CScopedMutex m(m_mutex);
-		for (auto emitter : m_emitters)
-			SetInputValue(emitter, inputNameHash, value);
+		const auto it = m_emitters.find(uniqueId);
+		if (it.atEnd())
+			return;
+
+		SoundEmitterData* emitter = *it;
+
+		if (destroy)
+			m_emitters.remove(it);
+
+		StopEmitter(emitter, destroy);
+		return;
 	}
+
+	CScopedMutex m(m_mutex);
+	for (auto emitter : m_emitters)
+		StopEmitter(emitter, destroy);
+
+	if (destroy)
+		m_emitters.clear();
 }
 
 SoundEmitterData* CSoundingObject::FindEmitter(int uniqueId) const
@@ -418,6 +399,7 @@ void CSoundingObject::AddEmitter(int uniqueId, SoundEmitterData* emitter)
 		StopEmitter(*itOld, true);
 
 	m_emitters.insert(uniqueId, emitter);
+	MarkEmittersChanged();
 }
 
 void CSoundingObject::SetEmitterState(SoundEmitterData* emitter, IEqAudioSource::State state, bool rewindOnPlay)
@@ -445,6 +427,7 @@ void CSoundingObject::SetEmitterState(SoundEmitterData* emitter, IEqAudioSource:
 
 	// update virtual params
 	emitter->virtualParams |= param;
+	MarkEmittersChanged();
 
 	if (emitter->soundSource)
 		emitter->soundSource->UpdateParams(param);
@@ -462,12 +445,12 @@ void CSoundingObject::StopEmitter(SoundEmitterData* emitter, bool destroy)
 
 		g_audioSystem->DestroySource(emitter->soundSource);
 
-		{
-			CScopedMutex m(m_mutex);
+		// prevents voice manager from restarting it
+		emitter->virtualParams.set_state(IEqAudioSource::STOPPED);
 
-			emitter->delNext = m_deleteList;
-			m_deleteList = emitter;
-		}
+		emitter->delNext = m_deleteList;
+		m_deleteList = emitter;
+		MarkEmittersChanged();
 		return;
 	}
 
@@ -508,6 +491,7 @@ void CSoundingObject::PlayEmitter(SoundEmitterData* emitter, bool rewind)
 
 	// update virtual params
 	emitter->virtualParams |= param;
+	MarkEmittersChanged();
 
 	// update actual params
 	if (emitter->soundSource)
@@ -581,6 +565,7 @@ void CSoundingObject::SetPosition(SoundEmitterData* emitter, const Vector3D& pos
 		return;
 	emitter->virtualParams.set_position(position);
 	emitter->nodeParams.set_position(position);
+	MarkEmittersChanged();
 }
 
 void CSoundingObject::SetVelocity(SoundEmitterData* emitter, const Vector3D& velocity)
@@ -666,6 +651,7 @@ void CSoundingObject::SetParams(SoundEmitterData* emitter, const IEqAudioSource:
 
 	const int excludeFlags = (IEqAudioSource::UPDATE_PITCH | IEqAudioSource::UPDATE_VOLUME | IEqAudioSource::UPDATE_REF_DIST);
 	emitter->virtualParams.merge(params, params.updateFlags & ~excludeFlags);
+	MarkEmittersChanged();
 }
 
 void CSoundingObject::SetInputValue(SoundEmitterData* emitter, int inputNameHash, float value)
@@ -679,112 +665,93 @@ void CSoundingObject::SetInputValue(SoundEmitterData* emitter, int inputNameHash
 //----------------------------------------
 
 CEmitterObjectSound::CEmitterObjectSound(CSoundingObject& soundingObj, int uniqueId)
-	: m_soundingObj(soundingObj)
+	: m_soundingObj(soundingObj), m_uniqueId(uniqueId)
 {
-	m_emitter = CWeakPtr(m_soundingObj.FindEmitter(uniqueId));
 }
 
 int CEmitterObjectSound::GetEmitterSampleId() const
 {
-	if (!m_emitter)
-		return -1;
-
-	return m_emitter->sampleId;
+	return m_soundingObj.GetEmitterSampleId(m_uniqueId);
 }
 
 void CEmitterObjectSound::SetEmitterSampleId(int sampleId)
 {
-	if (!m_emitter)
-		return;
-
-	if (m_emitter->sampleId == sampleId)
-		return;
-
-	m_emitter->sampleId = sampleId;
-
-	if (m_emitter->virtualParams.state == IEqAudioSource::PLAYING)
-	{
-		// this will restart emitter safely
-		g_sounds->SwitchSourceState(m_emitter, true);
-		g_sounds->SwitchSourceState(m_emitter, false);
-	}
+	m_soundingObj.SetEmitterSampleId(m_uniqueId, sampleId);
 }
 
 const IEqAudioSource::State CEmitterObjectSound::GetEmitterState() const
 {
-	if (!m_emitter)
-		return IEqAudioSource::STOPPED;
-	return m_emitter->virtualParams.state;
+	return m_soundingObj.GetEmitterState(m_uniqueId);
 }
 
 void CEmitterObjectSound::SetEmitterState(IEqAudioSource::State state, bool rewindOnPlay)
 {
-	m_soundingObj.SetEmitterState(m_emitter.Ptr(), state, rewindOnPlay);
+	m_soundingObj.SetEmitterState(m_uniqueId, state, rewindOnPlay);
 }
 
 void CEmitterObjectSound::StopEmitter()
 {
-	m_soundingObj.StopEmitter(m_emitter.Ptr(), false);
+	m_soundingObj.StopEmitter(m_uniqueId, false);
 }
 
 void CEmitterObjectSound::PlayEmitter(bool rewind)
 {
-	m_soundingObj.PlayEmitter(m_emitter.Ptr(), rewind);
+	m_soundingObj.PlayEmitter(m_uniqueId, rewind);
 }
 
 void CEmitterObjectSound::PauseEmitter()
 {
-	m_soundingObj.PauseEmitter(m_emitter.Ptr());
+	m_soundingObj.PauseEmitter(m_uniqueId);
 }
 
 void CEmitterObjectSound::StartLoop(float fadeInTime)
 {
-	m_soundingObj.StartLoop(m_emitter.Ptr(), fadeInTime);
+	m_soundingObj.StartLoop(m_uniqueId, fadeInTime);
 }
 
 void CEmitterObjectSound::StopLoop(float fadeOutTime)
 {
-	m_soundingObj.StopLoop(m_emitter.Ptr(), fadeOutTime);
+	m_soundingObj.StopLoop(m_uniqueId, fadeOutTime);
 }
 
 void CEmitterObjectSound::SetPosition(const Vector3D& position)
 {
-	m_soundingObj.SetPosition(m_emitter.Ptr(), position);
+	m_soundingObj.SetPosition(m_uniqueId, position);
 }
 
 void CEmitterObjectSound::SetVelocity(const Vector3D& velocity)
 {
-	m_soundingObj.SetVelocity(m_emitter.Ptr(), velocity);
+	m_soundingObj.SetVelocity(m_uniqueId, velocity);
 }
 
 void CEmitterObjectSound::SetConeProperties(const Vector3D& direction, float innerRadus, float outerRadius, float outerVolume, float outerVolumeHf)
 {
-	m_soundingObj.SetConeProperties(m_emitter.Ptr(), direction, innerRadus, outerRadius, outerVolume, outerVolumeHf);
+	m_soundingObj.SetConeProperties(m_uniqueId, direction, innerRadus, outerRadius, outerVolume, outerVolumeHf);
 }
 
 void CEmitterObjectSound::SetPitch(float pitch)
 {
-	m_soundingObj.SetPitch(m_emitter.Ptr(), pitch);
+	m_soundingObj.SetPitch(m_uniqueId, pitch);
 }
 
 void CEmitterObjectSound::SetVolume(float volume)
 {
-	m_soundingObj.SetVolume(m_emitter.Ptr(), volume);
+	m_soundingObj.SetVolume(m_uniqueId, volume);
 }
 
 void CEmitterObjectSound::SetSamplePlaybackPosition(int waveId, float seconds)
 {
-	m_soundingObj.SetSamplePlaybackPosition(m_emitter.Ptr(), waveId, seconds);
+	m_soundingObj.SetSamplePlaybackPosition(m_uniqueId, waveId, seconds);
 }
 
 void CEmitterObjectSound::SetSampleVolume(int waveId, float volume)
 {
-	m_soundingObj.SetSampleVolume(m_emitter.Ptr(), waveId, volume);
+	m_soundingObj.SetSampleVolume(m_uniqueId, waveId, volume);
 }
 
 void CEmitterObjectSound::SetParams(const IEqAudioSource::Params& params)
 {
-	m_soundingObj.SetParams(m_emitter.Ptr(), params);
+	m_soundingObj.SetParams(m_uniqueId, params);
 }
 
 void CEmitterObjectSound::SetInputValue(const char* name, float value)
@@ -795,5 +762,5 @@ void CEmitterObjectSound::SetInputValue(const char* name, float value)
 
 void CEmitterObjectSound::SetInputValue(int inputNameHash, float value)
 {
-	m_soundingObj.SetInputValue(m_emitter.Ptr(), inputNameHash, value);
-}
+	m_soundingObj.SetInputValue(m_uniqueId, inputNameHash, value);
+}
\ No newline at end of file
@@ -11,16 +11,20 @@
 
 struct SoundScriptDesc;
 struct SoundEmitterData;
+struct SoundCommand;
 
 struct EmitParams;
 class ConCommandBase;
 
 class CEmitterObjectSound;
 class CSoundScriptEditor;
+class CSoundVoiceManager;
 
 static constexpr const int s_loopRemainTimeFactorNameHash = StringToHashConst("loopRemainTimeFactor");
 
 // Sound channel entity that controls it's sound sources
+// Public setters only send commands which are executed on sound emitter system update,
+// getters return state from last update.
 class CSoundingObject : public WeakRefObject<CSoundingObject>
 {
 	friend class CSoundEmitterSystem;
@@ -49,6 +53,7 @@ public:
 	void		StopEmitter(int uniqueId, bool destroy = false);
 	void		PlayEmitter(int uniqueId, bool rewind = false);
 	void		PauseEmitter(int uniqueId);
+	void		StartLoop(int uniqueId, float fadeInTime = 0.0f);
 	void		StopLoop(int uniqueId, float fadeOutTime = 0.0f);
 	
 	// WARNING: SetPitch and SetVolume changes only the value that was passed through EmitParams
@@ -76,6 +81,10 @@ protected:
 	SoundEmitterData*	FindEmitter(int uniqueId) const;
 	void		AddEmitter(int uniqueId, SoundEmitterData* emitter);
 
+	void		ExecuteCommand(const SoundCommand& cmd);
+	void		ExecuteCommand(SoundEmitterData* emitter, const SoundCommand& cmd);
+	void		StopEmitterById(int uniqueId, bool destroy);
+
 	void		SetEmitterState(SoundEmitterData* emitter, IEqAudioSource::State state, bool rewindOnPlay);
 
 	void		StopEmitter(SoundEmitterData* emitter, bool destroy);
@@ -98,7 +107,8 @@ protected:
 
 	void		SetInputValue(SoundEmitterData* emitter, int inputNameHash, float value);
 
-	bool		UpdateEmitters(const Vector3D& listenerPos);
+	bool		UpdateEmitters(CSoundVoiceManager& voices);
+	void		MarkEmittersChanged() { Atomic::Store(m_emittersChanged, 1); }
 	void		StopFirstEmitterByChannel(int chan);
 
 	void		FlushOldEmitters();
@@ -107,7 +117,8 @@ protected:
 	Map<int, SoundEmitterData*>	m_emitters{ PP_SL };
 	SoundEmitterData*	m_deleteList{ nullptr };
 
-	Threading::CEqMutex	m_mutex;
+	Threading::CEqMutex	m_mutex;	// emitters are only modified on sound update, it protects lookups from game threads
+	int					m_emittersChanged{ 1 };	// emitters were added, removed, moved or changed state
 	uint8				m_numChannelSounds[CHAN_MAX]{ 0 };
 	float				m_volumeScale{ 1.0f };
 };
@@ -151,5 +162,5 @@ public:
 	void		SetInputValue(int inputNameHash, float value);
 private:
 	CSoundingObject&			m_soundingObj;
-	CWeakPtr<SoundEmitterData>	m_emitter{ nullptr };
+	int							m_uniqueId{ 0 };
 };
\ No newline at end of file
@@ -518,6 +518,8 @@ void SoundScriptDesc::ParseDesc(SoundScriptDesc& scriptDesc, const KVSection* sc
 		nodeDesc.func.inputCount = 1;
 		nodeDesc.func.outputCount = 1;
 	}
+
+	scriptDesc.program.Compile(scriptDesc);
 }
 
 void SoundScriptDesc::ReloadDesc(SoundScriptDesc& scriptDesc, const KVSection* scriptSection)
@@ -542,6 +544,7 @@ void SoundScriptDesc::ReloadDesc(SoundScriptDesc& scriptDesc, const KVSection* s
 	scriptDesc.soundFileNames.clear();
 	scriptDesc.splineDescs.clear();
 	scriptDesc.inputNodeMap.clear();
+	scriptDesc.program.Reset();
 
 	defaultsSec.SetKey("maxDistance", scriptDesc.maxDistance);
 	defaultsSec.SetKey("loop", scriptDesc.loop);
@@ -565,19 +568,8 @@ SoundEmitterData::SoundEmitterData()
 
 void SoundEmitterData::CreateNodeRuntime()
 {
-	inputs.clear();
-	const Array<SoundNodeDesc>& nodeDescs = script->nodeDescs;
-
-	for (int i = 0; i < nodeDescs.numElem(); ++i)
-	{
-		const SoundNodeDesc& nodeDesc = nodeDescs[i];
-
-		if (nodeDesc.type != SOUND_NODE_INPUT)
-			continue; // no need, we have desc to access
-
-		SoundNodeInput& input = *inputs.insert(i);
-		memset(&input, 0, sizeof(input));
-	}
+	inputValues.clear();
+	inputValues.assureSizeEmplace(script->program.numInputValues, 0.0f);
 }
 
 void SoundEmitterData::SetInputValue(int inputNameHash, int arrayIdx, float value)
@@ -586,13 +578,7 @@ void SoundEmitterData::SetInputValue(int inputNameHash, int arrayIdx, float valu
 	if (inputNodeId < 0)
 		return;
 
-	auto dataIt = inputs.find(inputNodeId);
-	if (dataIt.atEnd())
-		return;
-
-	SoundNodeInput& in = *dataIt;
-	in.values[arrayIdx] = value;
-	Atomic::Exchange(nodesNeedUpdate, 1);
+	SetInputValue(SoundNodeDesc::PackInputIdArrIdx(inputNodeId, arrayIdx), value);
 }
 
 void SoundEmitterData::SetInputValue(uint8 inputId, float value)
@@ -600,12 +586,19 @@ void SoundEmitterData::SetInputValue(uint8 inputId, float value)
 	uint nodeId, arrayIdx;
 	SoundNodeDesc::UnpackInputIdArrIdx(inputId, nodeId, arrayIdx);
 
-	auto dataIt = inputs.find(nodeId);
-	if (dataIt.atEnd())
+	const SoundNodeProgram& program = script->program;
+	if (!program.nodeInputOffsets.inRange(nodeId) || program.nodeInputOffsets[nodeId] < 0)
 		return;
 
-	SoundNodeInput& in = *dataIt;
-	in.values[arrayIdx] = value;
+	const SoundNodeDesc& nodeDesc = script->nodeDescs[nodeId];
+	if (arrayIdx >= (uint)nodeDesc.input.valueCount)
+		return;
+
+	const int valueIdx = program.nodeInputOffsets[nodeId] + arrayIdx;
+	if (!inputValues.inRange(valueIdx))
+		return;
+
+	inputValues[valueIdx] = value;
 	Atomic::Exchange(nodesNeedUpdate, 1);
 }
 
@@ -616,12 +609,15 @@ float SoundEmitterData::GetInputValue(int nodeId, int arrayIdx)
 	if(nodeDescs[nodeId].type == SOUND_NODE_CONST)
 		return nodeDescs[nodeId].c.value;
 
-	auto dataIt = inputs.find(nodeId);
-	if (dataIt.atEnd())
+	const SoundNodeProgram& program = script->program;
+	if (!program.nodeInputOffsets.inRange(nodeId) || program.nodeInputOffsets[nodeId] < 0)
+		return 0.0f;
+
+	const int valueIdx = program.nodeInputOffsets[nodeId] + arrayIdx;
+	if (!inputValues.inRange(valueIdx))
 		return 0.0f;
 
-	SoundNodeInput& in = *dataIt;
-	return in.values[arrayIdx];
+	return inputValues[valueIdx];
 }
 
 float SoundEmitterData::GetInputValue(uint8 inputId)
@@ -636,279 +632,326 @@ float SoundEmitterData::GetInputValue(uint8 inputId)
 }
 
 //---------------------------------------
-// Simple evaluator for sound scripts
-// with it's own runtime memory
+// Sound script node program
 //---------------------------------------
 
-struct EvalStack
-{
-	int	values[128];
-	int	sp{ 0 };
-
-	template<typename T>
-	int Push(T value)
-	{
-		const int oldSP = sp;
-		*(T*)&values[oldSP] = value;
-		sp += sizeof(T) / sizeof(int);
-		return oldSP;
-	}
-
-	template<typename T>
-	T Pop()
-	{
-		sp -= sizeof(T) / sizeof(int);
-		return *(T*)&values[sp];
-	}
-
-	template<typename T>
-	T Get(int pos)
-	{
-		return *(T*)&values[pos];
-	}
-};
-
-typedef void (*SoundEmitEvalFn)(EvalStack& stack, int argc, int nret);
-
-static void evalCopy(EvalStack& stack, int argc, int nret)
-{
-	// copy need to do nothing as argument was already pushed on stack
-}
-
-static void evalAdd(EvalStack& stack, int argc, int nret)
-{
-	ASSERT(argc == 2);
-	ASSERT(nret == 1);
-	const float operandB = stack.Pop<float>();
-	const float operandA = stack.Pop<float>();
-	stack.Push(operandA + operandB);
-}
-
-static void evalSub(EvalStack& stack, int argc, int nret)
-{
-	ASSERT(argc == 2);
-	ASSERT(nret == 1);
-	const float operandB = stack.Pop<float>();
-	const float operandA = stack.Pop<float>();
-	stack.Push(operandA - operandB);
-}
-
-static void evalMul(EvalStack& stack, int argc, int nret)
-{
-	ASSERT(argc == 2);
-	ASSERT(nret == 1);
-	const float operandB = stack.Pop<float>();
-	const float operandA = stack.Pop<float>();
-	stack.Push(operandA * operandB);
-}
-
-static void evalDiv(EvalStack& stack, int argc, int nret)
-{
-	ASSERT(argc == 2);
-	ASSERT(nret == 1);
-	const float operandB = stack.Pop<float>();
-	const float operandA = stack.Pop<float>();
-	stack.Push(operandA / operandB);
-}
-
-static void evalMin(EvalStack& stack, int argc, int nret)
+void SoundNodeProgram::Reset()
 {
-	ASSERT(argc == 2);
-	ASSERT(nret == 1);
-	const float operandB = stack.Pop<float>();
-	const float operandA = stack.Pop<float>();
-	stack.Push(min(operandA, operandB));
+	instrs.clear();
+	consts.clear();
+	inputs.clear();
+	nodeSlots.clear();
+	nodeInputOffsets.clear();
+	numSlots = 0;
+	numInputValues = 0;
 }
 
-static void evalMax(EvalStack& stack, int argc, int nret)
+bool SoundNodeProgram::Compile(const SoundScriptDesc& script)
 {
-	ASSERT(argc == 2);
-	ASSERT(nret == 1);
-	const float operandB = stack.Pop<float>();
-	const float operandA = stack.Pop<float>();
-	stack.Push(max(operandA, operandB));
-}
+	Reset();
 
-static void evalAverage(EvalStack& stack, int argc, int nret)
-{
-	ASSERT(nret == 1);
+	const Array<SoundNodeDesc>& nodeDescs = script.nodeDescs;
+	nodeSlots.setNum(nodeDescs.numElem());
+	nodeInputOffsets.setNum(nodeDescs.numElem());
 
-	// order doesn't matter
-	float value = 0.0f;
-	for (int i = 0; i < argc; ++i)
-		value += stack.Pop<float>();
+	// node values are laid out in node order
+	for (int nodeId = 0; nodeId < nodeDescs.numElem(); ++nodeId)
+	{
+		const SoundNodeDesc& nodeDesc = nodeDescs[nodeId];
 
-	stack.Push(value / (float)argc);
-}
+		nodeSlots[nodeId] = numSlots;
+		nodeInputOffsets[nodeId] = -1;
 
-static void evalAbs(EvalStack& stack, int argc, int nret)
-{
-	float value[SoundNodeDesc::MAX_ARRAY_IDX];
+		if (nodeDesc.type == SOUND_NODE_INPUT)
+		{
+			const int valueCount = min(nodeDesc.input.valueCount, (int)SoundNodeDesc::MAX_ARRAY_IDX);
+			inputs.append({ (uint16)numSlots, (uint16)numInputValues, (uint8)valueCount });
 
-	for (int i = 0; i < argc; ++i)
-		value[argc - i - 1] = fabsf(stack.Pop<float>());
+			nodeInputOffsets[nodeId] = numInputValues;
+			numInputValues += valueCount;
+			numSlots += valueCount;
+		}
+		else if (nodeDesc.type == SOUND_NODE_CONST)
+		{
+			consts.append({ (uint16)numSlots, (uint8)nodeId, -1 });
+			numSlots += 1;
+		}
+		else if (nodeDesc.type == SOUND_NODE_FUNC)
+		{
+			// copy outputs all it's arguments
+			const int retCount = (nodeDesc.func.type == SOUND_FUNC_COPY) ? nodeDesc.func.inputCount : nodeDesc.func.outputCount;
+			numSlots += min(retCount, (int)SoundNodeDesc::MAX_ARRAY_IDX);
+		}
+	}
 
-	for (int i = 0; i < nret; ++i)
-		stack.Push(value[i]);
-}
+	// functions become instructions, constant arguments get slots after node values
+	for (int nodeId = 0; nodeId < nodeDescs.numElem(); ++nodeId)
+	{
+		const SoundNodeDesc& nodeDesc = nodeDescs[nodeId];
+		if (nodeDesc.type != SOUND_NODE_FUNC)
+			continue;
 
-static void evalSpline(EvalStack& stack, int argc, int nret)
-{
-	ASSERT(argc == 1);
-	ASSERT(nret == 1);
+		const int argCount = min((int)nodeDesc.func.inputCount, (int)SoundNodeDesc::MAX_ARRAY_IDX);
+		const int retCount = (nodeDesc.func.type == SOUND_FUNC_COPY) ? argCount : min((int)nodeDesc.func.outputCount, (int)SoundNodeDesc::MAX_ARRAY_IDX);
 
-	const float input = stack.Pop<float>();
-	const SoundSplineDesc& splineDesc = *stack.Pop<SoundSplineDesc*>();
+		SoundNodeInstr& instr = instrs.append();
+		instr.func = nodeDesc.func.type;
+		instr.argCount = argCount;
+		instr.retCount = retCount;
+		instr.outSlot = nodeSlots[nodeId];
+		instr.splineIdx = (instr.func == SOUND_FUNC_SPLINE || instr.func == SOUND_FUNC_FADE) ? nodeDesc.func.inputIds[1] : 0;
 
-	const float output = SoundSplineDesc::splineInterpLinear(input, splineDesc.valueCount / 2, splineDesc.values);
-	stack.Push(output);
-}
+		for (int i = 0; i < argCount; ++i)
+		{
+			const uint8 inputId = nodeDesc.func.inputIds[i];
 
-static void evalFaderSpline(EvalStack& stack, int argc, int nret)
-{
-	ASSERT(argc == 1);
+			uint inNodeId = 0, inArrayIdx = 0;
+			if (inputId != SOUND_VAR_INVALID)
+				SoundNodeDesc::UnpackInputIdArrIdx(inputId, inNodeId, inArrayIdx);
 
-	const float input = stack.Pop<float>();
-	const SoundSplineDesc& splineDesc = *stack.Pop<SoundSplineDesc*>();
+			if (inputId != SOUND_VAR_INVALID && nodeSlots.inRange(inNodeId))
+			{
+				instr.argSlots[i] = nodeSlots[inNodeId] + inArrayIdx;
+			}
+			else
+			{
+				consts.append({ (uint16)numSlots, (uint8)nodeId, (int8)i });
+				instr.argSlots[i] = numSlots++;
+			}
+		}
 
-	const float output = SoundSplineDesc::splineInterpLinear(input, splineDesc.valueCount / 2, splineDesc.values);
+		if (instr.splineIdx >= script.splineDescs.numElem() && (instr.func == SOUND_FUNC_SPLINE || instr.func == SOUND_FUNC_FADE))
+		{
+			MsgError("sound script '%s' mixer %s: invalid spline\n", script.name.ToCString(), nodeDesc.name);
+			instrs.popBack();
+		}
+	}
 
-	// split one output into the number of outputs
-	for (int i = 0; i < nret; ++i)
+	// array index of argument can go past the last slot
+	if (numSlots + SoundNodeDesc::MAX_ARRAY_IDX > MAX_SLOTS)
 	{
-		const float targetValue = (float)i;
-		const float fadeValue = clamp(1.0f - fabsf(targetValue - output), 0.0f, 1.0f);
-		stack.Push(fadeValue);
+		MsgError("sound script '%s' has too many node values (%d, max %d)\n", script.name.ToCString(), numSlots, MAX_SLOTS);
+		Reset();
+		return false;
 	}
-}
 
-static SoundEmitEvalFn s_soundFuncTypeEvFn[] = {
-	evalCopy, // COPY
-	evalAdd, // ADD
-	evalSub, // SUB
-	evalMul, // MUL
-	evalDiv, // DIV
-	evalMin, // MIN
-	evalMax, // MAX
-	evalAbs, // ABS
-	evalAverage, // AVERAGE
-	evalSpline, // SPLINE
-	evalFaderSpline, // FADE
-};
-static_assert(elementsOf(s_soundFuncTypeEvFn) == SOUND_FUNC_COUNT, "s_soundFuncTypeFuncs and SOUND_FUNC_COUNT needs to be in sync");
+	return true;
+}
 
-void SoundEmitterData::UpdateNodes()
+void SoundNodeProgram::Evaluate(const SoundScriptDesc& script, ArrayCRef<SoundEmitterData*> emitters)
 {
-	if (!Atomic::Load(nodesNeedUpdate))
+	const SoundNodeProgram& program = script.program;
+	if (!program.numSlots)
 		return;
 
-	PROF_EVENT("Emitter Data Nodes Eval");
-
-	Atomic::Exchange(nodesNeedUpdate, 0);
+	PROF_EVENT("Sound Node Program Eval");
 
-	const Array<SoundNodeDesc>& nodeDescs = script->nodeDescs;
-	const Array<SoundSplineDesc>& splineDescs = script->splineDescs;
+	const Array<SoundNodeDesc>& nodeDescs = script.nodeDescs;
+	const Array<SoundSplineDesc>& splineDescs = script.splineDescs;
 
-	EvalStack stack;
-	short nodeValueSp[64];
+	// values of one slot for all evaluated emitters are next to each other
+	float slotValues[MAX_SLOTS * EVAL_LANES];
+	auto slot = [&slotValues](int slotIdx) { return &slotValues[slotIdx * EVAL_LANES]; };
 
-	// evaluate each function node down
-	for (int nodeId = 0; nodeId < nodeDescs.numElem(); ++nodeId)
+	for (int firstEmitter = 0; firstEmitter < emitters.numElem(); firstEmitter += EVAL_LANES)
 	{
-		const SoundNodeDesc& nodeDesc = nodeDescs[nodeId];
+		const int numLanes = min((int)EVAL_LANES, emitters.numElem() - firstEmitter);
+		memset(slotValues, 0, program.numSlots * EVAL_LANES * sizeof(float));
 
-		// remember stack pointer of each node for further processing
-		nodeValueSp[nodeId] = stack.sp;
-
-		if (nodeDesc.type == SOUND_NODE_INPUT)
+		for (const ConstSlot& constSlot : program.consts)
 		{
-			// add input values to stack
-			for (int i = 0; i < nodeDesc.input.valueCount; ++i)
-				stack.Push(GetInputValue(nodeId, i));
+			const SoundNodeDesc& nodeDesc = nodeDescs[constSlot.nodeId];
+			const float value = (constSlot.constIdx == -1) ? nodeDesc.c.value : nodeDesc.inputConst[constSlot.constIdx];
 
-			continue;
+			float* out = slot(constSlot.slot);
+			for (int lane = 0; lane < EVAL_LANES; ++lane)
+				out[lane] = value;
 		}
-		else if (nodeDesc.type == SOUND_NODE_CONST)
-		{
-			// FIXME: remove const in favor of input only?
-			stack.Push(nodeDesc.c.value);
-			continue;
-		}
-		else if (nodeDesc.type == SOUND_NODE_FUNC)
+
+		for (const InputSlot& inputSlot : program.inputs)
 		{
-			// NOTE: stack would be inverse to read!!!
-			
-			if (nodeDesc.func.type == SOUND_FUNC_SPLINE || nodeDesc.func.type == SOUND_FUNC_FADE)
+			for (int v = 0; v < inputSlot.valueCount; ++v)
 			{
-				// push spline ptr to the stack
-				const SoundSplineDesc& splineDesc = script->splineDescs[nodeDesc.func.inputIds[1]];
-				stack.Push(&splineDesc);
+				float* out = slot(inputSlot.slot + v);
+				for (int lane = 0; lane < numLanes; ++lane)
+				{
+					const Array<float>& inputValues = emitters[firstEmitter + lane]->inputValues;
+					const int valueIdx = inputSlot.inputOffset + v;
+					out[lane] = inputValues.inRange(valueIdx) ? inputValues[valueIdx] : 0.0f;
+				}
 			}
+		}
 
-			for (int i = 0; i < nodeDesc.func.inputCount; ++i)
-			{
-				const uint8 inputId = nodeDesc.func.inputIds[i];
+		for (const SoundNodeInstr& instr : program.instrs)
+		{
+			const float* a = slot(instr.argSlots[0]);
+			const float* b = slot(instr.argSlots[1]);
+			float* out = slot(instr.outSlot);
 
-				if (inputId != SOUND_VAR_INVALID)
+			switch (instr.func)
+			{
+				case SOUND_FUNC_COPY:
+				{
+					for (int i = 0; i < instr.argCount; ++i)
+						memcpy(slot(instr.outSlot + i), slot(instr.argSlots[i]), EVAL_LANES * sizeof(float));
+					break;
+				}
+				case SOUND_FUNC_ADD:
 				{
-					uint inNodeId, inArrayIdx;
-					SoundNodeDesc::UnpackInputIdArrIdx(inputId, inNodeId, inArrayIdx);
+					for (int lane = 0; lane < EVAL_LANES; ++lane)
+						out[lane] = a[lane] + b[lane];
+					break;
+				}
+				case SOUND_FUNC_SUB:
+				{
+					for (int lane = 0; lane < EVAL_LANES; ++lane)
+						out[lane] = a[lane] - b[lane];
+					break;
+				}
+				case SOUND_FUNC_MUL:
+				{
+					for (int lane = 0; lane < EVAL_LANES; ++lane)
+						out[lane] = a[lane] * b[lane];
+					break;
+				}
+				case SOUND_FUNC_DIV:
+				{
+					for (int lane = 0; lane < EVAL_LANES; ++lane)
+						out[lane] = a[lane] / b[lane];
+					break;
+				}
+				case SOUND_FUNC_MIN:
+				{
+					for (int lane = 0; lane < EVAL_LANES; ++lane)
+						out[lane] = min(a[lane], b[lane]);
+					break;
+				}
+				case SOUND_FUNC_MAX:
+				{
+					for (int lane = 0; lane < EVAL_LANES; ++lane)
+						out[lane] = max(a[lane], b[lane]);
+					break;
+				}
+				case SOUND_FUNC_ABS:
+				{
+					for (int i = 0; i < instr.retCount; ++i)
+					{
+						const float* arg = slot(instr.argSlots[i]);
+						float* argOut = slot(instr.outSlot + i);
+						for (int lane = 0; lane < EVAL_LANES; ++lane)
+							argOut[lane] = fabsf(arg[lane]);
+					}
+					break;
+				}
+				case SOUND_FUNC_AVERAGE:
+				{
+					float sum[EVAL_LANES]{ 0.0f };
+					for (int i = 0; i < instr.argCount; ++i)
+					{
+						const float* arg = slot(instr.argSlots[i]);
+						for (int lane = 0; lane < EVAL_LANES; ++lane)
+							sum[lane] += arg[lane];
+					}
 
-					// retrieve operands of previous nodes and put them to back of stack
-					const float operand = stack.Get<float>(nodeValueSp[inNodeId] + inArrayIdx);
-					stack.Push(operand);
+					const float scale = 1.0f / (float)instr.argCount;
+					for (int lane = 0; lane < EVAL_LANES; ++lane)
+						out[lane] = sum[lane] * scale;
+					break;
 				}
-				else
+				case SOUND_FUNC_SPLINE:
 				{
-					// since no value was pushed to stack, we use const
-					stack.Push(nodeDesc.inputConst[i]);
+					const SoundSplineDesc& splineDesc = splineDescs[instr.splineIdx];
+					for (int lane = 0; lane < numLanes; ++lane)
+						out[lane] = SoundSplineDesc::splineInterpLinear(a[lane], splineDesc.valueCount / 2, splineDesc.values);
+					break;
+				}
+				case SOUND_FUNC_FADE:
+				{
+					const SoundSplineDesc& splineDesc = splineDescs[instr.splineIdx];
+
+					float splineValue[EVAL_LANES];
+					for (int lane = 0; lane < numLanes; ++lane)
+						splineValue[lane] = SoundSplineDesc::splineInterpLinear(a[lane], splineDesc.valueCount / 2, splineDesc.values);
+
+					// split one output into the number of outputs
+					for (int i = 0; i < instr.retCount; ++i)
+					{
+						float* fadeOut = slot(instr.outSlot + i);
+						for (int lane = 0; lane < numLanes; ++lane)
+							fadeOut[lane] = clamp(1.0f - fabsf((float)i - splineValue[lane]), 0.0f, 1.0f);
+					}
+					break;
 				}
 			}
-			
-			s_soundFuncTypeEvFn[nodeDesc.func.type](stack, nodeDesc.func.inputCount, nodeDesc.func.outputCount);
 		}
+
+		for (int lane = 0; lane < numLanes; ++lane)
+			emitters[firstEmitter + lane]->SetNodeOutputs(&slotValues[lane], EVAL_LANES);
 	}
+}
+
+void SoundEmitterData::UpdateNodes()
+{
+	if (!Atomic::Load(nodesNeedUpdate))
+		return;
+
+	PROF_EVENT("Emitter Data Nodes Eval");
+
+	Atomic::Exchange(nodesNeedUpdate, 0);
+
+	SoundEmitterData* emitter = this;
+	SoundNodeProgram::Evaluate(*script, ArrayCRef<SoundEmitterData*>(&emitter, 1));
+}
+
+void SoundEmitterData::SetNodeOutputs(const float* slotValues, int slotStride)
+{
+	const Array<SoundNodeDesc>& nodeDescs = script->nodeDescs;
+	const SoundNodeProgram& program = script->program;
 
 	// output value mapping to sound parameters
 	const uint8* paramMap = script->paramNodeMap;
+	auto paramValue = [&](int paramId) {
+		return slotValues[program.nodeSlots[paramMap[paramId]] * slotStride];
+	};
+
 	{
-		const float volume = stack.Get<float>(nodeValueSp[paramMap[SOUND_PARAM_VOLUME]]);
+		const float volume = paramValue(SOUND_PARAM_VOLUME);
 		if (memcmp(&nodeParams.volume.x, &volume, sizeof(float)))
 			nodeParams.set_volume(Vector3D(volume, nodeParams.volume.yz()));
 	}
 
 	{
-		const float pitch = stack.Get<float>(nodeValueSp[paramMap[SOUND_PARAM_PITCH]]);
+		const float pitch = paramValue(SOUND_PARAM_PITCH);
 		if (memcmp(&nodeParams.pitch, &pitch, sizeof(float)))
 			nodeParams.set_pitch(pitch);
 	}
 
 	{
-		const float hpf = stack.Get<float>(nodeValueSp[paramMap[SOUND_PARAM_HPF]]);
+		const float hpf = paramValue(SOUND_PARAM_HPF);
 		if (memcmp(&nodeParams.bandPass.y, &hpf, sizeof(float)))
 			nodeParams.set_bandPass(Vector2D(nodeParams.bandPass.x, hpf));
 	}
 
 	{
-		const float lpf = stack.Get<float>(nodeValueSp[paramMap[SOUND_PARAM_LPF]]);
+		const float lpf = paramValue(SOUND_PARAM_LPF);
 		if (memcmp(&nodeParams.bandPass.x, &lpf, sizeof(float)))
 			nodeParams.set_bandPass(Vector2D(lpf, nodeParams.bandPass.y));
 	}
 
 	{
-		const float airAbsorption = stack.Get<float>(nodeValueSp[paramMap[SOUND_PARAM_AIRABSORPTION]]);
+		const float airAbsorption = paramValue(SOUND_PARAM_AIRABSORPTION);
 		if (memcmp(&nodeParams.airAbsorption, &airAbsorption, sizeof(float)))
 			nodeParams.set_airAbsorption(airAbsorption);
 	}
 
 	{
-		const float rollOff = stack.Get<float>(nodeValueSp[paramMap[SOUND_PARAM_ROLLOFF]]);
+		const float rollOff = paramValue(SOUND_PARAM_ROLLOFF);
 		if (memcmp(&nodeParams.rolloff, &rollOff, sizeof(float)))
 			nodeParams.set_rolloff(rollOff);
 	}
 
 	{
-		const float attenuation = stack.Get<float>(nodeValueSp[paramMap[SOUND_PARAM_ATTENUATION]]);
+		const float attenuation = paramValue(SOUND_PARAM_ATTENUATION);
 		if (memcmp(&nodeParams.referenceDistance, &attenuation, sizeof(float)))
 			nodeParams.set_referenceDistance(attenuation);
 	}
@@ -921,10 +964,10 @@ void SoundEmitterData::UpdateNodes()
 		if (svolumeNodeDesc.type != SOUND_NODE_FUNC)
 			return;
 
-		const int startSp = nodeValueSp[paramMap[SOUND_PARAM_SAMPLE_VOLUME]];
+		const float* svolumeValues = &slotValues[program.nodeSlots[paramMap[SOUND_PARAM_SAMPLE_VOLUME]] * slotStride];
 
 		for (int i = 0; i < svolumeNodeDesc.func.outputCount; ++i)
-			sampleVolume[i] = stack.Get<float>(startSp+i);
+			sampleVolume[i] = svolumeValues[i * slotStride];
 	}
 }
 
@@ -961,4 +1004,21 @@ void SoundEmitterData::CalcFinalParameters(float volumeScale, IEqAudioSource::Pa
 	const int excludeFlags = (IEqAudioSource::UPDATE_PITCH | IEqAudioSource::UPDATE_VOLUME | IEqAudioSource::UPDATE_REF_DIST);
 	virtualParams.merge(nodeParams, nodeParams.updateFlags & ~excludeFlags);
 	outParams.merge(nodeParams, nodeParams.updateFlags & ~excludeFlags);
-}
\ No newline at end of file
+}
+//-----------------------------------------------------------------
+
+void SoundEmitCommandParams::Set(const EmitParams& ep)
+{
+	origin = ep.origin;
+	volume = ep.volume;
+	pitch = ep.pitch;
+	radiusMultiplier = ep.radiusMultiplier;
+	effectSlot = ep.effectSlot;
+	flags = ep.flags;
+	sampleId = ep.sampleId;
+	channelType = ep.channelType;
+
+	numInputs = min(ep.inputs.numElem(), (int)elementsOf(inputs));
+	for (int i = 0; i < numInputs; ++i)
+		inputs[i] = ep.inputs[i];
+}
@@ -246,6 +246,57 @@ struct SoundNodeInput
 	float values[SoundNodeDesc::MAX_ARRAY_IDX];	// indexed by inputIds 
 };
 
+struct SoundScriptDesc;
+struct SoundEmitterData;
+
+// single function node of compiled program
+struct SoundNodeInstr
+{
+	uint16	argSlots[SoundNodeDesc::MAX_ARRAY_IDX];
+	uint16	outSlot;
+	uint8	func;			// ESoundFuncType
+	uint8	argCount;
+	uint8	retCount;
+	uint8	splineIdx;
+};
+
+// Node graph compiled into linear instruction list.
+// Every value produced by node gets it's own slot so evaluation
+// doesn't need a stack and many emitters can be evaluated at once
+struct SoundNodeProgram
+{
+	static constexpr const int MAX_SLOTS = 256;
+	static constexpr const int EVAL_LANES = 16;		// emitters evaluated at once
+
+	struct ConstSlot
+	{
+		uint16	slot;
+		uint8	nodeId;
+		int8	constIdx;		// index in SoundNodeDesc::inputConst or -1 for const node value
+	};
+
+	struct InputSlot
+	{
+		uint16	slot;
+		uint16	inputOffset;	// offset in SoundEmitterData::inputValues
+		uint8	valueCount;
+	};
+
+	Array<SoundNodeInstr>	instrs{ PP_SL };
+	Array<ConstSlot>		consts{ PP_SL };
+	Array<InputSlot>		inputs{ PP_SL };
+	Array<uint16>			nodeSlots{ PP_SL };			// first value slot of each node
+	Array<int16>			nodeInputOffsets{ PP_SL };	// offset in SoundEmitterData::inputValues for input nodes, -1 for others
+	int						numSlots{ 0 };
+	int						numInputValues{ 0 };
+
+	void		Reset();
+	bool		Compile(const SoundScriptDesc& script);
+
+	// evaluates emitters sharing same script and writes their node parameters
+	static void	Evaluate(const SoundScriptDesc& script, ArrayCRef<SoundEmitterData*> emitters);
+};
+
 struct SoundScriptDesc
 {
 	SoundScriptDesc() = default;
@@ -259,11 +310,13 @@ struct SoundScriptDesc
 	Array<SoundSplineDesc>	splineDescs{ PP_SL };
 	uint8					paramNodeMap[SOUND_PARAM_COUNT];
 	Map<int, int>			inputNodeMap{ PP_SL };
+	SoundNodeProgram		program;
 
 	uint		sampleRandomizer{ 0 };
 
 	int			channelType{ CHAN_INVALID };
 	float		maxDistance{ 1.0f };
+	float		priority{ 1.0f };			// audibility scale when ranking emitters for voices
 	float		stopLoopTime{ 0.0f };
 	float		startLoopTime{ 0.0f };
 	
@@ -293,7 +346,7 @@ struct SoundEmitterData : public WeakRefObject<SoundEmitterData>
 	float						samplePos[MAX_SOUND_SAMPLES_SCRIPT];
 	float						params[SOUND_PARAM_COUNT];
 
-	Map<int, SoundNodeInput>	inputs{ PP_SL };
+	Array<float>				inputValues{ PP_SL };		// dense input values, see SoundNodeProgram::nodeInputOffsets
 
 	SoundEmitterData*			delNext{ nullptr };
 
@@ -314,6 +367,14 @@ struct SoundEmitterData : public WeakRefObject<SoundEmitterData>
 	int							sampleId{ -1 };				// when randomSample and sampleId == -1, it's random
 	int							nodesNeedUpdate{ true };	// triggers recalc of entire node set
 
+	// voice management, see CSoundVoiceManager
+	int							voiceCell{ -1 };			// grid cell key
+	int							voiceCellIdx{ -1 };
+	uint						voiceFrame{ 0 };			// last frame emitter was selected to have voice
+	float						voiceScore{ 0.0f };
+	bool						hasVoice{ false };			// allowed to have audio source
+	bool						voiceDropped{ false };		// release on stop emitter that couldn't get voice
+
 	SoundEmitterData();
 
 	void	CreateNodeRuntime();
@@ -325,5 +386,77 @@ struct SoundEmitterData : public WeakRefObject<SoundEmitterData>
 	float	GetInputValue(uint8 inputId);
 
 	void	UpdateNodes();
+	void	SetNodeOutputs(const float* slotValues, int slotStride);
 	void	CalcFinalParameters(float volumeScale, IEqAudioSource::Params& outParams);
-};
\ No newline at end of file
+};
+//-----------------------------------------------------------------
+// Commands sent by game threads to the sound emitter system update
+
+enum ESoundCommandType : uint8
+{
+	SOUND_CMD_EMIT = 0,				// script, emit
+	SOUND_CMD_STOP_ALL,				// stops all sounding objects
+
+	SOUND_CMD_SET_STATE,			// intValue = state, flag = rewind on play
+	SOUND_CMD_PLAY,					// flag = rewind
+	SOUND_CMD_PAUSE,
+	SOUND_CMD_STOP,					// flag = destroy
+	SOUND_CMD_START_LOOP,			// values[0] = fade in time
+	SOUND_CMD_STOP_LOOP,			// values[0] = fade out time
+	SOUND_CMD_SET_SAMPLE_ID,		// intValue = sample id
+	SOUND_CMD_SET_POSITION,			// values[0..2]
+	SOUND_CMD_SET_VELOCITY,			// values[0..2]
+	SOUND_CMD_SET_CONE,				// values[0..2] = direction, values[3..6] = inner, outer, outer volume, outer volume HF
+	SOUND_CMD_SET_PITCH,			// values[0]
+	SOUND_CMD_SET_VOLUME,			// values[0]
+	SOUND_CMD_SET_SAMPLE_POSITION,	// intValue = wave id, values[0] = seconds
+	SOUND_CMD_SET_SAMPLE_VOLUME,	// intValue = wave id, values[0] = volume
+	SOUND_CMD_SET_PARAMS,			// params
+	SOUND_CMD_SET_INPUT,			// intValue = input name hash, values[0] = value
+};
+
+// EmitParams without sound name, which is resolved to script before command is sent
+struct SoundEmitCommandParams
+{
+	void	Set(const EmitParams& ep);
+
+	Vector3D				origin;
+	float					volume;
+	float					pitch;
+	float					radiusMultiplier;
+	int						effectSlot;
+	int						flags;
+	int						sampleId;
+	int						channelType;
+	int						numInputs;
+	EmitParams::InputValue	inputs[8];
+};
+
+// stored inline in command queue, so commands don't allocate
+struct SoundCommand
+{
+	SoundCommand()
+		: emit()
+	{
+	}
+
+	SoundCommand(ESoundCommandType type, CSoundingObject* soundingObj, int uniqueId)
+		: soundingObj(soundingObj), uniqueId(uniqueId), type(type), emit()
+	{
+	}
+
+	CSoundingObject*			soundingObj{ nullptr };
+	int							uniqueId{ 0 };
+	uint8						type{ SOUND_CMD_EMIT };
+	bool						flag{ false };
+	int							intValue{ 0 };
+	float						values[7]{ 0.0f };
+
+	// only for SOUND_CMD_EMIT
+	SoundScriptDesc*			script{ nullptr };
+
+	union {
+		SoundEmitCommandParams	emit;		// SOUND_CMD_EMIT
+		IEqAudioSource::Params	params;		// SOUND_CMD_SET_PARAMS
+	};
+};
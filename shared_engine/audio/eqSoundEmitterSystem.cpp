@@ -15,6 +15,7 @@
 
 #include "utils/KeyValues.h"
 #include "math/Random.h"
+#include "ds/sort.h"
 
 #include "source/snd_source.h"
 #include "eqSoundEmitterPrivateTypes.h"
@@ -54,6 +55,8 @@ DECLARE_CMD_VARIANTS(snd_test_scriptsound, "Test the scripted sound", cmd_vars_s
 
 DECLARE_CVAR(snd_scriptsound_debug, "0", nullptr, CV_CHEAT);
 DECLARE_CVAR(snd_scriptsound_showWarnings, "0", nullptr, 0);
+DECLARE_CVAR(snd_voice_budget, "48", "Maximum number of sound emitters playing at once, least audible are virtualized. 0 - no limit", CV_ARCHIVE);
+DECLARE_CVAR(snd_voice_debug, "0", "Show sound emitter voice statistics", CV_CHEAT);
 
 //----------------------------------------------------------------------------
 //
@@ -62,6 +65,7 @@ DECLARE_CVAR(snd_scriptsound_showWarnings, "0", nullptr, 0);
 //----------------------------------------------------------------------------
 
 CSoundEmitterSystem::CSoundEmitterSystem()
+	: m_commands(PP_SL, 4096)
 {
 }
 
@@ -103,16 +107,20 @@ void CSoundEmitterSystem::Shutdown()
 {
 	CScopedMutex m(s_soundEmitterSystemMutex);
 
-	// remove pending sounds
-	m_pendingStartSounds.clear(true);
+	// drop commands that weren't executed
+	{
+		SoundCommand cmd;
+		while (m_commands.Pop(cmd)) {}
+	}
 
 	for (auto it = m_soundingObjects.begin(); !it.atEnd(); ++it)
 	{
 		CSoundingObject* obj = it.key();
-		obj->StopEmitter(CSoundingObject::ID_ALL, true);
+		obj->StopEmitterById(CSoundingObject::ID_ALL, true);
 	}
 
 	m_soundingObjects.clear(true);
+	m_voices.Clear();
 
 	for (auto it = m_allSounds.begin(); !it.atEnd(); ++it)
 	{
@@ -183,20 +191,6 @@ int CSoundEmitterSystem::EmitSoundInternal(EmitParams* ep, int objUniqueId, CSou
 {
 	ASSERT(ep);
 
-	const bool forceStartOnUpdate = (ep->flags & EMITSOUND_FLAG_START_ON_UPDATE) || !m_updateDone.Wait(0);
-	if(forceStartOnUpdate && !(ep->flags & EMITSOUND_FLAG_PENDING))
-	{
-		CScopedMutex m(s_soundEmitterSystemMutex);
-		PendingSound& pending = m_pendingStartSounds.append();
-		pending.params = (*ep);
-		pending.params.flags &= ~EMITSOUND_FLAG_START_ON_UPDATE;
-		pending.params.flags |= EMITSOUND_FLAG_PENDING;
-		pending.objUniqueId = objUniqueId;
-		pending.soundingObj.Assign(soundingObj);
-		
-		return CHAN_INVALID;
-	}
-
 	SoundScriptDesc* script = FindSoundScript(ep->name.ToCString());
 
 	if (!script)
@@ -224,6 +218,37 @@ int CSoundEmitterSystem::EmitSoundInternal(EmitParams* ep, int objUniqueId, CSou
 		return CHAN_INVALID;
 	}
 
+	const bool releaseOnStop = soundingObj == nullptr || (ep->flags & EMITSOUND_FLAG_RELEASE_ON_STOP);
+	const bool is2Dsound = script->is2d || (ep->flags & EMITSOUND_FLAG_FORCE_2D);
+
+	// don't bother update with sounds that will be dropped anyway
+	if (releaseOnStop && !is2Dsound)
+	{
+		const Vector3D listenerPos = g_audioSystem->GetListenerPosition();
+		const float distToSoundSqr = lengthSqr(ep->origin - listenerPos);
+		if ((ep->flags & EMITSOUND_FLAG_STARTSILENT) || distToSoundSqr >= M_SQR(script->maxDistance))
+			return CHAN_INVALID;
+	}
+
+	if (!releaseOnStop && !soundingObj)
+	{
+		ASSERT_FAIL("Invalid value for releaseOnStop set\n");
+	}
+
+	ep->channelType = (ep->channelType != CHAN_INVALID) ? ep->channelType : script->channelType;
+
+	// sound is started on next update
+	SoundCommand cmd(SOUND_CMD_EMIT, soundingObj, objUniqueId);
+	cmd.script = script;
+	cmd.emit.Set(*ep);
+	PushCommand(cmd);
+
+	return ep->channelType;
+}
+
+// executed by update
+void CSoundEmitterSystem::StartEmitter(SoundScriptDesc* script, const SoundEmitCommandParams* ep, int objUniqueId, CSoundingObject* soundingObj)
+{
 	const Vector3D listenerPos = g_audioSystem->GetListenerPosition();
 
 	const bool releaseOnStop = soundingObj == nullptr || (ep->flags & EMITSOUND_FLAG_RELEASE_ON_STOP);
@@ -237,16 +262,9 @@ int CSoundEmitterSystem::EmitSoundInternal(EmitParams* ep, int objUniqueId, CSou
 	}
 	
 	if (!isAudibleToStart && releaseOnStop)
-	{
-		return CHAN_INVALID;
-	}
-
-	if (!releaseOnStop && !soundingObj)
-	{
-		ASSERT_FAIL("Invalid value for releaseOnStop set\n");
-	}
+		return;
 	
-	const int channelType = (ep->channelType != CHAN_INVALID) ? ep->channelType : script->channelType;
+	const int channelType = ep->channelType;
 
 	SoundEmitterData tmpEmit;
 	SoundEmitterData* edata = &tmpEmit;
@@ -260,10 +278,7 @@ int CSoundEmitterSystem::EmitSoundInternal(EmitParams* ep, int objUniqueId, CSou
 			soundingObj->StopFirstEmitterByChannel(channelType);
 
 		edata = PPNew SoundEmitterData();
-		{
-			CScopedMutex m(s_soundEmitterSystemMutex);
-			m_soundingObjects.insert(soundingObj);
-		}
+		m_soundingObjects.insert(soundingObj);
 	}
 
 	// fill in start params
@@ -281,7 +296,7 @@ int CSoundEmitterSystem::EmitSoundInternal(EmitParams* ep, int objUniqueId, CSou
 	
 	// apply inputs (if any) to emitter data
 	edata->SetInputValue(s_loopRemainTimeFactorNameHash, 0, 1.0f);
-	for (int i = 0; i < ep->inputs.numElem(); ++i)
+	for (int i = 0; i < ep->numInputs; ++i)
 		edata->SetInputValue(ep->inputs[i].nameHash, 0, ep->inputs[i].value);
 	
 	if (isAudibleToStart)
@@ -296,8 +311,6 @@ int CSoundEmitterSystem::EmitSoundInternal(EmitParams* ep, int objUniqueId, CSou
 	virtualParams.set_releaseOnStop(releaseOnStop);
 	virtualParams.set_effectSlot(ep->effectSlot);
 
-	ep->channelType = channelType;
-
 	if (soundingObj && channelType != CHAN_INVALID)
 		++soundingObj->m_numChannelSounds[channelType];
 
@@ -307,8 +320,50 @@ int CSoundEmitterSystem::EmitSoundInternal(EmitParams* ep, int objUniqueId, CSou
 		soundingObj->AddEmitter(objUniqueId, edata);
 	else
 		SwitchSourceState(edata, !isAudibleToStart);
+}
 
-	return ep->channelType;
+void CSoundEmitterSystem::PushCommand(const SoundCommand& cmd)
+{
+	if (m_commands.Push(cmd))
+		return;
+
+	// queue is full, execute commands here instead of waiting for update
+	CScopedMutex m(s_soundEmitterSystemMutex);
+	Atomic::Increment(m_numCommandStalls);
+
+	do {
+		ExecuteCommands();
+	} while (!m_commands.Push(cmd));
+}
+
+// must be called under s_soundEmitterSystemMutex
+void CSoundEmitterSystem::ExecuteCommands()
+{
+	PROF_EVENT("Sound Emitter System Execute Commands");
+
+	SoundCommand cmd;
+	while (m_commands.Pop(cmd))
+	{
+		ExecuteCommand(cmd);
+		++m_numCommands;
+	}
+}
+
+void CSoundEmitterSystem::ExecuteCommand(const SoundCommand& cmd)
+{
+	switch (cmd.type)
+	{
+		case SOUND_CMD_EMIT:
+			StartEmitter(cmd.script, &cmd.emit, cmd.uniqueId, cmd.soundingObj);
+			break;
+		case SOUND_CMD_STOP_ALL:
+			for (auto it = m_soundingObjects.begin(); !it.atEnd(); ++it)
+				it.key()->StopEmitterById(CSoundingObject::ID_ALL, false);
+			break;
+		default:
+			cmd.soundingObj->ExecuteCommand(cmd);
+			break;
+	}
 }
 
 bool CSoundEmitterSystem::SwitchSourceState(SoundEmitterData* emit, bool isVirtual)
@@ -327,7 +382,9 @@ bool CSoundEmitterSystem::SwitchSourceState(SoundEmitterData* emit, bool isVirtu
 #endif
 
 	// start the real sound
-	if (!isVirtual && emit->virtualParams.state != IEqAudioSource::STOPPED && !soundSource)
+	// emitters of sounding objects must also have voice given by voice manager
+	const bool canHaveSource = !emit->soundingObj || emit->hasVoice;
+	if (!isVirtual && canHaveSource && emit->virtualParams.state != IEqAudioSource::STOPPED && !soundSource)
 	{
 		PROF_EVENT("Emitter Switch Source - Create");
 
@@ -425,16 +482,8 @@ bool CSoundEmitterSystem::SwitchSourceState(SoundEmitterData* emit, bool isVirtu
 
 void CSoundEmitterSystem::StopAllSounds()
 {
-	CScopedMutex m(s_soundEmitterSystemMutex);
-
-	// remove pending sounds
-	m_pendingStartSounds.clear();
-
-	for (auto it = m_soundingObjects.begin(); !it.atEnd(); ++it)
-	{
-		CSoundingObject* obj = it.key();
-		obj->StopEmitter(CSoundingObject::ID_ALL);
-	}
+	SoundCommand cmd(SOUND_CMD_STOP_ALL, nullptr, CSoundingObject::ID_ALL);
+	PushCommand(cmd);
 }
 
 int CSoundEmitterSystem::EmitterUpdateCallback(IEqAudioSource* soundSource, IEqAudioSource::Params& params, CWeakPtr<SoundEmitterData> emitter)
@@ -519,17 +568,11 @@ int CSoundEmitterSystem::EmitterUpdateCallback(IEqAudioSource* soundSource, IEqA
 	nodeParams.updateFlags = 0;
 	virtualParams.state = params.state;
 
-	if (!params.relative)
 	{
 		PROF_EVENT("Emitter Update SwitchSourceState");
-		const Vector3D listenerPos = g_audioSystem->GetListenerPosition();
-
-		const float distToSoundSqr = lengthSqr(params.position - listenerPos);
-		const float maxDistSqr = M_SQR(script->maxDistance);
-		const bool isAudible = distToSoundSqr < maxDistSqr;
 
-		// switch emitter between virtual and real here
-		g_sounds->SwitchSourceState(emitter, !isAudible);
+		// voice manager decides on audibility, here source is only dropped when stopped
+		g_sounds->SwitchSourceState(emitter, !emitter->hasVoice);
 	}
 
 	return 0;
@@ -571,42 +614,133 @@ void CSoundEmitterSystem::Update(Threading::CEqSignal* waitFor)
 
 		g_audioSystem->BeginUpdate();
 
-		// start all pending sounds we accumulated during sound pause
+		const Vector3D listenerPos = g_audioSystem->GetListenerPosition();
+
 		{
+			// game threads are only sending commands, so lock is only contended by objects removal
 			CScopedMutex m(s_soundEmitterSystemMutex);
 
-			for (int i = 0; i < m_pendingStartSounds.numElem(); i++)
-			{
-				PendingSound& pending = m_pendingStartSounds[i];
-				EmitSoundInternal(&pending.params, pending.objUniqueId, pending.soundingObj);
-			}
+			// start sounds and apply changes sent since last update
+			m_numCommands = 0;
+			ExecuteCommands();
 
-			m_pendingStartSounds.clear();
+			UpdateEmitterVoices(listenerPos);
+			UpdateEmitterNodes();
 		}
 
-		const Vector3D listenerPos = g_audioSystem->GetListenerPosition();
+		g_audioSystem->EndUpdate();
+		m_updateDone.Raise();
+	});
+	g_parallelJobs->Submit();
+}
+
+// updates emitter grid and switches emitters between real and virtual
+void CSoundEmitterSystem::UpdateEmitterVoices(const Vector3D& listenerPos)
+{
+	PROF_EVENT("Sound Emitter System Update Voices");
 
+	CEqTimer timer;
+
+	// stopped real sounds have to be released
+	for (SoundEmitterData* emitter : m_voices.GetVoiceEmitters())
+	{
+		if (!emitter->soundSource || emitter->soundSource->GetState() == IEqAudioSource::STOPPED)
+			emitter->soundingObj->MarkEmittersChanged();
+	}
+
+	for (auto it = m_soundingObjects.begin(); !it.atEnd(); ++it)
+	{
+		CSoundingObject* obj = it.key();
+
+		if (!obj->UpdateEmitters(m_voices))
+			m_soundingObjects.remove(it);
+	}
+
+	m_voiceChangedEmitters.clear();
+	m_voices.AssignVoices(listenerPos, snd_voice_budget.GetInt(), m_voiceChangedEmitters);
+
+	for (SoundEmitterData* emitter : m_voiceChangedEmitters)
+	{
+		if (emitter->voiceDropped)
 		{
-			CScopedMutex m(s_soundEmitterSystemMutex);
-			for (auto it = m_soundingObjects.begin(); !it.atEnd(); ++it)
-			{
-				CSoundingObject* obj = it.key();
+			// will be removed by UpdateEmitters
+			SwitchSourceState(emitter, true);
+			emitter->soundingObj->MarkEmittersChanged();
+			continue;
+		}
 
-				if(!obj->UpdateEmitters(listenerPos))
-					m_soundingObjects.remove(it);
-			}
+		SwitchSourceState(emitter, !emitter->hasVoice);
+	}
+
+	m_voiceUpdateTime = timer.GetTime();
+
+	if (snd_voice_debug.GetBool())
+	{
+		debugoverlay->Text(color_white, "-----EMITTER VOICES-----");
+		debugoverlay->Text(color_white, "  emitters: %d, audible: %d, ranked: %d", m_voices.GetEmitterCount(), m_voices.GetCandidateCount(), m_voices.GetRankedCount());
+		debugoverlay->Text(color_white, "  real: %d (budget %d), virtual: %d", m_voices.GetVoiceCount(), snd_voice_budget.GetInt(), m_voices.GetEmitterCount() - m_voices.GetVoiceCount());
+		debugoverlay->Text(color_white, "  update time: %.3f ms", m_voiceUpdateTime * 1000.0f);
+		debugoverlay->Text(color_white, "  commands: %d, queue full stalls: %d", m_numCommands, m_numCommandStalls);
+	}
+}
+
+// evaluates nodes of emitters which inputs were changed, batched by script
+void CSoundEmitterSystem::UpdateEmitterNodes()
+{
+	PROF_EVENT("Sound Emitter System Update Nodes");
+
+	m_nodeUpdateEmitters.clear();
+
+	for (auto it = m_soundingObjects.begin(); !it.atEnd(); ++it)
+	{
+		CSoundingObject* obj = it.key();
+		for (auto emIt = obj->m_emitters.begin(); !emIt.atEnd(); ++emIt)
+		{
+			SoundEmitterData* emitter = *emIt;
+
+			// virtual emitters will be evaluated when they become audible
+			if (!emitter->soundSource || !Atomic::Exchange(emitter->nodesNeedUpdate, 0))
+				continue;
+
+			m_nodeUpdateEmitters.append(emitter);
 		}
+	}
 
-		g_audioSystem->EndUpdate();
-		m_updateDone.Raise();
+	if (!m_nodeUpdateEmitters.numElem())
+		return;
+
+	quickSort(m_nodeUpdateEmitters, [](SoundEmitterData* a, SoundEmitterData* b) {
+		return (a->script < b->script) ? -1 : ((a->script > b->script) ? 1 : 0);
 	});
-	g_parallelJobs->Submit();
+
+	for (int first = 0; first < m_nodeUpdateEmitters.numElem();)
+	{
+		const SoundScriptDesc* script = m_nodeUpdateEmitters[first]->script;
+
+		int last = first + 1;
+		while (last < m_nodeUpdateEmitters.numElem() && m_nodeUpdateEmitters[last]->script == script)
+			++last;
+
+		SoundNodeProgram::Evaluate(*script, ArrayCRef<SoundEmitterData*>(&m_nodeUpdateEmitters[first], last - first));
+		first = last;
+	}
 }
 
 void CSoundEmitterSystem::OnRemoveSoundingObject(CSoundingObject* obj)
 {
 	CScopedMutex m(s_soundEmitterSystemMutex);
+
+	// commands may still refer to this object
+	ExecuteCommands();
+
 	m_soundingObjects.remove(obj);
+
+	CScopedMutex mo(obj->m_mutex);
+	for (SoundEmitterData* emitter : obj->m_emitters)
+		m_voices.RemoveEmitter(emitter);
+
+	for (SoundEmitterData* del = obj->m_deleteList; del; del = del->delNext)
+		m_voices.RemoveEmitter(del);
 }
 
 //
@@ -673,6 +807,7 @@ bool CSoundEmitterSystem::CreateSoundScript(const KVSection* scriptSection, cons
 	};
 
 	newSound->maxDistance = KV_GetValueFloat(sectionGetOrDefault("maxDistance"), 0, m_defaultMaxDistance);
+	newSound->priority = KV_GetValueFloat(sectionGetOrDefault("priority"), 0, 1.0f);
 	newSound->startLoopTime = KV_GetValueFloat(sectionGetOrDefault("startLoopTime"), 0, 0.0f);
 	newSound->stopLoopTime = KV_GetValueFloat(sectionGetOrDefault("stopLoopTime"), 0, 0.0f);
 	newSound->loop = KV_GetValueBool(sectionGetOrDefault("loop"), 0, false);
@@ -725,6 +860,8 @@ const char* CSoundEmitterSystem::GetScriptName(SoundScriptDesc* desc)
 void CSoundEmitterSystem::RestartEmittersByScript(SoundScriptDesc* script)
 {
 #ifndef _RETAIL
+	CScopedMutex m(s_soundEmitterSystemMutex);
+
 	for (auto it = m_soundingObjects.begin(); !it.atEnd(); ++it)
 	{
 		CSoundingObject* obj = it.key();
@@ -744,4 +881,113 @@ void CSoundEmitterSystem::RestartEmittersByScript(SoundScriptDesc* script)
 		}
 	}
 #endif
-}
\ No newline at end of file
+}
+//----------------------------------------------------------------------------
+
+// city-like scene: static ambient emitters and moving vehicles
+DECLARE_CMD(snd_voice_bench, "Sound emitter voice virtualization benchmark. Arguments: [number of emitters] [number of frames] [voice budget]", 0)
+{
+	const int numEmitters = CMD_ARGC > 0 ? max(1, atoi(CMD_ARGV(0).ToCString())) : 5000;
+	const int numFrames = CMD_ARGC > 1 ? max(1, atoi(CMD_ARGV(1).ToCString())) : 1000;
+	const int voiceBudget = CMD_ARGC > 2 ? atoi(CMD_ARGV(2).ToCString()) : snd_voice_budget.GetInt();
+
+	constexpr const float sceneSize = 1000.0f;
+	constexpr const float frameTime = 1.0f / 60.0f;
+	const int numMoving = numEmitters / 10;
+
+	SoundScriptDesc ambientScript("bench_ambient");
+	ambientScript.maxDistance = 60.0f;
+
+	SoundScriptDesc vehicleScript("bench_vehicle");
+	vehicleScript.maxDistance = 150.0f;
+	vehicleScript.priority = 2.0f;
+
+	Array<SoundEmitterData*> emitters(PP_SL);
+	Array<Vector3D> velocities(PP_SL);
+	emitters.reserve(numEmitters);
+	velocities.reserve(numMoving);
+
+	for (int i = 0; i < numEmitters; ++i)
+	{
+		const bool isVehicle = i < numMoving;
+
+		SoundEmitterData* emitter = PPNew SoundEmitterData();
+		emitter->script = isVehicle ? &vehicleScript : &ambientScript;
+		emitter->epVolume = RandomFloat(0.2f, 1.0f);
+		emitter->nodeParams.referenceDistance = isVehicle ? 10.0f : RandomFloat(2.0f, 8.0f);
+		emitter->virtualParams.set_relative(false);
+		emitter->virtualParams.set_releaseOnStop(false);
+		emitter->virtualParams.set_state(IEqAudioSource::PLAYING);
+		emitter->virtualParams.set_position(Vector3D(RandomFloat(0.0f, sceneSize), 0.0f, RandomFloat(0.0f, sceneSize)));
+		emitters.append(emitter);
+
+		if (isVehicle)
+			velocities.append(Vector3D(RandomFloat(-15.0f, 15.0f), 0.0f, RandomFloat(-15.0f, 15.0f)));
+	}
+
+	CSoundVoiceManager voices;
+	for (SoundEmitterData* emitter : emitters)
+		voices.UpdateEmitter(emitter);
+
+	Array<SoundEmitterData*> changedEmitters(PP_SL);
+
+	CEqTimer timer;
+	double voiceTime = 0.0;
+	double bruteForceTime = 0.0;
+	int64 totalReal = 0;
+	int64 totalAudible = 0;
+	int64 totalRanked = 0;
+	int64 totalChanges = 0;
+	int bruteForceAudible = 0;
+
+	for (int frame = 0; frame < numFrames; ++frame)
+	{
+		// listener drives across the city
+		const float t = (float)frame / numFrames;
+		const Vector3D listenerPos(sceneSize * t, 0.0f, sceneSize * 0.5f + sinf(t * M_PI_2_F * 4.0f) * sceneSize * 0.25f);
+
+		for (int i = 0; i < numMoving; ++i)
+		{
+			IEqAudioSource::Params& virtualParams = emitters[i]->virtualParams;
+			virtualParams.position += velocities[i] * frameTime;
+		}
+
+		timer.GetTime(true);
+		{
+			for (int i = 0; i < numMoving; ++i)
+				voices.UpdateEmitter(emitters[i]);
+
+			changedEmitters.clear();
+			voices.AssignVoices(listenerPos, voiceBudget, changedEmitters);
+		}
+		voiceTime += timer.GetTime();
+
+		totalReal += voices.GetVoiceCount();
+		totalAudible += voices.GetCandidateCount();
+		totalRanked += voices.GetRankedCount();
+		totalChanges += changedEmitters.numElem();
+
+		// distance test of every emitter as it was done before
+		timer.GetTime(true);
+		{
+			bruteForceAudible = 0;
+			for (SoundEmitterData* emitter : emitters)
+			{
+				const float distSqr = lengthSqr(emitter->virtualParams.position - listenerPos);
+				bruteForceAudible += distSqr < M_SQR(emitter->script->maxDistance);
+			}
+		}
+		bruteForceTime += timer.GetTime();
+	}
+
+	MsgInfo("snd_voice_bench: %d emitters (%d moving), %d frames, voice budget %d\n", numEmitters, numMoving, numFrames, voiceBudget);
+	MsgInfo("  real voices: %.1f, virtual: %.1f, audible: %.1f (last frame %d)\n",
+		(double)totalReal / numFrames, numEmitters - (double)totalReal / numFrames, (double)totalAudible / numFrames, bruteForceAudible);
+	MsgInfo("  ranked per frame: %.1f, voice changes per frame: %.2f\n", (double)totalRanked / numFrames, (double)totalChanges / numFrames);
+	MsgInfo("  update: %.3f us per frame, all emitters distance test: %.3f us per frame\n",
+		voiceTime * 1000000.0 / numFrames, bruteForceTime * 1000000.0 / numFrames);
+
+	voices.Clear();
+	for (SoundEmitterData* emitter : emitters)
+		delete emitter;
+}
@@ -8,10 +8,14 @@
 #pragma once
 
 #include "audio/IEqAudioSystem.h"
+#include "ds/mpscqueue.h"
 #include "eqSoundEmitterCommon.h"
+#include "eqSoundVoiceManager.h"
 
 struct SoundScriptDesc;
 struct SoundEmitterData;
+struct SoundCommand;
+struct SoundEmitCommandParams;
 struct KVSection;
 struct ChannelDef;
 class CSoundingObject;
@@ -45,6 +49,12 @@ public:
 	static const char*	GetScriptName(SoundScriptDesc* desc);
 private:
 	int					EmitSoundInternal(EmitParams* emit, int objUniqueId, CSoundingObject* soundingObj);
+	void				StartEmitter(SoundScriptDesc* script, const SoundEmitCommandParams* ep, int objUniqueId, CSoundingObject* soundingObj);
+
+	// commands are sent from any thread and executed on update
+	void				PushCommand(const SoundCommand& cmd);
+	void				ExecuteCommands();
+	void				ExecuteCommand(const SoundCommand& cmd);
 
 	SoundScriptDesc*	FindSoundScript(const char* soundName) const;
 	void				OnRemoveSoundingObject(CSoundingObject* obj);
@@ -53,30 +63,31 @@ private:
 	static int			LoopSourceUpdateCallback(IEqAudioSource* source, IEqAudioSource::Params& params, SoundScriptDesc* script);
 
 	bool				SwitchSourceState(SoundEmitterData* emit, bool isVirtual);
+	void				UpdateEmitterVoices(const Vector3D& listenerPos);
+	void				UpdateEmitterNodes();
 
 	int					ChannelTypeByName(const char* str) const;
 
 	// Editor features
 	void				RestartEmittersByScript(SoundScriptDesc* soundScript);
 
-	struct PendingSound
-	{
-		EmitParams					params;
-		int							objUniqueId;
-		CWeakPtr<CSoundingObject>	soundingObj;
-	};
-
 	Threading::CEqSignal				m_updateDone{ true };
 	CEqTimer							m_updateTimer;
 
 	FixedArray<ChannelDef, CHAN_MAX>	m_channelTypes;
 	Map<int, SoundScriptDesc*>			m_allSounds{ PP_SL };
 	Set<CSoundingObject*>				m_soundingObjects{ PP_SL };
-	Array<PendingSound>					m_pendingStartSounds{ PP_SL };
+	MPSCQueue<SoundCommand>				m_commands;
+	Array<SoundEmitterData*>			m_nodeUpdateEmitters{ PP_SL };
+	Array<SoundEmitterData*>			m_voiceChangedEmitters{ PP_SL };
+	CSoundVoiceManager					m_voices;
 	SoundScriptDesc*					m_isolateSound{ nullptr };
 	
 	float								m_defaultMaxDistance{ 100.0f };
 	float								m_deltaTime{ 0.0f };
+	float								m_voiceUpdateTime{ 0.0f };
+	int									m_numCommands{ 0 };			// commands executed since last update
+	int									m_numCommandStalls{ 0 };	// times command queue was full
 	bool								m_isInit{ false };
 };
 
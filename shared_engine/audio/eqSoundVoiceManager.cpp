@@ -0,0 +1,309 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Sound emitter voice management.
+//				Spatial grid of emitters and voice budget ranked by audibility
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "ds/sort.h"
+
+#include "eqSoundEmitterPrivateTypes.h"
+#include "eqSoundVoiceManager.h"
+
+static constexpr const float VOICE_CELL_SIZE = 64.0f;
+static constexpr const float VOICE_CELL_INV_SIZE = 1.0f / VOICE_CELL_SIZE;
+static constexpr const float VOICE_KEEP_SCALE = 1.25f;		// emitters having voice are preferred to avoid flickering
+static constexpr const float VOICE_BAND_SCALE = 2.0f;		// score range around boundary that gets re-ranked
+
+static float VoiceEmitterScore(const SoundEmitterData* emitter, float distSqr)
+{
+	const float volume = max(emitter->nodeParams.volume.x * emitter->epVolume, 0.0f);
+	const float refDist = max(emitter->nodeParams.referenceDistance * emitter->epRadiusMultiplier, 1.0f);
+
+	// inverse square law past reference distance
+	const float refDistSqr = M_SQR(refDist);
+	float score = volume * emitter->script->priority * refDistSqr / max(distSqr, refDistSqr);
+
+	if (emitter->hasVoice)
+		score *= VOICE_KEEP_SCALE;
+
+	return score;
+}
+
+static int VoiceScoreCompare(SoundEmitterData* const& a, SoundEmitterData* const& b)
+{
+	if (a->voiceScore == b->voiceScore)
+		return 0;
+	return (a->voiceScore > b->voiceScore) ? -1 : 1;
+}
+
+CSoundVoiceManager::CSoundVoiceManager()
+{
+}
+
+void CSoundVoiceManager::Clear()
+{
+	for (auto it = m_cells.begin(); !it.atEnd(); ++it)
+	{
+		for (SoundEmitterData* emitter : it->emitters)
+		{
+			emitter->voiceCell = CELL_NONE;
+			emitter->voiceCellIdx = -1;
+			emitter->hasVoice = false;
+		}
+	}
+
+	for (SoundEmitterData* emitter : m_relativeEmitters)
+	{
+		emitter->voiceCell = CELL_NONE;
+		emitter->voiceCellIdx = -1;
+		emitter->hasVoice = false;
+	}
+
+	m_cells.clear(true);
+	m_relativeEmitters.clear(true);
+	m_voiceEmitters.clear(true);
+	m_selectedEmitters.clear(true);
+	m_sureCandidates.clear(true);
+	m_bandCandidates.clear(true);
+	m_lowCandidates.clear(true);
+
+	m_boundaryScore = 0.0f;
+	m_maxDistance = 0.0f;
+	m_numEmitters = 0;
+	m_numCandidates = 0;
+	m_numRanked = 0;
+}
+
+int CSoundVoiceManager::GetCellKey(const Vector3D& position) const
+{
+	const int x = (int)floorf(position.x * VOICE_CELL_INV_SIZE);
+	const int z = (int)floorf(position.z * VOICE_CELL_INV_SIZE);
+
+	// keep sign bit clear so keys never collide with CELL_NONE and CELL_RELATIVE
+	return ((z & 0x7fff) << 16) | (x & 0xffff);
+}
+
+Array<SoundEmitterData*>* CSoundVoiceManager::GetCellEmitters(int cellKey, bool allocate)
+{
+	if (cellKey == CELL_RELATIVE)
+		return &m_relativeEmitters;
+
+	auto it = m_cells.find(cellKey);
+	if (it.atEnd())
+	{
+		if (!allocate)
+			return nullptr;
+		it = m_cells.insert(cellKey);
+	}
+
+	return &it->emitters;
+}
+
+void CSoundVoiceManager::UpdateEmitter(SoundEmitterData* emitter)
+{
+	const IEqAudioSource::Params& virtualParams = emitter->virtualParams;
+	const int cellKey = virtualParams.relative ? CELL_RELATIVE : GetCellKey(virtualParams.position);
+
+	if (emitter->voiceCell == cellKey)
+		return;
+
+	if (emitter->voiceCell != CELL_NONE)
+		RemoveEmitter(emitter);
+
+	Array<SoundEmitterData*>& cellEmitters = *GetCellEmitters(cellKey, true);
+	emitter->voiceCell = cellKey;
+	emitter->voiceCellIdx = cellEmitters.append(emitter);
+
+	m_maxDistance = max(m_maxDistance, emitter->script->maxDistance);
+	++m_numEmitters;
+}
+
+void CSoundVoiceManager::RemoveEmitter(SoundEmitterData* emitter)
+{
+	if (emitter->hasVoice)
+	{
+		m_voiceEmitters.fastRemove(emitter);
+		emitter->hasVoice = false;
+	}
+
+	if (emitter->voiceCell == CELL_NONE)
+		return;
+
+	Array<SoundEmitterData*>* cellEmitters = GetCellEmitters(emitter->voiceCell, false);
+	ASSERT(cellEmitters && (*cellEmitters)[emitter->voiceCellIdx] == emitter);
+
+	const int idx = emitter->voiceCellIdx;
+	cellEmitters->fastRemoveIndex(idx);
+	if (idx < cellEmitters->numElem())
+		(*cellEmitters)[idx]->voiceCellIdx = idx;
+
+	if (!cellEmitters->numElem() && emitter->voiceCell != CELL_RELATIVE)
+		m_cells.remove(emitter->voiceCell);
+
+	emitter->voiceCell = CELL_NONE;
+	emitter->voiceCellIdx = -1;
+	--m_numEmitters;
+}
+
+void CSoundVoiceManager::AddCandidate(SoundEmitterData* emitter, float score)
+{
+	emitter->voiceScore = score;
+
+	if (m_boundaryScore <= 0.0f)
+		m_bandCandidates.append(emitter);
+	else if (score >= m_boundaryScore * VOICE_BAND_SCALE)
+		m_sureCandidates.append(emitter);
+	else if (score * VOICE_BAND_SCALE >= m_boundaryScore)
+		m_bandCandidates.append(emitter);
+	else
+		m_lowCandidates.append(emitter);
+}
+
+void CSoundVoiceManager::AddCandidates(ArrayCRef<SoundEmitterData*> emitters, const Vector3D& listenerPos)
+{
+	for (SoundEmitterData* emitter : emitters)
+	{
+		const IEqAudioSource::Params& virtualParams = emitter->virtualParams;
+		if (virtualParams.state == IEqAudioSource::STOPPED || emitter->voiceDropped)
+			continue;
+
+		if (virtualParams.relative)
+		{
+			AddCandidate(emitter, VoiceEmitterScore(emitter, 0.0f));
+			continue;
+		}
+
+		const float distSqr = lengthSqr(virtualParams.position - listenerPos);
+		if (distSqr >= M_SQR(emitter->script->maxDistance))
+			continue;
+
+		AddCandidate(emitter, VoiceEmitterScore(emitter, distSqr));
+	}
+}
+
+void CSoundVoiceManager::AssignVoices(const Vector3D& listenerPos, int voiceBudget, Array<SoundEmitterData*>& changedEmitters)
+{
+	PROF_EVENT("Sound Voice Manager Assign");
+
+	++m_frame;
+
+	m_sureCandidates.clear();
+	m_bandCandidates.clear();
+	m_lowCandidates.clear();
+
+	// gather audible emitters from cells around listener
+	AddCandidates(m_relativeEmitters, listenerPos);
+	{
+		const int minX = (int)floorf((listenerPos.x - m_maxDistance) * VOICE_CELL_INV_SIZE);
+		const int maxX = (int)floorf((listenerPos.x + m_maxDistance) * VOICE_CELL_INV_SIZE);
+		const int minZ = (int)floorf((listenerPos.z - m_maxDistance) * VOICE_CELL_INV_SIZE);
+		const int maxZ = (int)floorf((listenerPos.z + m_maxDistance) * VOICE_CELL_INV_SIZE);
+
+		if ((maxX - minX + 1) * (maxZ - minZ + 1) > m_cells.size())
+		{
+			// fewer cells are allocated than listener range covers
+			for (auto it = m_cells.begin(); !it.atEnd(); ++it)
+				AddCandidates(it->emitters, listenerPos);
+		}
+		else
+		{
+			for (int z = minZ; z <= maxZ; ++z)
+			{
+				for (int x = minX; x <= maxX; ++x)
+				{
+					auto it = m_cells.find(((z & 0x7fff) << 16) | (x & 0xffff));
+					if (!it.atEnd())
+						AddCandidates(it->emitters, listenerPos);
+				}
+			}
+		}
+	}
+
+	const int numSure = m_sureCandidates.numElem();
+	const int numBand = m_bandCandidates.numElem();
+	m_numCandidates = numSure + numBand + m_lowCandidates.numElem();
+	m_numRanked = 0;
+
+	// select emitters that are going to have voices
+	Array<SoundEmitterData*>& selected = m_selectedEmitters;
+	selected.clear();
+
+	if (voiceBudget <= 0 || m_numCandidates <= voiceBudget)
+	{
+		selected.append(m_sureCandidates);
+		selected.append(m_bandCandidates);
+		selected.append(m_lowCandidates);
+		m_boundaryScore = 0.0f;
+	}
+	else if (numSure <= voiceBudget && numSure + numBand >= voiceBudget)
+	{
+		// boundary has not moved far, only emitters near it are ranked
+		const int numFromBand = voiceBudget - numSure;
+		quickSort(m_bandCandidates, VoiceScoreCompare);
+
+		selected.append(m_sureCandidates);
+		selected.append(m_bandCandidates.ptr(), numFromBand);
+
+		if (numFromBand > 0)
+			m_boundaryScore = m_bandCandidates[numFromBand - 1]->voiceScore;
+		m_numRanked = numBand;
+	}
+	else
+	{
+		selected.append(m_sureCandidates);
+		selected.append(m_bandCandidates);
+		selected.append(m_lowCandidates);
+
+		quickSort(selected, VoiceScoreCompare);
+		selected.setNum(voiceBudget, false);
+
+		m_boundaryScore = selected.back()->voiceScore;
+		m_numRanked = m_numCandidates;
+	}
+
+	for (SoundEmitterData* emitter : selected)
+		emitter->voiceFrame = m_frame;
+
+	// release on stop emitters are not going to wait for voice
+	auto dropRejected = [this, &changedEmitters](ArrayCRef<SoundEmitterData*> candidates) {
+		for (SoundEmitterData* emitter : candidates)
+		{
+			if (emitter->voiceFrame == m_frame || emitter->hasVoice || !emitter->virtualParams.releaseOnStop)
+				continue;
+
+			emitter->voiceDropped = true;
+			changedEmitters.append(emitter);
+		}
+	};
+
+	if (selected.numElem() < m_numCandidates)
+	{
+		dropRejected(m_bandCandidates);
+		dropRejected(m_lowCandidates);
+	}
+
+	// emitters which weren't selected lose their voices
+	for (SoundEmitterData* emitter : m_voiceEmitters)
+	{
+		if (emitter->voiceFrame == m_frame)
+			continue;
+
+		emitter->hasVoice = false;
+		emitter->voiceDropped = emitter->virtualParams.releaseOnStop;
+		changedEmitters.append(emitter);
+	}
+
+	for (SoundEmitterData* emitter : selected)
+	{
+		if (emitter->hasVoice)
+			continue;
+
+		emitter->hasVoice = true;
+		changedEmitters.append(emitter);
+	}
+
+	m_voiceEmitters.swap(selected);
+}
@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Sound emitter voice management.
+//				Spatial grid of emitters and voice budget ranked by audibility
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+struct SoundEmitterData;
+
+// Keeps emitters in sparse XZ grid so only ones near the listener are visited.
+// Ranks audible emitters and gives hardware voices to the best ones.
+// Must be only accessed under sound emitter system lock.
+class CSoundVoiceManager
+{
+public:
+	static constexpr const int		CELL_NONE = -1;
+	static constexpr const int		CELL_RELATIVE = -2;		// listener-relative (2D) emitters
+
+	CSoundVoiceManager();
+
+	void		Clear();
+
+	// registers emitter or moves it to different cell by it's position
+	void		UpdateEmitter(SoundEmitterData* emitter);
+	void		RemoveEmitter(SoundEmitterData* emitter);
+
+	// ranks emitters around listener and assigns voices to voiceBudget best of them (0 = no limit)
+	// emitters that has gained or lost voice are added to changedEmitters
+	void		AssignVoices(const Vector3D& listenerPos, int voiceBudget, Array<SoundEmitterData*>& changedEmitters);
+
+	ArrayCRef<SoundEmitterData*>	GetVoiceEmitters() const { return m_voiceEmitters; }
+
+	int			GetEmitterCount() const { return m_numEmitters; }
+	int			GetVoiceCount() const { return m_voiceEmitters.numElem(); }
+	int			GetCandidateCount() const { return m_numCandidates; }
+	int			GetRankedCount() const { return m_numRanked; }
+
+private:
+	struct VoiceCell
+	{
+		Array<SoundEmitterData*>	emitters{ PP_SL };
+	};
+
+	int			GetCellKey(const Vector3D& position) const;
+	Array<SoundEmitterData*>* GetCellEmitters(int cellKey, bool allocate);
+
+	void		AddCandidates(ArrayCRef<SoundEmitterData*> emitters, const Vector3D& listenerPos);
+	void		AddCandidate(SoundEmitterData* emitter, float score);
+
+	Map<int, VoiceCell>			m_cells{ PP_SL };
+	Array<SoundEmitterData*>	m_relativeEmitters{ PP_SL };
+
+	Array<SoundEmitterData*>	m_voiceEmitters{ PP_SL };	// emitters having voices
+	Array<SoundEmitterData*>	m_selectedEmitters{ PP_SL };
+	Array<SoundEmitterData*>	m_sureCandidates{ PP_SL };	// candidates well above audibility boundary
+	Array<SoundEmitterData*>	m_bandCandidates{ PP_SL };	// candidates near audibility boundary
+	Array<SoundEmitterData*>	m_lowCandidates{ PP_SL };	// candidates well below boundary
+
+	float		m_boundaryScore{ 0.0f };	// score of least audible emitter having voice when budget was exceeded
+	float		m_maxDistance{ 0.0f };		// largest script distance of registered emitters
+	uint		m_frame{ 0 };
+	int			m_numEmitters{ 0 };
+	int			m_numCandidates{ 0 };
+	int			m_numRanked{ 0 };
+};
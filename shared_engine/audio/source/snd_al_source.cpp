@@ -24,8 +24,7 @@ CSoundSource_OpenALCache::CSoundSource_OpenALCache(ISoundSource* source)
 	}
 	else if (_Es(source->GetFilename()).Path_Extract_Ext() == "ogg")
 	{
-		CSoundSource_OggCache* ogg = (CSoundSource_OggCache*)source;
-		InitOgg(ogg);
+		InitOgg(source);
 	}
 }
 
@@ -61,7 +60,7 @@ void CSoundSource_OpenALCache::InitWav(CSoundSource_WaveCache* wav)
 	}
 }
 
-void CSoundSource_OpenALCache::InitOgg(CSoundSource_OggCache* ogg)
+void CSoundSource_OpenALCache::InitOgg(ISoundSource* ogg)
 {
 	alGenBuffers(1, &m_alBuffer);
 
@@ -77,7 +76,21 @@ void CSoundSource_OpenALCache::InitOgg(CSoundSource_OggCache* ogg)
 	else
 		alFormat = AL_FORMAT_MONO16;
 
-	alBufferData(m_alBuffer, alFormat, ogg->m_dataCache, ogg->m_cacheSize, m_format.frequency);
+	int dataSize = 0;
+	void* data = ogg->GetDataPtr(dataSize);
+
+	// compressed sample has to be decoded for buffer
+	Array<short> decoded(PP_SL);
+	if (!data)
+	{
+		decoded.setNum(ogg->GetSampleCount() * m_format.channels);
+		ogg->GetSamples(decoded.ptr(), ogg->GetSampleCount(), 0, false);
+
+		data = decoded.ptr();
+		dataSize = decoded.numElem() * sizeof(short);
+	}
+
+	alBufferData(m_alBuffer, alFormat, data, dataSize, m_format.frequency);
 }
 
 void CSoundSource_OpenALCache::Unload()
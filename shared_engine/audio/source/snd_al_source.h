@@ -10,7 +10,6 @@
 #include "snd_source.h"
 
 class CSoundSource_WaveCache;
-class CSoundSource_OggCache;
 
 class CSoundSource_OpenALCache : public ISoundSource
 {
@@ -31,7 +30,7 @@ public:
 
 private:
 	void					InitWav(CSoundSource_WaveCache* wav);
-	void					InitOgg(CSoundSource_OggCache* ogg);
+	void					InitOgg(ISoundSource* ogg);
 
 	virtual bool			Load();
 	virtual void			Unload();
@@ -0,0 +1,654 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Ogg Vorbis source kept compressed in memory.
+//				PCM is decoded by fixed size chunks into shared pool on demand
+//////////////////////////////////////////////////////////////////////////////////
+
+#include <minivorbis.h>
+#include "core/core_common.h"
+#include "core/ConCommand.h"
+#include "core/ConVar.h"
+#include "core/IFileSystem.h"
+#include "ds/MemoryStream.h"
+#include "snd_ogg_chunked.h"
+
+using namespace Threading;
+
+DECLARE_CVAR(snd_ogg_chunk_pool, "16", "Memory for decoded chunks of compressed Ogg samples in megabytes", CV_ARCHIVE);
+
+static constexpr const int OGG_CHUNK_DECODERS = 4;
+
+struct OggChunkDecoder
+{
+	CEqMutex						mutex;				// held while decoding, other threads wait on it
+	const CSoundSource_OggChunked*	owner{ nullptr };	// assigned under pool lock
+	const CSoundSource_OggChunked*	openedFor{ nullptr };
+	OggVorbis_File					file;
+	CMemoryStream					stream{ PP_SL };
+	int								position{ 0 };		// sample position of next decoded sample
+	uint							lastUse{ 0 };
+	bool							busy{ false };
+
+	void	Close();
+};
+
+void OggChunkDecoder::Close()
+{
+	if (!openedFor)
+		return;
+
+	ov_clear(&file);
+	stream.Close();
+	openedFor = nullptr;
+}
+
+// Decoded chunks of all compressed samples with least recently used ones evicted.
+// Also holds few open decoders since they are too heavy to keep one per sample.
+class CSoundChunkPool
+{
+public:
+	~CSoundChunkPool();
+
+	// returns decoded chunk, valid until pool lock is released.
+	// Lock is released while chunk is decoded so other sources can be read meanwhile
+	const short*		GetChunk(const CSoundSource_OggChunked* source, int chunkIdx);
+
+	void				AddSource(const CSoundSource_OggChunked* source);
+	void				RemoveSource(const CSoundSource_OggChunked* source);
+
+	void				PrintStats() const;
+
+	CEqMutex			m_mutex;
+
+private:
+	struct Slot
+	{
+		const CSoundSource_OggChunked*	owner{ nullptr };
+		int								chunkIdx{ -1 };
+		int								decoder{ -1 };		// decoder which is filling the slot
+		int								prev{ -1 };
+		int								next{ -1 };
+		Array<short>					pcm{ PP_SL };
+	};
+
+	int					AcquireDecoder(const CSoundSource_OggChunked* source);
+	void				WaitForDecoder(int decoderIdx);
+
+	int					AllocSlot(int numValues);
+	void				ReleaseSlot(int slotIdx);
+	void				LinkFront(int slotIdx);
+	void				Unlink(int slotIdx);
+
+	OggChunkDecoder		m_decoders[OGG_CHUNK_DECODERS];
+
+	Array<Slot>			m_slots{ PP_SL };
+	Array<int>			m_freeSlots{ PP_SL };
+	int					m_head{ -1 };		// most recently used
+	int					m_tail{ -1 };		// least recently used
+
+	int64				m_allocatedBytes{ 0 };
+	int64				m_compressedBytes{ 0 };
+	int64				m_decodedBytes{ 0 };	// memory it would take with full decode
+	int					m_numSources{ 0 };
+
+	uint				m_useCounter{ 0 };
+	int64				m_hits{ 0 };
+	int64				m_misses{ 0 };
+	int64				m_decoderOpens{ 0 };
+	double				m_decodeTime{ 0.0 };
+};
+
+static CSoundChunkPool s_oggChunkPool;
+
+DECLARE_CMD(snd_ogg_chunk_stats, "Prints memory and decoding statistics of compressed Ogg samples", 0)
+{
+	s_oggChunkPool.PrintStats();
+}
+
+CSoundChunkPool::~CSoundChunkPool()
+{
+	for (OggChunkDecoder& decoder : m_decoders)
+		decoder.Close();
+}
+
+void CSoundChunkPool::AddSource(const CSoundSource_OggChunked* source)
+{
+	const ISoundSource::Format& fmt = source->GetFormat();
+
+	++m_numSources;
+	m_compressedBytes += source->GetCompressedSize();
+	m_decodedBytes += (int64)source->GetSampleCount() * fmt.channels * sizeof(short);
+}
+
+void CSoundChunkPool::RemoveSource(const CSoundSource_OggChunked* source)
+{
+	const ISoundSource::Format& fmt = source->GetFormat();
+
+	--m_numSources;
+	m_compressedBytes -= source->GetCompressedSize();
+	m_decodedBytes -= (int64)source->GetSampleCount() * fmt.channels * sizeof(short);
+
+	for (int i = 0; i < source->m_chunkSlots.numElem(); ++i)
+	{
+		const int slotIdx = source->m_chunkSlots[i];
+		if (slotIdx == -1)
+			continue;
+
+		ASSERT_MSG(m_slots[slotIdx].decoder == -1, "Ogg sample is unloaded while it's chunk is decoded");
+		Unlink(slotIdx);
+		ReleaseSlot(slotIdx);
+	}
+
+	for (OggChunkDecoder& decoder : m_decoders)
+	{
+		if (decoder.owner != source)
+			continue;
+
+		ASSERT(!decoder.busy);
+		decoder.Close();
+		decoder.owner = nullptr;
+	}
+}
+
+void CSoundChunkPool::LinkFront(int slotIdx)
+{
+	Slot& slot = m_slots[slotIdx];
+	slot.prev = -1;
+	slot.next = m_head;
+
+	if (m_head != -1)
+		m_slots[m_head].prev = slotIdx;
+	m_head = slotIdx;
+
+	if (m_tail == -1)
+		m_tail = slotIdx;
+}
+
+void CSoundChunkPool::Unlink(int slotIdx)
+{
+	Slot& slot = m_slots[slotIdx];
+
+	if (slot.prev != -1)
+		m_slots[slot.prev].next = slot.next;
+	else
+		m_head = slot.next;
+
+	if (slot.next != -1)
+		m_slots[slot.next].prev = slot.prev;
+	else
+		m_tail = slot.prev;
+
+	slot.prev = -1;
+	slot.next = -1;
+}
+
+// slot is detached from it's chunk, buffer is kept for reuse
+void CSoundChunkPool::ReleaseSlot(int slotIdx)
+{
+	Slot& slot = m_slots[slotIdx];
+	if (slot.owner)
+		slot.owner->m_chunkSlots[slot.chunkIdx] = -1;
+
+	slot.owner = nullptr;
+	slot.chunkIdx = -1;
+	m_freeSlots.append(slotIdx);
+}
+
+int CSoundChunkPool::AllocSlot(int numValues)
+{
+	const int64 budget = (int64)(max(snd_ogg_chunk_pool.GetFloat(), 0.0f) * 1024 * 1024);
+	const int64 requiredBytes = numValues * sizeof(short);
+
+	for (;;)
+	{
+		// buffer of the same size is best to take
+		int freeBufferIdx = -1;
+		for (int i = 0; i < m_freeSlots.numElem(); ++i)
+		{
+			const int slotIdx = m_freeSlots[i];
+			const int numSlotValues = m_slots[slotIdx].pcm.numElem();
+			if (numSlotValues == numValues)
+			{
+				m_freeSlots.fastRemoveIndex(i);
+				return slotIdx;
+			}
+
+			if (numSlotValues > 0)
+				freeBufferIdx = i;
+		}
+
+		if (m_allocatedBytes + requiredBytes <= budget)
+			break;
+
+		if (freeBufferIdx != -1)
+		{
+			// drop unused buffer of different size
+			Slot& freeSlot = m_slots[m_freeSlots[freeBufferIdx]];
+			m_allocatedBytes -= freeSlot.pcm.numElem() * sizeof(short);
+			freeSlot.pcm.clear(true);
+			continue;
+		}
+
+		// at least one chunk must always fit
+		if (m_tail == -1)
+			break;
+
+		// evict least recently used chunk
+		const int slotIdx = m_tail;
+		Unlink(slotIdx);
+		ReleaseSlot(slotIdx);
+	}
+
+	int slotIdx;
+	if (m_freeSlots.numElem())
+	{
+		slotIdx = m_freeSlots.popBack();
+		m_allocatedBytes -= m_slots[slotIdx].pcm.numElem() * sizeof(short);
+	}
+	else
+	{
+		slotIdx = m_slots.numElem();
+		m_slots.append();
+	}
+
+	m_slots[slotIdx].pcm.setNum(numValues);
+	m_allocatedBytes += requiredBytes;
+
+	return slotIdx;
+}
+
+const short* CSoundChunkPool::GetChunk(const CSoundSource_OggChunked* source, int chunkIdx)
+{
+	int decoderIdx;
+	for (;;)
+	{
+		const int slotIdx = source->m_chunkSlots[chunkIdx];
+		if (slotIdx != -1)
+		{
+			const int slotDecoderIdx = m_slots[slotIdx].decoder;
+			if (slotDecoderIdx == -1)
+			{
+				++m_hits;
+				Unlink(slotIdx);
+				LinkFront(slotIdx);
+				return m_slots[slotIdx].pcm.ptr();
+			}
+
+			// same chunk is being decoded by another thread
+			WaitForDecoder(slotDecoderIdx);
+			continue;
+		}
+
+		decoderIdx = AcquireDecoder(source);
+		if (decoderIdx >= 0)
+			break;
+
+		// all decoders are busy, wait for the one which started first
+		WaitForDecoder(-decoderIdx - 1);
+	}
+
+	PROF_EVENT("Ogg Chunk Decode");
+
+	++m_misses;
+
+	// slot is reserved for the chunk but not linked, so it can't be evicted while decoded
+	const int slotIdx = AllocSlot(CSoundSource_OggChunked::CHUNK_SAMPLES * source->GetFormat().channels);
+	{
+		Slot& slot = m_slots[slotIdx];
+		slot.owner = source;
+		slot.chunkIdx = chunkIdx;
+		slot.decoder = decoderIdx;
+	}
+	source->m_chunkSlots[chunkIdx] = slotIdx;
+
+	OggChunkDecoder& decoder = m_decoders[decoderIdx];
+	short* pcm = m_slots[slotIdx].pcm.ptr();
+
+	m_mutex.Unlock();
+
+	CEqTimer timer;
+	const bool decoded = source->DecodeChunk(decoder, chunkIdx, pcm);
+	const double decodeTime = timer.GetTime();
+
+	// waiting threads are let through once slot state is updated
+	m_mutex.Lock();
+	decoder.mutex.Unlock();
+	decoder.busy = false;
+
+	m_decodeTime += decodeTime;
+	m_slots[slotIdx].decoder = -1;
+
+	if (!decoded)
+	{
+		ReleaseSlot(slotIdx);
+		return nullptr;
+	}
+
+	LinkFront(slotIdx);
+
+	return m_slots[slotIdx].pcm.ptr();
+}
+
+// Assigns free decoder to source and locks it. Pool lock must be held.
+// Returns decoder index, or -(index + 1) of busy decoder to wait for
+int CSoundChunkPool::AcquireDecoder(const CSoundSource_OggChunked* source)
+{
+	int bestIdx = -1;
+	int oldestBusyIdx = 0;
+	for (int i = 0; i < OGG_CHUNK_DECODERS; ++i)
+	{
+		const OggChunkDecoder& decoder = m_decoders[i];
+		if (decoder.busy)
+		{
+			if (decoder.lastUse < m_decoders[oldestBusyIdx].lastUse || !m_decoders[oldestBusyIdx].busy)
+				oldestBusyIdx = i;
+			continue;
+		}
+
+		if (decoder.owner == source)
+		{
+			bestIdx = i;
+			break;
+		}
+
+		if (bestIdx == -1 || m_decoders[bestIdx].owner && (!decoder.owner || decoder.lastUse < m_decoders[bestIdx].lastUse))
+			bestIdx = i;
+	}
+
+	if (bestIdx == -1)
+		return -oldestBusyIdx - 1;
+
+	OggChunkDecoder& decoder = m_decoders[bestIdx];
+	if (decoder.owner != source)
+	{
+		++m_decoderOpens;
+		decoder.owner = source;
+	}
+
+	decoder.busy = true;
+	decoder.lastUse = ++m_useCounter;
+
+	// decoder is not busy so only threads waiting for it can hold the lock, and only briefly
+	decoder.mutex.Lock();
+
+	return bestIdx;
+}
+
+void CSoundChunkPool::WaitForDecoder(int decoderIdx)
+{
+	CEqMutex& decoderMutex = m_decoders[decoderIdx].mutex;
+
+	m_mutex.Unlock();
+	decoderMutex.Lock();
+	decoderMutex.Unlock();
+	m_mutex.Lock();
+}
+
+void CSoundChunkPool::PrintStats() const
+{
+	CScopedMutex m(*const_cast<CEqMutex*>(&m_mutex));
+
+	const int64 numDecodes = max(m_misses, (int64)1);
+
+	MsgInfo("Compressed Ogg samples: %d, %.2f MB in memory, %.2f MB if fully decoded\n",
+		m_numSources, m_compressedBytes / (1024.0 * 1024.0), m_decodedBytes / (1024.0 * 1024.0));
+	MsgInfo("  chunk pool: %.2f of %.2f MB, %d slots\n",
+		m_allocatedBytes / (1024.0 * 1024.0), snd_ogg_chunk_pool.GetFloat(), m_slots.numElem());
+	MsgInfo("  chunk hits: %lld, decodes: %lld (%.1f%% hit rate), decoder opens: %lld\n",
+		m_hits, m_misses, m_hits * 100.0 / max(m_hits + m_misses, (int64)1), m_decoderOpens);
+	MsgInfo("  decode time: %.2f ms total, %.1f us per chunk of %d samples\n",
+		m_decodeTime * 1000.0, m_decodeTime * 1000000.0 / numDecodes, CSoundSource_OggChunked::CHUNK_SAMPLES);
+}
+
+//---------------------------------------------------------------------
+
+bool CSoundSource_OggChunked::Load()
+{
+	// Open for binary reading
+	IFilePtr pFile = g_fileSystem->Open(GetFilename(), "rb");
+	if(!pFile)
+		return false;
+
+	m_oggData.setNum(pFile->GetSize());
+	if (pFile->Read(m_oggData.ptr(), 1, m_oggData.numElem()) != m_oggData.numElem())
+	{
+		m_oggData.clear(true);
+		return false;
+	}
+
+	CMemoryStream stream(m_oggData.ptr(), VS_OPEN_READ, m_oggData.numElem(), PP_SL);
+	OggVorbis_File oggFile;
+
+	int ovResult = ov_open_callbacks(&stream, &oggFile, nullptr, 0, eqVorbisFile::callbacks);
+
+	if(ovResult < 0)
+	{
+		m_oggData.clear(true);
+
+		MsgError("Failed to load sound '%s', because it is not a valid Ogg file (%d)\n", GetFilename(), ovResult);
+		return false;
+	}
+
+	vorbis_info* info = ov_info(&oggFile, -1);
+	ParseFormat(*info);
+
+	ParseData(&oggFile);
+
+	// chained streams can't use seek table
+	if (ov_streams(&oggFile) == 1)
+		BuildSeekTable();
+
+	ov_clear( &oggFile );
+
+	{
+		CScopedMutex m(s_oggChunkPool.m_mutex);
+		s_oggChunkPool.AddSource(this);
+	}
+
+	return m_numSamples > 0;
+}
+
+void CSoundSource_OggChunked::Unload()
+{
+	if (m_oggData.numElem())
+	{
+		CScopedMutex m(s_oggChunkPool.m_mutex);
+		s_oggChunkPool.RemoveSource(this);
+	}
+
+	m_oggData.clear(true);
+	m_seekTable.clear(true);
+	m_chunkSlots.clear(true);
+	m_numSamples = 0;
+}
+
+void CSoundSource_OggChunked::ParseData(OggVorbis_File* file)
+{
+	m_numSamples = (uint)ov_pcm_total(file, -1);
+
+	const int numChunks = (m_numSamples + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES;
+	m_chunkSlots.setNum(numChunks);
+	for (int i = 0; i < numChunks; ++i)
+		m_chunkSlots[i] = -1;
+}
+
+// finds pages from which each chunk can be decoded without bisection search
+void CSoundSource_OggChunked::BuildSeekTable()
+{
+	const int numChunks = m_chunkSlots.numElem();
+	m_seekTable.setNum(numChunks);
+	for (int i = 0; i < numChunks; ++i)
+		m_seekTable[i] = -1;
+
+	ogg_sync_state sync;
+	ogg_sync_init(&sync);
+
+	const int dataSize = m_oggData.numElem();
+	int readPos = 0;
+	int pageOffset = 0;
+	int prevPageOffset = -1;		// last audio page which ends before chunk start
+	int nextChunk = 0;
+
+	ogg_page page;
+	while (nextChunk < numChunks)
+	{
+		const long pageSize = ogg_sync_pageseek(&sync, &page);
+		if (pageSize == 0)
+		{
+			if (readPos >= dataSize)
+				break;
+
+			const int numBytes = min(4096, dataSize - readPos);
+			char* buffer = ogg_sync_buffer(&sync, numBytes);
+			memcpy(buffer, m_oggData.ptr() + readPos, numBytes);
+			ogg_sync_wrote(&sync, numBytes);
+			readPos += numBytes;
+			continue;
+		}
+
+		if (pageSize < 0)
+		{
+			// skipped garbage
+			pageOffset -= pageSize;
+			continue;
+		}
+
+		// headers have zero granule position and pages without finished packets have -1
+		const int64 granulePos = ogg_page_granulepos(&page);
+		if (granulePos > 0)
+		{
+			while (nextChunk < numChunks && (int64)nextChunk * CHUNK_SAMPLES < granulePos)
+				m_seekTable[nextChunk++] = prevPageOffset;
+
+			prevPageOffset = pageOffset;
+		}
+
+		pageOffset += pageSize;
+	}
+
+	ogg_sync_clear(&sync);
+}
+
+bool CSoundSource_OggChunked::DecodeChunk(OggChunkDecoder& decoder, int chunkIdx, short* out) const
+{
+	// decoder could have been used by another sample
+	if (decoder.openedFor != this)
+	{
+		decoder.Close();
+
+		ubyte* data = const_cast<ubyte*>(m_oggData.ptr());
+		decoder.stream.Open(data, VS_OPEN_READ, m_oggData.numElem());
+
+		if (ov_open_callbacks(&decoder.stream, &decoder.file, nullptr, 0, eqVorbisFile::callbacks) < 0)
+		{
+			decoder.stream.Close();
+			return false;
+		}
+
+		decoder.openedFor = this;
+		decoder.position = 0;
+	}
+
+	OggVorbis_File* file = &decoder.file;
+
+	const int sampleSize = m_format.channels * sizeof(short);
+	const int chunkStart = chunkIdx * CHUNK_SAMPLES;
+	const int numSamples = min(CHUNK_SAMPLES, m_numSamples - chunkStart);
+
+	// sequential playback doesn't need seeking
+	if (decoder.position != chunkStart)
+	{
+		bool seeked = false;
+
+		const int pageOffset = m_seekTable.numElem() ? m_seekTable[chunkIdx] : -1;
+		if (pageOffset >= 0 && ov_raw_seek(file, pageOffset) == 0)
+		{
+			const int64 pcmPos = ov_pcm_tell(file);
+			seeked = pcmPos >= 0 && pcmPos <= chunkStart;
+		}
+
+		if (!seeked && ov_pcm_seek(file, chunkStart) != 0)
+		{
+			decoder.position = -1;
+			return false;
+		}
+
+		// decode up to chunk start into output as scratch
+		int position = (int)ov_pcm_tell(file);
+		while (position < chunkStart)
+		{
+			const int numToSkip = min(chunkStart - position, CHUNK_SAMPLES);
+			const int readBytes = ov_read(file, (char*)out, numToSkip * sampleSize, 0, 2, 1, nullptr);
+			if (readBytes <= 0)
+				break;
+
+			position += readBytes / sampleSize;
+		}
+		decoder.position = position;
+
+		if (position != chunkStart)
+		{
+			decoder.position = -1;
+			return false;
+		}
+	}
+
+	const int numBytes = numSamples * sampleSize;
+	int totalBytes = 0;
+	while (totalBytes < numBytes)
+	{
+		const int readBytes = ov_read(file, (char*)out + totalBytes, numBytes - totalBytes, 0, 2, 1, nullptr);
+		if (readBytes <= 0)
+			break;
+
+		totalBytes += readBytes;
+	}
+
+	decoder.position = chunkStart + totalBytes / sampleSize;
+
+	// keep the rest silent if stream ended early
+	memset((ubyte*)out + totalBytes, 0, CHUNK_SAMPLES * sampleSize - totalBytes);
+
+	return true;
+}
+
+int CSoundSource_OggChunked::GetSamples(void* out, int samplesToRead, int startOffset, bool loop) const
+{
+	const int sampleSize = m_format.channels * (m_format.bitwidth >> 3);
+
+	const int minSample = 0;
+	const int maxSample = m_numSamples;
+
+	CScopedMutex m(s_oggChunkPool.m_mutex);
+
+	int currentOffset = startOffset;
+	int numSamplesRead = 0;
+	int remainingSamples = samplesToRead;
+	while (remainingSamples > 0)
+	{
+		if (currentOffset >= maxSample)
+		{
+			if (!loop)
+				break;
+			currentOffset = minSample;
+		}
+
+		const int chunkIdx = currentOffset / CHUNK_SAMPLES;
+		const int chunkOffset = currentOffset - chunkIdx * CHUNK_SAMPLES;
+		const int numToRead = min(remainingSamples, min(CHUNK_SAMPLES - chunkOffset, maxSample - currentOffset));
+
+		const short* chunk = s_oggChunkPool.GetChunk(this, chunkIdx);
+		if (!chunk)
+			break;
+
+		memcpy((ubyte*)out + numSamplesRead * sampleSize, (const ubyte*)chunk + chunkOffset * sampleSize, numToRead * sampleSize);
+
+		numSamplesRead += numToRead;
+		currentOffset += numToRead;
+		remainingSamples -= numToRead;
+	}
+
+	return numSamplesRead;
+}
@@ -0,0 +1,41 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Ogg Vorbis source kept compressed in memory.
+//				PCM is decoded by fixed size chunks into shared pool on demand
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "snd_ogg_source.h"
+
+struct OggChunkDecoder;
+
+class CSoundSource_OggChunked : public CSoundSource_Ogg
+{
+	friend class CSoundChunkPool;
+public:
+	static constexpr const int CHUNK_SAMPLES = 8192;
+
+	int				GetSamples(void* out, int samplesToRead, int startOffset, bool loop) const;
+	void*			GetDataPtr(int& dataSize) const { dataSize = 0; return nullptr; }
+
+	bool			Load();
+	void			Unload();
+
+	// data is in memory and can be accessed randomly
+	bool			IsStreaming() const { return false; }
+
+	int				GetCompressedSize() const { return m_oggData.numElem(); }
+
+protected:
+	void			ParseData(OggVorbis_File* file);
+	void			BuildSeekTable();
+
+	// decodes chunk samples, out must hold CHUNK_SAMPLES samples. Decoder must be locked
+	virtual bool	DecodeChunk(OggChunkDecoder& decoder, int chunkIdx, short* out) const;
+
+	Array<ubyte>		m_oggData{ PP_SL };			// compressed file contents
+	Array<int>			m_seekTable{ PP_SL };		// offset of page to start decoding each chunk from, -1 if unknown
+	mutable Array<int>	m_chunkSlots{ PP_SL };		// pool slot of each decoded chunk, -1 if not decoded
+};
@@ -85,13 +85,17 @@ int CSoundSource_OggStream::GetSamples(void* out, int samplesToRead, int startOf
 int CSoundSource_OggStream::ReadData(void* out, int offset, int count) const
 {
 	const int sampleSize = m_format.channels * (m_format.bitwidth >> 3);
-	ov_pcm_seek(const_cast<OggVorbis_File*>(&m_oggStream), offset / sampleSize);
+	OggVorbis_File* oggStream = const_cast<OggVorbis_File*>(&m_oggStream);
+
+	// sequential reads don't need to seek which is bisection over file pages
+	if (ov_pcm_tell(oggStream) != offset / sampleSize)
+		ov_pcm_seek(oggStream, offset / sampleSize);
 
 	int totalBytes = 0;
 	while(totalBytes < count)
 	{
 		char* dest = ((char*)out) + totalBytes;
-		const int readBytes = ov_read(const_cast<OggVorbis_File*>(&m_oggStream), dest, count - totalBytes, 0, 2, 1, nullptr);
+		const int readBytes = ov_read(oggStream, dest, count - totalBytes, 0, 2, 1, nullptr);
 
 		if (readBytes <= 0)
 			break;
@@ -7,6 +7,7 @@
 
 #include <minivorbis.h>
 #include "core/core_common.h"
+#include "core/ConVar.h"
 #include "core/IFileSystem.h"
 #include "snd_source.h"
 
@@ -16,9 +17,12 @@
 #include "snd_wav_stream.h"
 #include "snd_ogg_cache.h"
 #include "snd_ogg_stream.h"
+#include "snd_ogg_chunked.h"
 
 #define STREAM_THRESHOLD    (1024 * 1024)     // 1mb
 
+DECLARE_CVAR(snd_ogg_compressed, "0", "Keep Ogg samples compressed in memory and decode them on demand", CV_ARCHIVE);
+
 //-----------------------------------------------------------------
 
 ISoundSourcePtr ISoundSource::CreateSound( const char* szFilename )
@@ -42,6 +46,8 @@ ISoundSourcePtr ISoundSource::CreateSound( const char* szFilename )
 
 		if ( filelen > STREAM_THRESHOLD )
 			pSource = ISoundSourcePtr(CRefPtr_new( CSoundSource_OggStream));
+		else if (snd_ogg_compressed.GetBool())
+			pSource = ISoundSourcePtr(CRefPtr_new(CSoundSource_OggChunked));
 		else
 			pSource = ISoundSourcePtr(CRefPtr_new(CSoundSource_OggCache));
 	}
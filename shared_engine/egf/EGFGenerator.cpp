@@ -556,8 +556,7 @@ void CEGFGenerator::ParseLods(const KVSection* pSection)
 
 	// always add first default lod
 	studioLodParams_t lod;
-	lod.distance = 0.0f;
-	lod.flags = 0;
+	memset(&lod, 0, sizeof(lod));
 	m_lodparams.append(lod);
 
 	for(int i = 0; i < pSection->keys.numElem(); i++)
@@ -580,8 +579,9 @@ void CEGFGenerator::ParseLods(const KVSection* pSection)
 		const int lodIdx = m_lodparams.numElem();
 
 		studioLodParams_t& newlod = m_lodparams.append();
+		memset(&newlod, 0, sizeof(newlod));
 		newlod.distance = lodDist;
-		newlod.flags = 0;
+		newlod.animUpdateInterval = clamp(KV_GetValueInt(lodKey->FindSection("animUpdateInterval"), 0, 0), 0, 255);
 
 		const char* lodFlagStr = KV_GetValueString(lodKey, 1, nullptr);
 		if (lodFlagStr && !stricmp(lodFlagStr, "manual"))
@@ -1299,6 +1299,12 @@ bool CEGFGenerator::InitFromKeyValues(const KVSection* mainsection)
 		return false;
 	}
 
+	// legacy triangle strip output
+	m_triStrips = KV_GetValueBool(mainsection->FindSection("tristrips"));
+
+	// compact vertex layout, unpacked by loader. See STUDIO_FLAG_PACKED_VERTS for trade-off
+	m_packedVerts = KV_GetValueBool(mainsection->FindSection("packedvertices"));
+
 	// try load models
 	if( !ParseModels( mainsection ) )
 		return false;
@@ -103,6 +103,7 @@ protected:
 	void					WriteMaterialPaths(studioHdr_t* header, IVirtualStream* stream);
 	void					WriteMotionPackageList(studioHdr_t* header, IVirtualStream* stream);
 	void					WriteBones(studioHdr_t* header, IVirtualStream* stream);
+	void					WriteBoneLodMasks(studioHdr_t* header);
 
 	void					Validate(studioHdr_t* header, const char* stage);
 
@@ -127,6 +128,8 @@ protected:
 	Vector3D						m_modelScale{ 1.0f };
 	Vector3D						m_modelOffset{ 0.0f };
 	bool							m_notextures{ false };
+	bool							m_triStrips{ false };		// ACTC triangle strips instead of cache optimized lists
+	bool							m_packedVerts{ false };		// quantized positions and octahedral TBN
 
 	EqString						m_refsPath;
 	EqString						m_outputFilename;
@@ -10,6 +10,7 @@
 #include "math/Utility.h"
 #include "EGFGenerator.h"
 #include "utils/AdjacentTriangles.h"
+#include "utils/MeshOptimizer.h"
 
 #include "dsm_loader.h"
 #include "dsm_esm_loader.h"
@@ -72,10 +73,78 @@ struct StudioVertexData
 	studioBoneWeight_t	boneWeights;
 };
 
+static constexpr const float VERT_MERGE_EPS = 0.001f;
+static constexpr const float WEIGHT_MERGE_EPS = 0.001f;
+
+//************************************
+// Writes quantized position and octahedral TBN streams
+// of mesh vertices preceded by position bounds
+//************************************
+static void WritePackedVertices(IVirtualStream* stream, ArrayCRef<StudioVertexData> vertices, int vertexType)
+{
+	BoundingBox bbox;
+	for (int i = 0; i < vertices.numElem(); ++i)
+		bbox.AddVertex(vertices[i].posUvs.point);
+
+	studioPackedVertexBounds_t bounds;
+	bounds.mins = bbox.minPoint;
+	bounds.size = max(bbox.GetSize(), Vector3D(F_EPS));
+	stream->Write(&bounds, 1, sizeof(bounds));
+
+	for (int i = 0; i < vertices.numElem(); ++i)
+	{
+		const StudioVertexData& vertData = vertices[i];
+
+		if (vertexType & STUDIO_VERTFLAG_POS_UV)
+		{
+			const Vector3D unitPos = clamp((vertData.posUvs.point - bounds.mins) / bounds.size, 0.0f, 1.0f);
+
+			studioPackedPosUv_t posUv;
+			posUv.point[0] = (uint16)floorf(unitPos.x * 65535.0f + 0.5f);
+			posUv.point[1] = (uint16)floorf(unitPos.y * 65535.0f + 0.5f);
+			posUv.point[2] = (uint16)floorf(unitPos.z * 65535.0f + 0.5f);
+			posUv.unused = 0;
+			posUv.texCoord[0] = half(vertData.posUvs.texCoord.x);
+			posUv.texCoord[1] = half(vertData.posUvs.texCoord.y);
+			stream->Write(&posUv, 1, sizeof(posUv));
+		}
+
+		if (vertexType & STUDIO_VERTFLAG_TBN)
+		{
+			const studioVertexTBN_t& srcTbn = vertData.tbn;
+
+			studioPackedTBN_t tbn;
+			PackNormalOctahedralSnorm16(srcTbn.normal, tbn.normal);
+			PackNormalOctahedralSnorm16(srcTbn.tangent, tbn.tangent);
+			tbn.binormalSign = dot(cross(srcTbn.normal, srcTbn.tangent), srcTbn.binormal) < 0.0f ? -1 : 1;
+			tbn.unused = 0;
+			stream->Write(&tbn, 1, sizeof(tbn));
+		}
+
+		if (vertexType & STUDIO_VERTFLAG_BONEWEIGHT)
+			stream->Write(&vertData.boneWeights, 1, sizeof(studioBoneWeight_t));
+
+		if (vertexType & STUDIO_VERTFLAG_COLOR)
+			stream->Write(&vertData.color, 1, sizeof(studioVertexColor_t));
+	}
+}
+
+// bone weights are at same place of vertex in both layouts
+static const studioBoneWeight_t* GetMeshBoneWeight(const studioHdr_t* header, const studioMeshDesc_t* mesh, int vertex)
+{
+	if (!(header->flags & STUDIO_FLAG_PACKED_VERTS))
+		return mesh->pBoneWeight(vertex);
+
+	const int vertexType = mesh->vertexType;
+	const int ofs = sizeof(studioPackedVertexBounds_t)
+		+ ((vertexType & STUDIO_VERTFLAG_POS_UV) ? sizeof(studioPackedPosUv_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_TBN) ? sizeof(studioPackedTBN_t) : 0);
+
+	return (const studioBoneWeight_t*)((const ubyte*)mesh + mesh->vertexOffset + ofs + Studio_PackedVertexSize(vertexType) * vertex);
+}
+
 static bool CompareVertex(const StudioVertexData& v0, const StudioVertexData&v1)
 {
-	static constexpr const float VERT_MERGE_EPS = 0.001f;
-	static constexpr const float WEIGHT_MERGE_EPS = 0.001f;
 
 	if (compare_epsilon(v0.posUvs.point, v1.posUvs.point, VERT_MERGE_EPS) &&
 		compare_epsilon(v0.posUvs.texCoord, v1.posUvs.texCoord, VERT_MERGE_EPS) &&
@@ -104,6 +173,82 @@ static bool CompareVertex(const StudioVertexData& v0, const StudioVertexData&v1)
 	return false;
 }
 
+// Spatial hash of welded vertices. Cell size equals to merge tolerance
+// so vertex matched by CompareVertex is always in one of neighbour cells
+class CVertexWeldHash
+{
+public:
+	CVertexWeldHash(int maxVertices)
+	{
+		int numBuckets = 64;
+		while (numBuckets < maxVertices)
+			numBuckets <<= 1;
+
+		m_bucketMask = numBuckets - 1;
+		m_buckets.assureSizeEmplace(numBuckets, -1);
+		m_next.reserve(maxVertices);
+	}
+
+	// returns lowest index of matching vertex as linear search does
+	int Find(const Array<StudioVertexData>& vertexList, const StudioVertexData& vertex) const
+	{
+		int64 cell[3];
+		GetCell(vertex.posUvs.point, cell);
+
+		int found = -1;
+		for (int z = -1; z <= 1; ++z)
+		{
+			for (int y = -1; y <= 1; ++y)
+			{
+				for (int x = -1; x <= 1; ++x)
+				{
+					const int bucket = GetBucket(cell[0] + x, cell[1] + y, cell[2] + z);
+					for (int i = m_buckets[bucket]; i != -1; i = m_next[i])
+					{
+						if (found != -1 && i >= found)
+							continue;
+
+						if (CompareVertex(vertexList[i], vertex))
+							found = i;
+					}
+				}
+			}
+		}
+
+		return found;
+	}
+
+	// vertices must be added in order of their indices
+	void Add(int index, const Vector3D& point)
+	{
+		ASSERT(index == m_next.numElem());
+
+		int64 cell[3];
+		GetCell(point, cell);
+
+		const int bucket = GetBucket(cell[0], cell[1], cell[2]);
+		m_next.append(m_buckets[bucket]);
+		m_buckets[bucket] = index;
+	}
+
+private:
+	static void GetCell(const Vector3D& point, int64 cell[3])
+	{
+		for (int i = 0; i < 3; ++i)
+			cell[i] = (int64)floor((double)point[i] / VERT_MERGE_EPS);
+	}
+
+	int GetBucket(int64 x, int64 y, int64 z) const
+	{
+		const uint64 hash = ((uint64)x * 73856093ULL) ^ ((uint64)y * 19349663ULL) ^ ((uint64)z * 83492791ULL);
+		return (int)(hash & m_bucketMask);
+	}
+
+	Array<int>	m_buckets{ PP_SL };
+	Array<int>	m_next{ PP_SL };		// next vertex in same bucket
+	uint64		m_bucketMask{ 0 };
+};
+
 static StudioVertexData MakeStudioVertex(const DSVertex& vert)
 {
 	StudioVertexData vertex;
@@ -182,23 +327,25 @@ void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMe
 	Array<StudioVertexData> shapeVertsList(PP_SL);	// shape key verts
 	Array<int32> indexList(PP_SL);
 
-	vertexList.reserve(dstGroup->numVertices);
-	shapeVertsList.reserve(dstGroup->numVertices);
-	indexList.reserve(dstGroup->numVertices);
+	vertexList.reserve(srcGroup->verts.numElem());
+	shapeVertsList.reserve(modShapeKey ? srcGroup->verts.numElem() : 0);
+	indexList.reserve(srcGroup->verts.numElem());
+
+	CEqTimer timer;
+	CVertexWeldHash weldHash(srcGroup->verts.numElem());
 
 	for(const DSVertex& srcVertex : srcGroup->verts)
 	{
 		const StudioVertexData newVertex = MakeStudioVertex(srcVertex);
 
 		// add vertex or point to existing vertex if found duplicate
-		const int foundVertex = arrayFindIndexF(vertexList, [&](const StudioVertexData& vert) {
-			return CompareVertex(vert, newVertex);
-		});
+		const int foundVertex = weldHash.Find(vertexList, newVertex);
 
 		if(foundVertex == -1)
 		{
 			const int newIndex = vertexList.append(newVertex);
 			indexList.append(newIndex);
+			weldHash.Add(newIndex, newVertex.posUvs.point);
 
 			// modify vertex by shape key
 			if( modShapeKey )
@@ -217,13 +364,15 @@ void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMe
 			vertexStreamsAvailableBits |= STUDIO_VERTFLAG_COLOR;
 	}
 
+	const double weldTime = timer.GetTime(true);
+
 	if((float)indexList.numElem() / (float)3.0f != (int)indexList.numElem() / (int)3)
 	{
 		MsgError("Model group has invalid triangles!\n");
 		return;
 	}
 
-	auto usedVertList = ArrayRef<StudioVertexData>(modShapeKey ? shapeVertsList : vertexList);
+	Array<StudioVertexData>& usedVertList = modShapeKey ? shapeVertsList : vertexList;
 
 	// calculate rest of tangent space
 	for(int32 i = 0; i < indexList.numElem(); i+=3)
@@ -265,6 +414,44 @@ void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMe
 		usedVertList[i].tbn.binormal = normalize(usedVertList[i].tbn.binormal);
 	}
 
+	Array<StudioVertexData> fetchVertList(PP_SL);
+
+	if(!m_triStrips)
+	{
+		MsgInfo("Optimizing group '%s'...\n", srcGroup->texture.ToCString());
+
+		const int numVertices = usedVertList.numElem();
+		const float acmrBefore = MeshOptimizer::CalcACMR(indexList, numVertices);
+
+		MeshOptimizer::OptimizeVertexCache(indexList, numVertices);
+
+		{
+			Array<Vector3D> positions(PP_SL);
+			positions.setNum(numVertices);
+			for (int i = 0; i < numVertices; ++i)
+				positions[i] = usedVertList[i].posUvs.point;
+
+			MeshOptimizer::OptimizeOverdraw(indexList, positions);
+		}
+
+		const float acmrAfter = MeshOptimizer::CalcACMR(indexList, numVertices);
+
+		// put vertices in order of use
+		Array<int> remapTable(PP_SL);
+		MeshOptimizer::OptimizeVertexFetch(indexList, numVertices, remapTable);
+
+		fetchVertList.setNum(numVertices);
+		for (int i = 0; i < numVertices; ++i)
+			fetchVertList[remapTable[i]] = usedVertList[i];
+
+		usedVertList.swap(fetchVertList);
+
+		MsgInfo("   %d verts, %d tris, ACMR %.3f -> %.3f, weld %.1f ms, optimize %.1f ms\n",
+			numVertices, indexList.numElem() / 3, acmrBefore, acmrAfter, weldTime * 1000.0, timer.GetTime(true) * 1000.0);
+
+		goto skipOptimize;
+	}
+
 #ifdef USE_ACTC
 	{
 		// optimize model using ACTC
@@ -399,32 +586,40 @@ skipOptimize:
 	dstGroup->vertexType = vertexStreamsAvailableBits;
 
 	ASSERT(vertexStreamsAvailableBits & (STUDIO_VERTFLAG_POS_UV | STUDIO_VERTFLAG_TBN));
-	WRITE_RESERVE_NUM(studioVertexPosUv_t, dstGroup->numVertices);
-	WRITE_RESERVE_NUM(studioVertexTBN_t, dstGroup->numVertices);
 
-	if (vertexStreamsAvailableBits & STUDIO_VERTFLAG_BONEWEIGHT)
-		WRITE_RESERVE_NUM(studioBoneWeight_t, dstGroup->numVertices);
+	if (header->flags & STUDIO_FLAG_PACKED_VERTS)
+	{
+		WritePackedVertices(stream, usedVertList, vertexStreamsAvailableBits);
+	}
+	else
+	{
+		WRITE_RESERVE_NUM(studioVertexPosUv_t, dstGroup->numVertices);
+		WRITE_RESERVE_NUM(studioVertexTBN_t, dstGroup->numVertices);
 
-	if (vertexStreamsAvailableBits & STUDIO_VERTFLAG_COLOR)
-		WRITE_RESERVE_NUM(studioVertexColor_t, dstGroup->numVertices);
+		if (vertexStreamsAvailableBits & STUDIO_VERTFLAG_BONEWEIGHT)
+			WRITE_RESERVE_NUM(studioBoneWeight_t, dstGroup->numVertices);
 
-	for (int32 i = 0; i < dstGroup->numVertices; i++)
-	{
-		const StudioVertexData& vertData = usedVertList[i];
+		if (vertexStreamsAvailableBits & STUDIO_VERTFLAG_COLOR)
+			WRITE_RESERVE_NUM(studioVertexColor_t, dstGroup->numVertices);
 
-		studioVertexPosUv_t* vertPosUv = dstGroup->pPosUvs(i);
-		studioVertexTBN_t* vertTbn = dstGroup->pTBNs(i);
-		studioBoneWeight_t* vertBoneWeight = dstGroup->pBoneWeight(i);
-		studioVertexColor_t* vertColor = dstGroup->pColor(i);
+		for (int32 i = 0; i < dstGroup->numVertices; i++)
+		{
+			const StudioVertexData& vertData = usedVertList[i];
 
-		*vertPosUv = vertData.posUvs;
-		*vertTbn = vertData.tbn;
+			studioVertexPosUv_t* vertPosUv = dstGroup->pPosUvs(i);
+			studioVertexTBN_t* vertTbn = dstGroup->pTBNs(i);
+			studioBoneWeight_t* vertBoneWeight = dstGroup->pBoneWeight(i);
+			studioVertexColor_t* vertColor = dstGroup->pColor(i);
 
-		if (vertexStreamsAvailableBits & STUDIO_VERTFLAG_BONEWEIGHT)
-			*vertBoneWeight = vertData.boneWeights;
+			*vertPosUv = vertData.posUvs;
+			*vertTbn = vertData.tbn;
 
-		if (vertexStreamsAvailableBits & STUDIO_VERTFLAG_COLOR)
-			*vertColor = vertData.color;
+			if (vertexStreamsAvailableBits & STUDIO_VERTFLAG_BONEWEIGHT)
+				*vertBoneWeight = vertData.boneWeights;
+
+			if (vertexStreamsAvailableBits & STUDIO_VERTFLAG_COLOR)
+				*vertColor = vertData.color;
+		}
 	}
 #else
 	WRITE_RESERVE_NUM(studioVertexDesc_t, dstGroup->numVertices);
@@ -576,6 +771,7 @@ void CEGFGenerator::WriteLods(studioHdr_t* header, IVirtualStream* stream)
 	{
 		header->pLodParams(i)->distance = m_lodparams[i].distance;
 		header->pLodParams(i)->flags = m_lodparams[i].flags;
+		header->pLodParams(i)->animUpdateInterval = m_lodparams[i].animUpdateInterval;
 	}
 }
 
@@ -734,11 +930,133 @@ void CEGFGenerator::WriteBones(studioHdr_t* header, IVirtualStream* stream)
 		strcpy(destBone->name, srcBone->name);
 
 		destBone->parent = srcBone->parentIdx;
+		destBone->lodMask = 0;
 		destBone->position = srcBone->position;
 		destBone->rotation = srcBone->angles;
 	}
 }
 
+//************************************
+// Computes which bones are needed by each LOD
+// so the animation can skip the rest
+//************************************
+void CEGFGenerator::WriteBoneLodMasks(studioHdr_t* header)
+{
+	const int numBones = header->numBones;
+	const int numLods = max(1, (int)header->numLodParams);
+
+	for (int i = 0; i < header->numLods; ++i)
+	{
+		const studioLodModel_t* lodModel = header->pLodModel(i);
+
+		for (int lod = 0; lod < numLods; ++lod)
+		{
+			// same fallback as renderer uses
+			int modelLod = lod;
+			uint8 modelDescId = EGF_INVALID_IDX;
+			do
+			{
+				modelDescId = lodModel->modelsIndexes[modelLod];
+				modelLod--;
+			} while (modelDescId == EGF_INVALID_IDX && modelLod >= 0);
+
+			if (modelDescId == EGF_INVALID_IDX)
+				continue;
+
+			const studioMeshGroupDesc_t* meshGroup = header->pMeshGroupDesc(modelDescId);
+			for (int j = 0; j < meshGroup->numMeshes; ++j)
+			{
+				const studioMeshDesc_t* mesh = meshGroup->pMesh(j);
+				if (!(mesh->vertexType & STUDIO_VERTFLAG_BONEWEIGHT))
+					continue;
+
+				for (int k = 0; k < mesh->numVertices; ++k)
+				{
+					const studioBoneWeight_t* weights = GetMeshBoneWeight(header, mesh, k);
+					for (int w = 0; w < weights->numweights; ++w)
+					{
+						const int boneIdx = weights->bones[w];
+						if (boneIdx >= 0 && boneIdx < numBones && weights->weight[w] > 0.0f)
+							header->pBone(boneIdx)->lodMask |= (1 << lod);
+					}
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < numBones; ++i)
+	{
+		studioBoneDesc_t* bone = header->pBone(i);
+
+		// higher LODs than specified in params use last one
+		if (bone->lodMask & (1 << (numLods - 1)))
+			bone->lodMask |= ~((1 << numLods) - 1);
+
+		// first LOD is always fully animated as game code may use any bone up close
+		bone->lodMask |= 1;
+	}
+
+	// attachment and IK bones are used by game code at any distance
+	for (int i = 0; i < header->numTransforms; ++i)
+	{
+		const int boneIdx = header->pTransform(i)->attachBoneIdx;
+		if (boneIdx != EGF_INVALID_IDX && boneIdx < numBones)
+			header->pBone(boneIdx)->lodMask = 0xff;
+	}
+
+	for (int i = 0; i < header->numIKChains; ++i)
+	{
+		const studioIkChain_t* chain = header->pIkChain(i);
+		for (int j = 0; j < chain->numLinks; ++j)
+			header->pBone(chain->pLink(j)->bone)->lodMask = 0xff;
+	}
+
+	// parents are needed to compute children
+	for (int i = numBones - 1; i >= 0; --i)
+	{
+		const studioBoneDesc_t* bone = header->pBone(i);
+		if (bone->parent >= 0)
+			header->pBone(bone->parent)->lodMask |= bone->lodMask;
+	}
+
+	// bones with unsorted parents
+	for (int pass = 0; pass < numBones; ++pass)
+	{
+		bool changed = false;
+		for (int i = 0; i < numBones; ++i)
+		{
+			const studioBoneDesc_t* bone = header->pBone(i);
+			if (bone->parent < 0)
+				continue;
+
+			studioBoneDesc_t* parent = header->pBone(bone->parent);
+			if ((parent->lodMask | bone->lodMask) != parent->lodMask)
+			{
+				parent->lodMask |= bone->lodMask;
+				changed = true;
+			}
+		}
+
+		if (!changed)
+			break;
+	}
+
+	int numLodBones[MAX_MODEL_LODS] = { 0 };
+	for (int i = 0; i < numBones; ++i)
+	{
+		for (int lod = 0; lod < numLods; ++lod)
+		{
+			if (header->pBone(i)->lodMask & (1 << lod))
+				++numLodBones[lod];
+		}
+	}
+
+	for (int lod = 0; lod < numLods; ++lod)
+		Msg(" lod %d animates %d of %d bones\n", lod, numLodBones[lod], numBones);
+
+	header->flags |= STUDIO_FLAG_ANIM_LOD;
+}
+
 void CEGFGenerator::Validate(studioHdr_t* header, const char* stage)
 {
 	Array<GenModel*> writeModels{ PP_SL };
@@ -780,6 +1098,9 @@ bool CEGFGenerator::GenerateEGF()
 
 #if ENABLE_OLD_VERTEX_FORMAT == 0
 	header->flags = STUDIO_FLAG_NEW_VERTEX_FMT;
+
+	if (m_packedVerts)
+		header->flags |= STUDIO_FLAG_PACKED_VERTS;
 #else
 	header->flags = 0;
 #endif
@@ -831,6 +1152,8 @@ bool CEGFGenerator::GenerateEGF()
 	WriteBones(header, &egfStream);
 	Validate(header, "Write bones");
 
+	WriteBoneLodMasks(header);
+
 	// set the size of file (size with header), for validation purposes
 	header->length = egfStream.GetSize();
 
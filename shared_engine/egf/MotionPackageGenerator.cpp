@@ -66,6 +66,10 @@ void CMotionPackageGenerator::Cleanup()
 	m_sequences.clear();
 	m_events.clear();
 	m_posecontrollers.clear();
+	m_animationdescs.clear();
+	m_animframes.clear();
+	m_animtracks.clear();
+	m_animtrackdata.clear();
 
 	m_animPath = "./";
 	Studio_FreeModel(m_model);
@@ -1137,7 +1141,7 @@ void CMotionPackageGenerator::ConvertAnimationsToWrite()
 		animationdesc_t anim;
 		memset(&anim, 0, sizeof(animationdesc_t));
 
-		anim.firstFrame = m_animframes.numElem();
+		anim.firstFrame = m_compressTracks ? m_animtracks.numElem() : m_animframes.numElem();
 
 		strcpy(anim.name, m_animations[i].name);
 
@@ -1145,8 +1149,16 @@ void CMotionPackageGenerator::ConvertAnimationsToWrite()
 		for(int j = 0; j < m_model->numBones; j++)
 		{
 			const studioBoneAnimation_t& boneFrame = m_animations[i].bones[j];
-			for(int k = 0; k < boneFrame.numFrames; ++k)
-				m_animframes.append(boneFrame.keyFrames[k]);
+
+			if (m_compressTracks)
+			{
+				Studio_CompressAnimTrack(ArrayCRef<animframe_t>(boneFrame.keyFrames, boneFrame.numFrames), m_trackCompression, m_animtracks.append(), m_animtrackdata);
+			}
+			else
+			{
+				for(int k = 0; k < boneFrame.numFrames; ++k)
+					m_animframes.append(boneFrame.keyFrames[k]);
+			}
 
 			anim.numFrames += boneFrame.numFrames;
 		}
@@ -1223,6 +1235,12 @@ bool CMotionPackageGenerator::CompileScript(const char* filename)
 
 	m_animPath = _Es(filename).Path_Strip_Name();
 
+	// track compression settings, rotation error is in degrees
+	m_compressTracks = KV_GetValueBool(sec->FindSection("CompressTracks"), 0, true) && g_cmdLine->FindArgument("-nocompresstracks") == -1;
+	m_trackCompression.rotationError = DEG2RAD(KV_GetValueFloat(sec->FindSection("CompressRotationError"), 0, RAD2DEG(m_trackCompression.rotationError)));
+	m_trackCompression.positionError = KV_GetValueFloat(sec->FindSection("CompressPositionError"), 0, m_trackCompression.positionError);
+	m_trackCompression.reduceKeys = KV_GetValueBool(sec->FindSection("CompressReduceKeys"), 0, true);
+
 	KVSection* animSourceKey = sec->FindSection("FBXSource");
 	if (animSourceKey)
 	{
@@ -1277,38 +1295,67 @@ void CMotionPackageGenerator::WriteAnimationPackage(const char* packageOutputFil
 	CopyLumpToFile(&lumpDataStream, ANIMFILE_ANIMATIONS, (ubyte*)m_animationdescs.ptr(), m_animationdescs.numElem() * sizeof(animationdesc_t));
 	header.numLumps++;
 
-	// try to compress frame data
-	const int nFramesSize = m_animframes.numElem() * sizeof(animframe_t);
+	if (m_compressTracks)
+	{
+		int numRawFrames = 0;
+		int numKeys = 0;
+		int numConstantTracks = 0;
+		for (const animtrack_t& track : m_animtracks)
+		{
+			numKeys += track.numKeys;
+			if ((track.flags & ANIMTRACK_CONSTANT_ROTATION) && (track.flags & ANIMTRACK_CONSTANT_POSITION))
+				++numConstantTracks;
+		}
+
+		for (const animationdesc_t& desc : m_animationdescs)
+			numRawFrames += desc.numFrames;
+
+		const int tracksSize = m_animtracks.numElem() * sizeof(animtrack_t);
+		MsgWarning("Compressed %d frames to %d keys (%d of %d tracks constant), %d to %d bytes\n",
+			numRawFrames, numKeys, numConstantTracks, m_animtracks.numElem(), numRawFrames * (int)sizeof(animframe_t), tracksSize + m_animtrackdata.numElem());
+
+		CopyLumpToFile(&lumpDataStream, ANIMFILE_COMPRESSEDTRACKS, (ubyte*)m_animtracks.ptr(), tracksSize);
+		CopyLumpToFile(&lumpDataStream, ANIMFILE_COMPRESSEDTRACKDATA, m_animtrackdata.ptr(), m_animtrackdata.numElem());
+		header.numLumps += 2;
+	}
+	else
+	{
+		// try to compress frame data
+		const int nFramesSize = m_animframes.numElem() * sizeof(animframe_t);
 
-	unsigned long nCompressedFramesSize = nFramesSize + 150;
-	ubyte* pCompressedFrames = (ubyte*)PPAlloc(nCompressedFramesSize);
+		unsigned long nCompressedFramesSize = nFramesSize + 150;
+		ubyte* pCompressedFrames = (ubyte*)PPAlloc(nCompressedFramesSize);
 
-	memset(pCompressedFrames, 0, nCompressedFramesSize);
+		memset(pCompressedFrames, 0, nCompressedFramesSize);
 
-	int comp_stats = Z_ERRNO;
+		int comp_stats = Z_ERRNO;
 
-	// do not compress animation frames if option found
-	if(g_cmdLine->FindArgument("-nocompress") == -1)
-		comp_stats = compress2(pCompressedFrames, &nCompressedFramesSize, (ubyte*)m_animframes.ptr(), nFramesSize, 9);
+		// do not compress animation frames if option found
+		if(g_cmdLine->FindArgument("-nocompress") == -1)
+			comp_stats = compress2(pCompressedFrames, &nCompressedFramesSize, (ubyte*)m_animframes.ptr(), nFramesSize, 9);
 
-	if(comp_stats == Z_OK)
-	{
-		MsgWarning("Successfully compressed frame data from %d to %d bytes\n", nFramesSize, nCompressedFramesSize);
+		if(comp_stats == Z_OK)
+		{
+			MsgWarning("Successfully compressed frame data from %d to %d bytes\n", nFramesSize, nCompressedFramesSize);
 
-		// write decompression data size
-		CopyLumpToFile(&lumpDataStream, ANIMFILE_UNCOMPRESSEDFRAMESIZE, (ubyte*)&nFramesSize, sizeof(int));
-		header.numLumps++;
+			// write decompression data size
+			CopyLumpToFile(&lumpDataStream, ANIMFILE_UNCOMPRESSEDFRAMESIZE, (ubyte*)&nFramesSize, sizeof(int));
+			header.numLumps++;
 
-		// write compressed frame data (decompress when loading MOP file)
-		CopyLumpToFile(&lumpDataStream, ANIMFILE_COMPRESSEDFRAMES, pCompressedFrames, nCompressedFramesSize);
-		header.numLumps++;
+			// write compressed frame data (decompress when loading MOP file)
+			CopyLumpToFile(&lumpDataStream, ANIMFILE_COMPRESSEDFRAMES, pCompressedFrames, nCompressedFramesSize);
+			header.numLumps++;
 
-		PPFree(pCompressedFrames);
-	}
-	else
-	{
-		// write uncompressed frame data
-		CopyLumpToFile(&lumpDataStream, ANIMFILE_ANIMATIONFRAMES, (ubyte*)m_animframes.ptr(), m_animframes.numElem() * sizeof(animframe_t));
+			PPFree(pCompressedFrames);
+		}
+		else
+		{
+			// write uncompressed frame data
+			CopyLumpToFile(&lumpDataStream, ANIMFILE_ANIMATIONFRAMES, (ubyte*)m_animframes.ptr(), m_animframes.numElem() * sizeof(animframe_t));
+			header.numLumps++;
+
+			PPFree(pCompressedFrames);
+		}
 	}
 
 	CopyLumpToFile(&lumpDataStream, ANIMFILE_SEQUENCES, (ubyte*)m_sequences.ptr(), m_sequences.numElem() * sizeof(sequencedesc_t));
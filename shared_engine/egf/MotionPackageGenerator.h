@@ -8,6 +8,7 @@
 #pragma once
 #include "egf/model.h"
 #include "egf/motionpackage.h"
+#include "studiofile/StudioAnimTrack.h"
 
 struct KVSection;
 struct animCaBoneFrames_t;
@@ -110,6 +111,11 @@ private:
 	Array<posecontroller_t>		m_posecontrollers{ PP_SL };
 	Array<animationdesc_t>		m_animationdescs{ PP_SL };
 	Array<animframe_t>			m_animframes{ PP_SL };
+	Array<animtrack_t>			m_animtracks{ PP_SL };
+	Array<ubyte>				m_animtrackdata{ PP_SL };
+
+	AnimTrackCompressParams		m_trackCompression;
+	bool						m_compressTracks{ true };
 
 	EqString					m_animPath{ "./" };
 };
\ No newline at end of file
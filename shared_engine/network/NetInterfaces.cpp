@@ -28,6 +28,25 @@ void INetworkInterface::Update( int timeMs, CDPRecvPipe_fn func, void* recvObj )
 	m_pSocket->UpdateRecieve( timeMs, func, recvObj);
 }
 
+void INetworkInterface::UpdateAndWait( int maxWaitMs, CDPRecvPipe_fn func, void* recvObj )
+{
+	ASSERT_MSG(m_pSocket != nullptr, "INetworkInterface - not initialized.");
+
+	// loop can wake up more often than once per millisecond, so keep the remainder
+	const int timeMs = (int)((m_updateTimer.GetTime() - m_updateTime) * 1000.0);
+	m_updateTime += timeMs * 0.001;
+
+	Update( timeMs, func, recvObj );
+
+	// sleep until something is received, sent or has to be resent
+	int waitMs = m_pSocket->GetNextTimeoutMs();
+	if(waitMs < 0 || waitMs > maxWaitMs)
+		waitMs = maxWaitMs;
+
+	// anything due was handled by Update, messages queued meanwhile have already signalled the socket
+	m_pSocket->WaitForEvents( max(waitMs, 1) );
+}
+
 CEqRDPSocket* INetworkInterface::GetSocket() const 
 {
 	return m_pSocket; 
@@ -45,6 +64,12 @@ bool INetworkInterface::PreProcessRecievedMessage( ubyte* data, int size, netMes
 {
 	netMessage_t* msg = (netMessage_t*)data;
 
+	const int dataSize = msg->header.compressed_size > 0 ? msg->header.compressed_size : msg->header.message_size;
+
+	// truncated or malformed datagram
+	if( size < (int)NETMESSAGE_HDR || size - (int)NETMESSAGE_HDR < dataSize || msg->header.message_size > MAX_MESSAGE_LENGTH )
+		return false;
+
 	out.header = msg->header;
 
 	// decompress message and put to &out
@@ -52,14 +77,8 @@ bool INetworkInterface::PreProcessRecievedMessage( ubyte* data, int size, netMes
 	if( msg->header.compressed_size > 0 )
 	{
 		uLongf decompSize = msg->header.message_size;
-		Bytef* decompData = (Bytef*)PPAlloc( decompSize );
-
-		int z_result = uncompress(decompData, &decompSize, msg->data, msg->header.compressed_size );
-
-		if(z_result == Z_OK)
-			memcpy(out.data, decompData, decompSize);
 
-		PPFree( decompData );
+		int z_result = uncompress(out.data, &decompSize, msg->data, msg->header.compressed_size );
 
 		if(z_result != Z_OK)
 			return false;
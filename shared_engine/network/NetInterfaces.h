@@ -65,6 +65,10 @@ public:
 
 	void				Update( int timeMs, CDPRecvPipe_fn func, void* recvObj );
 
+	// updates by time passed since previous call and sleeps until data is received,
+	// socket is woken up or queued message is due, but no longer than maxWaitMs
+	void				UpdateAndWait( int maxWaitMs, CDPRecvPipe_fn func, void* recvObj );
+
 	CEqRDPSocket*		GetSocket() const;
 	sockaddr_in			GetAddress() const;
 
@@ -80,6 +84,9 @@ protected:
 
 	hostent*			m_hostinfo;
 
+	CEqTimer			m_updateTimer;
+	double				m_updateTime{ 0.0 };
+
 };
 
 //-------------------------------------------------------------------------------------------------------
@@ -10,11 +10,21 @@
 
 #include "core/core_common.h"
 #include "core/ConVar.h"
+#include "core/ConCommand.h"
 #include "utils/KeyValues.h"
 #include "math/Random.h"
 
 #include "c_udp.h"
 
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/eventfd.h>
+#endif // !_WIN32
+
+#ifdef __linux__
+#define UDP_CDP_USE_MMSG					// recvmmsg and sendmmsg
+#endif // __linux__
+
 using namespace Threading;
 
 DECLARE_CVAR(net_fakelag, "0", "Simulate lagging packets\n", CV_CHEAT);
@@ -28,24 +38,36 @@ namespace Networking
 
 #define UDP_CDP_IDENT						MCHAR4('E','Q','D','P')		// signature: EqDatagramPacket
 
-#define UDP_CDP_PROTOCOL_VERSION			9			// protocol version
+#define UDP_CDP_PROTOCOL_VERSION			10			// protocol version
 
 #define UDP_CDP_MIN_SEND_BUFFER				2048		// minimal send buffer; tweak this if you have bandwith issues
 #define UDP_CDP_MIN_MESSAGESIZE				512
 
-#define UDP_CDP_MAX_QUEUE_BUFFERS			16			// maximum amount of queue buffers
+#define UDP_CDP_MAX_QUEUE_BUFFERS			48			// maximum amount of queue buffers per peer
+#define UDP_CDP_MAX_RECV_PER_UPDATE			256			// datagrams read at once so send queue is not starved
+#define UDP_CDP_RECV_BATCH					16			// datagrams received by single system call
+#define UDP_CDP_SEND_BATCH					64			// datagrams sent by single system call
+#define UDP_CDP_MESSAGE_POOL_SIZE			64			// free messages kept for reuse
+
+#define UDP_CDP_SEND_WINDOW					32			// guaranteed datagrams in flight per peer. Must fit into ack bits
+#define UDP_CDP_RECV_WINDOW					256			// received sequences remembered per peer
+#define UDP_CDP_MAX_SEND_TIMES				8			// guaranteed datagram is failed after that many sends
 
 #define UDP_CDP_FORCESEND_FILLPERCENTAGE	(0.7)
 
 #define CDP_MAX_MESSAGE_ID					32760
 
 #define CDP_DATA_PACKETDATA					0xda1a
-#define CDP_DATA_PACKETSTATE				0x51a1
+
+#define CDP_HDR_FLAG_ACK					(1 << 7)	// header carries acknowledgements. Not one of ECDPSendFlags
 
 // default settings: tweak this if you have bandwith issues in cdp_config.cfg
-#define CDP_SEND_TIMEOUT_MS					10			// 40 ms delay to send
-#define CDP_SEND_REMOVE_TIMEOUT_MS			1000		// Guaranteed messages only - 5 sec delay to send unacknowledged messages
-#define CDP_RECV_TIMEOUT_MS					1500		// Guaranteed messages only - 5 sec delay to receive message and then remove it from received list
+#define CDP_SEND_TIMEOUT_MS					10			// delay to gather messages into datagram
+#define CDP_PEER_TIMEOUT_MS					10000		// peer state is freed when nothing is received for that long
+
+#define CDP_INITIAL_RTO_MS					100			// resend timeout until round trip time is measured
+#define CDP_MIN_RTO_MS						20
+#define CDP_MAX_RTO_MS						1000		// limit of resend timeout backoff
 
 //ConVar net_cudp_sendtime("net_cudp_sendtime", "100", 1.0, 200.0, "Delay to send message buffer", CV_CHEAT);
 //ConVar net_cudp_removetime("net_cudp_removetime", "500", 1.0, 80.0, "Delay to send message buffer", CV_CHEAT);
@@ -57,24 +79,25 @@ namespace Networking
 struct cdp_queued_message_t
 {
 	cdp_queued_message_t()
+		: bytestream(nullptr, VS_OPEN_WRITE, UDP_CDP_MIN_MESSAGESIZE, PP_SL)
 	{
-		bytestream = nullptr;
-		flags = 0;
-		sendTime = 0;
+		memset(&addr, 0, sizeof(sockaddr_in));
 	}
 
 	sockaddr_in				addr;			// address of sender or receiver
-	CMemoryStream*			bytestream{ nullptr };
-	mutable int				sendTimes{ 0 };		// send times
-	mutable int				sentTimeout{ 0 };	// timeout to send
-	mutable int				removeTimeout{ 0 };	// timeout to remove
+	CMemoryStream			bytestream;
+	cdp_peer_t*				peer{ nullptr };
+
+	int						sendTimes{ 0 };		// send times
+	int						sentTimeout{ 0 };	// time since queued or last sent
 
 	uint32					sendTime{ 0 };
+	int						queueIndex{ -1 };	// in m_pMessageQueue
+	ushort					sequence{ 0 };		// assigned on first send
 	short					flags{ 0 };
 
 	bool Write(const void* pData, int nSize );
-	void WriteReset();
-	void ReadReset();
+	void Reset();
 };
 
 // big message header
@@ -82,10 +105,17 @@ struct udp_cdp_hdr_s
 {
 	int				ident;					// UDP_CDP_IDENT
 	ubyte			protocol_version;		// UDP_RCP_PROTOCOL_VERSION
-	ubyte			flags;					// message flags ( ECDPSendFlags )
+	ubyte			flags;					// message flags ( ECDPSendFlags ) and CDP_HDR_FLAG_ACK
 
 	//uint			crc32;					// message CRC32
 	short			message_id;				// less than CDP_MAX_MESSAGE_ID
+
+	ushort			session;				// sender's session with receiver, changes when peer state is recreated
+	ushort			sequence;				// guaranteed datagram sequence within session
+
+	ushort			ack_session;			// receiver's session the acknowledgements belong to
+	ushort			ack;					// latest guaranteed sequence received
+	uint			ack_bits;				// bit N is set if (ack - 1 - N) was received
 };
 
 ALIGNED_TYPE(udp_cdp_hdr_s,1) udp_cdp_hdr_t;
@@ -93,102 +123,237 @@ ALIGNED_TYPE(udp_cdp_hdr_s,1) udp_cdp_hdr_t;
 // submessage/data
 struct udp_cdp_submsg_s
 {
-	ushort	data_type;				// message data type (state of packet or packet data)
+	ushort	data_type;				// message data type (packet data)
 	ushort	size;					// message size including header
 };
 
 ALIGNED_TYPE(udp_cdp_submsg_s,2) udp_cdp_submsg_t;
 
-// packet state message data
-struct udp_cdp_packetstate_s
+//------------------------------------------------------------------------------
+// reliability state of single address
+//------------------------------------------------------------------------------
+struct cdp_peer_t
 {
-	short	message_id;
-	short	status;
-};
+	cdp_peer_t()
+	{
+		memset(&addr, 0, sizeof(sockaddr_in));
+		memset(sent, 0, sizeof(sent));
+	}
 
-ALIGNED_TYPE(udp_cdp_packetstate_s,2) udp_cdp_packetstate_t;
+	// new sequence would overwrite the oldest datagram in flight
+	bool	IsWindowFull() const { return sent[sendSequence % UDP_CDP_SEND_WINDOW] != nullptr; }
+
+	// returns false if sequence is already received or too old
+	bool	ReceiveSequence( ushort fromSession, ushort sequence );
+	uint	GetAckBits() const;
+
+	void	AddRTTSample( int rttMs );
+	int		GetResendTimeout( int sendTimes ) const;
+
+	sockaddr_in				addr;
+
+	// sending
+	ushort					session{ 0 };
+	ushort					sendSequence{ 0 };
+	cdp_queued_message_t*	sent[UDP_CDP_SEND_WINDOW];			// datagrams in flight by sequence
+	Array<cdp_queued_message_t*> unsent{ PP_SL };				// datagrams still being filled
+	int						numMessages{ 0 };
+
+	// receiving
+	uint32					received[UDP_CDP_RECV_WINDOW];		// received sequences by sequence
+	ushort					remoteSession{ 0 };
+	ushort					recvSequence{ 0 };					// latest received
+	bool					hasReceived{ false };
+	bool					ackPending{ false };
+	uint32					lastRecvTime{ 0 };
+
+	// round trip time estimation
+	float					srtt{ 0.0f };
+	float					rttvar{ 0.0f };
+	int						rto{ CDP_INITIAL_RTO_MS };
+	bool					hasRTT{ false };
+
+	// earliest time when one of the messages has to be sent, resent or failed
+	uint32					sendDeadline{ 0 };
+	bool					sendScheduled{ false };
+};
 
-bool cdp_queued_message_t::Write(const void* pData, int nSize )
+bool cdp_peer_t::ReceiveSequence( ushort fromSession, ushort sequence )
 {
-	ASSERT( bytestream->Tell() + nSize < UDP_CDP_MAX_MESSAGEPAYLOAD );
+	// remote peer state was recreated
+	if( !hasReceived || fromSession != remoteSession )
+	{
+		memset(received, 0xff, sizeof(received));
+
+		hasReceived = true;
+		remoteSession = fromSession;
+		recvSequence = sequence;
+		received[sequence % UDP_CDP_RECV_WINDOW] = sequence;
+
+		return true;
+	}
+
+	const int diff = (short)(ushort)(sequence - recvSequence);
+
+	if( diff > 0 )
+	{
+		// forget sequences which were skipped
+		for( int i = 1; i < min(diff, UDP_CDP_RECV_WINDOW); i++ )
+			received[(ushort)(recvSequence + i) % UDP_CDP_RECV_WINDOW] = 0xffffffff;
+
+		received[sequence % UDP_CDP_RECV_WINDOW] = sequence;
+		recvSequence = sequence;
+
+		return true;
+	}
+
+	if( diff <= -UDP_CDP_RECV_WINDOW )
+		return false;
+
+	if( received[sequence % UDP_CDP_RECV_WINDOW] == sequence )
+		return false;
+
+	received[sequence % UDP_CDP_RECV_WINDOW] = sequence;
 
-	return bytestream->Write( pData, 1, nSize ) > 0;
+	return true;
 }
 
-void cdp_queued_message_t::WriteReset()
+uint cdp_peer_t::GetAckBits() const
 {
-	delete bytestream;
-	bytestream = nullptr;
+	uint ackBits = 0;
+
+	for( int i = 0; i < 32; i++ )
+	{
+		const ushort sequence = recvSequence - 1 - i;
+
+		if( received[sequence % UDP_CDP_RECV_WINDOW] == sequence )
+			ackBits |= (1u << i);
+	}
+
+	return ackBits;
 }
 
-void cdp_queued_message_t::ReadReset()
+// RFC 6298
+void cdp_peer_t::AddRTTSample( int rttMs )
 {
-	bytestream->Seek(0, VS_SEEK_SET);
+	const float sample = (float)rttMs;
+
+	if( !hasRTT )
+	{
+		srtt = sample;
+		rttvar = sample * 0.5f;
+		hasRTT = true;
+	}
+	else
+	{
+		rttvar = rttvar * 0.75f + fabsf(srtt - sample) * 0.25f;
+		srtt = srtt * 0.875f + sample * 0.125f;
+	}
+
+	// time is measured in whole milliseconds
+	rto = min(max((int)ceilf(srtt + max(rttvar * 4.0f, 1.0f)), CDP_MIN_RTO_MS), CDP_MAX_RTO_MS);
 }
 
-void FreeMessage(cdp_queued_message_t* pMessage)
+int cdp_peer_t::GetResendTimeout( int sendTimes ) const
 {
-	delete pMessage->bytestream;
-	delete pMessage;
+	// exponential backoff
+	return min(rto << min(sendTimes - 1, 6), CDP_MAX_RTO_MS);
 }
 
-// allocates message
-cdp_queued_message_t* AllocMessage()
-{
-	cdp_queued_message_t* pMessage = PPNew cdp_queued_message_t;
+//------------------------------------------------------------------------------
 
-	memset(pMessage, 0, sizeof(cdp_queued_message_t));
+bool cdp_queued_message_t::Write(const void* pData, int nSize )
+{
+	ASSERT( bytestream.Tell() + nSize < UDP_CDP_MAX_MESSAGEPAYLOAD );
 
-	if(!pMessage->bytestream)
-	{
-		pMessage->bytestream = PPNew CMemoryStream(nullptr, VS_OPEN_WRITE, UDP_CDP_MIN_MESSAGESIZE, PP_SL);
-	}
+	return bytestream.Write( pData, 1, nSize ) > 0;
+}
 
-	return pMessage;
+// stream memory is kept
+void cdp_queued_message_t::Reset()
+{
+	bytestream.Seek(0, VS_SEEK_SET);
+
+	peer = nullptr;
+	sendTimes = 0;
+	sentTimeout = 0;
+	sendTime = 0;
+	queueIndex = -1;
+	sequence = 0;
+	flags = 0;
 }
 
-int udp_select_messages( SOCKET sock )
+static void udp_write_header( cdp_queued_message_t* message, short messageId, short flags )
 {
-	struct timeval stTimeOut;
+	udp_cdp_hdr_t hdr;
+	memset(&hdr, 0, sizeof(udp_cdp_hdr_t));
+
+	hdr.ident = UDP_CDP_IDENT;
+	hdr.protocol_version = UDP_CDP_PROTOCOL_VERSION;
+	hdr.message_id = messageId;
+	hdr.flags = flags;
 
-	fd_set stReadFDS;
+	// write header before return
+	message->Write( &hdr, sizeof( udp_cdp_hdr_t ) );
+}
 
-	FD_ZERO(&stReadFDS);
+static uint64 udp_peer_key( const sockaddr_in& addr )
+{
+	return ((uint64)addr.sin_addr.s_addr << 16) | addr.sin_port;
+}
 
-    // Timeout of one second
+static bool udp_would_block( int errorCode )
+{
 #ifdef _WIN32
-	stTimeOut.tv_sec = 0;
-	stTimeOut.tv_usec = 20 * 1000;
+	return errorCode == WSAEWOULDBLOCK;
 #else
-	stTimeOut.tv_sec = 0;
-	stTimeOut.tv_usec = 0;
+	return errorCode == EWOULDBLOCK || errorCode == EAGAIN;
 #endif // _WIN32
-	FD_SET(sock, &stReadFDS);
+}
+
+// returns false if there is nothing to receive
+static bool udp_check_recv_error( int errorCode )
+{
+	if( udp_would_block( errorCode ) )
+		return false;
 
+	// skip WSAENOTCONN and WSAECONNRESET to avoid receiving ICMP error
 #ifdef _WIN32
-	return select( sock+1, &stReadFDS, nullptr, nullptr, &stTimeOut);
+	if( errorCode != WSAENOTCONN && errorCode != WSAECONNRESET )
 #else
-    int cnt = select( sock+1, &stReadFDS, nullptr, nullptr, &stTimeOut);
-
-    if (FD_ISSET(sock, &stReadFDS))
-    {
-        // Есть данные для чтения
-        return cnt;
-    }
+	if( errorCode != ENOTCONN && errorCode != ECONNRESET )
+#endif // _WIN32
+	{
+		Msg("receive error (%s)\n", NETErrorString(errorCode));
+	}
 
-    return -1;
-#endif
+	return true;
 }
 
 CEqRDPSocket::CEqRDPSocket()
 {
 	m_sock = -1;
 
+#ifdef _WIN32
+	m_wakeSock = INVALID_SOCKET;
+	memset(&m_wakeAddr, 0, sizeof(sockaddr_in));
+#else
+	m_wakeFd = -1;
+#endif // _WIN32
+
 	memset(&m_addr, 0, sizeof(sockaddr_in));
 
 	m_init = false;
 
 	m_nMessageIDInc = 0;
+
+	m_time = 0;
+	m_peerCheckTime = 0;
+
+	m_numSentDatagrams = 0;
+	m_numSendCalls = 0;
+	m_numRecvDatagrams = 0;
+	m_numRecvCalls = 0;
 }
 
 CEqRDPSocket::~CEqRDPSocket()
@@ -196,6 +361,7 @@ CEqRDPSocket::~CEqRDPSocket()
 	Close();
 }
 
+
 bool CEqRDPSocket::Init( int port )
 {
 	SOCKET sock = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
@@ -281,18 +447,61 @@ bool CEqRDPSocket::Init( int port )
 											(unsigned char)hostaddress.S_un.S_un_b.s_b4,
 											port);
 #endif // !_WIN32
+
+	// network thread sleeps on socket and gets woken up when there is something to send
+#ifdef _WIN32
+	SOCKET wakeSock = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+
+	sockaddr_in wakeAddr;
+	memset((void *)&wakeAddr, 0, sizeof(sockaddr_in));
+	wakeAddr.sin_family = AF_INET;
+	wakeAddr.sin_addr.S_un.S_addr = htonl( INADDR_LOOPBACK );
+
+	socklen_t wakeAddrLen = sizeof(sockaddr_in);
+
+	if( wakeSock == INVALID_SOCKET || 
+		ioctlsocket(wakeSock, FIONBIO, &_true) == -1 ||
+		bind(wakeSock, (struct sockaddr *)&wakeAddr, sizeof(sockaddr_in)) == SOCKET_ERROR ||
+		getsockname(wakeSock, (struct sockaddr *)&wakeAddr, &wakeAddrLen) == SOCKET_ERROR )
+	{
+		if(wakeSock != INVALID_SOCKET)
+			closesocket(wakeSock);
+		closesocket(sock);
+
+		MsgError("Failed to create wakeup socket (%s)!!!\n", NETErrorString( sock_errno ));
+		return false;
+	}
+
+	m_wakeSock = wakeSock;
+	m_wakeAddr = wakeAddr;
+#else
+	m_wakeFd = eventfd( 0, EFD_NONBLOCK );
+
+	if( m_wakeFd == -1 )
+	{
+		closesocket(sock);
+
+		MsgError("Failed to create wakeup event (%s)!!!\n", NETErrorString( sock_errno ));
+		return false;
+	}
+#endif // _WIN32
+
 	m_sock = sock;
 
 	m_init = true;
 
+	m_recvBuffer.setNum( UDP_CDP_RECV_BATCH * UDP_CDP_MAX_MESSAGEPAYLOAD );
+
+	m_freeMessages.reserve( UDP_CDP_MESSAGE_POOL_SIZE );
+	for(int i = 0; i < UDP_CDP_MESSAGE_POOL_SIZE / 4; i++)
+		m_freeMessages.append( PPNew cdp_queued_message_t );
+
 	// setup defaults
 	m_nSendTimeout					= CDP_SEND_TIMEOUT_MS;
-	m_nUnconfirmedRemoveTimeout		= CDP_SEND_REMOVE_TIMEOUT_MS;
-	m_nRecvTimeout					= CDP_RECV_TIMEOUT_MS;
+	m_nPeerTimeout					= CDP_PEER_TIMEOUT_MS;
 
 	return true;
 }
-
 void CEqRDPSocket::Close()
 {
 	if(!m_init)
@@ -300,6 +509,14 @@ void CEqRDPSocket::Close()
 
 	closesocket( m_sock );
 
+#ifdef _WIN32
+	closesocket( m_wakeSock );
+	m_wakeSock = INVALID_SOCKET;
+#else
+	close( m_wakeFd );
+	m_wakeFd = -1;
+#endif // _WIN32
+
 	m_sock = -1;
 	m_init = false;
 
@@ -310,49 +527,47 @@ void CEqRDPSocket::Close()
 		FreeMessage(m_pMessageQueue[i]);
 
 	m_pMessageQueue.clear();
-	m_receivedIds.clear();
-}
 
-void CEqRDPSocket::SendMessageStatus(  const sockaddr_in* to, short message_id, bool isOk  )
-{
-	// alloc new message
-	cdp_queued_message_t* buffer = AllocMessage();
-	buffer->addr = *to;
+	for(auto it = m_peers.begin(); !it.atEnd(); ++it)
+		delete *it;
 
-	udp_cdp_hdr_t hdr;
-	hdr.ident = UDP_CDP_IDENT;
-	hdr.protocol_version = UDP_CDP_PROTOCOL_VERSION;
-	hdr.message_id = -1;
-	hdr.flags = 0; // mark it as unguaranteed, but not necessary for sender, may be reciever
-	//hdr.crc32 = 0;
+	m_peers.clear(true);
+	m_ackPeers.clear();
 
-	// write header before return
-	buffer->Write( &hdr, sizeof( udp_cdp_hdr_t ) );
+	for(int i = 0; i < m_freeMessages.numElem(); i++)
+		delete m_freeMessages[i];
 
-	// generate message subheader
-	udp_cdp_submsg_t subhdr;
-	subhdr.data_type = CDP_DATA_PACKETSTATE;
-	subhdr.size = sizeof( udp_cdp_packetstate_t );
+	m_freeMessages.clear(true);
+	m_recvBuffer.clear(true);
+}
 
-	// write header
-	buffer->Write( &subhdr, sizeof( udp_cdp_submsg_t ));
+cdp_queued_message_t* CEqRDPSocket::AllocMessage()
+{
+	{
+		CScopedMutex m(m_poolMutex);
 
-	udp_cdp_packetstate_t statehdr;
-	statehdr.message_id = message_id;
-	statehdr.status = isOk ? 0x1 : 0x0;
+		if(m_freeMessages.numElem())
+			return m_freeMessages.popBack();
+	}
 
-	// write message size
-	buffer->Write( &statehdr, sizeof( udp_cdp_packetstate_t ) );
+	return PPNew cdp_queued_message_t;
+}
 
-	// status messages also with CRC
-	//udp_cdp_hdr_t* pModHDR = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
-	//pModHDR->crc32 = buffer->bytestream->GetCRC32();
+void CEqRDPSocket::FreeMessage( cdp_queued_message_t* message )
+{
+	message->Reset();
 
-	// sent packet state now
-	sendto( m_sock, (char*)buffer->bytestream->GetBasePointer(), buffer->bytestream->Tell(), 0, (sockaddr*)&buffer->addr, sizeof(sockaddr_in) );
+	{
+		CScopedMutex m(m_poolMutex);
 
-	// free buffer since we just allocated it
-	FreeMessage( buffer );
+		if(m_freeMessages.numElem() < UDP_CDP_MESSAGE_POOL_SIZE)
+		{
+			m_freeMessages.append( message );
+			return;
+		}
+	}
+
+	delete message;
 }
 
 // sends message
@@ -365,101 +580,63 @@ int CEqRDPSocket::Send( const char* data, int size, const sockaddr_in* to, short
 		return -1;
 	}
 
-	cdp_queued_message_t* buffer = nullptr;
-
-	bool continiousMessage = (flags & CDPSEND_GUARANTEED);
-
-	if(continiousMessage)
-	{
-		buffer = GetFreeBuffer( size + sizeof(udp_cdp_submsg_t) + 16, to, flags );
-	}
-	else
-	{
-		buffer = AllocMessage();
-
-		buffer->addr = *to;
-
-		udp_cdp_hdr_t hdr;
-		hdr.ident = UDP_CDP_IDENT;
-		hdr.protocol_version = UDP_CDP_PROTOCOL_VERSION;
-		hdr.message_id = GetMessageUniqueID();
-		hdr.flags = 0; // mark it as unguaranteed, but not necessary for sender, may be reciever
-
-		// write header before return
-		buffer->Write( &hdr, sizeof( udp_cdp_hdr_t ) );
-	}
-
-	if(!buffer)
-	{
-		msgId = CUDP_MESSAGE_ID_ERROR;
-		return -1;
-	}
-
-	if(continiousMessage)
-		m_Mutex.Lock();
-
-	buffer->addr = *to;
-
 	// generate message subheader
 	udp_cdp_submsg_t subhdr;
 	subhdr.data_type = CDP_DATA_PACKETDATA;
 	subhdr.size = size+sizeof(udp_cdp_submsg_t);
 
-	// write subheader
-	buffer->Write( &subhdr, sizeof(udp_cdp_submsg_t));
+	if( flags & CDPSEND_GUARANTEED )
+	{
+		// buffer must not be sent while it's written
+		m_Mutex.Lock();
 
-	// write message bytes
-	buffer->Write( data, size );
+		cdp_queued_message_t* buffer = GetFreeBuffer( size + sizeof(udp_cdp_submsg_t) + 16, to, flags );
 
-	// if buffer now have filled for over 80 percent, we force to send message fast
-	if( float(buffer->bytestream->Tell()) / float(UDP_CDP_MAX_MESSAGEPAYLOAD) >= UDP_CDP_FORCESEND_FILLPERCENTAGE || (flags & CDPSEND_IMMEDIATE))
-	{
-		buffer->sentTimeout = m_nSendTimeout;
-	}
+		// write subheader and message bytes
+		buffer->Write( &subhdr, sizeof(udp_cdp_submsg_t));
+		buffer->Write( data, size );
 
-	if( continiousMessage )
-	{
-		udp_cdp_hdr_t* pHdr = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
+		// if buffer now have filled for over 80 percent, we force to send message fast
+		if( float(buffer->bytestream.Tell()) / float(UDP_CDP_MAX_MESSAGEPAYLOAD) >= UDP_CDP_FORCESEND_FILLPERCENTAGE || (flags & CDPSEND_IMMEDIATE))
+		{
+			buffer->sentTimeout = m_nSendTimeout;
+		}
+
+		ScheduleSend( buffer->peer, m_nSendTimeout - buffer->sentTimeout );
+
+		udp_cdp_hdr_t* pHdr = (udp_cdp_hdr_t*)buffer->bytestream.GetBasePointer();
 
 		// set message id to return
 		msgId = pHdr->message_id;
 
 		m_Mutex.Unlock();
-	}
-	else
-	{
-		// FAKE LAG
-		if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
-		{
-			FreeMessage( buffer );
-			msgId = CUDP_MESSAGE_ID_IMMEDIATE;
-			return size;
-		}
 
-		// sent packet state now
-		sendto( m_sock, (char*)buffer->bytestream->GetBasePointer(), buffer->bytestream->Tell(), 0, (sockaddr*)&buffer->addr, sizeof(sockaddr_in) );
-
-		// free buffer since we just allocated it
-		FreeMessage( buffer );
+		// let network thread to reschedule
+		Wakeup();
 
-		msgId = CUDP_MESSAGE_ID_IMMEDIATE;
+		return size;
 	}
 
-	/*
-	// DEBUG
-	char filename[256];
+	cdp_queued_message_t* buffer = AllocMessage();
+	buffer->addr = *to;
+
+	// mark it as unguaranteed, but not necessary for sender, may be reciever
+	udp_write_header( buffer, GetMessageUniqueID(), 0 );
 
-	udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
+	buffer->Write( &subhdr, sizeof(udp_cdp_submsg_t));
+	buffer->Write( data, size );
 
-	strcpy( filename, varargs("msg_debug/cdpprepsendmsg_%d", hdr->message_id) );
+	msgId = CUDP_MESSAGE_ID_IMMEDIATE;
 
-	FILE* pFile = fopen(filename, "wb");
-	if(pFile)
+	// FAKE LAG
+	if(!net_fakelag.GetInt() || RandomInt(0, net_fakelag.GetInt()) != 0)
 	{
-		fwrite(buffer->bytestream->GetBasePointer(), buffer->bytestream->Tell(), 1, pFile);
-		fclose(pFile);
+		// sent packet state now
+		SendDatagrams( &buffer, 1 );
 	}
-	*/
+
+	// free buffer since we just allocated it
+	FreeMessage( buffer );
 
 	return size;
 }
@@ -472,170 +649,170 @@ void CEqRDPSocket::UpdateRecieve( int dtMs, CDPRecvPipe_fn recvFunc, void* recvO
 
 	ASSERT(recvFunc);
 
-	// get incomming messages from socket
-	int count = udp_select_messages( m_sock );
+	int recvSizes[UDP_CDP_RECV_BATCH];
+	sockaddr_in recvAddrs[UDP_CDP_RECV_BATCH];
 
-	for( int i = 0; i < count; i++ )
+	// get all incoming messages from socket
+	for( int i = 0; i < UDP_CDP_MAX_RECV_PER_UPDATE; )
 	{
-		sockaddr_in fromaddr;
-		socklen_t	fromlen = sizeof(sockaddr_in);
+		const int numRecv = ReceiveDatagrams( recvSizes, recvAddrs );
 
-		// zero it
-		static char message_buffer[UDP_CDP_MAX_MESSAGEPAYLOAD] = {0};
+		// nothing left to receive
+		if( numRecv < 0 )
+			break;
 
-		// receive messages
-		int r_size = recvfrom( m_sock, message_buffer, UDP_CDP_MAX_MESSAGEPAYLOAD, 0, (sockaddr*)&fromaddr, &fromlen );
+		// errors are counted too
+		i += max(numRecv, 1);
 
-		if( r_size < 0 )
-		{
-			int nErrorMsg = sock_errno;
-#ifdef _WIN32
-			// skip WSAEWOULDBLOCK, WSAENOTCONN and WSAECONNRESET to avoid receiving ICMP error
-			if( nErrorMsg != WSAEWOULDBLOCK && nErrorMsg != WSAENOTCONN && nErrorMsg != WSAECONNRESET )
-			{
-				Msg("receive error (%s)\n", NETErrorString(nErrorMsg));
-				continue;
-			}
-#else
-			// skip WSAEWOULDBLOCK, WSAENOTCONN and WSAECONNRESET to avoid receiving ICMP error
-			if( nErrorMsg != EWOULDBLOCK && nErrorMsg != ENOTCONN && nErrorMsg != ECONNRESET && nErrorMsg != EAGAIN )
-			{
-				Msg("receive error (%s)\n", NETErrorString(nErrorMsg));
-				continue;
-			}
-#endif // _WIN32
-		}
+		// datagrams are processed right in receive buffer
+		for( int j = 0; j < numRecv; j++ )
+			ProcessDatagram( m_recvBuffer.ptr() + j * UDP_CDP_MAX_MESSAGEPAYLOAD, recvSizes[j], recvAddrs[j], recvFunc, recvObj );
 
-		// FAKE LAG - do not accept recieved message
-		if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
-			continue;
+		if( numRecv > 0 && numRecv < UDP_CDP_RECV_BATCH )
+			break;
+	}
 
-		// don't receive zero packets
-		if(r_size <= 0)
-			continue;
+	// acknowledge everything received at once
+	SendAcks();
 
-		// don't receive from itself !!!
-		if( NETCompareAdr( fromaddr, m_addr ) )
-			continue;
+	// check once a second
+	if( m_time - m_peerCheckTime >= 1000 )
+	{
+		m_peerCheckTime = m_time;
+		RemoveIdlePeers();
+	}
+}
 
-		// get message header
-		udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)message_buffer;
+int CEqRDPSocket::ReceiveDatagrams( int* sizes, sockaddr_in* fromAddrs )
+{
+#ifdef UDP_CDP_USE_MMSG
+	m_numRecvCalls++;
 
-		if( hdr->ident != UDP_CDP_IDENT)
-			continue; // unk kind of message
+	mmsghdr msgs[UDP_CDP_RECV_BATCH];
+	iovec iovs[UDP_CDP_RECV_BATCH];
 
-		if( hdr->protocol_version != UDP_CDP_PROTOCOL_VERSION )
-			continue; // wrong version
+	memset(msgs, 0, sizeof(msgs));
 
-		// skip this message if it was already received
-		if( HasAnyMessageWithId( hdr->message_id, fromaddr ) )
-		{
-			// send status
-			if(hdr->flags & CDPSEND_GUARANTEED)
-			{
-                SendMessageStatus( &fromaddr, hdr->message_id, true );
-			}
+	for( int i = 0; i < UDP_CDP_RECV_BATCH; i++ )
+	{
+		iovs[i].iov_base = m_recvBuffer.ptr() + i * UDP_CDP_MAX_MESSAGEPAYLOAD;
+		iovs[i].iov_len = UDP_CDP_MAX_MESSAGEPAYLOAD;
 
-			continue;
-		}
+		msgs[i].msg_hdr.msg_name = &fromAddrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
 
-		// add to received IDs
-		if(hdr->message_id != -1)
-		{
-			cdp_receive_msgid_t		mid;
+	const int numRecv = recvmmsg( m_sock, msgs, UDP_CDP_RECV_BATCH, 0, nullptr );
 
-			mid.addr	= fromaddr;
-			mid.msgid	= hdr->message_id;
-			mid.timeMs	= 0;				// sometime i've forgotten to zero it.
+	if( numRecv < 0 )
+		return udp_check_recv_error( sock_errno ) ? 0 : -1;
 
-			Threading::CScopedMutex m( m_Mutex );
+	for( int i = 0; i < numRecv; i++ )
+		sizes[i] = msgs[i].msg_len;
+#else
+	int numRecv = 0;
 
-			m_receivedIds.append( mid );
-		}
+	for( ; numRecv < UDP_CDP_RECV_BATCH; numRecv++ )
+	{
+		socklen_t fromlen = sizeof(sockaddr_in);
 
-		int message_offset = sizeof(udp_cdp_hdr_t);
-		int msg_idx = 0;
+		m_numRecvCalls++;
 
-		// cyclic reading
-		while( message_offset < r_size )
-		{
-			// get message header
-			udp_cdp_submsg_t* subhdr = (udp_cdp_submsg_t*)(message_buffer + message_offset);
+		const int r_size = recvfrom( m_sock, (char*)m_recvBuffer.ptr() + numRecv * UDP_CDP_MAX_MESSAGEPAYLOAD, UDP_CDP_MAX_MESSAGEPAYLOAD, 0, (sockaddr*)&fromAddrs[numRecv], &fromlen );
 
-			// prevent zero messages
-			if( subhdr->size <= 0 )
+		if( r_size < 0 )
+		{
+			// report datagrams received before the error
+			if( numRecv > 0 )
 				break;
 
-			message_offset += subhdr->size;
+			return udp_check_recv_error( sock_errno ) ? 0 : -1;
+		}
 
-			// then add them to received_messages buffer list
-			// or check for status message
+		sizes[numRecv] = r_size;
+	}
+#endif // UDP_CDP_USE_MMSG
 
-			// is a packet
-			if( subhdr->data_type == CDP_DATA_PACKETDATA )
-			{
-				// if message was guaranteed
-				if(hdr->flags & CDPSEND_GUARANTEED)
-					SendMessageStatus( &fromaddr, hdr->message_id, true );
+	m_numRecvDatagrams += numRecv;
 
-				// get message size
-				int msg_size = subhdr->size-sizeof(udp_cdp_submsg_t);
-				ubyte* rbuf = ((ubyte*)subhdr) + sizeof(udp_cdp_submsg_t);
+	return numRecv;
+}
 
-				ERecvMessageKind recvFlags = (hdr->flags & CDPSEND_IS_RESPONSE) ? RECV_MSG_RESPONSE_DATA : RECV_MSG_DATA;
+void CEqRDPSocket::ProcessDatagram( ubyte* data, int size, const sockaddr_in& fromaddr, CDPRecvPipe_fn recvFunc, void* recvObj )
+{
+	// FAKE LAG - do not accept recieved message
+	if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
+		return;
 
-				// make the reciever happy
-				(recvFunc)(recvObj, rbuf, msg_size, fromaddr, hdr->message_id, recvFlags );
+	// don't receive zero packets
+	if( size < (int)sizeof(udp_cdp_hdr_t) )
+		return;
 
-				/*
-				// DEBUG
+	// don't receive from itself !!!
+	if( NETCompareAdr( fromaddr, m_addr ) )
+		return;
 
-				char filename[256];
+	// get message header
+	udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)data;
 
-				strcpy( filename, varargs("msg_debug/cdpmsg_%d_%d", hdr->message_id, msg_idx) );
+	if( hdr->ident != UDP_CDP_IDENT)
+		return; // unk kind of message
 
-				FILE* pFile = fopen(filename, "wb");
-				if(pFile)
-				{
-					fwrite(rbuf, msg_size, 1, pFile);
-					fclose(pFile);
-				}
-				*/
-			}
-			else if( subhdr->data_type == CDP_DATA_PACKETSTATE )
-			{
-				char* rbuf = ((char*)subhdr) + sizeof(udp_cdp_submsg_t);
+	if( hdr->protocol_version != UDP_CDP_PROTOCOL_VERSION )
+		return; // wrong version
 
-				// get a state and message index, then check remove message from send list
-				udp_cdp_packetstate_t* statehdr = (udp_cdp_packetstate_t*)rbuf;
+	cdp_peer_t* peer;
+	{
+		Threading::CScopedMutex m( m_Mutex );
+		peer = GetPeer( fromaddr, true );
+	}
 
-				// got state
-				//if( statehdr->status == 0x1 )
-				{
-					// make sender happy
-					(recvFunc)(recvObj, nullptr, DELIVERY_SUCCESS, fromaddr, hdr->message_id, RECV_MSG_STATUS );
+	peer->lastRecvTime = m_time;
 
-					m_Mutex.Lock();
-					RemoveMessageFromSendPool( statehdr->message_id );
-					m_Mutex.Unlock();
-				}
-				//else
-				//	CheckMessageForResend( statehdr->message_id );
-			}
+	if( hdr->flags & CDP_HDR_FLAG_ACK )
+		ProcessAcks( peer, hdr->ack_session, hdr->ack, hdr->ack_bits, recvFunc, recvObj );
 
-			msg_idx++;
+	if( hdr->flags & CDPSEND_GUARANTEED )
+	{
+		// duplicates are acknowledged again because acknowledgement could be lost
+		if( !peer->ackPending )
+		{
+			peer->ackPending = true;
+			m_ackPeers.append( peer );
 		}
+
+		// skip this message if it was already received
+		if( !peer->ReceiveSequence( hdr->session, hdr->sequence ) )
+			return;
 	}
 
-	for(int i = 0; i < m_receivedIds.numElem(); i++)
+	int message_offset = sizeof(udp_cdp_hdr_t);
+
+	// cyclic reading
+	while( message_offset + (int)sizeof(udp_cdp_submsg_t) <= size )
 	{
-		m_receivedIds[i].timeMs += dtMs;
+		// get message header
+		udp_cdp_submsg_t* subhdr = (udp_cdp_submsg_t*)(data + message_offset);
 
-		if( m_receivedIds[i].timeMs > m_nRecvTimeout )
+		// prevent zero and truncated messages
+		if( subhdr->size < sizeof(udp_cdp_submsg_t) || message_offset + subhdr->size > size )
+			break;
+
+		message_offset += subhdr->size;
+
+		// is a packet
+		if( subhdr->data_type == CDP_DATA_PACKETDATA )
 		{
-			// remove it
-			m_receivedIds.fastRemoveIndex(i);
-			i--;
+			// get message size
+			int msg_size = subhdr->size-sizeof(udp_cdp_submsg_t);
+			ubyte* rbuf = ((ubyte*)subhdr) + sizeof(udp_cdp_submsg_t);
+
+			ERecvMessageKind recvFlags = (hdr->flags & CDPSEND_IS_RESPONSE) ? RECV_MSG_RESPONSE_DATA : RECV_MSG_DATA;
+
+			// make the reciever happy
+			(recvFunc)(recvObj, rbuf, msg_size, fromaddr, hdr->message_id, recvFlags );
 		}
 	}
 }
@@ -647,171 +824,177 @@ void CEqRDPSocket::UpdateSendQueue( int timeMs, CDPRecvPipe_fn recvFunc, void* r
 
 	ASSERT(recvFunc);
 
+	m_sendBatch.clear();
+	m_failedMessages.clear();
+
+	// increment the time
+	if(m_time > UINT_MAX - timeMs)
+		m_time = 0;
+
+	m_time += timeMs;
+
+	m_Mutex.Lock();
+
+	// deadlines are collected again from messages that are left
+	for(auto it = m_peers.begin(); !it.atEnd(); ++it)
+		(*it)->sendScheduled = false;
+
 	for(int i = 0; i < m_pMessageQueue.numElem(); i++)
 	{
 		cdp_queued_message_t* buffer = m_pMessageQueue[i];
+		cdp_peer_t* peer = buffer->peer;
 
-		// after 5 retries of sending that should be removed
-		// TODO: tweak
-		if( buffer->sendTimes >= 5 )
-		{
-			Atomic::Add(buffer->removeTimeout, i);
+		buffer->sentTimeout += timeMs;
 
-			// Expired message
-			if( buffer->removeTimeout >= m_nUnconfirmedRemoveTimeout )
-			{
-				// add pending message ids
-				udp_cdp_hdr_t* pMsgHdr = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
+		udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)buffer->bytestream.GetBasePointer();
 
-				// make sender happy
-				(recvFunc)(recvObj, nullptr, DELIVERY_FAILED, buffer->addr, pMsgHdr->message_id, RECV_MSG_STATUS );
-
-				m_Mutex.Lock();
+		if( buffer->sendTimes == 0 )
+		{
+			if( buffer->sentTimeout < m_nSendTimeout )
+			{
+				ScheduleSend( peer, m_nSendTimeout - buffer->sentTimeout );
+				continue;
+			}
 
-				// remove
-				FreeMessage( buffer );
+			// wait until the oldest datagram in flight is acknowledged, see RemoveMessage
+			if( peer->IsWindowFull() )
+				continue;
 
-				m_pMessageQueue.fastRemoveIndex( i );
-				i--;
+			// message can't be written anymore
+			peer->unsent.fastRemove( buffer );
 
-				if(m_pMessageQueue.numElem() < UDP_CDP_MAX_QUEUE_BUFFERS)
-					m_SendSignal.Raise();
+			buffer->sequence = peer->sendSequence++;
+			peer->sent[buffer->sequence % UDP_CDP_SEND_WINDOW] = buffer;
 
-				m_Mutex.Unlock();
+			hdr->session = peer->session;
+			hdr->sequence = buffer->sequence;
+		}
+		else
+		{
+			const int resendTimeout = peer->GetResendTimeout( buffer->sendTimes );
+			if( buffer->sentTimeout < resendTimeout )
+			{
+				ScheduleSend( peer, resendTimeout - buffer->sentTimeout );
+				continue;
+			}
 
+			// no acknowledgement after all resends
+			if( buffer->sendTimes >= UDP_CDP_MAX_SEND_TIMES )
+			{
+				m_failedMessages.append( buffer );
 				continue;
 			}
 		}
 
-		Atomic::Add(buffer->sentTimeout, timeMs);
+		buffer->sendTimes++;
+		buffer->sentTimeout = 0;
 
-		int nSendTimeoutQueueMod = m_nSendTimeout;
+		// set the send time
+		buffer->sendTime = m_time;
 
-		if(buffer->sentTimeout >= nSendTimeoutQueueMod)
-		{
-			Atomic::Increment(buffer->sendTimes);
+		// resent or failed if not acknowledged
+		ScheduleSend( peer, peer->GetResendTimeout( buffer->sendTimes ) );
 
-			// set the send time
-			buffer->sendTime = m_time;
+		WriteAcks( buffer, peer );
 
-			bool bSend = true;
+		// FAKE LAG
+		if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
+			continue;
 
-			// FAKE LAG
-			if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
-				bSend = false;
+		m_sendBatch.append( buffer );
+	}
 
-			
-			if(bSend)
-			{
-				int s_size = sendto( m_sock, (char*)buffer->bytestream->GetBasePointer(), buffer->bytestream->Tell(), 0, (sockaddr*)&buffer->addr, sizeof(sockaddr_in) );
+	m_Mutex.Unlock();
 
-                udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
+	// all due messages are sent at once
+	if( m_sendBatch.numElem() )
+		SendDatagrams( m_sendBatch.ptr(), m_sendBatch.numElem() );
 
-				if( s_size < 0 )
-				{
-					int nErrorMsg = sock_errno;
+	for(int i = 0; i < m_failedMessages.numElem(); i++)
+	{
+		cdp_queued_message_t* buffer = m_failedMessages[i];
+		udp_cdp_hdr_t* pMsgHdr = (udp_cdp_hdr_t*)buffer->bytestream.GetBasePointer();
 
-					// skip WSAEWOULDBLOCK and WSAENOTCONN to avoid freeze
-#ifdef _WIN32
-					if( nErrorMsg != WSAEWOULDBLOCK && nErrorMsg != WSAENOTCONN )
-#else
-					if( nErrorMsg != EWOULDBLOCK && nErrorMsg != ENOTCONN )
-#endif // _WIN32
-					{
-						continue;
-					}
-				}
-			}
+		// make sender happy
+		(recvFunc)(recvObj, nullptr, DELIVERY_FAILED, buffer->addr, pMsgHdr->message_id, RECV_MSG_STATUS );
 
-			// if this message is unguaranteed, remove now
-			if( !(buffer->flags & CDPSEND_GUARANTEED) )
-			{
-				Threading::CScopedMutex m( m_Mutex );
+		RemoveMessage( buffer );
+	}
+}
 
-				FreeMessage( buffer );
+void CEqRDPSocket::SendDatagrams( cdp_queued_message_t** messages, int numMessages )
+{
+#ifdef UDP_CDP_USE_MMSG
+	mmsghdr msgs[UDP_CDP_SEND_BATCH];
+	iovec iovs[UDP_CDP_SEND_BATCH];
 
-				m_pMessageQueue.fastRemoveIndex( i );
-				i--;
+	for( int offset = 0; offset < numMessages; )
+	{
+		const int numBatch = min(numMessages - offset, UDP_CDP_SEND_BATCH);
 
-				if(m_pMessageQueue.numElem() < UDP_CDP_MAX_QUEUE_BUFFERS)
-					m_SendSignal.Raise();
+		memset(msgs, 0, sizeof(mmsghdr) * numBatch);
 
-				continue;
-			}
+		for( int i = 0; i < numBatch; i++ )
+		{
+			cdp_queued_message_t* message = messages[offset + i];
 
-			buffer->sentTimeout = 0;
+			iovs[i].iov_base = message->bytestream.GetBasePointer();
+			iovs[i].iov_len = message->bytestream.Tell();
 
-			// DEBUG
-			/*
-			char filename[256];
+			msgs[i].msg_hdr.msg_name = &message->addr;
+			msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
 
-			udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)buffer->data;
+		int numSent = sendmmsg( m_sock, msgs, numBatch, 0 );
 
-			strcpy( filename, varargs("msg_debug/cdpsendmsg_%d", hdr->message_id) );
+		Atomic::Increment(m_numSendCalls);
 
-			FILE* pFile = fopen(filename, "wb");
-			if(pFile)
-			{
-				fwrite(buffer->data, buffer->size, 1, pFile);
-				fclose(pFile);
-			}
-			*/
-		}
-	}
+		// skip the datagram which has failed, guaranteed ones are sent again after timeout
+		if( numSent < 0 )
+			numSent = 1;
+		else
+			Atomic::Add(m_numSentDatagrams, (int64)numSent);
 
-	// that's all
-	if(m_time > UINT_MAX - timeMs)
-		m_time = 0;
+		offset += numSent;
+	}
+#else
+	for( int i = 0; i < numMessages; i++ )
+	{
+		cdp_queued_message_t* message = messages[i];
 
-	// increment the time
-	m_time += timeMs;
-}
+		const int s_size = sendto( m_sock, (char*)message->bytestream.GetBasePointer(), message->bytestream.Tell(), 0, (sockaddr*)&message->addr, sizeof(sockaddr_in) );
 
-bool CEqRDPSocket::HasAnyMessageWithId( short message_id, const sockaddr_in& addr  )
-{
-	CScopedMutex m(m_Mutex);
+		Atomic::Increment(m_numSendCalls);
 
-	for(int i = 0; i < m_receivedIds.numElem(); i++)
-	{
-		if((m_receivedIds[i].msgid == message_id) && NETCompareAdr(m_receivedIds[i].addr, addr))
-			return true;
+		if( s_size >= 0 )
+			Atomic::Increment(m_numSentDatagrams);
 	}
-
-	return false;
+#endif // UDP_CDP_USE_MMSG
 }
 
-// returns a free message (it could create new buffer or return one freed)
+// returns a free message (it could create new buffer or return one not sent yet)
 cdp_queued_message_t* CEqRDPSocket::GetFreeBuffer( int freeSpaceRequired, const sockaddr_in* to, short nFlags )
 {
 	ASSERT(freeSpaceRequired < UDP_CDP_MAX_MESSAGEPAYLOAD);
 
-	{
-		Threading::CScopedMutex m(m_Mutex);
+	cdp_peer_t* peer = GetPeer( *to, true );
 
-		// find and return existing buffer
-		for( int i = 0; i < m_pMessageQueue.numElem(); i++ )
-		{
-			if(!m_pMessageQueue[i]->bytestream)
-			{
-				FreeMessage(m_pMessageQueue[i]);
-				m_pMessageQueue.fastRemoveIndex(i);
-				i--;
-				continue;
-			}
-
-			int nCurPos = m_pMessageQueue[i]->bytestream->Tell();
+	// find and return existing buffer
+	for( int i = 0; i < peer->unsent.numElem(); i++ )
+	{
+		cdp_queued_message_t* buffer = peer->unsent[i];
 
-			int nFreeSpace = ( UDP_CDP_MAX_MESSAGEPAYLOAD - m_pMessageQueue[i]->bytestream->Tell() );
+		int nCurPos = buffer->bytestream.Tell();
 
-			if( nCurPos < UDP_CDP_MIN_SEND_BUFFER &&						// check for reaching minimal send size (THIS IS UGLY)
-				nFreeSpace > freeSpaceRequired &&							// check for overflow
-				(m_pMessageQueue[i]->sendTimes == 0) &&			// don't use already sent buffers
-				(m_pMessageQueue[i]->flags == nFlags) &&					// check it's usage
-				NETCompareAdr( m_pMessageQueue[i]->addr, *to ) )			// and only deliver to needed address
-			{
-				return m_pMessageQueue[i];
-			}
+		int nFreeSpace = ( UDP_CDP_MAX_MESSAGEPAYLOAD - nCurPos );
 
+		if( nCurPos < UDP_CDP_MIN_SEND_BUFFER &&						// check for reaching minimal send size (THIS IS UGLY)
+			nFreeSpace > freeSpaceRequired &&							// check for overflow
+			buffer->flags == nFlags )									// check it's usage
+		{
+			return buffer;
 		}
 	}
 
@@ -819,90 +1002,185 @@ cdp_queued_message_t* CEqRDPSocket::GetFreeBuffer( int freeSpaceRequired, const
 
 	// if we ran out of buffers, force all to send immediately
 	// and wait thread
-	if( m_pMessageQueue.numElem() >= UDP_CDP_MAX_QUEUE_BUFFERS )
+	if( peer->numMessages >= UDP_CDP_MAX_QUEUE_BUFFERS )
 	{
-		Msg("GetFreeBuffer: exceeded UDP_CDP_MAX_QUEUE_BUFFERS (%d > %d)\n", m_pMessageQueue.numElem(), UDP_CDP_MAX_QUEUE_BUFFERS);
+		Msg("GetFreeBuffer: exceeded UDP_CDP_MAX_QUEUE_BUFFERS (%d > %d)\n", peer->numMessages, UDP_CDP_MAX_QUEUE_BUFFERS);
 
-		m_Mutex.Lock();
+		for(int i = 0; i < peer->unsent.numElem(); i++)
+			peer->unsent[i]->sentTimeout = m_nSendTimeout;
 
-		for(int i = 0; i < m_pMessageQueue.numElem(); i++)
-		{
-			m_pMessageQueue[i]->sentTimeout = m_nSendTimeout;
-		}
+		ScheduleSend( peer, 0 );
 
+		// peer is not removed while it has messages
 		m_Mutex.Unlock();
 
-		m_SendSignal.Wait( m_nSendTimeout*m_pMessageQueue.numElem() );
+		Wakeup();
+		m_SendSignal.Wait( m_nSendTimeout*UDP_CDP_MAX_QUEUE_BUFFERS );
 
 		m_SendSignal.Clear();
+
+		m_Mutex.Lock();
 	}
 
 	cdp_queued_message_t* buffer = AllocMessage();
 
+	buffer->addr = *to;
 	buffer->flags = nFlags;
+	buffer->peer = peer;
 
-	udp_cdp_hdr_t hdr;
-	hdr.ident = UDP_CDP_IDENT;
-	hdr.protocol_version = UDP_CDP_PROTOCOL_VERSION;
-	hdr.message_id = GetMessageUniqueID();
-	hdr.flags = nFlags;
-	//hdr.crc32 = 0;
+	udp_write_header( buffer, GetMessageUniqueID(), nFlags );
 
-	// write header before return
-	buffer->Write(&hdr, sizeof( udp_cdp_hdr_t ));
+	buffer->queueIndex = m_pMessageQueue.append(buffer);
 
-	m_Mutex.Lock();
-	m_pMessageQueue.append(buffer);
-	m_Mutex.Unlock();
+	peer->unsent.append(buffer);
+	peer->numMessages++;
 
 	return buffer;
 }
 
-void CEqRDPSocket::RemoveMessageFromSendPool( short message_id )
+cdp_peer_t* CEqRDPSocket::GetPeer( const sockaddr_in& addr, bool create )
 {
-	for( int i = 0; i < m_pMessageQueue.numElem(); i++ )
-	{
-		cdp_queued_message_t* pMsg = m_pMessageQueue[i];
+	const uint64 key = udp_peer_key( addr );
 
-		// this could not be happened, but i'll keep it there
-		//if( pMsg->sendTimes == 0 )
-		//	continue;
+	auto it = m_peers.find( key );
+	if( !it.atEnd() )
+		return *it;
 
-		// get message header
-		udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)m_pMessageQueue[i]->bytestream->GetBasePointer();
+	if( !create )
+		return nullptr;
 
-		if( hdr->message_id == message_id )
-		{
-			FreeMessage( m_pMessageQueue[i] );
-			m_pMessageQueue.fastRemoveIndex( i );
-			i--;
-		}
+	cdp_peer_t* peer = PPNew cdp_peer_t;
+	peer->addr = addr;
+	peer->session = RandomInt(1, USHRT_MAX);
+	peer->lastRecvTime = m_time;
+
+	m_peers.insert( key, peer );
+
+	return peer;
+}
+
+void CEqRDPSocket::WriteAcks( cdp_queued_message_t* message, cdp_peer_t* peer )
+{
+	udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)message->bytestream.GetBasePointer();
+
+	if( !peer->hasReceived )
+	{
+		hdr->flags &= ~CDP_HDR_FLAG_ACK;
+		return;
 	}
+
+	hdr->flags |= CDP_HDR_FLAG_ACK;
+	hdr->ack_session = peer->remoteSession;
+	hdr->ack = peer->recvSequence;
+	hdr->ack_bits = peer->GetAckBits();
 }
 
-void CEqRDPSocket::CheckMessageForResend( short message_id )
+void CEqRDPSocket::ProcessAcks( cdp_peer_t* peer, ushort ackSession, ushort ack, uint32 ackBits, CDPRecvPipe_fn recvFunc, void* recvObj )
 {
-	for( int i = 0; i < m_pMessageQueue.numElem(); i++ )
+	// acknowledges sequences of previous peer state
+	if( ackSession != peer->session )
+		return;
+
+	for( int i = 0; i <= 32; i++ )
 	{
-		cdp_queued_message_t* pMsg = m_pMessageQueue[i];
+		if( i > 0 && !(ackBits & (1u << (i - 1))) )
+			continue;
+
+		const ushort sequence = ack - i;
+		cdp_queued_message_t* message = peer->sent[sequence % UDP_CDP_SEND_WINDOW];
 
-		// this could not be happened, but i'll keep it there
-		if( pMsg->sendTimes == 0 )
+		if( !message || message->sequence != sequence )
 			continue;
 
-		// get message header
-		udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)m_pMessageQueue[i]->bytestream->GetBasePointer();
+		// resent datagrams can't tell which send was acknowledged
+		if( message->sendTimes == 1 )
+			peer->AddRTTSample( m_time - message->sendTime );
 
-		if( hdr->message_id == message_id )
-		{
-			Threading::CScopedMutex m( m_Mutex );
+		udp_cdp_hdr_t* pMsgHdr = (udp_cdp_hdr_t*)message->bytestream.GetBasePointer();
 
-			// repeat
-			m_pMessageQueue[i]->sendTimes = 0;
-			m_pMessageQueue[i]->sentTimeout = 0;
+		// make sender happy
+		(recvFunc)(recvObj, nullptr, DELIVERY_SUCCESS, message->addr, pMsgHdr->message_id, RECV_MSG_STATUS );
 
-			return;
+		RemoveMessage( message );
+	}
+}
+
+void CEqRDPSocket::SendAcks()
+{
+	if( !m_ackPeers.numElem() )
+		return;
+
+	for(int i = 0; i < m_ackPeers.numElem(); i++)
+	{
+		cdp_peer_t* peer = m_ackPeers[i];
+		peer->ackPending = false;
+
+		cdp_queued_message_t* message = AllocMessage();
+		message->addr = peer->addr;
+
+		udp_write_header( message, -1, 0 );
+		WriteAcks( message, peer );
+
+		m_ackMessages.append( message );
+	}
+
+	SendDatagrams( m_ackMessages.ptr(), m_ackMessages.numElem() );
+
+	for(int i = 0; i < m_ackMessages.numElem(); i++)
+		FreeMessage( m_ackMessages[i] );
+
+	m_ackMessages.clear();
+	m_ackPeers.clear();
+}
+
+void CEqRDPSocket::RemoveMessage( cdp_queued_message_t* message )
+{
+	CScopedMutex m(m_Mutex);
+
+	cdp_peer_t* peer = message->peer;
+
+	if( message->sendTimes > 0 )
+	{
+		const bool windowWasFull = peer->IsWindowFull();
+		peer->sent[message->sequence % UDP_CDP_SEND_WINDOW] = nullptr;
+
+		// messages waiting for free window slot can be sent now
+		if( windowWasFull && !peer->IsWindowFull() && peer->unsent.numElem() )
+			ScheduleSend( peer, 0 );
+	}
+	else
+		peer->unsent.fastRemove( message );
+
+	peer->numMessages--;
+
+	const int index = message->queueIndex;
+	m_pMessageQueue.fastRemoveIndex( index );
+
+	if( index < m_pMessageQueue.numElem() )
+		m_pMessageQueue[index]->queueIndex = index;
+
+	FreeMessage( message );
+
+	if( peer->numMessages < UDP_CDP_MAX_QUEUE_BUFFERS )
+		m_SendSignal.Raise();
+}
+
+void CEqRDPSocket::RemoveIdlePeers()
+{
+	CScopedMutex m(m_Mutex);
+
+	for( auto it = m_peers.begin(); !it.atEnd(); )
+	{
+		cdp_peer_t* peer = *it;
+
+		if( peer->numMessages == 0 && !peer->ackPending && m_time - peer->lastRecvTime > (uint32)m_nPeerTimeout )
+		{
+			delete peer;
+			it = m_peers.remove( it );
+			continue;
 		}
+
+		++it;
 	}
 }
 
@@ -915,15 +1193,485 @@ int CEqRDPSocket::GetMessageUniqueID()
 	return m_nMessageIDInc++;
 }
 
+void CEqRDPSocket::WaitForEvents( int timeoutMs )
+{
+	if(!m_init)
+		return;
+
+#ifdef _WIN32
+	fd_set readFDS;
+	FD_ZERO(&readFDS);
+	FD_SET(m_sock, &readFDS);
+	FD_SET(m_wakeSock, &readFDS);
+
+	timeval timeOut;
+	timeOut.tv_sec = timeoutMs / 1000;
+	timeOut.tv_usec = (timeoutMs % 1000) * 1000;
+
+	if( select( 0, &readFDS, nullptr, nullptr, timeoutMs < 0 ? nullptr : &timeOut ) <= 0 )
+		return;
+
+	if( FD_ISSET(m_wakeSock, &readFDS) )
+	{
+		char wakeBuffer[16];
+		while( recvfrom( m_wakeSock, wakeBuffer, sizeof(wakeBuffer), 0, nullptr, nullptr ) > 0 ) {}
+	}
+#else
+	pollfd fds[2];
+	fds[0].fd = m_sock;
+	fds[0].events = POLLIN;
+	fds[0].revents = 0;
+	fds[1].fd = m_wakeFd;
+	fds[1].events = POLLIN;
+	fds[1].revents = 0;
+
+	if( poll( fds, 2, timeoutMs ) <= 0 )
+		return;
+
+	// reset event counter
+	if( fds[1].revents & POLLIN )
+	{
+		eventfd_t value;
+		eventfd_read( m_wakeFd, &value );
+	}
+#endif // _WIN32
+}
+
+void CEqRDPSocket::Wakeup()
+{
+	if(!m_init)
+		return;
+
+#ifdef _WIN32
+	const char wakeByte = 0;
+	sendto( m_wakeSock, &wakeByte, 1, 0, (sockaddr*)&m_wakeAddr, sizeof(sockaddr_in) );
+#else
+	eventfd_write( m_wakeFd, 1 );
+#endif // _WIN32
+}
+
+// m_Mutex must be locked
+void CEqRDPSocket::ScheduleSend( cdp_peer_t* peer, int delayMs )
+{
+	const uint32 deadline = m_time + max(delayMs, 0);
+
+	if( !peer->sendScheduled || (int)(deadline - peer->sendDeadline) < 0 )
+	{
+		peer->sendDeadline = deadline;
+		peer->sendScheduled = true;
+	}
+}
+
+int CEqRDPSocket::GetNextTimeoutMs() const
+{
+	CScopedMutex m(m_Mutex);
+
+	int nextTimeout = -1;
+	for(auto it = m_peers.begin(); !it.atEnd(); ++it)
+	{
+		const cdp_peer_t* peer = *it;
+
+		if( !peer->sendScheduled )
+			continue;
+
+		const int timeout = max((int)(peer->sendDeadline - m_time), 0);
+
+		if( nextTimeout == -1 || timeout < nextTimeout )
+			nextTimeout = timeout;
+	}
+
+	return nextTimeout;
+}
+
 int CEqRDPSocket::GetSendPoolCount() const
 {
 	return m_pMessageQueue.numElem();
 }
 
+int CEqRDPSocket::GetPeerRTT( const sockaddr_in& addr ) const
+{
+	CScopedMutex m(m_Mutex);
+
+	auto it = m_peers.find( udp_peer_key( addr ) );
+	if( it.atEnd() || !(*it)->hasRTT )
+		return -1;
+
+	return (*it)->srtt;
+}
+
 void CEqRDPSocket::PrintStats() const
 {
 	Msg("m_pMessageQueue = %d\n", m_pMessageQueue.numElem());
-	Msg("m_receivedIds = %d\n", m_receivedIds.numElem());
+	Msg("m_peers = %d\n", m_peers.size());
+	Msg("datagrams sent = %lld in %lld calls, received = %lld in %lld calls\n", m_numSentDatagrams, m_numSendCalls, m_numRecvDatagrams, m_numRecvCalls);
+}
+
+void CEqRDPSocket::GetIOStats( int64& sentDatagrams, int64& sendCalls, int64& recvDatagrams, int64& recvCalls ) const
+{
+	sentDatagrams = Atomic::Load(m_numSentDatagrams);
+	sendCalls = Atomic::Load(m_numSendCalls);
+	recvDatagrams = m_numRecvDatagrams;
+	recvCalls = m_numRecvCalls;
 }
 
 }; // namespace CUDP
+
+//----------------------------------------------------------------------------
+
+static void UDPBenchRecv(void* thisptr, ubyte* data, int size, const sockaddr_in& from, short msgId, Networking::ERecvMessageKind type)
+{
+	if(type != Networking::RECV_MSG_STATUS)
+		(*(int64*)thisptr)++;
+}
+
+// clients send guaranteed messages to server each round and wait for acknowledgements
+DECLARE_CMD(net_udp_bench, "Loopback datagram benchmark. Arguments: [number of clients] [seconds] [messages per round]", 0)
+{
+	using namespace Networking;
+
+	const int numClients = CMD_ARGC > 0 ? max(1, atoi(CMD_ARGV(0).ToCString())) : 64;
+	const float duration = CMD_ARGC > 1 ? max(0.1f, (float)atof(CMD_ARGV(1).ToCString())) : 5.0f;
+	const int messagesPerRound = CMD_ARGC > 2 ? max(1, atoi(CMD_ARGV(2).ToCString())) : 1;
+
+	const int serverPort = DEFAULT_SERVERPORT + 100;
+
+	CEqRDPSocket server;
+	if(!server.Init( serverPort ))
+		return;
+
+	sockaddr_in serverAddr;
+	memset(&serverAddr, 0, sizeof(sockaddr_in));
+	serverAddr.sin_family = AF_INET;
+	serverAddr.sin_port = htons( serverPort );
+	serverAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+	Array<CEqRDPSocket*> clients(PP_SL);
+	for(int i = 0; i < numClients; i++)
+	{
+		CEqRDPSocket* client = PPNew CEqRDPSocket();
+		clients.append(client);
+
+		if(!client->Init( 0 ))
+			break;
+	}
+
+	if(clients.numElem() == numClients)
+	{
+		ubyte payload[64];
+		memset(payload, 0x55, sizeof(payload));
+
+		int64 serverMessages = 0;
+		int64 clientMessages = 0;
+
+		CEqTimer timer;
+		CEqTimer frameTimer;
+		CEqTimer serverTimer;
+		double frameTime = 0.0;
+		double serverTime = 0.0;
+
+		while(timer.GetTime() < duration)
+		{
+			frameTime += frameTimer.GetTime(true) * 1000.0;
+			const int dtMs = (int)frameTime;
+			frameTime -= dtMs;
+
+			for(CEqRDPSocket* client : clients)
+			{
+				for(int i = 0; i < messagesPerRound; i++)
+				{
+					short msgId;
+					client->Send( (const char*)payload, sizeof(payload), &serverAddr, msgId, CDPSEND_GUARANTEED | CDPSEND_IMMEDIATE );
+				}
+
+				client->UpdateSendQueue( dtMs, UDPBenchRecv, &clientMessages );
+			}
+
+			serverTimer.GetTime(true);
+			server.UpdateSendQueue( dtMs, UDPBenchRecv, &serverMessages );
+			server.UpdateRecieve( dtMs, UDPBenchRecv, &serverMessages );
+			serverTime += serverTimer.GetTime();
+
+			for(CEqRDPSocket* client : clients)
+				client->UpdateRecieve( dtMs, UDPBenchRecv, &clientMessages );
+		}
+
+		const double totalTime = timer.GetTime();
+
+		int64 sentDatagrams, sendCalls, recvDatagrams, recvCalls;
+		server.GetIOStats( sentDatagrams, sendCalls, recvDatagrams, recvCalls );
+
+		MsgInfo("net_udp_bench: %d clients, %.1f s: server received %.0f datagrams/s (%.0f messages/s), sent %.0f acks/s\n",
+			numClients, totalTime, recvDatagrams / totalTime, serverMessages / totalTime, sentDatagrams / totalTime);
+		MsgInfo("  server time %.2f us per received datagram, datagrams per system call: %.1f received, %.1f sent\n",
+			serverTime * 1000000.0 / max(recvDatagrams, (int64)1), recvDatagrams / (double)max(recvCalls, (int64)1), sentDatagrams / (double)max(sendCalls, (int64)1));
+	}
+
+	for(CEqRDPSocket* client : clients)
+		delete client;
+}
+
+//----------------------------------------------------------------------------
+
+struct UDPLossDatagram
+{
+	sockaddr_in		to;
+	uint32			releaseTime;
+	int				size;
+	ubyte			data[Networking::MAX_MESSAGE_LENGTH];
+};
+
+struct UDPLossTestState
+{
+	Map<int, int>	deliveryStatus{ PP_SL };	// by datagram message id; -1 while pending
+	Array<short>	messageIds{ PP_SL };		// datagram message id of each sent message
+	Array<int>		received{ PP_SL };
+	int				numPending{ 0 };
+	int				numDelivered{ 0 };
+	int				numFailed{ 0 };
+	int				numUnexpected{ 0 };
+};
+
+static void UDPLossTestRecv(void* thisptr, ubyte* data, int size, const sockaddr_in& from, short msgId, Networking::ERecvMessageKind type)
+{
+	UDPLossTestState* state = (UDPLossTestState*)thisptr;
+
+	if(type == Networking::RECV_MSG_STATUS)
+	{
+		// each datagram must get exactly one status
+		auto it = state->deliveryStatus.find(msgId);
+		if(it.atEnd() || *it != -1)
+		{
+			state->numUnexpected++;
+			return;
+		}
+
+		*it = size;
+		state->numPending--;
+
+		if(size == Networking::DELIVERY_SUCCESS)
+			state->numDelivered++;
+		else
+			state->numFailed++;
+		return;
+	}
+
+	int index = -1;
+	if(size >= (int)sizeof(int))
+		memcpy(&index, data, sizeof(int));
+
+	if(index < 0 || index >= state->received.numElem())
+	{
+		state->numUnexpected++;
+		return;
+	}
+
+	state->received[index]++;
+}
+
+static SOCKET UDPLossRelayOpen(int port)
+{
+	SOCKET sock = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if(sock == INVALID_SOCKET)
+		return INVALID_SOCKET;
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(sockaddr_in));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons( port );
+	addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+#ifdef _WIN32
+	unsigned long _true = 1;
+	const bool nonBlocking = ioctlsocket(sock, FIONBIO, &_true) != -1;
+#else
+	const bool nonBlocking = fcntl( sock, F_SETFL, O_NONBLOCK ) != -1;
+#endif // _WIN32
+
+	if(!nonBlocking || bind(sock, (struct sockaddr *)&addr, sizeof(sockaddr_in)) == SOCKET_ERROR)
+	{
+		closesocket(sock);
+		return INVALID_SOCKET;
+	}
+
+	return sock;
+}
+
+// sender and receiver talk through relay which drops, duplicates and delays datagrams.
+// Every message must be received exactly once and every acknowledged message must be received
+DECLARE_CMD(net_udp_losstest, "Lossy loopback reliability test. Arguments: [loss percent] [duplicate percent] [max delay ms] [number of messages]", 0)
+{
+	using namespace Networking;
+
+	const int lossPercent = CMD_ARGC > 0 ? clamp(atoi(CMD_ARGV(0).ToCString()), 0, 90) : 20;
+	const int duplicatePercent = CMD_ARGC > 1 ? clamp(atoi(CMD_ARGV(1).ToCString()), 0, 100) : 5;
+	const int maxDelay = CMD_ARGC > 2 ? max(0, atoi(CMD_ARGV(2).ToCString())) : 50;
+	const int numMessages = CMD_ARGC > 3 ? max(1, atoi(CMD_ARGV(3).ToCString())) : 2000;
+
+	const int senderPort = DEFAULT_SERVERPORT + 101;
+	const int receiverPort = DEFAULT_SERVERPORT + 102;
+	const int relayPort = DEFAULT_SERVERPORT + 103;
+
+	CEqRDPSocket sender;
+	CEqRDPSocket receiver;
+	if(!sender.Init( senderPort ) || !receiver.Init( receiverPort ))
+		return;
+
+	SOCKET relay = UDPLossRelayOpen( relayPort );
+	if(relay == INVALID_SOCKET)
+	{
+		MsgError("net_udp_losstest: failed to open relay socket\n");
+		return;
+	}
+
+	sockaddr_in relayAddr;
+	memset(&relayAddr, 0, sizeof(sockaddr_in));
+	relayAddr.sin_family = AF_INET;
+	relayAddr.sin_port = htons( relayPort );
+	relayAddr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+	sockaddr_in senderAddr = relayAddr;
+	senderAddr.sin_port = htons( senderPort );
+
+	sockaddr_in receiverAddr = relayAddr;
+	receiverAddr.sin_port = htons( receiverPort );
+
+	UDPLossTestState senderState;
+	UDPLossTestState receiverState;
+	receiverState.received.setNum( numMessages );
+	memset(receiverState.received.ptr(), 0, sizeof(int) * numMessages);
+
+	Array<UDPLossDatagram*> inFlight(PP_SL);
+	UDPLossDatagram* datagram = PPNew UDPLossDatagram;
+
+	int numSent = 0;
+	int numRelayed = 0;
+	int numDropped = 0;
+	int numDuplicated = 0;
+
+	CEqTimer timer;
+	CEqTimer frameTimer;
+	double frameTime = 0.0;
+
+	ubyte payload[1024];
+	memset(payload, 0x55, sizeof(payload));
+
+	// all datagrams are either acknowledged or failed
+	while((numSent < numMessages || senderState.numPending > 0) && timer.GetTime() < 120.0)
+	{
+		frameTime += frameTimer.GetTime(true) * 1000.0;
+		const int dtMs = (int)frameTime;
+		frameTime -= dtMs;
+
+		const uint32 curTime = (uint32)(timer.GetTime() * 1000.0);
+
+		// don't let Send wait for acknowledgements as they come from this thread
+		while(numSent < numMessages && sender.GetSendPoolCount() < UDP_CDP_MAX_QUEUE_BUFFERS - 1)
+		{
+			// various sizes so datagrams carry different number of messages
+			memcpy(payload, &numSent, sizeof(int));
+
+			short msgId;
+			sender.Send( (const char*)payload, RandomInt(sizeof(int), sizeof(payload)), &relayAddr, msgId, CDPSEND_GUARANTEED );
+			numSent++;
+
+			senderState.messageIds.append(msgId);
+			if(!senderState.deliveryStatus.contains(msgId))
+			{
+				senderState.deliveryStatus[msgId] = -1;
+				senderState.numPending++;
+			}
+		}
+
+		sender.UpdateSendQueue( dtMs, UDPLossTestRecv, &senderState );
+		receiver.UpdateSendQueue( dtMs, UDPLossTestRecv, &receiverState );
+
+		// relay datagrams in both directions
+		for(;;)
+		{
+			sockaddr_in fromAddr;
+			socklen_t fromAddrLen = sizeof(sockaddr_in);
+
+			datagram->size = recvfrom( relay, (char*)datagram->data, sizeof(datagram->data), 0, (sockaddr*)&fromAddr, &fromAddrLen );
+			if(datagram->size < 0)
+				break;
+
+			numRelayed++;
+
+			if(RandomInt(0, 99) < lossPercent)
+			{
+				numDropped++;
+				continue;
+			}
+
+			datagram->to = (fromAddr.sin_port == senderAddr.sin_port) ? receiverAddr : senderAddr;
+			datagram->releaseTime = curTime + RandomInt(0, maxDelay);
+
+			if(RandomInt(0, 99) < duplicatePercent)
+			{
+				UDPLossDatagram* duplicate = PPNew UDPLossDatagram;
+				*duplicate = *datagram;
+				duplicate->releaseTime = curTime + RandomInt(0, maxDelay);
+				inFlight.append(duplicate);
+				numDuplicated++;
+			}
+
+			inFlight.append(datagram);
+			datagram = PPNew UDPLossDatagram;
+		}
+
+		// random delays are reordering datagrams
+		for(int i = 0; i < inFlight.numElem(); i++)
+		{
+			UDPLossDatagram* delayed = inFlight[i];
+			if((int)(curTime - delayed->releaseTime) < 0)
+				continue;
+
+			sendto( relay, (char*)delayed->data, delayed->size, 0, (sockaddr*)&delayed->to, sizeof(sockaddr_in) );
+
+			delete delayed;
+			inFlight.fastRemoveIndex(i--);
+		}
+
+		sender.UpdateRecieve( dtMs, UDPLossTestRecv, &senderState );
+		receiver.UpdateRecieve( dtMs, UDPLossTestRecv, &receiverState );
+
+		Platform_Sleep(1);
+	}
+
+	int numReceived = 0;
+	int numDuplicateReceived = 0;
+	int numLost = 0;
+	int numLostAcknowledged = 0;
+	for(int i = 0; i < numSent; i++)
+	{
+		numReceived += min(receiverState.received[i], 1);
+		numDuplicateReceived += max(receiverState.received[i] - 1, 0);
+
+		if(receiverState.received[i])
+			continue;
+
+		// failed messages might have been received with their acknowledgements lost, but acknowledged ones must be received
+		numLost++;
+		if(senderState.deliveryStatus[senderState.messageIds[i]] != DELIVERY_FAILED)
+			numLostAcknowledged++;
+	}
+
+	const bool passed = numSent == numMessages && senderState.numPending == 0 && numDuplicateReceived == 0 && numLostAcknowledged == 0 &&
+		receiverState.numUnexpected == 0 && senderState.numUnexpected == 0;
+
+	MsgInfo("net_udp_losstest: %d messages in %.1f s, %d%% loss, %d%% duplicates, %d ms max delay\n", numMessages, timer.GetTime(), lossPercent, duplicatePercent, maxDelay);
+	MsgInfo("  relay: %d datagrams, %d dropped, %d duplicated\n", numRelayed, numDropped, numDuplicated);
+	MsgInfo("  sender: %d datagrams acknowledged, %d failed, rtt %d ms\n", senderState.numDelivered, senderState.numFailed, sender.GetPeerRTT( relayAddr ));
+	MsgInfo("  receiver: %d received, %d duplicates, %d lost\n", numReceived, numDuplicateReceived, numLost);
+
+	if(passed)
+		MsgInfo("net_udp_losstest: PASSED\n");
+	else
+		MsgError("net_udp_losstest: FAILED\n");
+
+	for(UDPLossDatagram* delayed : inFlight)
+		delete delayed;
+	delete datagram;
+
+	closesocket(relay);
+}
@@ -19,6 +19,7 @@ struct sockaddr_in;
 namespace Networking
 {
 struct cdp_queued_message_t;
+struct cdp_peer_t;
 
 class CEqRDPSocket
 {
@@ -36,21 +37,48 @@ public:
 	void							UpdateRecieve( int dtMs, CDPRecvPipe_fn recvFunc, void* recvObj );
 	void							UpdateSendQueue( int dtMs, CDPRecvPipe_fn recvFunc, void* recvObj );
 
+	// blocks until there is incoming data, Wakeup is called or timeout has passed (-1 is infinite)
+	void							WaitForEvents( int timeoutMs );
+
+	// interrupts WaitForEvents. Can be called from any thread
+	void							Wakeup();
+
+	// time until queued message has to be sent or dropped, -1 if there is nothing to send
+	int								GetNextTimeoutMs() const;
+
 	int								GetSendPoolCount() const;
 
+	// smoothed round trip time to the address, -1 if not measured yet
+	int								GetPeerRTT( const sockaddr_in& addr ) const;
+
 	void							PrintStats() const;
+	void							GetIOStats( int64& sentDatagrams, int64& sendCalls, int64& recvDatagrams, int64& recvCalls ) const;
 
 	sockaddr_in						GetAddress() const { return m_addr; }
 
 protected:
-	cdp_queued_message_t*			GetFreeBuffer( int freeSpaceRequired, const sockaddr_in* to, short nFlags );
+	// messages are pooled and keep their buffers
+	cdp_queued_message_t*			AllocMessage();
+	void							FreeMessage( cdp_queued_message_t* message );
+
+	// sends datagrams using as few system calls as possible
+	void							SendDatagrams( cdp_queued_message_t** messages, int numMessages );
 
-	bool							HasAnyMessageWithId( short message_id, const sockaddr_in& addr );
+	// receives datagrams into m_recvBuffer. Returns -1 if there is nothing to receive
+	int								ReceiveDatagrams( int* sizes, sockaddr_in* fromAddrs );
+	void							ProcessDatagram( ubyte* data, int size, const sockaddr_in& fromaddr, CDPRecvPipe_fn recvFunc, void* recvObj );
 
-	void							RemoveMessageFromSendPool( short message_id );
-	void							CheckMessageForResend( short message_id );
+	// m_Mutex must be locked
+	cdp_queued_message_t*			GetFreeBuffer( int freeSpaceRequired, const sockaddr_in* to, short nFlags );
+	cdp_peer_t*						GetPeer( const sockaddr_in& addr, bool create );
+	void							ScheduleSend( cdp_peer_t* peer, int delayMs );
 
-	void							SendMessageStatus( const sockaddr_in* to, short message_id, bool isOk );
+	void							WriteAcks( cdp_queued_message_t* message, cdp_peer_t* peer );
+	void							ProcessAcks( cdp_peer_t* peer, ushort ackSession, ushort ack, uint32 ackBits, CDPRecvPipe_fn recvFunc, void* recvObj );
+	void							SendAcks();
+
+	void							RemoveMessage( cdp_queued_message_t* message );
+	void							RemoveIdlePeers();
 
 	int								GetMessageUniqueID();
 
@@ -59,28 +87,42 @@ private:
 
 	SOCKET 							m_sock;
 
-	sockaddr_in						m_addr;
+#ifdef _WIN32
+	SOCKET							m_wakeSock;		// loopback socket which only receives wakeups
+	sockaddr_in						m_wakeAddr;
+#else
+	int								m_wakeFd;		// eventfd
+#endif // _WIN32
 
-	struct cdp_receive_msgid_t
-	{
-		sockaddr_in		addr;
-		short			msgid;
-		int				timeMs;
-	};
+	sockaddr_in						m_addr;
 
-	// messages are not limited, but they are splitted
+	// guaranteed messages of all peers which are waiting for send or acknowledgement
 	Array<cdp_queued_message_t*> 	m_pMessageQueue{ PP_SL };
-	Array<cdp_receive_msgid_t>		m_receivedIds{ PP_SL };
+
+	Map<uint64, cdp_peer_t*>		m_peers{ PP_SL };
+	Array<cdp_peer_t*>				m_ackPeers{ PP_SL };			// peers to send acknowledgements to
+	Array<cdp_queued_message_t*>	m_failedMessages{ PP_SL };
+
+	Array<cdp_queued_message_t*>	m_freeMessages{ PP_SL };
+	Array<cdp_queued_message_t*>	m_sendBatch{ PP_SL };
+	Array<cdp_queued_message_t*>	m_ackMessages{ PP_SL };
+	Array<ubyte>					m_recvBuffer{ PP_SL };
 
 	int								m_nMessageIDInc;
 
 	int								m_nSendTimeout;
-	int								m_nUnconfirmedRemoveTimeout;
-	int								m_nRecvTimeout;
+	int								m_nPeerTimeout;
 
 	uint32							m_time;
+	uint32							m_peerCheckTime;
+
+	volatile int64					m_numSentDatagrams;
+	volatile int64					m_numSendCalls;
+	int64							m_numRecvDatagrams;
+	int64							m_numRecvCalls;
 
-	Threading::CEqMutex				m_Mutex;
+	mutable Threading::CEqMutex		m_Mutex;
+	Threading::CEqMutex				m_poolMutex;
 	Threading::CEqSignal			m_SendSignal;
 };
 
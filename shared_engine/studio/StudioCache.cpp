@@ -8,6 +8,8 @@
 #include "core/core_common.h"
 #include "core/ConVar.h"
 #include "core/ConCommand.h"
+#include "core/IEqParallelJobs.h"
+#include "core/IFileSystem.h"
 #include "utils/KeyValues.h"
 
 #include "materialsystem1/IMaterialSystem.h"
@@ -17,7 +19,7 @@
 #include "StudioGeom.h"
 
 
-DECLARE_CVAR(job_modelLoader, "0", "Load models in parallel threads", CV_ARCHIVE);
+DECLARE_CVAR(job_modelLoader, "1", "Load models in parallel threads", CV_ARCHIVE);
 
 CStaticAutoPtr<CStudioCache> g_studioModelCache;
 
@@ -31,6 +33,52 @@ DECLARE_CMD(egf_info, "Print loaded EGF info", CV_CHEAT)
 	}
 }
 
+DECLARE_CMD(egf_bench_precache, "Measures loading time of models listed in text file. Usage: egf_bench_precache <listFile> [sequential]", CV_CHEAT)
+{
+	if (CMD_ARGC == 0)
+	{
+		MsgWarning("Usage: egf_bench_precache <listFile> [sequential]\n");
+		return;
+	}
+
+	char* listBuffer = (char*)g_fileSystem->GetFileBuffer(CMD_ARGV(0).ToCString());
+	if (!listBuffer)
+	{
+		MsgError("Can't open '%s'\n", CMD_ARGV(0).ToCString());
+		return;
+	}
+
+	Array<EqString> lines(PP_SL);
+	xstrsplit(listBuffer, "\n", lines);
+	PPFree(listBuffer);
+
+	Array<const char*> modelNames(PP_SL);
+	for (EqString& line : lines)
+	{
+		line = line.TrimSpaces();
+		if (line.Length() && g_studioModelCache->GetModelIndex(line) == CACHE_INVALID_MODEL)
+			modelNames.append(line.ToCString());
+	}
+
+	const bool sequential = CMD_ARGC > 1 && atoi(CMD_ARGV(1).ToCString());
+
+	CEqTimer timer;
+	timer.GetTime(true);
+
+	if (sequential)
+	{
+		for (const char* modelName : modelNames)
+			g_studioModelCache->PrecacheModel(modelName, false);
+	}
+	else
+	{
+		g_studioModelCache->PrecacheModels(modelNames);
+	}
+
+	const double loadTime = timer.GetTime(true);
+	MsgInfo("%d models loaded (%s) in %.2f ms\n", modelNames.numElem(), sequential ? "sequential" : "parallel", loadTime * 1000.0);
+}
+
 IMaterialPtr CStudioCache::GetErrorMaterial()
 {
 	InitErrorMaterial();
@@ -53,6 +101,32 @@ void CStudioCache::InitErrorMaterial()
 
 // caches model and returns it's index
 int CStudioCache::PrecacheModel(const char* modelName)
+{
+	return PrecacheModel(modelName, job_modelLoader.GetBool());
+}
+
+void CStudioCache::PrecacheModels(ArrayCRef<const char*> modelNames, ArrayRef<int> modelIndices)
+{
+	ASSERT(!modelIndices.numElem() || modelIndices.numElem() == modelNames.numElem());
+
+	// start loading of all models first so job threads are busy while we wait
+	Array<int> indices(PP_SL);
+	indices.reserve(modelNames.numElem());
+
+	for (const char* modelName : modelNames)
+		indices.append(PrecacheModel(modelName, true));
+
+	for (int i = 0; i < indices.numElem(); ++i)
+	{
+		CEqStudioGeom* model = m_cachedList[indices[i] == CACHE_INVALID_MODEL ? 0 : indices[i]];
+		model->WaitForLoading();
+
+		if (modelIndices.numElem())
+			modelIndices[i] = indices[i];
+	}
+}
+
+int CStudioCache::PrecacheModel(const char* modelName, bool useJob)
 {
 	if (strlen(modelName) <= 0)
 		return CACHE_INVALID_MODEL;
@@ -87,8 +161,12 @@ int CStudioCache::PrecacheModel(const char* modelName)
 
 		const int cacheIdx = m_cachedList.numElem();
 
+		// there is no one to run loading stages without job threads
+		if (!g_parallelJobs->GetJobThreadsCount())
+			useJob = false;
+
 		CEqStudioGeom* pModel = PPNew CEqStudioGeom();
-		if (pModel->LoadModel(str, job_modelLoader.GetBool()))
+		if (pModel->LoadModel(str, useJob))
 		{
 			int newIdx = m_cachedList.append(pModel);
 			ASSERT(newIdx == cacheIdx);
@@ -107,6 +185,66 @@ int CStudioCache::PrecacheModel(const char* modelName)
 	return idx;
 }
 
+void CStudioCache::AddLoadTask(CEqStudioGeom* model, int stage)
+{
+	{
+		Threading::CScopedMutex m(m_loadTasksMutex);
+		m_loadTasks.append({ model, stage });
+	}
+
+	// start new worker if there are free job threads
+	const int maxWorkers = g_parallelJobs->GetJobThreadsCount();
+	while (true)
+	{
+		const int numWorkers = Atomic::Load(m_loadWorkers);
+		if (numWorkers >= maxWorkers)
+			return;
+
+		if (Atomic::CompareExchange(m_loadWorkers, numWorkers, numWorkers + 1) == numWorkers)
+			break;
+	}
+
+	g_parallelJobs->AddJob(JOB_TYPE_SPOOL_EGF, [this](void*, int) {
+		LoadWorkerJob();
+	});
+	g_parallelJobs->Submit();
+}
+
+bool CStudioCache::RunLoadTask()
+{
+	LoadTask task;
+	{
+		Threading::CScopedMutex m(m_loadTasksMutex);
+		if (!m_loadTasks.numElem())
+			return false;
+
+		// dependent stages of last parsed model are taken first
+		task = m_loadTasks.popBack();
+	}
+
+	task.model->RunLoadStage(task.stage);
+	return true;
+}
+
+void CStudioCache::LoadWorkerJob()
+{
+	while (true)
+	{
+		while (RunLoadTask()) {}
+
+		Atomic::Decrement(m_loadWorkers);
+
+		// task could be added after queue was found empty
+		{
+			Threading::CScopedMutex m(m_loadTasksMutex);
+			if (!m_loadTasks.numElem())
+				break;
+		}
+
+		Atomic::Increment(m_loadWorkers);
+	}
+}
+
 // returns count of cached models
 int	CStudioCache::GetCachedModelCount() const
 {
@@ -171,7 +309,7 @@ void CStudioCache::ReleaseCache()
 		if (m_cachedList[i])
 		{
 			// wait for loading completion
-			m_cachedList[i]->GetStudioHdr();
+			m_cachedList[i]->WaitForLoading();
 			delete m_cachedList[i];
 		}
 	}
@@ -26,6 +26,11 @@ public:
 
 	// caches model and returns it's index
 	int						PrecacheModel(const char* modelName);
+	int						PrecacheModel(const char* modelName, bool useJob);
+
+	// caches models in parallel and waits for their loading, calling thread takes part in loading
+	void					PrecacheModels(ArrayCRef<const char*> modelNames, ArrayRef<int> modelIndices = nullptr);
+
 	int						GetCachedModelCount() const;
 
 	CEqStudioGeom*			GetModel(int index) const;
@@ -43,11 +48,26 @@ public:
 	void					PrintLoadedModels() const;
 
 private:
+	struct LoadTask
+	{
+		CEqStudioGeom*		model;
+		int					stage;
+	};
+
 	void					InitErrorMaterial();
 
+	// loading stages of models are run by job threads and threads waiting for models
+	void					AddLoadTask(CEqStudioGeom* model, int stage);
+	bool					RunLoadTask();
+	void					LoadWorkerJob();
+
 	Map<int, int>			m_cacheIndex{ PP_SL };
 	Array<CEqStudioGeom*>	m_cachedList{ PP_SL };
 
+	Array<LoadTask>			m_loadTasks{ PP_SL };
+	Threading::CEqMutex		m_loadTasksMutex;
+	volatile int			m_loadWorkers{ 0 };
+
 	IVertexFormat*			m_egfFormat[2]{ nullptr };
 	IMaterialPtr			m_errorMaterial;
 };
@@ -8,8 +8,11 @@
 #include "core/core_common.h"
 #include "core/IEqParallelJobs.h"
 #include "core/ConVar.h"
+#include "core/ConCommand.h"
 
 #include "math/Utility.h"
+#include "math/Random.h"
+#include "utils/TriangleBVH.h"
 
 #include "studiofile/StudioLoader.h"
 #include "StudioGeom.h"
@@ -182,15 +185,14 @@ static bool TransformEGFVertex(EGFHwVertex::PositionUV& vertPos, EGFHwVertex::TB
 	return bAffected;
 }
 
-static int ComputeQuaternionsForSkinning(const CEqStudioGeom* model, const Matrix4x4* boneMatrices, RenderBoneTransform* bquats)
+int ComputeQuaternionsForSkinning(ArrayCRef<studioJoint_t> joints, const Matrix4x4* boneMatrices, RenderBoneTransform* bquats)
 {
-	const studioHdr_t& studio = model->GetStudioHdr();
-	const int numBones = studio.numBones;
+	const int numBones = joints.numElem();
 
 	for (int i = 0; i < numBones; i++)
 	{
 		// FIXME: kind of slowness
-		const Matrix4x4 toAbsTransform = (!model->GetJoint(i).absTrans * boneMatrices[i]);
+		const Matrix4x4 toAbsTransform = (!joints[i].absTrans * boneMatrices[i]);
 
 		// cast matrices to quaternions
 		// note that quaternions uses transposes matrix set.
@@ -229,7 +231,7 @@ bool CEqStudioGeom::PrepareForSkinning(Matrix4x4* jointMatrices) const
 		}
 
 		RenderBoneTransform rendBoneTransforms[128];
-		const int numBones = ComputeQuaternionsForSkinning(this, drawProperties.boneTransforms, rendBoneTransforms);
+		const int numBones = ComputeQuaternionsForSkinning(ArrayCRef(m_joints, m_studio->numBones), drawProperties.boneTransforms, rendBoneTransforms);
 		g_matSystem->SetSkinningBones(ArrayCRef(rendBoneTransforms, numBones));
 
 		return true;
@@ -313,6 +315,10 @@ void CEqStudioGeom::DestroyModel()
 		SAFE_DELETE_ARRAY(m_hwGeomRefs);
 		SAFE_DELETE_ARRAY(m_joints);
 
+		for (int i = 0; i < m_meshGroupBVHs.numElem(); i++)
+			delete m_meshGroupBVHs[i];
+		m_meshGroupBVHs.clear(true);
+
 		Studio_FreeModel(m_studio);
 	}
 }
@@ -397,62 +403,70 @@ static int CopyGroupIndexDataToHWList(void* indexData, int indexSize, int curren
 	return pMesh->numIndices;
 }
 
-void CEqStudioGeom::LoadModelJob(void* data, int i)
+void CEqStudioGeom::RunLoadStage(int stage)
 {
-	CEqStudioGeom* model = (CEqStudioGeom*)data;
+	switch (stage)
+	{
+		case LOAD_STAGE_HEADER:
+		{
+			if (!LoadFromFile())
+			{
+				DestroyModel();
+				Atomic::Store(m_loadedStages, (1 << (LOAD_FINISHED + 1)) - 1);
+				return;
+			}
 
-	model->LoadMaterials();
-	model->LoadPhysicsData();
+			Atomic::Add(m_loadedStages, 1 << LOAD_STAGE_HEADER);
 
-	//g_parallelJobs->AddJob(JOB_TYPE_SPOOL_EGF, LoadPhysicsJob, data, 1, OnLoadingJobComplete);
-	g_parallelJobs->AddJob(JOB_TYPE_SPOOL_EGF, LoadVertsJob, data, 1, OnLoadingJobComplete);
-	g_parallelJobs->AddJob(JOB_TYPE_SPOOL_EGF, LoadMotionJob, data, 1, OnLoadingJobComplete);
+			for (int i = LOAD_STAGE_HEADER + 1; i < LOAD_STAGE_COUNT; ++i)
+				g_studioModelCache->AddLoadTask(this, i);
+			return;
+		}
+		case LOAD_STAGE_VERTS:
+			m_loadFailed = !LoadGenerateVertexBuffer();
+			break;
+		case LOAD_STAGE_MOTION:
+			LoadSetupBones();
+			LoadMotionPackages();
+			break;
+		case LOAD_STAGE_PHYSICS:
+			LoadPhysicsData();
+			break;
+		case LOAD_STAGE_MATERIALS:
+			LoadMaterials();
+			break;
+	}
 
-	g_parallelJobs->Submit();
-}
+	Atomic::Add(m_loadedStages, 1 << stage);
 
-void CEqStudioGeom::LoadVertsJob(void* data, int i)
-{
-	CEqStudioGeom* model = (CEqStudioGeom*)data;
-	
-	if (model->m_readyState == MODEL_LOAD_ERROR)
+	// last stage finishes loading
+	if (Atomic::Decrement(m_loading) > 0)
 		return;
 
-	if (!model->LoadGenerateVertexBuffer())
-		model->DestroyModel();
-}
-
-void CEqStudioGeom::LoadPhysicsJob(void* data, int i)
-{
-	CEqStudioGeom* model = (CEqStudioGeom*)data;
-
-	if (model->m_readyState == MODEL_LOAD_ERROR)
-		return;
+	if (m_loadFailed)
+		DestroyModel();
+	else
+		Atomic::Exchange(m_readyState, MODEL_LOAD_OK);
 
-	model->LoadPhysicsData();
+	Atomic::Add(m_loadedStages, 1 << LOAD_FINISHED);
 }
 
-void CEqStudioGeom::LoadMotionJob(void* data, int i)
+void CEqStudioGeom::WaitForLoadStage(int stage) const
 {
-	CEqStudioGeom* model = (CEqStudioGeom*)data;
-	if (model->m_readyState == MODEL_LOAD_ERROR)
-		return;
-
-	model->LoadSetupBones();
-	model->LoadMotionPackages();
+	while (!(Atomic::Load(m_loadedStages) & (1 << stage)) && Atomic::Load(m_readyState) == MODEL_LOAD_IN_PROGRESS)
+	{
+		// help with loading instead of waiting
+		if (!g_studioModelCache->RunLoadTask())
+			Threading::YieldCurrentThread();
+	}
 }
 
-void CEqStudioGeom::OnLoadingJobComplete(struct eqParallelJob_t* job)
+void CEqStudioGeom::WaitForLoading() const
 {
-	CEqStudioGeom* model = (CEqStudioGeom*)job->arguments;
-
-	if (model->m_readyState == MODEL_LOAD_ERROR)
-		return;
-	
-	if (Atomic::Decrement(model->m_loading) <= 0)
+	while (!(Atomic::Load(m_loadedStages) & (1 << LOAD_FINISHED)))
 	{
-		Atomic::Exchange(model->m_readyState, MODEL_LOAD_OK);
-		//DevMsg(DEVMSG_CORE, "EGF loading completed\n");
+		if (!g_studioModelCache->RunLoadTask())
+			Threading::YieldCurrentThread();
 	}
 }
 
@@ -463,24 +477,24 @@ bool CEqStudioGeom::LoadModel(const char* pszPath, bool useJob)
 
 	// first we switch to loading
 	Atomic::Exchange(m_readyState, MODEL_LOAD_IN_PROGRESS);
-
-	// multi-threaded version
-	if (!LoadFromFile())
-	{
-		DestroyModel();
-		return false;
-	}
+	Atomic::Store(m_loadedStages, 0);
+	m_loadFailed = false;
 
 	if (useJob)
 	{
-		m_loading = 3;
-		g_parallelJobs->AddJob(JOB_TYPE_SPOOL_EGF, LoadModelJob, this, 1, OnLoadingJobComplete);
-
-		g_parallelJobs->Submit();
+		// header failure is reported by loading state
+		Atomic::Store(m_loading, LOAD_STAGE_COUNT - 1);
+		g_studioModelCache->AddLoadTask(this, LOAD_STAGE_HEADER);
 		return true;
 	}
 
 	// single-thread version
+	if (!LoadFromFile())
+	{
+		DestroyModel();
+		return false;
+	}
+
 	LoadMaterials();
 	
 	if (!LoadGenerateVertexBuffer())
@@ -492,7 +506,8 @@ bool CEqStudioGeom::LoadModel(const char* pszPath, bool useJob)
 	LoadSetupBones();
 	LoadMotionPackages();
 	LoadPhysicsData();
-	
+
+	Atomic::Store(m_loadedStages, (1 << (LOAD_FINISHED + 1)) - 1);
 	Atomic::Exchange(m_readyState, MODEL_LOAD_OK);
 
 	return true;
@@ -507,6 +522,11 @@ bool CEqStudioGeom::LoadFromFile()
 
 	m_studio = pHdr;
 
+	// acceleration structures are built on demand
+	m_meshGroupBVHs.setNum(pHdr->numMeshGroups);
+	for (int i = 0; i < m_meshGroupBVHs.numElem(); i++)
+		m_meshGroupBVHs[i] = nullptr;
+
 	return true;
 }
 
@@ -630,11 +650,11 @@ void CEqStudioGeom::LoadMotionPackage(const char* filename)
 	if (m_readyState == MODEL_LOAD_ERROR)
 		return;
 
-	if (m_readyState != MODEL_LOAD_OK)
-	{
-		m_additionalMotionPackages.append(filename);
+	// motion stage might be running, added after it
+	WaitForLoadStage(LOAD_STAGE_MOTION);
+
+	if (m_readyState == MODEL_LOAD_ERROR)
 		return;
-	}
 
 	studioMotionData_t* motionData = Studio_LoadMotionData(filename, m_studio->numBones);
 	if (motionData)
@@ -664,17 +684,6 @@ void CEqStudioGeom::LoadMotionPackages()
 		else
 			MsgError("Can't open motion package '%s' specified in EGF\n", studio->pPackage(i)->packageName);
 	}
-
-	// load additional external motion packages requested by user
-	for (int i = 0; i < m_additionalMotionPackages.numElem(); i++)
-	{
-		studioMotionData_t* motionData = Studio_LoadMotionData(m_additionalMotionPackages[i].ToCString(), studio->numBones);
-		if (motionData)
-			m_motionData.append(motionData);
-		else
-			MsgError("Can't open motion data package '%s'!\n", m_additionalMotionPackages[i].ToCString());
-	}
-	m_additionalMotionPackages.clear(true);
 }
 
 // loads materials for studio
@@ -890,14 +899,21 @@ void CEqStudioGeom::Draw(const DrawProps& drawProperties) const
 	if (!drawProperties.bodyGroupFlags)
 		return;
 
+	// not drawn until all stages are loaded
+	if (Atomic::Load(m_readyState) != MODEL_LOAD_OK)
+		return;
+
 	RenderBoneTransform rendBoneTransforms[128];
 	ArrayCRef<RenderBoneTransform> rendBoneTransformsArray(nullptr);
-	const bool isSkinned = drawProperties.boneTransforms;
-
+	const bool isSkinned = drawProperties.boneTransforms || drawProperties.skinningBones.numElem();
 
-	if (isSkinned)
+	if (drawProperties.skinningBones.numElem())
+	{
+		rendBoneTransformsArray = drawProperties.skinningBones;
+	}
+	else if (isSkinned)
 	{
-		const int numBones = ComputeQuaternionsForSkinning(this, drawProperties.boneTransforms, rendBoneTransforms);
+		const int numBones = ComputeQuaternionsForSkinning(ArrayCRef(m_joints, GetStudioHdr().numBones), drawProperties.boneTransforms, rendBoneTransforms);
 		rendBoneTransformsArray = ArrayCRef(rendBoneTransforms, numBones);
 	}
 
@@ -998,8 +1014,8 @@ void CEqStudioGeom::Draw(const DrawProps& drawProperties) const
 
 const BoundingBox& CEqStudioGeom::GetBoundingBox() const
 {
-	while (!m_studio && GetLoadingState() == MODEL_LOAD_IN_PROGRESS) // wait for hwdata
-		Platform_Sleep(1);
+	// computed along with vertex buffers
+	WaitForLoadStage(LOAD_STAGE_VERTS);
 
 	return m_boundingBox;
 }
@@ -1017,24 +1033,21 @@ int	CEqStudioGeom::GetLoadingState() const
 
 const studioHdr_t& CEqStudioGeom::GetStudioHdr() const
 {
-	while (!m_studio && GetLoadingState() == MODEL_LOAD_IN_PROGRESS) // wait for hwdata
-		Platform_Sleep(1);
+	WaitForLoadStage(LOAD_STAGE_HEADER);
 
 	return *m_studio; 
 }
 
 const studioPhysData_t& CEqStudioGeom::GetPhysData() const 
 {
-	while (!m_studio && GetLoadingState() == MODEL_LOAD_IN_PROGRESS) // wait for hwdata
-		Platform_Sleep(1);
+	WaitForLoadStage(LOAD_STAGE_PHYSICS);
 
 	return m_physModel;
 }
 
 const studioMotionData_t& CEqStudioGeom::GetMotionData(int index) const
 {
-	while (!m_studio && GetLoadingState() == MODEL_LOAD_IN_PROGRESS) // wait for hwdata
-		Platform_Sleep(1);
+	WaitForLoadStage(LOAD_STAGE_MOTION);
 
 	return *m_motionData[index];
 }
@@ -1341,6 +1354,80 @@ CRefPtr<DecalData> CEqStudioGeom::MakeDecal(const DecalMakeInfo& info, Matrix4x4
 }
 
 
+// calls func(meshIdx, firstIndex, v0, v1, v2) for every non-degenerate triangle of mesh group
+template<typename F>
+static void ForEachMeshGroupTriangle(const studioMeshGroupDesc_t* modDesc, F func)
+{
+	for (int j = 0; j < modDesc->numMeshes; j++)
+	{
+		const studioMeshDesc_t* pMesh = modDesc->pMesh(j);
+		if (!(pMesh->vertexType & STUDIO_VERTFLAG_POS_UV))
+			continue;
+
+		const uint32* pIndices = pMesh->pVertexIdx(0);
+
+		const int numIndices = (pMesh->primitiveType == EGFPRIM_TRI_STRIP) ? pMesh->numIndices - 2 : pMesh->numIndices;
+		const int indexStep = (pMesh->primitiveType == EGFPRIM_TRI_STRIP) ? 1 : 3;
+
+		for (int k = 0; k < numIndices; k += indexStep)
+		{
+			// skip strip degenerates
+			if (pIndices[k] == pIndices[k+1] || pIndices[k] == pIndices[k+2] || pIndices[k+1] == pIndices[k+2])
+				continue;
+
+			const int even = k % 2; // handle flipped triangles on EGFPRIM_TRI_STRIP
+
+			if (even && pMesh->primitiveType == EGFPRIM_TRI_STRIP)
+			{
+				func(j, k,
+					pMesh->pPosUvs(pIndices[k + 2])->point,
+					pMesh->pPosUvs(pIndices[k + 1])->point,
+					pMesh->pPosUvs(pIndices[k])->point);
+			}
+			else
+			{
+				func(j, k,
+					pMesh->pPosUvs(pIndices[k])->point,
+					pMesh->pPosUvs(pIndices[k + 1])->point,
+					pMesh->pPosUvs(pIndices[k + 2])->point);
+			}
+		}
+	}
+}
+
+static CEqMutex s_studioBVHMutex;
+
+const CTriangleBVH& CEqStudioGeom::GetMeshGroupBVH(int meshGroupIdx) const
+{
+	CTriangleBVH* bvh = Atomic::Load(m_meshGroupBVHs[meshGroupIdx]);
+	if (bvh)
+		return *bvh;
+
+	CScopedMutex m(s_studioBVHMutex);
+
+	// could be built by other thread while we were waiting
+	bvh = m_meshGroupBVHs[meshGroupIdx];
+	if (bvh)
+		return *bvh;
+
+	PROF_EVENT("EGF BuildMeshGroupBVH");
+
+	Array<CTriangleBVH::Triangle> triangles(PP_SL);
+	ForEachMeshGroupTriangle(m_studio->pMeshGroupDesc(meshGroupIdx), [&](int meshIdx, int firstIndex, const Vector3D& v0, const Vector3D& v1, const Vector3D& v2) {
+		CTriangleBVH::Triangle& tri = triangles.append();
+		tri.v0 = v0;
+		tri.v1 = v1;
+		tri.v2 = v2;
+		tri.userId = ((int64)meshIdx << 32) | (uint)firstIndex;
+	});
+
+	bvh = PPNew CTriangleBVH();
+	bvh->Build(triangles);
+
+	Atomic::Store(m_meshGroupBVHs[meshGroupIdx], bvh);
+	return *bvh;
+}
+
 float CEqStudioGeom::CheckIntersectionWithRay(const Vector3D& rayStart, const Vector3D& rayDir, int bodyGroupFlags, int lod) const
 {
 	float f1, f2;
@@ -1371,48 +1458,101 @@ float CEqStudioGeom::CheckIntersectionWithRay(const Vector3D& rayStart, const Ve
 		if (modelDescId == EGF_INVALID_IDX)
 			continue;
 
-		const studioMeshGroupDesc_t* modDesc = studio.pMeshGroupDesc(modelDescId);
+		int64 hitTriangleId;
+		const float dist = GetMeshGroupBVH(modelDescId).TraceRay(rayStart, rayDir, hitTriangleId, true);
+		if (dist < best_dist)
+			best_dist = dist;
+	}
 
-		for(int j = 0; j < modDesc->numMeshes; j++)
-		{
-			const studioMeshDesc_t* pMesh = modDesc->pMesh(j);
+	return best_dist;
+}
 
-			const uint32* pIndices = pMesh->pVertexIdx(0);
+DECLARE_CMD(egf_bench_raypick, "Measures ray picking speed of EGF model. Usage: egf_bench_raypick <model> [numRays]", CV_CHEAT)
+{
+	if (CMD_ARGC == 0)
+	{
+		MsgWarning("Usage: egf_bench_raypick <model> [numRays]\n");
+		return;
+	}
 
-			const int numIndices = (pMesh->primitiveType == EGFPRIM_TRI_STRIP) ? pMesh->numIndices - 2 : pMesh->numIndices;
-			const int indexStep = (pMesh->primitiveType == EGFPRIM_TRI_STRIP) ? 1 : 3;
+	const int numRays = CMD_ARGC > 1 ? max(atoi(CMD_ARGV(1).ToCString()), 1) : 10000;
 
-			for (int k = 0; k < numIndices; k += indexStep)
-			{
-				// skip strip degenerates
-				if (pIndices[k] == pIndices[k+1] || pIndices[k] == pIndices[k+2] || pIndices[k+1] == pIndices[k+2])
-					continue;
+	const int modelIdx = g_studioModelCache->PrecacheModel(CMD_ARGV(0).ToCString());
+	CEqStudioGeom* model = g_studioModelCache->GetModel(modelIdx);
+	EGF_LOADING_CRITICAL_SECTION(model);
 
-				const int even = k % 2; // handle flipped triangles on EGFPRIM_TRI_STRIP
+	const studioHdr_t& studio = model->GetStudioHdr();
+	const BoundingBox& bbox = model->GetBoundingBox();
+	const float radius = length(bbox.GetSize());
 
-				Vector3D v0, v1, v2;
-				if (even && pMesh->primitiveType == EGFPRIM_TRI_STRIP)
-				{
-					v0 = pMesh->pPosUvs(pIndices[k + 2])->point;
-					v1 = pMesh->pPosUvs(pIndices[k + 1])->point;
-					v2 = pMesh->pPosUvs(pIndices[k])->point;
-				}
-				else
-				{
-					v0 = pMesh->pPosUvs(pIndices[k])->point;
-					v1 = pMesh->pPosUvs(pIndices[k + 1])->point;
-					v2 = pMesh->pPosUvs(pIndices[k + 2])->point;
-				}
+	CUniformRandomStream random;
+	random.SetSeed(numRays);
+
+	Array<Vector3D> rayStarts(PP_SL);
+	Array<Vector3D> rayDirs(PP_SL);
+	rayStarts.reserve(numRays);
+	rayDirs.reserve(numRays);
+
+	for (int i = 0; i < numRays; i++)
+	{
+		const Vector3D dir = normalize(Vector3D(random.RandomFloat(-1, 1), random.RandomFloat(-1, 1), random.RandomFloat(-1, 1)) + Vector3D(F_EPS));
+		const Vector3D target(
+			random.RandomFloat(bbox.minPoint.x, bbox.maxPoint.x), 
+			random.RandomFloat(bbox.minPoint.y, bbox.maxPoint.y), 
+			random.RandomFloat(bbox.minPoint.z, bbox.maxPoint.z));
+
+		rayStarts.append(target - dir * radius);
+		rayDirs.append(dir);
+	}
 
+	int numTriangles = 0;
+	for (int i = 0; i < studio.numMeshGroups; i++)
+	{
+		ForEachMeshGroupTriangle(studio.pMeshGroupDesc(i), [&](int, int, const Vector3D&, const Vector3D&, const Vector3D&) {
+			++numTriangles;
+		});
+	}
+
+	CEqTimer timer;
+
+	// first pick builds BVH
+	timer.GetTime(true);
+	model->CheckIntersectionWithRay(rayStarts[0], rayDirs[0], -1);
+	const double buildTime = timer.GetTime(true);
+
+	int numHits = 0;
+	for (int i = 0; i < numRays; i++)
+	{
+		if (model->CheckIntersectionWithRay(rayStarts[i], rayDirs[i], -1) < F_INFINITY)
+			++numHits;
+	}
+	const double bvhTime = timer.GetTime(true);
+
+	// brute-force reference over all LOD 0 triangles, limited to keep the command responsive
+	const int numBruteRays = min(numRays, 100);
+	int numBruteHits = 0;
+	for (int i = 0; i < numBruteRays; i++)
+	{
+		float bestDist = F_INFINITY;
+		for (int j = 0; j < studio.numBodyGroups; j++)
+		{
+			const uint8 modelDescId = studio.pLodModel(studio.pBodyGroups(j)->lodModelIndex)->modelsIndexes[0];
+			if (modelDescId == EGF_INVALID_IDX)
+				continue;
+
+			ForEachMeshGroupTriangle(studio.pMeshGroupDesc(modelDescId), [&](int, int, const Vector3D& v0, const Vector3D& v1, const Vector3D& v2) {
 				float dist = F_INFINITY;
-				if(IsRayIntersectsTriangle(v0,v1,v2, rayStart, rayDir, dist, true))
-				{
-					if(dist < best_dist && dist > 0)
-						best_dist = dist;
-				}
-			}
+				if (IsRayIntersectsTriangle(v0, v1, v2, rayStarts[i], rayDirs[i], dist, true) && dist < bestDist && dist > 0)
+					bestDist = dist;
+			});
 		}
+
+		if (bestDist < F_INFINITY)
+			++numBruteHits;
 	}
+	const double bruteTime = timer.GetTime(true);
 
-	return best_dist;
-}
\ No newline at end of file
+	MsgInfo("%s: %d triangles (all groups), BVH build %.2f ms\n", model->GetName(), numTriangles, buildTime * 1000.0);
+	MsgInfo("  BVH: %d rays, %d hits, %.0f picks/sec\n", numRays, numHits, numRays / max(bvhTime, 0.000001));
+	MsgInfo("  brute force: %d rays, %d hits, %.0f picks/sec\n", numBruteRays, numBruteHits, numBruteRays / max(bruteTime, 0.000001));
+}
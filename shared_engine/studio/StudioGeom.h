@@ -15,7 +15,9 @@ class IVertexFormat;
 class IVertexBuffer;
 class IIndexBuffer;
 class CBaseEqGeomInstancer;
+class CTriangleBVH;
 struct RenderDrawCmd;
+struct RenderBoneTransform;
 struct DecalMakeInfo;
 struct DecalData;
 struct VertexFormatDesc;
@@ -124,6 +126,9 @@ public:
 
 	const BoundingBox&			GetBoundingBox() const;
 
+	// waits for all loading stages, calling thread takes part in loading
+	void						WaitForLoading() const;
+
 	// Makes dynamic temporary decal
 	CRefPtr<DecalData>			MakeDecal(const DecalMakeInfo& info, Matrix4x4* jointMatrices, int bodyGroupFlags, int lod = 0) const;
 
@@ -157,16 +162,26 @@ private:
 		} *meshRefs{ nullptr };
 	};
 
+	// loading stages run by studio cache loader tasks.
+	// All stages depend on header only
+	enum ELoadStage : int
+	{
+		LOAD_STAGE_HEADER = 0,
+		LOAD_STAGE_VERTS,
+		LOAD_STAGE_MOTION,			// bones and motion packages
+		LOAD_STAGE_PHYSICS,
+		LOAD_STAGE_MATERIALS,
+
+		LOAD_STAGE_COUNT,
+		LOAD_FINISHED = LOAD_STAGE_COUNT,	// set after last stage is complete
+	};
+
 	bool					LoadModel(const char* pszPath, bool useJob = true);
 	void					DestroyModel();
 
-	static void				LoadModelJob(void* data, int i);
-	static void				LoadVertsJob(void* data, int i);
-	static void				LoadPhysicsJob(void* data, int i);
-	static void				LoadMotionJob(void* data, int i);
-	
-	static void				OnLoadingJobComplete(struct eqParallelJob_t* job);
-	
+	void					RunLoadStage(int stage);
+	void					WaitForLoadStage(int stage) const;
+
 	bool					LoadFromFile();
 	void					LoadMaterials();
 	void					LoadPhysicsData(); // loads physics object data
@@ -174,18 +189,21 @@ private:
 	void					LoadMotionPackages();
 	void					LoadSetupBones();
 
+	// returns ray/decal acceleration structure of mesh group, builds it on first use
+	const CTriangleBVH&		GetMeshGroupBVH(int meshGroupIdx) const;
+
 	//-----------------------------------------------
 
 	// array of material index for each group
 	FixedArray<IMaterialPtr, MAX_STUDIOMATERIALS>		m_materials;
 	FixedArray<studioMotionData_t*, MAX_MOTIONPACKAGES>	m_motionData;
 
-	Array<EqString>			m_additionalMotionPackages{ PP_SL };
 	BoundingBox				m_boundingBox; // FIXME: bounding boxes for each groups?
 	EqString				m_name;
 	
 	studioJoint_t*			m_joints{ nullptr };
 	HWGeomRef*				m_hwGeomRefs{ nullptr };	// hardware representation of models (indices)
+	mutable Array<CTriangleBVH*>	m_meshGroupBVHs{ PP_SL };
 
 	CBaseEqGeomInstancer*	m_instancer{ nullptr };
 	studioHdr_t*			m_studio{ nullptr };
@@ -199,8 +217,10 @@ private:
 
 	int						m_cacheIdx{ -1 };
 
-	mutable int				m_loading{ MODEL_LOAD_ERROR };
+	mutable int				m_loading{ MODEL_LOAD_ERROR };	// number of loading stages left
+	mutable int				m_loadedStages{ 0 };			// ELoadStage bits
 	mutable int				m_readyState{ 0 };
+	bool					m_loadFailed{ false };
 
 	EGFHwVertex*			m_softwareVerts{ nullptr };
 	bool					m_forceSoftwareSkinning{ false };
@@ -209,6 +229,9 @@ private:
 
 extern ArrayCRef<EGFHwVertex::VertexStream> g_defaultVertexStreamMapping;
 
+// converts model space bone matrices to hardware skinning transforms. Returns number of bones
+int ComputeQuaternionsForSkinning(ArrayCRef<studioJoint_t> joints, const Matrix4x4* boneMatrices, RenderBoneTransform* bquats);
+
 struct CEqStudioGeom::DrawProps
 {
 	using SetupDrawFunc = EqFunction<void(RenderDrawCmd& drawCmd)>;
@@ -217,6 +240,7 @@ struct CEqStudioGeom::DrawProps
 	ArrayCRef<EGFHwVertex::VertexStream> vertexStreamMapping{ g_defaultVertexStreamMapping };
 	IVertexFormat*	vertexFormat{ nullptr };
 	Matrix4x4*		boneTransforms{ nullptr };
+	ArrayCRef<RenderBoneTransform> skinningBones{ nullptr };	// precomputed skinning of boneTransforms, see ComputeQuaternionsForSkinning
 
 	SetupDrawFunc	setupDrawCmd;		// called once before entire EGF is drawn
 	BodyGroupFunc	setupBodyGroup;	// called multiple times before body group is drawn
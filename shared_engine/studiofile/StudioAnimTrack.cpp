@@ -0,0 +1,463 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Compressed animation tracks of motion packages
+//
+//				Rotations are stored as smallest three quaternion components
+//				(15 bits each, index of dropped component in the high bits),
+//				positions are 16 bit per component in per-track range.
+//				Constant tracks store single value, keys which can be
+//				interpolated from neighbours within error bounds are dropped.
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/ConCommand.h"
+#include "math/Random.h"
+#include "StudioAnimTrack.h"
+
+static constexpr const float ANIMTRACK_QUAT_RANGE = 1.41421356f;	// smallest three components are in -1/sqrt(2)..1/sqrt(2)
+static constexpr const int ANIMTRACK_QUAT_MAXVALUE = 32767;
+static constexpr const int ANIMTRACK_POS_MAXVALUE = 65535;
+static constexpr const int ANIMTRACK_MAX_KEYFRAME_INDEX = 65535;
+
+static void PackRotation(const Quaternion& q, uint16* out)
+{
+	const float comps[4] = { q.x, q.y, q.z, q.w };
+
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (fabsf(comps[i]) > fabsf(comps[largest]))
+			largest = i;
+	}
+
+	// q and -q are same rotation, so dropped component is always positive
+	const float sign = comps[largest] < 0.0f ? -1.0f : 1.0f;
+
+	int values[3];
+	for (int i = 0, n = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+
+		const float v = comps[i] * sign / ANIMTRACK_QUAT_RANGE + 0.5f;
+		values[n++] = clamp((int)(v * ANIMTRACK_QUAT_MAXVALUE + 0.5f), 0, ANIMTRACK_QUAT_MAXVALUE);
+	}
+
+	out[0] = values[0] | ((largest & 1) << 15);
+	out[1] = values[1] | ((largest >> 1) << 15);
+	out[2] = values[2];
+}
+
+static Quaternion UnpackRotation(const uint16* in)
+{
+	const int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+
+	float comps[4];
+	float sumSqr = 0.0f;
+	for (int i = 0, n = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+
+		const float v = ((in[n++] & 0x7fff) / (float)ANIMTRACK_QUAT_MAXVALUE - 0.5f) * ANIMTRACK_QUAT_RANGE;
+		comps[i] = v;
+		sumSqr += v * v;
+	}
+	comps[largest] = sqrtf(max(0.0f, 1.0f - sumSqr));
+
+	return Quaternion(comps[3], comps[0], comps[1], comps[2]);
+}
+
+static void PackPosition(const Vector3D& pos, const Vector3D& posMin, const Vector3D& posRange, uint16* out)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		const float v = posRange[i] > 0.0f ? (pos[i] - posMin[i]) / posRange[i] : 0.0f;
+		out[i] = clamp((int)(v * ANIMTRACK_POS_MAXVALUE + 0.5f), 0, ANIMTRACK_POS_MAXVALUE);
+	}
+}
+
+static Vector3D UnpackPosition(const uint16* in, const Vector3D& posMin, const Vector3D& posRange)
+{
+	const float scale = 1.0f / ANIMTRACK_POS_MAXVALUE;
+	return posMin + Vector3D(in[0] * scale, in[1] * scale, in[2] * scale) * posRange;
+}
+
+// normalized lerp along the shortest arc, used between keys
+static Quaternion KeyRotationLerp(const Quaternion& a, const Quaternion& b, float t)
+{
+	const float cosTheta = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	const float tb = cosTheta < 0.0f ? -t : t;
+	const float ta = 1.0f - t;
+
+	Quaternion r(a.w * ta + b.w * tb, a.x * ta + b.x * tb, a.y * ta + b.y * tb, a.z * ta + b.z * tb);
+	r.normalize();
+	return r;
+}
+
+// angle of rotation between a and b. Unlike acos of dot product this is precise for small angles
+static float RotationAngle(const Quaternion& a, const Quaternion& b)
+{
+	const Vector4D va(a.x, a.y, a.z, a.w);
+	Vector4D vb(b.x, b.y, b.z, b.w);
+	if (dot(va, vb) < 0.0f)
+		vb = -vb;
+
+	return 4.0f * atan2f(length(va - vb), length(va + vb));
+}
+
+//-------------------------------------------------------------------------
+
+int Studio_GetAnimTrackDataSize(const animtrack_t& track)
+{
+	int numValues = 0;
+	if (track.flags & ANIMTRACK_KEYFRAME_INDICES)
+		numValues += track.numKeys;
+
+	numValues += (track.flags & ANIMTRACK_CONSTANT_ROTATION) ? 3 : track.numKeys * 3;
+
+	if (!(track.flags & ANIMTRACK_CONSTANT_POSITION))
+		numValues += track.numKeys * 3;
+
+	return numValues * sizeof(uint16);
+}
+
+void Studio_CompressAnimTrack(ArrayCRef<animframe_t> frames, const AnimTrackCompressParams& params, animtrack_t& outTrack, Array<ubyte>& trackData)
+{
+	const int numFrames = frames.numElem();
+
+	outTrack.flags = 0;
+	outTrack.numKeys = 0;
+	outTrack.dataOffset = trackData.numElem();
+	outTrack.posMin = vec3_zero;
+	outTrack.posRange = vec3_zero;
+
+	if (!numFrames)
+	{
+		// identity track
+		uint16 rotation[3];
+		PackRotation(identity(), rotation);
+
+		outTrack.flags = ANIMTRACK_CONSTANT_ROTATION | ANIMTRACK_CONSTANT_POSITION;
+		outTrack.numKeys = 1;
+		trackData.append((ubyte*)rotation, sizeof(rotation));
+		return;
+	}
+
+	Array<Quaternion> rotations(PP_SL);
+	rotations.setNum(numFrames);
+
+	BoundingBox posBounds;
+	for (int i = 0; i < numFrames; ++i)
+	{
+		const Vector3D& ang = frames[i].angBoneAngles;
+		rotations[i] = Quaternion(ang.x, ang.y, ang.z);
+
+		posBounds.AddVertex(frames[i].vecBonePosition);
+	}
+
+	// constant track elimination
+	bool constantRotation = true;
+	bool constantPosition = true;
+	{
+		uint16 packed[3];
+		PackRotation(rotations[0], packed);
+		const Quaternion firstRotation = UnpackRotation(packed);
+
+		for (int i = 0; i < numFrames; ++i)
+		{
+			if (constantRotation && RotationAngle(firstRotation, rotations[i]) > params.rotationError)
+				constantRotation = false;
+
+			if (constantPosition && length(frames[i].vecBonePosition - frames[0].vecBonePosition) > params.positionError)
+				constantPosition = false;
+		}
+	}
+
+	if (constantPosition)
+	{
+		outTrack.flags |= ANIMTRACK_CONSTANT_POSITION;
+		outTrack.posMin = frames[0].vecBonePosition;
+	}
+	else
+	{
+		outTrack.posMin = posBounds.minPoint;
+		outTrack.posRange = posBounds.GetSize();
+	}
+
+	if (constantRotation)
+		outTrack.flags |= ANIMTRACK_CONSTANT_ROTATION;
+
+	// quantized values which are seen by decoder
+	Array<Quaternion> decodedRotations(PP_SL);
+	Array<Vector3D> decodedPositions(PP_SL);
+	Array<uint16> packedRotations(PP_SL);
+	Array<uint16> packedPositions(PP_SL);
+	decodedRotations.setNum(numFrames);
+	decodedPositions.setNum(numFrames);
+	packedRotations.setNum(numFrames * 3);
+	packedPositions.setNum(numFrames * 3);
+
+	for (int i = 0; i < numFrames; ++i)
+	{
+		PackRotation(rotations[i], &packedRotations[i * 3]);
+		decodedRotations[i] = UnpackRotation(&packedRotations[i * 3]);
+
+		PackPosition(frames[i].vecBonePosition, outTrack.posMin, outTrack.posRange, &packedPositions[i * 3]);
+		decodedPositions[i] = UnpackPosition(&packedPositions[i * 3], outTrack.posMin, outTrack.posRange);
+	}
+
+	// checks that frames between two keys are reconstructed within error bounds
+	auto segmentWithinError = [&](int keyA, int keyB) {
+		for (int i = keyA + 1; i < keyB; ++i)
+		{
+			const float t = (float)(i - keyA) / (float)(keyB - keyA);
+
+			if (!constantRotation)
+			{
+				const Quaternion rotation = KeyRotationLerp(decodedRotations[keyA], decodedRotations[keyB], t);
+				if (RotationAngle(rotation, rotations[i]) > params.rotationError)
+					return false;
+			}
+
+			if (!constantPosition)
+			{
+				const Vector3D position = lerp(decodedPositions[keyA], decodedPositions[keyB], t);
+				if (length(position - frames[i].vecBonePosition) > params.positionError)
+					return false;
+			}
+		}
+		return true;
+	};
+
+	Array<int> keys(PP_SL);
+	keys.append(0);
+
+	if (constantRotation && constantPosition)
+	{
+		// single key is enough
+	}
+	else if (params.reduceKeys && numFrames <= ANIMTRACK_MAX_KEYFRAME_INDEX + 1)
+	{
+		int segmentStart = 0;
+		for (int i = 2; i < numFrames; ++i)
+		{
+			if (segmentWithinError(segmentStart, i))
+				continue;
+
+			segmentStart = i - 1;
+			keys.append(segmentStart);
+		}
+
+		if (numFrames > 1)
+			keys.append(numFrames - 1);
+	}
+	else
+	{
+		for (int i = 1; i < numFrames; ++i)
+			keys.append(i);
+	}
+
+	// keys that match frames don't need indices
+	if (keys.numElem() != numFrames)
+		outTrack.flags |= ANIMTRACK_KEYFRAME_INDICES;
+
+	outTrack.numKeys = keys.numElem();
+
+	if (outTrack.flags & ANIMTRACK_KEYFRAME_INDICES)
+	{
+		for (int i = 0; i < keys.numElem(); ++i)
+		{
+			const uint16 frameIdx = keys[i];
+			trackData.append((const ubyte*)&frameIdx, sizeof(frameIdx));
+		}
+	}
+
+	const int numRotationKeys = constantRotation ? 1 : keys.numElem();
+	for (int i = 0; i < numRotationKeys; ++i)
+		trackData.append((const ubyte*)&packedRotations[keys[i] * 3], sizeof(uint16) * 3);
+
+	if (!constantPosition)
+	{
+		for (int i = 0; i < keys.numElem(); ++i)
+			trackData.append((const ubyte*)&packedPositions[keys[i] * 3], sizeof(uint16) * 3);
+	}
+
+	ASSERT(trackData.numElem() - outTrack.dataOffset == Studio_GetAnimTrackDataSize(outTrack));
+}
+
+void Studio_DecodeAnimTrack(const animtrack_t& track, const ubyte* trackData, int frame, Quaternion& outRotation, Vector3D& outPosition)
+{
+	const int numKeys = track.numKeys;
+	const uint16* data = (const uint16*)(trackData + track.dataOffset);
+
+	const uint16* frameIndices = nullptr;
+	if (track.flags & ANIMTRACK_KEYFRAME_INDICES)
+	{
+		frameIndices = data;
+		data += numKeys;
+	}
+
+	const uint16* rotations = data;
+	data += (track.flags & ANIMTRACK_CONSTANT_ROTATION) ? 3 : numKeys * 3;
+
+	const uint16* positions = data;
+
+	// find keys around the frame
+	int keyA = min(max(frame, 0), numKeys - 1);
+	int keyB = keyA;
+	float t = 0.0f;
+
+	if (frameIndices)
+	{
+		if (frame >= frameIndices[numKeys - 1])
+		{
+			keyA = keyB = numKeys - 1;
+		}
+		else
+		{
+			int lo = 0;
+			int hi = numKeys - 1;
+			while (hi - lo > 1)
+			{
+				const int mid = (lo + hi) >> 1;
+				if (frameIndices[mid] <= frame)
+					lo = mid;
+				else
+					hi = mid;
+			}
+
+			keyA = lo;
+			keyB = hi;
+			t = (float)(frame - frameIndices[keyA]) / (float)(frameIndices[keyB] - frameIndices[keyA]);
+		}
+	}
+
+	if (track.flags & ANIMTRACK_CONSTANT_ROTATION)
+		outRotation = UnpackRotation(rotations);
+	else if (keyA == keyB || t <= 0.0f)
+		outRotation = UnpackRotation(rotations + keyA * 3);
+	else
+		outRotation = KeyRotationLerp(UnpackRotation(rotations + keyA * 3), UnpackRotation(rotations + keyB * 3), t);
+
+	if (track.flags & ANIMTRACK_CONSTANT_POSITION)
+		outPosition = track.posMin;
+	else if (keyA == keyB || t <= 0.0f)
+		outPosition = UnpackPosition(positions + keyA * 3, track.posMin, track.posRange);
+	else
+		outPosition = lerp(UnpackPosition(positions + keyA * 3, track.posMin, track.posRange), UnpackPosition(positions + keyB * 3, track.posMin, track.posRange), t);
+}
+
+//-------------------------------------------------------------------------
+
+// synthetic bone frames: constant, linear, smooth, noisy and stepping motion
+static void AnimTrackTest_MakeFrames(int bone, int numFrames, animframe_t* frames)
+{
+	for (int i = 0; i < numFrames; ++i)
+	{
+		const float t = (float)i / (float)max(1, numFrames - 1);
+		animframe_t& frame = frames[i];
+
+		switch (bone)
+		{
+		case 0:
+			frame.angBoneAngles = Vector3D(0.3f, -1.2f, 2.0f);
+			frame.vecBonePosition = Vector3D(1.0f, 2.0f, 3.0f);
+			break;
+		case 1:
+			frame.angBoneAngles = Vector3D(0.0f, t * M_PI_F * 0.5f, 0.0f);
+			frame.vecBonePosition = Vector3D(0.0f, 0.0f, 10.0f);
+			break;
+		case 2:
+			frame.angBoneAngles = Vector3D(sinf(t * 6.0f), cosf(t * 4.0f) * 0.5f, sinf(t * 9.0f + 1.0f) * 2.0f);
+			frame.vecBonePosition = Vector3D(sinf(t * 5.0f) * 50.0f, t * 20.0f, cosf(t * 3.0f) * 5.0f);
+			break;
+		case 3:
+			frame.angBoneAngles = Vector3D(RandomFloat(-M_PI_F, M_PI_F), RandomFloat(-M_PI_F, M_PI_F), RandomFloat(-M_PI_F, M_PI_F));
+			frame.vecBonePosition = Vector3D(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f));
+			break;
+		default:
+			frame.angBoneAngles = Vector3D(i < numFrames / 2 ? 0.0f : 1.0f, 0.0f, 0.0f);
+			frame.vecBonePosition = Vector3D(0.0f, i < numFrames / 2 ? 0.0f : 100.0f, 0.0f);
+			break;
+		}
+	}
+}
+
+// compresses synthetic tracks and checks every decoded frame against source within error bounds
+DECLARE_CMD(test_animtrack, "Compressed animation track test. Arguments: [number of frames]", 0)
+{
+	const int numFrames = CMD_ARGC > 0 ? max(0, atoi(CMD_ARGV(0).ToCString())) : 120;
+	const int numBones = 5;
+
+	// flat array of each bone frames like in motion packages
+	Array<animframe_t> allFrames(PP_SL);
+	allFrames.setNum(numBones * numFrames);
+	for (int bone = 0; bone < numBones; ++bone)
+		AnimTrackTest_MakeFrames(bone, numFrames, allFrames.ptr() + bone * numFrames);
+
+	const int rawSize = allFrames.numElem() * sizeof(animframe_t);
+
+	bool result = true;
+	for (int reduce = 0; reduce < 2; ++reduce)
+	{
+		AnimTrackCompressParams params;
+		params.reduceKeys = reduce != 0;
+
+		Array<ubyte> trackData(PP_SL);
+		Array<animtrack_t> tracks(PP_SL);
+
+		float maxRotationError = 0.0f;
+		float maxPositionError = 0.0f;
+
+		for (int bone = 0; bone < numBones; ++bone)
+		{
+			animtrack_t& track = tracks.append();
+			Studio_CompressAnimTrack(ArrayCRef<animframe_t>(allFrames.ptr() + bone * numFrames, numFrames), params, track, trackData);
+
+			if (Studio_GetAnimTrackDataSize(track) != trackData.numElem() - track.dataOffset)
+			{
+				MsgError("  bone %d: track data size %d, %d was written\n", bone, Studio_GetAnimTrackDataSize(track), trackData.numElem() - track.dataOffset);
+				result = false;
+			}
+		}
+
+		for (int bone = 0; bone < numBones; ++bone)
+		{
+			const animframe_t* frames = allFrames.ptr() + bone * numFrames;
+			const animtrack_t& track = tracks[bone];
+
+			// quantization step of kept keys is allowed on top of error bounds
+			const float rotationBound = params.rotationError + 0.0001f;
+			const float positionBound = params.positionError + length(track.posRange) / ANIMTRACK_POS_MAXVALUE;
+
+			for (int i = 0; i < numFrames; ++i)
+			{
+				Quaternion rotation;
+				Vector3D position;
+				Studio_DecodeAnimTrack(track, trackData.ptr(), i, rotation, position);
+
+				const Vector3D& ang = frames[i].angBoneAngles;
+				const float rotationError = RotationAngle(rotation, Quaternion(ang.x, ang.y, ang.z));
+				const float positionError = length(position - frames[i].vecBonePosition);
+
+				maxRotationError = max(maxRotationError, rotationError);
+				maxPositionError = max(maxPositionError, positionError);
+
+				if (rotationError > rotationBound || positionError > positionBound)
+				{
+					MsgError("  bone %d frame %d: rotation error %g, position error %g\n", bone, i, rotationError, positionError);
+					result = false;
+					break;
+				}
+			}
+		}
+
+		MsgInfo("test_animtrack: %d bones, %d frames, reduce keys %d: %d of %d bytes, max rotation error %g, max position error %g\n",
+			numBones, numFrames, params.reduceKeys, trackData.numElem(), rawSize, maxRotationError, maxPositionError);
+	}
+
+	MsgInfo("test_animtrack: %s\n", result ? "OK" : "FAILED");
+}
@@ -0,0 +1,25 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Compressed animation tracks of motion packages
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "egf/model.h"
+
+struct AnimTrackCompressParams
+{
+	float	rotationError{ 0.001f };	// max rotation error in radians
+	float	positionError{ 0.001f };	// max position error in model units
+	bool	reduceKeys{ true };
+};
+
+// compresses frames of single bone. Key data is appended to trackData
+void	Studio_CompressAnimTrack(ArrayCRef<animframe_t> frames, const AnimTrackCompressParams& params, animtrack_t& outTrack, Array<ubyte>& trackData);
+
+// size of track key data in bytes
+int		Studio_GetAnimTrackDataSize(const animtrack_t& track);
+
+// decodes bone rotation and position at frame directly from compressed data
+void	Studio_DecodeAnimTrack(const animtrack_t& track, const ubyte* trackData, int frame, Quaternion& outRotation, Vector3D& outPosition);
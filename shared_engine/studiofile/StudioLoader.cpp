@@ -8,8 +8,13 @@
 #include <zlib.h>
 
 #include "core/core_common.h"
+#include "core/ConCommand.h"
 #include "core/IFileSystem.h"
+#include "core/platform/OSFile.h"
+#include "math/Utility.h"
+#include "math/Random.h"
 #include "StudioLoader.h"
+#include "StudioAnimTrack.h"
 
 static bool IsValidModelIdentifier(int id)
 {
@@ -36,6 +41,152 @@ static void ConvertHeaderToLatestVersion(basemodelheader_t* pBaseHdr)
 	}
 }
 
+static int Studio_VertexSize(int vertexType)
+{
+	return ((vertexType & STUDIO_VERTFLAG_POS_UV) ? sizeof(studioVertexPosUv_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_TBN) ? sizeof(studioVertexTBN_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_BONEWEIGHT) ? sizeof(studioBoneWeight_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_COLOR) ? sizeof(studioVertexColor_t) : 0);
+}
+
+// Packed vertex streams are expanded to float layout in new buffer.
+// Unpacked vertices are placed after original model data
+static studioHdr_t* UnpackModelVertices(const studioHdr_t* pHdr)
+{
+	const int vertexDataStart = (pHdr->length + 15) & ~15;
+
+	int unpackedSize = 0;
+	for (int i = 0; i < pHdr->numMeshGroups; ++i)
+	{
+		const studioMeshGroupDesc_t* meshGroupDesc = pHdr->pMeshGroupDesc(i);
+		for (int j = 0; j < meshGroupDesc->numMeshes; ++j)
+		{
+			const studioMeshDesc_t* mesh = meshGroupDesc->pMesh(j);
+			unpackedSize += mesh->numVertices * Studio_VertexSize(mesh->vertexType);
+		}
+	}
+
+	ubyte* buffer = (ubyte*)PPAlloc(vertexDataStart + unpackedSize);
+	memcpy(buffer, pHdr, pHdr->length);
+
+	studioHdr_t* newHdr = (studioHdr_t*)buffer;
+	int writeOfs = vertexDataStart;
+
+	for (int i = 0; i < newHdr->numMeshGroups; ++i)
+	{
+		studioMeshGroupDesc_t* meshGroupDesc = newHdr->pMeshGroupDesc(i);
+		for (int j = 0; j < meshGroupDesc->numMeshes; ++j)
+		{
+			studioMeshDesc_t* mesh = meshGroupDesc->pMesh(j);
+			const int vertexType = mesh->vertexType;
+
+			const ubyte* srcVerts = (const ubyte*)mesh + mesh->vertexOffset;
+			const studioPackedVertexBounds_t& bounds = *(const studioPackedVertexBounds_t*)srcVerts;
+			srcVerts += sizeof(studioPackedVertexBounds_t);
+
+			mesh->vertexOffset = writeOfs - (int)((ubyte*)mesh - buffer);
+			writeOfs += mesh->numVertices * Studio_VertexSize(vertexType);
+
+			for (int k = 0; k < mesh->numVertices; ++k)
+			{
+				if (vertexType & STUDIO_VERTFLAG_POS_UV)
+				{
+					const studioPackedPosUv_t& packed = *(const studioPackedPosUv_t*)srcVerts;
+					studioVertexPosUv_t* posUv = mesh->pPosUvs(k);
+
+					const Vector3D unitPos(packed.point[0], packed.point[1], packed.point[2]);
+					posUv->point = bounds.mins + bounds.size * unitPos * (1.0f / 65535.0f);
+					posUv->texCoord = Vector2D(packed.texCoord[0], packed.texCoord[1]);
+
+					srcVerts += sizeof(studioPackedPosUv_t);
+				}
+
+				if (vertexType & STUDIO_VERTFLAG_TBN)
+				{
+					const studioPackedTBN_t& packed = *(const studioPackedTBN_t*)srcVerts;
+					studioVertexTBN_t* tbn = mesh->pTBNs(k);
+
+					tbn->normal = UnpackNormalOctahedralSnorm16(packed.normal);
+					tbn->tangent = UnpackNormalOctahedralSnorm16(packed.tangent);
+					tbn->binormal = cross(tbn->normal, tbn->tangent) * (float)packed.binormalSign;
+
+					srcVerts += sizeof(studioPackedTBN_t);
+				}
+
+				if (vertexType & STUDIO_VERTFLAG_BONEWEIGHT)
+				{
+					*mesh->pBoneWeight(k) = *(const studioBoneWeight_t*)srcVerts;
+					srcVerts += sizeof(studioBoneWeight_t);
+				}
+
+				if (vertexType & STUDIO_VERTFLAG_COLOR)
+				{
+					*mesh->pColor(k) = *(const studioVertexColor_t*)srcVerts;
+					srcVerts += sizeof(studioVertexColor_t);
+				}
+			}
+		}
+	}
+
+	newHdr->flags &= ~STUDIO_FLAG_PACKED_VERTS;
+	newHdr->length = writeOfs;
+
+	return newHdr;
+}
+
+// mappings of models used in place. Files are closed right after loading
+static Map<const studioHdr_t*, COSFileMapping*> s_mappedModels{ PP_SL };
+static Threading::CEqMutex s_mappedModelsMutex;
+
+static bool Studio_CheckModelHeader(const char* pszPath, const studioHdr_t* pHdr, int len)
+{
+	if(len < (int)sizeof(studioHdr_t) || !IsValidModelIdentifier( pHdr->ident ))
+	{
+		MsgError("Invalid model file '%s'\n",pszPath);
+		return false;
+	}
+
+	if(pHdr->version != EQUILIBRIUM_MODEL_VERSION)
+	{
+		MsgError("Wrong model '%s' version, excepted %i, but model version is %i\n",pszPath, EQUILIBRIUM_MODEL_VERSION, pHdr->version);
+		return false;
+	}
+
+	if(len != pHdr->length)
+	{
+		MsgError("Model is not valid (read %d vs size %d in header)!\n",len, pHdr->length);
+		return false;
+	}
+
+	return true;
+}
+
+// tracks of broken or mismatching packages would be sampled out of bounds
+static bool Studio_CheckMotionTracks(const char* pszPath, const studioMotionData_t* pMotion, const animationdesc_t* animationdescs, int numAnimDescs, int numAnimTracks, int trackDataSize, int boneCount)
+{
+	for (int i = 0; i < numAnimDescs; i++)
+	{
+		const int firstTrack = animationdescs[i].firstFrame;
+		if (firstTrack < 0 || firstTrack > numAnimTracks - boneCount)
+		{
+			MsgError("%s: animation '%s' uses tracks %d-%d but package has %d, model bone count mismatch?\n", pszPath, animationdescs[i].name, firstTrack, firstTrack + boneCount - 1, numAnimTracks);
+			return false;
+		}
+	}
+
+	for (int i = 0; i < numAnimTracks; i++)
+	{
+		const animtrack_t& track = pMotion->tracks[i];
+		if (track.numKeys <= 0 || track.numKeys > trackDataSize || track.dataOffset < 0 || (track.dataOffset & 1) || Studio_GetAnimTrackDataSize(track) > trackDataSize - track.dataOffset)
+		{
+			MsgError("%s: animation track %d is broken\n", pszPath, i);
+			return false;
+		}
+	}
+
+	return true;
+}
+
 // loads all supported EGF model formats
 studioHdr_t* Studio_LoadModel(const char* pszPath)
 {
@@ -48,41 +199,62 @@ studioHdr_t* Studio_LoadModel(const char* pszPath)
 	}
 
 	const int len = file->GetSize();
-	char* _buffer = (char*)PPAlloc(len+32); // +32 bytes for conversion issues
 
-	file->Read(_buffer, 1, len);
-	file = nullptr;
+	// uncompressed loose and package files are used in place.
+	// Mapping is copy-on-write so only pages touched by header conversion are copied
+	studioHdr_t* mappedHdr = (studioHdr_t*)file->GetMappedData();
+	if (mappedHdr && ((uintptr_t)mappedHdr & (alignof(studioHdr_t) - 1)) == 0)
+	{
+		if(!Studio_CheckModelHeader(pszPath, mappedHdr, len))
+			return nullptr;
 
-	basemodelheader_t* pBaseHdr = (basemodelheader_t*)_buffer;
+		// packed vertices can't be used in place, mapping is released once they are unpacked
+		if (mappedHdr->flags & STUDIO_FLAG_PACKED_VERTS)
+			return UnpackModelVertices(mappedHdr);
 
-	if(!IsValidModelIdentifier( pBaseHdr->ident ))
-	{
-		PPFree(_buffer);
-		MsgError("Invalid model file '%s'\n",pszPath);
-		return nullptr;
+		COSFileMapping* mapping = PPNew COSFileMapping();
+		if (file->DetachMappedData(*mapping))
+		{
+			// mapping outlives file handle
+			file = nullptr;
+
+			ConvertHeaderToLatestVersion( (basemodelheader_t*)mappedHdr );
+
+			Threading::CScopedMutex m(s_mappedModelsMutex);
+			s_mappedModels.insert(mappedHdr, mapping);
+			return mappedHdr;
+		}
+
+		// stream can't give mapping away, read it instead
+		delete mapping;
+		file->Seek(0, VS_SEEK_SET);
 	}
 
-	ConvertHeaderToLatestVersion( pBaseHdr );
+	char* _buffer = (char*)PPAlloc(len+32); // +32 bytes for conversion issues
 
-	// TODO: Double data protection!!! (hash lookup)
+	file->Read(_buffer, 1, len);
+	file = nullptr;
 
-	studioHdr_t* pHdr = (studioHdr_t*)pBaseHdr;
+	basemodelheader_t* pBaseHdr = (basemodelheader_t*)_buffer;
 
-	if(pHdr->version != EQUILIBRIUM_MODEL_VERSION)
+	if(!Studio_CheckModelHeader(pszPath, (studioHdr_t*)pBaseHdr, len))
 	{
-		MsgError("Wrong model '%s' version, excepted %i, but model version is %i\n",pszPath, EQUILIBRIUM_MODEL_VERSION,pBaseHdr->version);
 		PPFree(_buffer);
 		return nullptr;
 	}
 
-	if(len != pHdr->length)
+	if (((studioHdr_t*)pBaseHdr)->flags & STUDIO_FLAG_PACKED_VERTS)
 	{
-		MsgError("Model is not valid (read %d vs size %d in header)!\n",len, pBaseHdr->size);
+		studioHdr_t* unpackedHdr = UnpackModelVertices((studioHdr_t*)pBaseHdr);
 		PPFree(_buffer);
-		return nullptr;
+		return unpackedHdr;
 	}
 
-	return pHdr;
+	ConvertHeaderToLatestVersion( pBaseHdr );
+
+	// TODO: Double data protection!!! (hash lookup)
+
+	return (studioHdr_t*)pBaseHdr;
 }
 
 studioMotionData_t* Studio_LoadMotionData(const char* pszPath, int boneCount)
@@ -105,7 +277,7 @@ studioMotionData_t* Studio_LoadMotionData(const char* pszPath, int boneCount)
 		return nullptr;
 	}
 
-	if(pHDR->version != ANIMFILE_VERSION)
+	if(pHDR->version < ANIMFILE_MIN_VERSION || pHDR->version > ANIMFILE_VERSION)
 	{
 		MsgError("Bad motion package version, please update or reinstall the game.\n", pszPath);
 		PPFree(pData);
@@ -114,10 +286,12 @@ studioMotionData_t* Studio_LoadMotionData(const char* pszPath, int boneCount)
 
 	pData += sizeof(lumpfilehdr_t);
 
-	studioMotionData_t* pMotion = (studioMotionData_t*)PPAlloc(sizeof(studioMotionData_t));
+	studioMotionData_t* pMotion = new(PPAlloc(sizeof(studioMotionData_t))) studioMotionData_t{};
 
 	int numAnimDescs = 0;
 	int numAnimFrames = 0;
+	int numAnimTracks = 0;
+	int trackDataSize = 0;
 
 	animationdesc_t*	animationdescs = nullptr;
 	animframe_t*		animframes = nullptr;
@@ -170,6 +344,21 @@ studioMotionData_t* Studio_LoadMotionData(const char* pszPath, int boneCount)
 
 				break;
 			}
+			case ANIMFILE_COMPRESSEDTRACKS:
+			{
+				numAnimTracks = pLump->size / sizeof(animtrack_t);
+
+				pMotion->tracks = (animtrack_t*)PPAlloc(pLump->size);
+				memcpy(pMotion->tracks, pData, pLump->size);
+				break;
+			}
+			case ANIMFILE_COMPRESSEDTRACKDATA:
+			{
+				trackDataSize = pLump->size;
+				pMotion->trackData = (ubyte*)PPAlloc(pLump->size);
+				memcpy(pMotion->trackData, pData, pLump->size);
+				break;
+			}
 			case ANIMFILE_SEQUENCES:
 			{
 				pMotion->numsequences = pLump->size / sizeof(sequencedesc_t);
@@ -199,12 +388,27 @@ studioMotionData_t* Studio_LoadMotionData(const char* pszPath, int boneCount)
 		pData += pLump->size;
 	}
 
+	// compressed tracks are sampled directly, no frames are stored
+	const bool hasCompressedTracks = pMotion->tracks && pMotion->trackData;
+	if (hasCompressedTracks && !Studio_CheckMotionTracks(pszPath, pMotion, animationdescs, numAnimDescs, numAnimTracks, trackDataSize, boneCount))
+	{
+		if (hasCompressedAnimationFrames)
+			PPFree(animframes);
+
+		Studio_FreeMotionData(pMotion, boneCount);
+		PPFree(pMotion);
+		PPFree(pStart);
+		return nullptr;
+	}
+
 	// first processing done, convert animca animations to EGF format.
 	pMotion->animations = PPAllocStructArray(studioAnimation_t, numAnimDescs);
 	pMotion->numAnimations = numAnimDescs;
-
-	pMotion->frames = PPAllocStructArray(animframe_t, numAnimFrames);
-	memcpy(pMotion->frames, animframes, numAnimFrames * sizeof(animframe_t));
+	if (!hasCompressedTracks)
+	{
+		pMotion->frames = PPAllocStructArray(animframe_t, numAnimFrames);
+		memcpy(pMotion->frames, animframes, numAnimFrames * sizeof(animframe_t));
+	}
 
 	for(int i = 0; i < pMotion->numAnimations; i++)
 	{
@@ -217,11 +421,26 @@ studioMotionData_t* Studio_LoadMotionData(const char* pszPath, int boneCount)
 		anim.bones = PPAllocStructArray(studioBoneAnimation_t, boneCount);
 		//anim.numFrames = numFrames;
 
+		if (hasCompressedTracks)
+		{
+			// tracks are stored per bone of each animation
+			for (int j = 0; j < boneCount; j++)
+			{
+				anim.bones[j].numFrames = numFrames;
+				anim.bones[j].keyFrames = nullptr;
+				anim.bones[j].track = pMotion->tracks + animationdescs[i].firstFrame + j;
+				anim.bones[j].trackData = pMotion->trackData;
+			}
+			continue;
+		}
+
 		// since frames are just flat array of each bone, we can simply reference it
 		for(int j = 0; j < boneCount; j++)
 		{
 			anim.bones[j].numFrames = numFrames;
 			anim.bones[j].keyFrames = pMotion->frames + (animationdescs[i].firstFrame + j * numFrames);
+			anim.bones[j].track = nullptr;
+			anim.bones[j].trackData = nullptr;
 		}
 	}
 
@@ -382,16 +601,29 @@ bool Studio_LoadPhysModel(const char* pszPath, studioPhysData_t* pModel)
 
 void Studio_FreeModel(studioHdr_t* pModel)
 {
+	{
+		Threading::CScopedMutex m(s_mappedModelsMutex);
+		auto it = s_mappedModels.find(pModel);
+		if (!it.atEnd())
+		{
+			delete *it;
+			s_mappedModels.remove(it);
+			return;
+		}
+	}
+
 	PPFree(pModel);
 }
 
 void Studio_FreeMotionData(studioMotionData_t* data, int numBones)
 {
-	// NOTE: no need to delete bone keyFrames since they are mapped from data->frames.
+	// NOTE: no need to delete bone keyFrames and tracks since they are mapped from data->frames and data->tracks.
 	for (int i = 0; i < data->numAnimations; i++)
 		PPFree(data->animations[i].bones);
 
 	PPFree(data->frames);
+	PPFree(data->tracks);
+	PPFree(data->trackData);
 	PPFree(data->sequences);
 	PPFree(data->events);
 	PPFree(data->poseControllers);
@@ -406,3 +638,249 @@ void Studio_FreePhysModel(studioPhysData_t* model)
 	PPFree(model->objects);
 	PPFree(model->joints);
 }
+
+//-------------------------------------------------------------------------
+
+static float PackedVertsTest_AngleError(const Vector3D& a, const Vector3D& b)
+{
+	return RAD2DEG(acosf(clamp(dot(a, b), -1.0f, 1.0f)));
+}
+
+// random orthonormal frame with random handedness
+static void PackedVertsTest_MakeTBN(studioVertexTBN_t& tbn)
+{
+	Vector3D normal(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f));
+	if (length(normal) < 0.01f)
+		normal = Vector3D(0.0f, 0.0f, -1.0f);
+
+	tbn.normal = normalize(normal);
+
+	const Vector3D side = fabsf(tbn.normal.y) < 0.9f ? Vector3D(0.0f, 1.0f, 0.0f) : Vector3D(1.0f, 0.0f, 0.0f);
+	tbn.tangent = normalize(cross(tbn.normal, side));
+	tbn.binormal = cross(tbn.normal, tbn.tangent) * (RandomInt(0, 1) ? 1.0f : -1.0f);
+}
+
+static bool PackedVertsTest_Directions(int numDirections)
+{
+	Array<Vector3D> directions(PP_SL);
+
+	// axes, octant diagonals and points near fold of lower hemisphere
+	for (int i = 0; i < 3; ++i)
+	{
+		Vector3D axis(0.0f);
+		axis[i] = 1.0f;
+		directions.append(axis);
+		directions.append(-axis);
+	}
+
+	for (int i = 0; i < 8; ++i)
+		directions.append(normalize(Vector3D((i & 1) ? -1.0f : 1.0f, (i & 2) ? -1.0f : 1.0f, (i & 4) ? -1.0f : 1.0f)));
+
+	directions.append(normalize(Vector3D(0.001f, -0.001f, -1.0f)));
+	directions.append(normalize(Vector3D(1.0f, 1.0f, -0.0001f)));
+
+	for (int i = 0; i < numDirections; ++i)
+	{
+		studioVertexTBN_t tbn;
+		PackedVertsTest_MakeTBN(tbn);
+		directions.append(tbn.normal);
+	}
+
+	float maxError = 0.0f;
+	for (const Vector3D& dir : directions)
+	{
+		int16 packed[2];
+		PackNormalOctahedralSnorm16(dir, packed);
+		maxError = max(maxError, PackedVertsTest_AngleError(dir, UnpackNormalOctahedralSnorm16(packed)));
+	}
+
+	// zero length direction must decode to something usable
+	int16 packedZero[2];
+	PackNormalOctahedralSnorm16(vec3_zero, packedZero);
+	const Vector3D zeroDir = UnpackNormalOctahedralSnorm16(packedZero);
+
+	MsgInfo("  %d directions, max error %g degrees\n", directions.numElem(), maxError);
+
+	bool result = true;
+	if (maxError > 0.05f)
+	{
+		MsgError("  octahedral direction error is too big\n");
+		result = false;
+	}
+
+	if (PackedVertsTest_AngleError(zeroDir, Vector3D(0.0f, 0.0f, 1.0f)) > 0.05f)
+	{
+		MsgError("  zero direction decoded as %g %g %g\n", zeroDir.x, zeroDir.y, zeroDir.z);
+		result = false;
+	}
+
+	return result;
+}
+
+// builds model with single packed mesh in same layout as EGF writer and unpacks it
+static bool PackedVertsTest_Mesh(int numVerts)
+{
+	const int vertexType = STUDIO_VERTFLAG_POS_UV | STUDIO_VERTFLAG_TBN | STUDIO_VERTFLAG_BONEWEIGHT | STUDIO_VERTFLAG_COLOR;
+
+	Array<studioVertexPosUv_t> srcPosUvs(PP_SL);
+	Array<studioVertexTBN_t> srcTbns(PP_SL);
+	Array<studioBoneWeight_t> srcWeights(PP_SL);
+	Array<uint> srcColors(PP_SL);
+
+	BoundingBox bbox;
+	for (int i = 0; i < numVerts; ++i)
+	{
+		studioVertexPosUv_t& posUv = srcPosUvs.append();
+		posUv.point = Vector3D(RandomFloat(-50.0f, 120.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(0.0f, 300.0f));
+		posUv.texCoord = Vector2D(RandomFloat(-2.0f, 2.0f), RandomFloat(0.0f, 1.0f));
+		bbox.AddVertex(posUv.point);
+
+		PackedVertsTest_MakeTBN(srcTbns.append());
+
+		studioBoneWeight_t& weight = srcWeights.append();
+		memset(&weight, 0, sizeof(weight));
+		weight.numweights = RandomInt(1, MAX_MODEL_VERTEX_WEIGHTS);
+		for (int j = 0; j < weight.numweights; ++j)
+		{
+			weight.bones[j] = RandomInt(0, 127);
+			weight.weight[j] = RandomFloat(0.0f, 1.0f);
+		}
+
+		srcColors.append((uint)RandomInt(0, 0x7fffffff) ^ (uint)(i << 16));
+	}
+
+	studioPackedVertexBounds_t bounds;
+	bounds.mins = bbox.minPoint;
+	bounds.size = max(bbox.GetSize(), Vector3D(F_EPS));
+
+	const int meshGroupOfs = sizeof(studioHdr_t);
+	const int meshOfs = meshGroupOfs + sizeof(studioMeshGroupDesc_t);
+	const int vertexOfs = meshOfs + sizeof(studioMeshDesc_t);
+	const int modelSize = vertexOfs + sizeof(studioPackedVertexBounds_t) + Studio_PackedVertexSize(vertexType) * numVerts;
+
+	ubyte* modelData = (ubyte*)PPAlloc(modelSize);
+	memset(modelData, 0, modelSize);
+
+	studioHdr_t* hdr = (studioHdr_t*)modelData;
+	hdr->ident = EQUILIBRIUM_MODEL_SIGNATURE;
+	hdr->flags = STUDIO_FLAG_NEW_VERTEX_FMT | STUDIO_FLAG_PACKED_VERTS;
+	hdr->length = modelSize;
+	hdr->numMeshGroups = 1;
+	hdr->meshGroupsOffset = meshGroupOfs;
+
+	studioMeshGroupDesc_t* meshGroup = hdr->pMeshGroupDesc(0);
+	meshGroup->numMeshes = 1;
+	meshGroup->meshesOffset = meshOfs - meshGroupOfs;
+
+	studioMeshDesc_t* mesh = meshGroup->pMesh(0);
+	mesh->numVertices = numVerts;
+	mesh->vertexOffset = vertexOfs - meshOfs;
+	mesh->vertexType = vertexType;
+
+	ubyte* dstVerts = modelData + vertexOfs;
+	memcpy(dstVerts, &bounds, sizeof(bounds));
+	dstVerts += sizeof(bounds);
+
+	for (int i = 0; i < numVerts; ++i)
+	{
+		const Vector3D unitPos = clamp((srcPosUvs[i].point - bounds.mins) / bounds.size, 0.0f, 1.0f);
+
+		studioPackedPosUv_t posUv;
+		posUv.point[0] = (uint16)floorf(unitPos.x * 65535.0f + 0.5f);
+		posUv.point[1] = (uint16)floorf(unitPos.y * 65535.0f + 0.5f);
+		posUv.point[2] = (uint16)floorf(unitPos.z * 65535.0f + 0.5f);
+		posUv.unused = 0;
+		posUv.texCoord[0] = half(srcPosUvs[i].texCoord.x);
+		posUv.texCoord[1] = half(srcPosUvs[i].texCoord.y);
+		memcpy(dstVerts, &posUv, sizeof(posUv));
+		dstVerts += sizeof(posUv);
+
+		const studioVertexTBN_t& srcTbn = srcTbns[i];
+
+		studioPackedTBN_t tbn;
+		PackNormalOctahedralSnorm16(srcTbn.normal, tbn.normal);
+		PackNormalOctahedralSnorm16(srcTbn.tangent, tbn.tangent);
+		tbn.binormalSign = dot(cross(srcTbn.normal, srcTbn.tangent), srcTbn.binormal) < 0.0f ? -1 : 1;
+		tbn.unused = 0;
+		memcpy(dstVerts, &tbn, sizeof(tbn));
+		dstVerts += sizeof(tbn);
+
+		memcpy(dstVerts, &srcWeights[i], sizeof(studioBoneWeight_t));
+		dstVerts += sizeof(studioBoneWeight_t);
+
+		memcpy(dstVerts, &srcColors[i], sizeof(studioVertexColor_t));
+		dstVerts += sizeof(studioVertexColor_t);
+	}
+
+	studioHdr_t* unpackedHdr = UnpackModelVertices(hdr);
+	PPFree(modelData);
+
+	bool result = true;
+	if (unpackedHdr->flags & STUDIO_FLAG_PACKED_VERTS)
+	{
+		MsgError("  unpacked model is still marked as packed\n");
+		result = false;
+	}
+
+	const studioMeshDesc_t* unpackedMesh = unpackedHdr->pMeshGroupDesc(0)->pMesh(0);
+	if ((const ubyte*)unpackedMesh->pColor(numVerts - 1) + sizeof(studioVertexColor_t) > (const ubyte*)unpackedHdr + unpackedHdr->length)
+	{
+		MsgError("  unpacked vertices are out of model bounds\n");
+		PPFree(unpackedHdr);
+		return false;
+	}
+
+	// quantization steps
+	const Vector3D positionBound = bounds.size / 65535.0f + Vector3D(0.0001f);
+
+	float maxTbnError = 0.0f;
+	int numFailed = 0;
+	for (int i = 0; i < numVerts; ++i)
+	{
+		const studioVertexPosUv_t& posUv = *unpackedMesh->pPosUvs(i);
+		const studioVertexTBN_t& tbn = *unpackedMesh->pTBNs(i);
+		const studioVertexTBN_t& srcTbn = srcTbns[i];
+
+		const Vector3D posError = posUv.point - srcPosUvs[i].point;
+		const bool posOk = fabsf(posError.x) <= positionBound.x && fabsf(posError.y) <= positionBound.y && fabsf(posError.z) <= positionBound.z;
+
+		// half has 11 bits of mantissa
+		const Vector2D& srcTexCoord = srcPosUvs[i].texCoord;
+		const bool uvOk = fabsf(posUv.texCoord.x - srcTexCoord.x) <= fabsf(srcTexCoord.x) * 0.001f + 0.0001f
+			&& fabsf(posUv.texCoord.y - srcTexCoord.y) <= fabsf(srcTexCoord.y) * 0.001f + 0.0001f;
+
+		const float tbnError = max(max(PackedVertsTest_AngleError(tbn.normal, srcTbn.normal), PackedVertsTest_AngleError(tbn.tangent, srcTbn.tangent)),
+			PackedVertsTest_AngleError(tbn.binormal, srcTbn.binormal));
+		maxTbnError = max(maxTbnError, tbnError);
+
+		const bool weightOk = !memcmp(unpackedMesh->pBoneWeight(i), &srcWeights[i], sizeof(studioBoneWeight_t));
+		const bool colorOk = unpackedMesh->pColor(i)->color == srcColors[i];
+
+		if (!posOk || !uvOk || tbnError > 0.1f || !weightOk || !colorOk)
+		{
+			if (numFailed++ < 8)
+			{
+				MsgError("  vertex %d: position %s, uv %s, tbn error %g, weights %s, color %s\n", i,
+					posOk ? "ok" : "bad", uvOk ? "ok" : "bad", tbnError, weightOk ? "ok" : "bad", colorOk ? "ok" : "bad");
+			}
+			result = false;
+		}
+	}
+
+	MsgInfo("  %d vertices unpacked, max TBN error %g degrees, %d failed\n", numVerts, maxTbnError, numFailed);
+
+	PPFree(unpackedHdr);
+	return result;
+}
+
+// packs synthetic directions and vertices and checks them after unpacking
+DECLARE_CMD(test_packedverts, "Packed EGF vertex and octahedral TBN test. Arguments: [number of vertices]", 0)
+{
+	const int numVerts = CMD_ARGC > 0 ? max(1, atoi(CMD_ARGV(0).ToCString())) : 10000;
+
+	const bool directionsOk = PackedVertsTest_Directions(numVerts);
+	MsgInfo("test_packedverts: octahedral directions %s\n", directionsOk ? "OK" : "FAILED");
+
+	const bool meshOk = PackedVertsTest_Mesh(numVerts);
+	MsgInfo("test_packedverts: packed mesh %s\n", meshOk ? "OK" : "FAILED");
+}
@@ -0,0 +1,494 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: SoA skeleton pose and batched pose operations
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "math/Simd.h"
+#include "studiofile/StudioAnimTrack.h"
+#include "AnimPose.h"
+
+// number of SoA component streams in pose
+static constexpr const int POSE_STREAMS = 7;
+
+struct SimdQuat
+{
+	Simd4f x, y, z, w;
+};
+
+int AnimPose_GetMemorySize(int numBones)
+{
+	return SimdAlignCount(numBones) * POSE_STREAMS;
+}
+
+float* AnimPose_Init(AnimPose& pose, float* memory, int numBones)
+{
+	const int stride = SimdAlignCount(numBones);
+
+	pose.numBones = numBones;
+	pose.stride = stride;
+	pose.boneIndices = nullptr;
+	pose.posX = memory;
+	pose.posY = memory + stride;
+	pose.posZ = memory + stride * 2;
+	pose.rotX = memory + stride * 3;
+	pose.rotY = memory + stride * 4;
+	pose.rotZ = memory + stride * 5;
+	pose.rotW = memory + stride * 6;
+
+	return memory + stride * POSE_STREAMS;
+}
+
+void AnimPose_SetBoneSubset(AnimPose& pose, const int* boneIndices, int numBones)
+{
+	ASSERT(numBones <= pose.stride);
+	pose.boneIndices = boneIndices;
+	pose.numBones = numBones;
+}
+
+void AnimPose_SetIdentity(AnimPose& pose)
+{
+	const int stride = pose.stride;
+	memset(pose.posX, 0, sizeof(float) * stride * (POSE_STREAMS - 1));
+
+	for (int i = 0; i < stride; ++i)
+		pose.rotW[i] = 1.0f;
+}
+
+void AnimPose_Copy(AnimPose& dst, const AnimPose& src)
+{
+	ASSERT(dst.numBones == src.numBones && dst.boneIndices == src.boneIndices);
+	ASSERT(dst.stride == src.stride);
+	memcpy(dst.posX, src.posX, sizeof(float) * src.stride * POSE_STREAMS);
+}
+
+void AnimPose_Remap(AnimPose& dst, const AnimPose& src)
+{
+	ASSERT(dst.posX != src.posX);
+
+	AnimPose_SetIdentity(dst);
+
+	// both lane lists are ascending
+	int srcLane = 0;
+	for (int i = 0; i < dst.numBones; ++i)
+	{
+		const int boneId = AnimPose_GetLaneBone(dst, i);
+		while (srcLane < src.numBones && AnimPose_GetLaneBone(src, srcLane) < boneId)
+			++srcLane;
+
+		if (srcLane >= src.numBones)
+			break;
+
+		if (AnimPose_GetLaneBone(src, srcLane) != boneId)
+			continue;
+
+		dst.posX[i] = src.posX[srcLane];
+		dst.posY[i] = src.posY[srcLane];
+		dst.posZ[i] = src.posZ[srcLane];
+		dst.rotX[i] = src.rotX[srcLane];
+		dst.rotY[i] = src.rotY[srcLane];
+		dst.rotZ[i] = src.rotZ[srcLane];
+		dst.rotW[i] = src.rotW[srcLane];
+	}
+}
+
+void AnimPose_GetBone(const AnimPose& pose, int lane, Quaternion& rotation, Vector3D& position)
+{
+	rotation = Quaternion(pose.rotW[lane], pose.rotX[lane], pose.rotY[lane], pose.rotZ[lane]);
+	position = Vector3D(pose.posX[lane], pose.posY[lane], pose.posZ[lane]);
+}
+
+//-------------------------------------------------------------------------
+
+static inline SimdQuat LoadQuat(const AnimPose& pose, int i)
+{
+	return { simdLoad(pose.rotX + i), simdLoad(pose.rotY + i), simdLoad(pose.rotZ + i), simdLoad(pose.rotW + i) };
+}
+
+static inline void StoreQuat(AnimPose& pose, int i, const SimdQuat& q)
+{
+	simdStore(pose.rotX + i, q.x);
+	simdStore(pose.rotY + i, q.y);
+	simdStore(pose.rotZ + i, q.z);
+	simdStore(pose.rotW + i, q.w);
+}
+
+// sine and cosine with quadrant range reduction
+static inline void SimdSinCos(const Simd4f& x, Simd4f& outSin, Simd4f& outCos)
+{
+	// Cody-Waite split of PI/2
+	const Simd4f quadrant = simdRound(x * simdSplat(0.636619772f));
+	Simd4f r = x - quadrant * simdSplat(1.5703125f);
+	r = r - quadrant * simdSplat(4.837512969970703125e-4f);
+	r = r - quadrant * simdSplat(7.54978995489188216e-8f);
+
+	const Simd4f r2 = r * r;
+
+	Simd4f s = simdMadd(r2, simdSplat(1.0f / 362880.0f), simdSplat(-1.0f / 5040.0f));
+	s = simdMadd(s, r2, simdSplat(1.0f / 120.0f));
+	s = simdMadd(s, r2, simdSplat(-1.0f / 6.0f));
+	s = simdMadd(s * r2, r, r);
+
+	Simd4f c = simdMadd(r2, simdSplat(1.0f / 40320.0f), simdSplat(-1.0f / 720.0f));
+	c = simdMadd(c, r2, simdSplat(1.0f / 24.0f));
+	c = simdMadd(c, r2, simdSplat(-0.5f));
+	c = simdMadd(c, r2, simdSplat(1.0f));
+
+	// quadrant = 4 * n + m, m is 0..3
+	const Simd4f m = quadrant - simdSplat(4.0f) * simdRound(quadrant * simdSplat(0.25f) - simdSplat(0.375f));
+	const Simd4f high = simdRound(m * simdSplat(0.5f) - simdSplat(0.25f));	// m >= 2
+	const Simd4f odd = m - simdSplat(2.0f) * high;							// m is 1 or 3
+
+	const Simd4f swap = simdCmpGt(odd, simdSplat(0.5f));
+	const Simd4f sinSign = simdSplat(1.0f) - simdSplat(2.0f) * high;
+	const Simd4f cosSign = sinSign * (simdSplat(1.0f) - simdSplat(2.0f) * odd);
+
+	outSin = simdSelect(swap, c, s) * sinSign;
+	outCos = simdSelect(swap, s, c) * cosSign;
+}
+
+// acos for inputs in 0..1 range
+static inline Simd4f SimdAcosPositive(const Simd4f& x)
+{
+	Simd4f p = simdMadd(x, simdSplat(-0.0012624911f), simdSplat(0.0066700901f));
+	p = simdMadd(p, x, simdSplat(-0.0170881256f));
+	p = simdMadd(p, x, simdSplat(0.0308918810f));
+	p = simdMadd(p, x, simdSplat(-0.0501743046f));
+	p = simdMadd(p, x, simdSplat(0.0889789874f));
+	p = simdMadd(p, x, simdSplat(-0.2145988016f));
+	p = simdMadd(p, x, simdSplat(1.5707963050f));
+
+	return p * simdSqrt(simdMax(simdSplat(1.0f) - x, simdSplat(0.0f)));
+}
+
+static inline Simd4f SimdSin(const Simd4f& x)
+{
+	Simd4f s, c;
+	SimdSinCos(x, s, c);
+	return s;
+}
+
+// matches Quaternion(x, y, z) constructor
+static inline SimdQuat SimdQuatFromEuler(const Simd4f& ax, const Simd4f& ay, const Simd4f& az)
+{
+	const Simd4f half = simdSplat(0.5f);
+
+	Simd4f sr, cr, sp, cp, sy, cy;
+	SimdSinCos(ax * half, sr, cr);
+	SimdSinCos(ay * half, sp, cp);
+	SimdSinCos(az * half, sy, cy);
+
+	const Simd4f cpcy = cp * cy;
+	const Simd4f spcy = sp * cy;
+	const Simd4f cpsy = cp * sy;
+	const Simd4f spsy = sp * sy;
+
+	SimdQuat q;
+	q.x = sr * cpcy - cr * spsy;
+	q.y = cr * spcy + sr * cpsy;
+	q.z = cr * cpsy - sr * spcy;
+	q.w = cr * cpcy + sr * spsy;
+
+	const Simd4f invLen = simdSplat(1.0f) / simdSqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	q.x = q.x * invLen;
+	q.y = q.y * invLen;
+	q.z = q.z * invLen;
+	q.w = q.w * invLen;
+
+	return q;
+}
+
+// matches slerp() including it's linear interpolation fallback
+static inline SimdQuat SimdQuatSlerp(const SimdQuat& a, const SimdQuat& b, const Simd4f& t)
+{
+	const Simd4f zero = simdSplat(0.0f);
+	const Simd4f one = simdSplat(1.0f);
+
+	Simd4f cosTheta = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+
+	// take the short way around the sphere
+	const Simd4f flip = simdCmpLt(cosTheta, zero);
+	cosTheta = simdSelect(flip, -cosTheta, cosTheta);
+
+	const SimdQuat z = {
+		simdSelect(flip, -b.x, b.x),
+		simdSelect(flip, -b.y, b.y),
+		simdSelect(flip, -b.z, b.z),
+		simdSelect(flip, -b.w, b.w),
+	};
+
+	const Simd4f theta = SimdAcosPositive(simdMin(cosTheta, one));
+	const Simd4f invSinTheta = one / SimdSin(theta);
+	const Simd4f wa = SimdSin((one - t) * theta) * invSinTheta;
+	const Simd4f wb = SimdSin(t * theta) * invSinTheta;
+
+	// near-equal rotations are linearly interpolated, as slerp() does it with unflipped quaternion
+	const Simd4f delta = one - cosTheta;
+	const Simd4f useLerp = simdCmpLt(simdMax(delta, -delta), simdSplat(F_EPS));
+	const Simd4f la = one - t;
+
+	SimdQuat r;
+	r.x = simdSelect(useLerp, a.x * la + b.x * t, a.x * wa + z.x * wb);
+	r.y = simdSelect(useLerp, a.y * la + b.y * t, a.y * wa + z.y * wb);
+	r.z = simdSelect(useLerp, a.z * la + b.z * t, a.z * wa + z.z * wb);
+	r.w = simdSelect(useLerp, a.w * la + b.w * t, a.w * wa + z.w * wb);
+	return r;
+}
+
+//-------------------------------------------------------------------------
+
+// compressed tracks are decoded straight to quaternions
+static void SampleCompressedAnimation(AnimPose& out, const studioAnimation_t* anim, int firstFrame, int lastFrame, float interp)
+{
+	const int numBones = out.numBones;
+	const Simd4f t = simdSplat(interp);
+
+	for (int i = 0; i < numBones; i += SIMD_WIDTH)
+	{
+		float rotA[4][SIMD_WIDTH], rotB[4][SIMD_WIDTH];
+		float posA[3][SIMD_WIDTH], posB[3][SIMD_WIDTH];
+
+		for (int j = 0; j < SIMD_WIDTH; ++j)
+		{
+			const int lane = i + j;
+			if (lane >= numBones)
+			{
+				for (int k = 0; k < 4; ++k)
+					rotA[k][j] = rotB[k][j] = (k == 3) ? 1.0f : 0.0f;
+				for (int k = 0; k < 3; ++k)
+					posA[k][j] = posB[k][j] = 0.0f;
+				continue;
+			}
+
+			const studioBoneAnimation_t& boneAnim = anim->bones[AnimPose_GetLaneBone(out, lane)];
+			ASSERT(firstFrame >= 0 && firstFrame < boneAnim.numFrames);
+			ASSERT(lastFrame >= 0 && lastFrame < boneAnim.numFrames);
+
+			Quaternion qa, qb;
+			Vector3D pa, pb;
+			Studio_DecodeAnimTrack(*boneAnim.track, boneAnim.trackData, firstFrame, qa, pa);
+			Studio_DecodeAnimTrack(*boneAnim.track, boneAnim.trackData, lastFrame, qb, pb);
+
+			// decoded keys are not sign-continuous, keep slerp's linear fallback valid
+			if (qa.x * qb.x + qa.y * qb.y + qa.z * qb.z + qa.w * qb.w < 0.0f)
+				qb = -qb;
+
+			rotA[0][j] = qa.x; rotA[1][j] = qa.y; rotA[2][j] = qa.z; rotA[3][j] = qa.w;
+			rotB[0][j] = qb.x; rotB[1][j] = qb.y; rotB[2][j] = qb.z; rotB[3][j] = qb.w;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				posA[k][j] = pa[k];
+				posB[k][j] = pb[k];
+			}
+		}
+
+		const SimdQuat qa = { simdLoad(rotA[0]), simdLoad(rotA[1]), simdLoad(rotA[2]), simdLoad(rotA[3]) };
+		const SimdQuat qb = { simdLoad(rotB[0]), simdLoad(rotB[1]), simdLoad(rotB[2]), simdLoad(rotB[3]) };
+		StoreQuat(out, i, SimdQuatSlerp(qa, qb, t));
+
+		float* outPos[3] = { out.posX, out.posY, out.posZ };
+		for (int k = 0; k < 3; ++k)
+		{
+			const Simd4f pa = simdLoad(posA[k]);
+			simdStore(outPos[k] + i, simdMadd(t, simdLoad(posB[k]) - pa, pa));
+		}
+	}
+}
+
+void AnimPose_SampleAnimation(AnimPose& out, const studioAnimation_t* anim, int firstFrame, int lastFrame, float interp)
+{
+	const int numBones = out.numBones;
+	const Simd4f t = simdSplat(interp);
+
+	if (numBones && anim->bones[0].track)
+	{
+		SampleCompressedAnimation(out, anim, firstFrame, lastFrame, interp);
+		return;
+	}
+
+	for (int i = 0; i < numBones; i += SIMD_WIDTH)
+	{
+		// gather key frames of four bones
+		float angA[3][SIMD_WIDTH], angB[3][SIMD_WIDTH];
+		float posA[3][SIMD_WIDTH], posB[3][SIMD_WIDTH];
+
+		for (int j = 0; j < SIMD_WIDTH; ++j)
+		{
+			const int lane = i + j;
+			if (lane >= numBones)
+			{
+				for (int k = 0; k < 3; ++k)
+					angA[k][j] = angB[k][j] = posA[k][j] = posB[k][j] = 0.0f;
+				continue;
+			}
+
+			const studioBoneAnimation_t& boneAnim = anim->bones[AnimPose_GetLaneBone(out, lane)];
+			ASSERT(firstFrame >= 0 && firstFrame < boneAnim.numFrames);
+			ASSERT(lastFrame >= 0 && lastFrame < boneAnim.numFrames);
+
+			const animframe_t& frameA = boneAnim.keyFrames[firstFrame];
+			const animframe_t& frameB = boneAnim.keyFrames[lastFrame];
+
+			for (int k = 0; k < 3; ++k)
+			{
+				angA[k][j] = frameA.angBoneAngles[k];
+				angB[k][j] = frameB.angBoneAngles[k];
+				posA[k][j] = frameA.vecBonePosition[k];
+				posB[k][j] = frameB.vecBonePosition[k];
+			}
+		}
+
+		const SimdQuat qa = SimdQuatFromEuler(simdLoad(angA[0]), simdLoad(angA[1]), simdLoad(angA[2]));
+		const SimdQuat qb = SimdQuatFromEuler(simdLoad(angB[0]), simdLoad(angB[1]), simdLoad(angB[2]));
+		StoreQuat(out, i, SimdQuatSlerp(qa, qb, t));
+
+		float* outPos[3] = { out.posX, out.posY, out.posZ };
+		for (int k = 0; k < 3; ++k)
+		{
+			const Simd4f pa = simdLoad(posA[k]);
+			simdStore(outPos[k] + i, simdMadd(t, simdLoad(posB[k]) - pa, pa));
+		}
+	}
+}
+
+void AnimPose_Blend(AnimPose& out, const AnimPose& a, const AnimPose& b, float t)
+{
+	const int numBones = out.numBones;
+	const Simd4f st = simdSplat(t);
+
+	for (int i = 0; i < numBones; i += SIMD_WIDTH)
+	{
+		StoreQuat(out, i, SimdQuatSlerp(LoadQuat(a, i), LoadQuat(b, i), st));
+
+		const Simd4f ax = simdLoad(a.posX + i);
+		const Simd4f ay = simdLoad(a.posY + i);
+		const Simd4f az = simdLoad(a.posZ + i);
+		simdStore(out.posX + i, simdMadd(st, simdLoad(b.posX + i) - ax, ax));
+		simdStore(out.posY + i, simdMadd(st, simdLoad(b.posY + i) - ay, ay));
+		simdStore(out.posZ + i, simdMadd(st, simdLoad(b.posZ + i) - az, az));
+	}
+}
+
+void AnimPose_Add(AnimPose& out, const AnimPose& a, const AnimPose& b)
+{
+	const int numBones = out.numBones;
+
+	for (int i = 0; i < numBones; i += SIMD_WIDTH)
+	{
+		const SimdQuat u = LoadQuat(a, i);
+		const SimdQuat v = LoadQuat(b, i);
+
+		// same as Quaternion operator * followed by fastNormalize
+		SimdQuat r;
+		r.w = v.w * u.w - v.x * u.x - v.y * u.y - v.z * u.z;
+		r.x = v.w * u.x + v.x * u.w + v.y * u.z - v.z * u.y;
+		r.y = v.w * u.y + v.y * u.w + v.z * u.x - v.x * u.z;
+		r.z = v.w * u.z + v.z * u.w + v.x * u.y - v.y * u.x;
+
+		const Simd4f invLen = simdRsqrtFast(r.w * r.w + r.x * r.x + r.y * r.y + r.z * r.z);
+		r.x = r.x * invLen;
+		r.y = r.y * invLen;
+		r.z = r.z * invLen;
+		r.w = r.w * invLen;
+
+		StoreQuat(out, i, r);
+
+		simdStore(out.posX + i, simdLoad(a.posX + i) + simdLoad(b.posX + i));
+		simdStore(out.posY + i, simdLoad(a.posY + i) + simdLoad(b.posY + i));
+		simdStore(out.posZ + i, simdLoad(a.posZ + i) + simdLoad(b.posZ + i));
+	}
+}
+
+void AnimPose_Scale(AnimPose& pose, float scale)
+{
+	const int count = pose.stride * POSE_STREAMS;
+	const Simd4f s = simdSplat(scale);
+
+	for (int i = 0; i < count; i += SIMD_WIDTH)
+		simdStore(pose.posX + i, simdLoad(pose.posX + i) * s);
+}
+
+// out = a * b, out must not alias b
+static inline void SimdMatrixMultiply(const Matrix4x4& a, const Matrix4x4& b, Matrix4x4& out)
+{
+	const Simd4f b0 = simdLoad(&b.rows[0].x);
+	const Simd4f b1 = simdLoad(&b.rows[1].x);
+	const Simd4f b2 = simdLoad(&b.rows[2].x);
+	const Simd4f b3 = simdLoad(&b.rows[3].x);
+
+	for (int r = 0; r < 4; ++r)
+	{
+		const Vector4D& row = a.rows[r];
+		const Simd4f res = simdSplat(row.x) * b0 + simdSplat(row.y) * b1 + simdSplat(row.z) * b2 + simdSplat(row.w) * b3;
+		simdStore(&out.rows[r].x, res);
+	}
+}
+
+void AnimPose_ComputeBoneMatrices(const AnimPose& pose, ArrayCRef<studioJoint_t> joints, bool parentsSorted, Matrix4x4* outTransforms)
+{
+	const int numBones = pose.numBones;
+	ASSERT(pose.boneIndices ? parentsSorted : numBones == joints.numElem());
+
+	for (int i = 0; i < numBones; i += SIMD_WIDTH)
+	{
+		// rotation part of TMat4(const Quaternion&) for four bones
+		const SimdQuat q = LoadQuat(pose, i);
+
+		const Simd4f x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+		const Simd4f xx = q.x * x2, xy = q.x * y2, xz = q.x * z2;
+		const Simd4f yy = q.y * y2, yz = q.y * z2, zz = q.z * z2;
+		const Simd4f wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+		const Simd4f one = simdSplat(1.0f);
+
+		float rot[9][SIMD_WIDTH];
+		simdStore(rot[0], one - (yy + zz));
+		simdStore(rot[1], xy + wz);
+		simdStore(rot[2], xz - wy);
+		simdStore(rot[3], xy - wz);
+		simdStore(rot[4], one - (xx + zz));
+		simdStore(rot[5], yz + wx);
+		simdStore(rot[6], xz + wy);
+		simdStore(rot[7], yz - wx);
+		simdStore(rot[8], one - (xx + yy));
+
+		const int count = min(SIMD_WIDTH, numBones - i);
+		for (int j = 0; j < count; ++j)
+		{
+			const int lane = i + j;
+			const int boneId = AnimPose_GetLaneBone(pose, lane);
+			const Matrix4x4 local(
+				Vector4D(rot[0][j], rot[1][j], rot[2][j], 0.0f),
+				Vector4D(rot[3][j], rot[4][j], rot[5][j], 0.0f),
+				Vector4D(rot[6][j], rot[7][j], rot[8][j], 0.0f),
+				Vector4D(pose.posX[lane], pose.posY[lane], pose.posZ[lane], 1.0f));
+
+			const studioJoint_t& joint = joints[boneId];
+			const int parentIdx = joint.parent;
+
+			// parents are already in model space so the hierarchy is resolved in the same pass
+			if (parentsSorted && parentIdx != -1)
+			{
+				Matrix4x4 boneTransform;
+				SimdMatrixMultiply(local, joint.localTrans, boneTransform);
+				SimdMatrixMultiply(boneTransform, outTransforms[parentIdx], outTransforms[boneId]);
+			}
+			else
+			{
+				SimdMatrixMultiply(local, joint.localTrans, outTransforms[boneId]);
+			}
+		}
+	}
+
+	if (parentsSorted)
+		return;
+
+	for (int i = 0; i < numBones; ++i)
+	{
+		const int parentIdx = joints[i].parent;
+		if (parentIdx != -1)
+			outTransforms[i] = outTransforms[i] * outTransforms[parentIdx];
+	}
+}
@@ -0,0 +1,65 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: SoA skeleton pose and batched pose operations
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "egf/model.h"
+
+//-------------------------------------------------------------------------
+// Local pose of all bones stored as separate component streams
+// so the operations can process four bones per SIMD instruction.
+// Streams are padded to SIMD width; memory is owned by the caller.
+//
+// Pose may hold a subset of bones (animation LOD), then each lane
+// holds bone from boneIndices. Lane operations require same subset.
+//-------------------------------------------------------------------------
+struct AnimPose
+{
+	float*		posX{ nullptr };
+	float*		posY{ nullptr };
+	float*		posZ{ nullptr };
+
+	float*		rotX{ nullptr };
+	float*		rotY{ nullptr };
+	float*		rotZ{ nullptr };
+	float*		rotW{ nullptr };
+
+	const int*	boneIndices{ nullptr };	// bone of each lane in ascending order, nullptr if lanes are bones
+	int			numBones{ 0 };			// number of lanes
+	int			stride{ 0 };			// allocated lanes per stream
+};
+
+// size of pose memory in floats
+int		AnimPose_GetMemorySize(int numBones);
+float*	AnimPose_Init(AnimPose& pose, float* memory, int numBones);	// returns memory after the pose
+
+// makes pose hold only specified bones. boneIndices must outlive the pose, nullptr selects first numBones bones
+void	AnimPose_SetBoneSubset(AnimPose& pose, const int* boneIndices, int numBones);
+
+inline int AnimPose_GetLaneBone(const AnimPose& pose, int lane) { return pose.boneIndices ? pose.boneIndices[lane] : lane; }
+
+void	AnimPose_SetIdentity(AnimPose& pose);
+void	AnimPose_Copy(AnimPose& dst, const AnimPose& src);
+
+// copies bones from src which has different bone subset, missing bones are set to identity
+void	AnimPose_Remap(AnimPose& dst, const AnimPose& src);
+
+void	AnimPose_GetBone(const AnimPose& pose, int lane, Quaternion& rotation, Vector3D& position);
+
+// samples all bones of animation interpolated between two frames
+void	AnimPose_SampleAnimation(AnimPose& out, const studioAnimation_t* anim, int firstFrame, int lastFrame, float interp);
+
+// out = slerp(a, b, t) for rotations and lerp for positions. out may alias a or b
+void	AnimPose_Blend(AnimPose& out, const AnimPose& a, const AnimPose& b, float t);
+
+// out = a * b with normalized rotation and summed positions. out may alias a or b
+void	AnimPose_Add(AnimPose& out, const AnimPose& a, const AnimPose& b);
+
+void	AnimPose_Scale(AnimPose& pose, float scale);
+
+// computes model space bone matrices of pose bones. If parentsSorted is set parents must precede their children.
+// Pose with bone subset requires sorted parents which are included in the subset
+void	AnimPose_ComputeBoneMatrices(const AnimPose& pose, ArrayCRef<studioJoint_t> joints, bool parentsSorted, Matrix4x4* outTransforms);
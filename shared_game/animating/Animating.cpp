@@ -6,11 +6,16 @@
 //////////////////////////////////////////////////////////////////////////////////
 
 #include "core/core_common.h"
+#include "core/IEqParallelJobs.h"
 #include "core/ConVar.h"
+#include "core/ConCommand.h"
 #include "ds/sort.h"
 #include "render/IDebugOverlay.h"
+#include "materialsystem1/IMaterialSystem.h"
 #include "Animating.h"
+#include "AnimationManager.h"
 #include "studio/StudioGeom.h"
+#include "studio/StudioCache.h"
 #include "anim_activity.h"
 #include "anim_events.h"
 
@@ -18,14 +23,17 @@ DECLARE_CVAR(r_debugIK, "0", "Draw debug information about Inverse Kinematics",
 DECLARE_CVAR(r_debugSkeleton, "0", "Draw debug information about bones", CV_CHEAT);
 DECLARE_CVAR(r_debugShowBone, "-1", "Shows the bone", CV_CHEAT);
 DECLARE_CVAR(r_ikIterations, "100", "IK link iterations per update", CV_ARCHIVE);
+DECLARE_CVAR(anim_lod, "1", "Animate only bones used by model LOD and reduce update rate of distant models", CV_ARCHIVE);
+DECLARE_CVAR(anim_lodMaxUpdateInterval, "4", "Max frames between animation updates of distant models if not set by model", CV_ARCHIVE);
+DECLARE_CVAR(anim_lodLayerWeight, "0.01", "Sequence layers with smaller blend weight are not evaluated", CV_ARCHIVE);
 
-static Matrix4x4 CalculateLocalBonematrix(const qanimframe_t& frame)
+static struct
 {
-	Matrix4x4 bonetransform(frame.angBoneAngles);
-	bonetransform.setTranslation(frame.vecBonePosition);
-
-	return bonetransform;
-}
+	volatile int evaluatedBones{ 0 };
+	volatile int interpolatedBones{ 0 };
+	volatile int culledBones{ 0 };
+	volatile int skippedLayers{ 0 };
+} s_animLodCounters;
 
 // computes blending animation index and normalized weight
 static void ComputeAnimationBlend(int numWeights, const float blendrange[2], float blendValue, float& blendWeight, int& blendMainAnimation1, int& blendMainAnimation2)
@@ -60,38 +68,18 @@ static void ComputeAnimationBlend(int numWeights, const float blendrange[2], flo
 	blendMainAnimation2 = maxAnim;
 }
 
-// interpolates frame transform
-static void InterpolateFrameTransform(const qanimframe_t& frame1, const qanimframe_t& frame2, float value, qanimframe_t& out)
-{
-	out.angBoneAngles = slerp(frame1.angBoneAngles, frame2.angBoneAngles, value);
-	out.vecBonePosition = lerp(frame1.vecBonePosition, frame2.vecBonePosition, value);
-}
-
-// adds transform
-static void AddFrameTransform(const qanimframe_t& frame1, const qanimframe_t& frame2, qanimframe_t& out)
-{
-	out.angBoneAngles = frame1.angBoneAngles * frame2.angBoneAngles;
-	out.angBoneAngles.fastNormalize();
-	out.vecBonePosition = frame1.vecBonePosition + frame2.vecBonePosition;
-}
-
-// zero frame
-static void ZeroFrameTransform(qanimframe_t& frame)
-{
-	frame.angBoneAngles = identity();
-	frame.vecBonePosition = vec3_zero;
-}
-
 CAnimatingEGF::CAnimatingEGF()
 {
 	m_boneTransforms = nullptr;
-	m_transitionFrames = nullptr;
 	m_transitionTime = m_transitionRemTime = SEQ_DEFAULT_TRANSITION_TIME;
 	m_sequenceTimers.setNum(m_sequenceTimers.numAllocated());
 }
 
 CAnimatingEGF::~CAnimatingEGF()
 {
+	if (m_animationManager)
+		m_animationManager->Unregister(this);
+
 	DestroyAnimating();
 }
 
@@ -107,9 +95,23 @@ void CAnimatingEGF::DestroyAnimating()
 		PPFree(m_boneTransforms);
 	m_boneTransforms = nullptr;
 
-	if (m_transitionFrames)
-		PPFree(m_transitionFrames);
-	m_transitionFrames = nullptr;
+	if (m_skinningBones)
+		PPFree(m_skinningBones);
+	m_skinningBones = nullptr;
+
+	m_deferredEvents.clear();
+
+	if (m_poseMemory)
+		PPFree(m_poseMemory);
+	m_poseMemory = nullptr;
+	m_parentsSorted = true;
+
+	m_studioGeom = nullptr;
+	m_lodBones.clear();
+	m_animLod = 0;
+	m_lodUpdateInterval = 1;
+	m_lodFramesLeft = 0;
+	m_lodPoseValid = false;
 
 	m_transitionTime = m_transitionRemTime = SEQ_DEFAULT_TRANSITION_TIME;
 	m_sequenceTimers.clear();
@@ -132,8 +134,41 @@ void CAnimatingEGF::InitAnimating(CEqStudioGeom* model)
 	for (int i = 0; i < m_joints.numElem(); i++)
 		m_boneTransforms[i] = m_joints[i].absTrans;
 
-	m_transitionFrames = PPAllocStructArray(qanimframe_t, m_joints.numElem());
-	memset(m_transitionFrames, 0, sizeof(qanimframe_t) * m_joints.numElem());
+	m_skinningBones = PPAllocStructArray(RenderBoneTransform, m_joints.numElem());
+	UpdateSkinningBones();
+
+	{
+		const int numBones = m_joints.numElem();
+		AnimPose* poses[] = { &m_transitionPose, &m_finalPose, &m_timedPose, &m_addPose, &m_layerPose, &m_blendPose, &m_lodPrevPose, &m_lodNextPose };
+
+		m_poseMemory = PPAllocStructArray(float, AnimPose_GetMemorySize(numBones) * elementsOf(poses));
+		memset(m_poseMemory, 0, sizeof(float) * AnimPose_GetMemorySize(numBones) * elementsOf(poses));
+
+		float* poseMemory = m_poseMemory;
+		for (AnimPose* pose : poses)
+			poseMemory = AnimPose_Init(*pose, poseMemory, numBones);
+
+		for (int i = 0; i < numBones; i++)
+		{
+			if (m_joints[i].parent >= i)
+				m_parentsSorted = false;
+		}
+
+		// bone subsets need parents to be computed first
+		const bool useBoneLods = (studio.flags & STUDIO_FLAG_ANIM_LOD) && m_parentsSorted;
+
+		m_studioGeom = model;
+		for (int lod = 0; lod < MAX_MODEL_LODS; ++lod)
+		{
+			m_lodBoneOffsets[lod] = m_lodBones.numElem();
+			for (int i = 0; i < numBones; i++)
+			{
+				if (!useBoneLods || (m_joints[i].bone->lodMask & (1 << lod)))
+					m_lodBones.append(i);
+			}
+		}
+		m_lodBoneOffsets[MAX_MODEL_LODS] = m_lodBones.numElem();
+	}
 
 	//m_velocityFrames = PPAllocStructArray(qanimframe_t, m_numBones);
 	//memset(m_velocityFrames, 0, sizeof(qanimframe_t)*m_numBones);
@@ -527,13 +562,36 @@ void CAnimatingEGF::RaiseSequenceEvents(sequencetimer_t& timer)
 		if (event_type == EV_INVALID)	// try as event number
 			event_type = (AnimationEvent)atoi(evt->command);
 
-		HandleAnimatingEvent(event_type, evt->parameter);
+		if (m_deferEvents)
+			m_deferredEvents.append({ event_type, evt->parameter });
+		else
+			HandleAnimatingEvent(event_type, evt->parameter);
 
 		// to the next
 		timer.eventCounter++;
 	}
 }
 
+void CAnimatingEGF::SetDeferredEvents(bool enable)
+{
+	if (!enable)
+		DispatchDeferredEvents();
+
+	m_deferEvents = enable;
+}
+
+void CAnimatingEGF::DispatchDeferredEvents()
+{
+	// handler is allowed to change animation state
+	for (int i = 0; i < m_deferredEvents.numElem(); ++i)
+	{
+		const DeferredEvent evt = m_deferredEvents[i];
+		HandleAnimatingEvent(evt.type, evt.parameter);
+	}
+
+	m_deferredEvents.clear(false);
+}
+
 // swaps sequence timers
 void CAnimatingEGF::SwapSequenceTimers(int index, int swapTo)
 {
@@ -582,34 +640,40 @@ void CAnimatingEGF::GetPoseControllerRange(int nPoseCtrl, float& rMin, float& rM
 	rMax = poseCtrl.p->blendRange[1];
 }
 
-static void GetInterpolatedBoneFrame(const studioAnimation_t* pAnim, int nBone, int firstframe, int lastframe, float interp, qanimframe_t& out)
-{
-	studioBoneAnimation_t& frame = pAnim->bones[nBone];
-	ASSERT(firstframe >= 0);
-	ASSERT(lastframe >= 0);
-	ASSERT(firstframe < frame.numFrames);
-	ASSERT(lastframe < frame.numFrames);
-	InterpolateFrameTransform(frame.keyFrames[firstframe], frame.keyFrames[lastframe], interp, out);
-}
-
-static void GetInterpolatedBoneFrameBetweenTwoAnimations(
-	const studioAnimation_t* pAnim1,
-	const studioAnimation_t* pAnim2,
-	int nBone, int firstframe, int lastframe, float interp, float animTransition, qanimframe_t& out)
+// samples sequence pose blending it's animations by pose controller
+static void GetSequencePose(gsequence_t* seq, int firstFrame, int lastFrame, float interp, AnimPose& out, AnimPose& scratch)
 {
-	// compute frame 1
-	qanimframe_t anim1transform;
-	GetInterpolatedBoneFrame(pAnim1, nBone, firstframe, lastframe, interp, anim1transform);
-
-	// compute frame 2
-	qanimframe_t anim2transform;
-	GetInterpolatedBoneFrame(pAnim2, nBone, firstframe, lastframe, interp, anim2transform);
+	const sequencedesc_t* seqDesc = seq->s;
+	const int numAnims = seqDesc->numAnimations;
 
-	// resultative interpolation
-	InterpolateFrameTransform(anim1transform, anim2transform, animTransition, out);
+	if (numAnims > 1 && seq->posecontroller)
+	{
+		const gposecontroller_t* ctrl = seq->posecontroller;
+
+		float blendWeight = 0;
+		int blendAnimation1 = 0;
+		int blendAnimation2 = 0;
+
+		// get frame indexes and lerp value of blended animation
+		ComputeAnimationBlend(numAnims,
+			ctrl->p->blendRange,
+			ctrl->interpolatedValue,
+			blendWeight,
+			blendAnimation1,
+			blendAnimation2);
+
+		AnimPose_SampleAnimation(out, seq->animations[blendAnimation1], firstFrame, lastFrame, interp);
+		AnimPose_SampleAnimation(scratch, seq->animations[blendAnimation2], firstFrame, lastFrame, interp);
+		AnimPose_Blend(out, out, scratch, blendWeight);
+	}
+	else
+	{
+		// simply compute frames
+		AnimPose_SampleAnimation(out, seq->animations[0], firstFrame, lastFrame, interp);
+	}
 }
 
-static void GetSequenceLayerBoneFrame(gsequence_t* pSequence, int nBone, qanimframe_t& out)
+static void GetSequenceLayerPose(gsequence_t* pSequence, AnimPose& out, AnimPose& scratch)
 {
 	float blendWeight = 0;
 	int blendAnimation1 = 0;
@@ -623,148 +687,218 @@ static void GetSequenceLayerBoneFrame(gsequence_t* pSequence, int nBone, qanimfr
 		blendAnimation2
 	);
 
-	const studioAnimation_t* pAnim1 = pSequence->animations[blendAnimation1];
-	const studioAnimation_t* pAnim2 = pSequence->animations[blendAnimation2];
-
-	GetInterpolatedBoneFrameBetweenTwoAnimations(pAnim1,
-		pAnim2,
-		nBone,
-		0,
-		0,
-		0,
-		blendWeight,
-		out
-	);
+	AnimPose_SampleAnimation(out, pSequence->animations[blendAnimation1], 0, 0, 0.0f);
+	AnimPose_SampleAnimation(scratch, pSequence->animations[blendAnimation2], 0, 0, 0.0f);
+	AnimPose_Blend(out, out, scratch, blendWeight);
 }
 
 // updates bones
 void CAnimatingEGF::RecalcBoneTransforms()
 {
-	m_sequenceTimers[0].blendWeight = 1.0f;
+	if (!m_poseMemory)
+		return;
 
-	// setup each bone's transformation
-	for (int boneId = 0; boneId < m_joints.numElem(); boneId++)
-	{
-		qanimframe_t finalBoneFrame;
+	PROF_EVENT("Animating RecalcBoneTransforms");
 
-		for (sequencetimer_t& timer : m_sequenceTimers)
-		{
-			// if no animation plays on this timer, continue
-			if (!timer.seq)
-				continue;
+	const int numLodBones = m_finalPose.numBones;
+	Atomic::Add(s_animLodCounters.culledBones, m_joints.numElem() - numLodBones);
 
-			gsequence_t* seq = timer.seq;
-			const sequencedesc_t* seqDesc = seq->s;
+	// sequences are not evaluated on throttled frames
+	if (m_lodUpdateInterval > 1 && m_lodPoseValid && m_lodFramesLeft > 0)
+	{
+		--m_lodFramesLeft;
 
-			if (timer.blendWeight <= 0)
-				continue;
+		const float lodLerp = 1.0f - (float)m_lodFramesLeft / (float)m_lodUpdateInterval;
+		AnimPose_Blend(m_finalPose, m_lodPrevPose, m_lodNextPose, lodLerp);
+		AnimPose_ComputeBoneMatrices(m_finalPose, m_joints, m_parentsSorted, m_boneTransforms);
 
-			const studioAnimation_t* curanim = seq->animations[0];
+		Atomic::Add(s_animLodCounters.interpolatedBones, numLodBones);
+		return;
+	}
 
-			if (!curanim)
-				continue;
+	const bool throttled = m_lodUpdateInterval > 1;
 
-			// the computed frame
-			qanimframe_t cTimedFrame;
+	// interpolation continues from currently displayed pose
+	if (throttled && m_lodPoseValid)
+		AnimPose_Copy(m_lodPrevPose, m_finalPose);
 
-			const float frame_interp = min(timer.seq_time - timer.currFrame, 1.0f);
-			const int numAnims = seqDesc->numAnimations;
+	const float layerWeightThreshold = anim_lodLayerWeight.GetFloat();
 
-			// blend between many animations in sequence using pose controller
-			if (numAnims > 1 && timer.seq->posecontroller)
-			{
-				gposecontroller_t* ctrl = timer.seq->posecontroller;
-
-				float playingBlendWeight = 0;
-				int playingBlendAnimation1 = 0;
-				int playingBlendAnimation2 = 0;
-
-				// get frame indexes and lerp value of blended animation
-				ComputeAnimationBlend(numAnims,
-					ctrl->p->blendRange,
-					ctrl->interpolatedValue,
-					playingBlendWeight,
-					playingBlendAnimation1,
-					playingBlendAnimation2);
-
-				// get frame pointers
-				const studioAnimation_t* pPlayingAnim1 = seq->animations[playingBlendAnimation1];
-				const studioAnimation_t* pPlayingAnim2 = seq->animations[playingBlendAnimation2];
-
-				// compute blending frame
-				GetInterpolatedBoneFrameBetweenTwoAnimations(pPlayingAnim1,
-					pPlayingAnim2,
-					boneId,
-					timer.currFrame,
-					timer.nextFrame,
-					frame_interp,
-					playingBlendWeight,
-					cTimedFrame);
-			}
-			else
-			{
-				// simply compute frames
-				GetInterpolatedBoneFrame(curanim, boneId, timer.currFrame, timer.nextFrame, frame_interp, cTimedFrame);
-			}
+	m_sequenceTimers[0].blendWeight = 1.0f;
 
-			qanimframe_t cAddFrame;
+	AnimPose_SetIdentity(m_finalPose);
 
-			int seqBlends = seqDesc->numSequenceBlends;
+	// each sequence layer is sampled for all bones at once
+	for (sequencetimer_t& timer : m_sequenceTimers)
+	{
+		// if no animation plays on this timer, continue
+		if (!timer.seq)
+			continue;
 
-			// add blended sequences to this
-			for (int blend_seq = 0; blend_seq < seqBlends; blend_seq++)
-			{
-				gsequence_t* pSequence = seq->blends[blend_seq];
+		gsequence_t* seq = timer.seq;
+		const sequencedesc_t* seqDesc = seq->s;
 
-				qanimframe_t frame;
+		if (timer.blendWeight <= 0)
+			continue;
 
-				// get bone frame of layer
-				GetSequenceLayerBoneFrame(pSequence, boneId, frame);
+		if (timer.blendWeight < layerWeightThreshold)
+		{
+			Atomic::Increment(s_animLodCounters.skippedLayers);
+			continue;
+		}
 
-				AddFrameTransform(cAddFrame, frame, cAddFrame);
-			}
+		if (!seq->animations[0])
+			continue;
 
-			AddFrameTransform(cTimedFrame, cAddFrame, cTimedFrame);
+		const float frame_interp = min(timer.seq_time - timer.currFrame, 1.0f);
+		GetSequencePose(seq, timer.currFrame, timer.nextFrame, frame_interp, m_timedPose, m_blendPose);
 
-			// interpolate or add the slots, this is useful for body part splitting
-			if (seqDesc->flags & SEQFLAG_SLOTBLEND)
-			{
-				// TODO: check if that incorrect since we've switched to quaternions
-				cTimedFrame.angBoneAngles *= timer.blendWeight;
-				cTimedFrame.vecBonePosition *= timer.blendWeight;
+		// add blended sequences to this
+		AnimPose_SetIdentity(m_addPose);
 
-				AddFrameTransform(finalBoneFrame, cTimedFrame, finalBoneFrame);
-			}
-			else
-				InterpolateFrameTransform(finalBoneFrame, cTimedFrame, timer.blendWeight, finalBoneFrame);
+		const int seqBlends = seqDesc->numSequenceBlends;
+		for (int blend_seq = 0; blend_seq < seqBlends; blend_seq++)
+		{
+			GetSequenceLayerPose(seq->blends[blend_seq], m_layerPose, m_blendPose);
+			AnimPose_Add(m_addPose, m_addPose, m_layerPose);
 		}
 
-		// first sequence timer is main and has transition effects
-		if (m_transitionTime > 0.0f && m_transitionRemTime > 0.0f)
+		AnimPose_Add(m_timedPose, m_timedPose, m_addPose);
+
+		// interpolate or add the slots, this is useful for body part splitting
+		if (seqDesc->flags & SEQFLAG_SLOTBLEND)
 		{
-			// perform transition based on the last frame
-			const float transitionLerp = m_transitionRemTime / m_transitionTime;
-			InterpolateFrameTransform(finalBoneFrame, m_transitionFrames[boneId], transitionLerp, finalBoneFrame);
+			// TODO: check if that incorrect since we've switched to quaternions
+			AnimPose_Scale(m_timedPose, timer.blendWeight);
+			AnimPose_Add(m_finalPose, m_finalPose, m_timedPose);
 		}
 		else
-		{
-			m_transitionFrames[boneId] = finalBoneFrame;
-		}
+			AnimPose_Blend(m_finalPose, m_finalPose, m_timedPose, timer.blendWeight);
+	}
 
-		// compute transformation
-		Matrix4x4 calculatedFrameMat = CalculateLocalBonematrix(finalBoneFrame);
+	// first sequence timer is main and has transition effects
+	if (m_transitionTime > 0.0f && m_transitionRemTime > 0.0f)
+	{
+		// perform transition based on the last frame
+		const float transitionLerp = m_transitionRemTime / m_transitionTime;
+		AnimPose_Blend(m_finalPose, m_finalPose, m_transitionPose, transitionLerp);
+	}
+	else
+	{
+		AnimPose_Copy(m_transitionPose, m_finalPose);
+	}
+
+	Atomic::Add(s_animLodCounters.evaluatedBones, numLodBones);
+
+	if (throttled)
+	{
+		AnimPose_Copy(m_lodNextPose, m_finalPose);
 
-		// store matrix
-		m_boneTransforms[boneId] = (calculatedFrameMat * m_joints[boneId].localTrans);
+		if (m_lodPoseValid)
+			AnimPose_Blend(m_finalPose, m_lodPrevPose, m_lodNextPose, 1.0f / (float)m_lodUpdateInterval);
+		else
+			AnimPose_Copy(m_lodPrevPose, m_finalPose);
+
+		m_lodFramesLeft = m_lodUpdateInterval - 1;
 	}
+	m_lodPoseValid = true;
 
-	// setup each bone's transformation
-	for (int i = 0; i < m_joints.numElem(); i++)
+	AnimPose_ComputeBoneMatrices(m_finalPose, m_joints, m_parentsSorted, m_boneTransforms);
+}
+
+void CAnimatingEGF::UpdateAnimationLOD(float distance)
+{
+	if (!m_studioGeom)
+		return;
+
+	if (!anim_lod.GetBool())
+	{
+		SetAnimationLOD(0, 1);
+		return;
+	}
+
+	const studioHdr_t& studio = m_studioGeom->GetStudioHdr();
+	const int lod = m_studioGeom->SelectLod(distance);
+
+	// model may specify update interval for each LOD
+	int updateInterval = 0;
+	if ((studio.flags & STUDIO_FLAG_ANIM_LOD) && lod < studio.numLodParams)
+		updateInterval = studio.pLodParams(lod)->animUpdateInterval;
+
+	if (!updateInterval)
+		updateInterval = min(lod + 1, anim_lodMaxUpdateInterval.GetInt());
+
+	SetAnimationLOD(lod, updateInterval);
+}
+
+void CAnimatingEGF::SetAnimationLOD(int lod, int updateInterval)
+{
+	if (!m_poseMemory)
+		return;
+
+	lod = clamp(lod, 0, MAX_MODEL_LODS - 1);
+	updateInterval = max(1, updateInterval);
+
+	if (m_lodUpdateInterval != updateInterval)
 	{
-		const int parentIdx = m_joints[i].parent;
-		if (parentIdx != -1)
-			m_boneTransforms[i] = m_boneTransforms[i] * m_boneTransforms[parentIdx];
+		m_lodUpdateInterval = updateInterval;
+		m_lodFramesLeft = 0;
 	}
+
+	if (m_animLod == lod)
+		return;
+
+	m_animLod = lod;
+
+	const int numLodBones = m_lodBoneOffsets[lod + 1] - m_lodBoneOffsets[lod];
+	const int* boneIndices = (numLodBones == m_joints.numElem()) ? nullptr : m_lodBones.ptr() + m_lodBoneOffsets[lod];
+
+	if (m_transitionPose.boneIndices == boneIndices)
+		return;
+
+	// keep transition continuous
+	AnimPose_SetBoneSubset(m_blendPose, boneIndices, numLodBones);
+	AnimPose_Remap(m_blendPose, m_transitionPose);
+	QuickSwap(m_blendPose, m_transitionPose);
+
+	AnimPose* poses[] = { &m_finalPose, &m_timedPose, &m_addPose, &m_layerPose, &m_blendPose, &m_lodPrevPose, &m_lodNextPose };
+	for (AnimPose* pose : poses)
+		AnimPose_SetBoneSubset(*pose, boneIndices, numLodBones);
+
+	m_lodPoseValid = false;
+	m_lodFramesLeft = 0;
+}
+
+void CAnimatingEGF::GetAnimLodCounters(AnimLodCounters& counters)
+{
+	counters.evaluatedBones = Atomic::Load(s_animLodCounters.evaluatedBones);
+	counters.interpolatedBones = Atomic::Load(s_animLodCounters.interpolatedBones);
+	counters.culledBones = Atomic::Load(s_animLodCounters.culledBones);
+	counters.skippedLayers = Atomic::Load(s_animLodCounters.skippedLayers);
+}
+
+void CAnimatingEGF::ResetAnimLodCounters()
+{
+	Atomic::Store(s_animLodCounters.evaluatedBones, 0);
+	Atomic::Store(s_animLodCounters.interpolatedBones, 0);
+	Atomic::Store(s_animLodCounters.culledBones, 0);
+	Atomic::Store(s_animLodCounters.skippedLayers, 0);
+}
+
+void CAnimatingEGF::UpdateSkinningBones()
+{
+	if (!m_skinningBones)
+		return;
+
+	ComputeQuaternionsForSkinning(m_joints, m_boneTransforms, m_skinningBones);
+}
+
+ArrayCRef<RenderBoneTransform> CAnimatingEGF::GetSkinningBones() const
+{
+	if (!m_skinningBones)
+		return ArrayCRef<RenderBoneTransform>(nullptr);
+
+	return ArrayCRef(m_skinningBones, m_joints.numElem());
 }
 
 Matrix4x4 CAnimatingEGF::GetLocalStudioTransformMatrix(int attachmentIdx) const
@@ -1092,4 +1226,93 @@ int CAnimatingEGF::FindIKChain(const char* pszName)
 	}
 
 	return -1;
-}
\ No newline at end of file
+}
+DECLARE_CMD(anim_bench_pose, "Measures bone setup speed of animated model. Usage: anim_bench_pose <model> [numCharacters] [numFrames] [animLod]", CV_CHEAT)
+{
+	if (CMD_ARGC == 0)
+	{
+		MsgWarning("Usage: anim_bench_pose <model> [numCharacters] [numFrames] [animLod]\n");
+		return;
+	}
+
+	const int numCharacters = CMD_ARGC > 1 ? max(atoi(CMD_ARGV(1).ToCString()), 1) : 500;
+	const int numFrames = CMD_ARGC > 2 ? max(atoi(CMD_ARGV(2).ToCString()), 1) : 60;
+	const int animLod = CMD_ARGC > 3 ? clamp(atoi(CMD_ARGV(3).ToCString()), 0, MAX_MODEL_LODS - 1) : 0;
+
+	const int modelIdx = g_studioModelCache->PrecacheModel(CMD_ARGV(0).ToCString());
+	CEqStudioGeom* model = g_studioModelCache->GetModel(modelIdx);
+	EGF_LOADING_CRITICAL_SECTION(model);
+
+	if (!model->GetMotionPackageCount())
+	{
+		MsgWarning("%s has no motion packages\n", model->GetName());
+		return;
+	}
+
+	Array<CAnimatingEGF*> characters(PP_SL);
+	characters.reserve(numCharacters);
+
+	for (int i = 0; i < numCharacters; ++i)
+	{
+		CAnimatingEGF* character = PPNew CAnimatingEGF();
+		character->InitAnimating(model);
+		character->SetSequence(0, 0);
+		character->PlaySequence(0);
+
+		// desync characters so they don't sample same frames
+		character->SetSequenceTime(i * 0.37f, 0);
+		character->SetAnimationLOD(animLod, animLod + 1);
+		characters.append(character);
+	}
+
+	const float frameTime = 1.0f / 60.0f;
+	double advanceTime = 0.0;
+	double poseTime = 0.0;
+
+	CAnimatingEGF::ResetAnimLodCounters();
+
+	CEqTimer timer;
+	for (int frame = 0; frame < numFrames; ++frame)
+	{
+		timer.GetTime(true);
+		for (CAnimatingEGF* character : characters)
+			character->AdvanceFrame(frameTime);
+		advanceTime += timer.GetTime(true);
+
+		for (CAnimatingEGF* character : characters)
+			character->RecalcBoneTransforms();
+		poseTime += timer.GetTime(true);
+	}
+
+	const int numBones = model->GetStudioHdr().numBones;
+	const double poseFrameMs = poseTime * 1000.0 / numFrames;
+
+	MsgInfo("%d characters x %d bones, %d frames\n", numCharacters, numBones, numFrames);
+	MsgInfo("  advance: %.3f ms per frame\n", advanceTime * 1000.0 / numFrames);
+	MsgInfo("  pose: %.3f ms per frame (%.1f ns per bone)\n", poseFrameMs, poseFrameMs * 1000000.0 / (numCharacters * max(numBones, 1)));
+
+	AnimLodCounters counters;
+	CAnimatingEGF::GetAnimLodCounters(counters);
+	MsgInfo("  LOD %d bones per frame: %d evaluated, %d interpolated, %d culled\n", animLod,
+		counters.evaluatedBones / numFrames, counters.interpolatedBones / numFrames, counters.culledBones / numFrames);
+
+	// full update through job batches
+	{
+		CAnimationManager manager;
+		for (CAnimatingEGF* character : characters)
+			manager.Register(character);
+
+		timer.GetTime(true);
+		for (int frame = 0; frame < numFrames; ++frame)
+			manager.Update(frameTime);
+		const double managerTime = timer.GetTime(true);
+
+		for (CAnimatingEGF* character : characters)
+			manager.Unregister(character);
+
+		MsgInfo("  animation manager (advance, pose, IK, skinning): %.3f ms per frame\n", managerTime * 1000.0 / numFrames);
+	}
+
+	for (CAnimatingEGF* character : characters)
+		delete character;
+}
@@ -7,6 +7,7 @@
 
 #pragma once
 #include "BoneSetup.h"
+#include "AnimPose.h"
 #include "anim_events.h"
 #include "anim_activity.h"
 
@@ -15,10 +16,22 @@
 //--------------------------------------------------------------------------------------
 
 class CEqStudioGeom;
+class CAnimationManager;
 struct studioJoint_t;
+struct RenderBoneTransform;
+
+// animation LOD counters summed over all animated objects
+struct AnimLodCounters
+{
+	int		evaluatedBones{ 0 };		// bones sampled from sequences
+	int		interpolatedBones{ 0 };		// bones interpolated between throttled updates
+	int		culledBones{ 0 };			// bones not animated due to LOD bone mask
+	int		skippedLayers{ 0 };			// sequence layers below blend weight threshold
+};
 
 class CAnimatingEGF
 {
+	friend class CAnimationManager;
 public:
 	CAnimatingEGF();
 	virtual ~CAnimatingEGF();
@@ -82,8 +95,36 @@ public:
 
 	void						RecalcBoneTransforms();
 
+	// selects animation LOD by model LOD distances
+	void						UpdateAnimationLOD(float distance);
+
+	// animates only bones used by LOD and evaluates sequences every updateInterval frames
+	void						SetAnimationLOD(int lod, int updateInterval = 1);
+	int							GetAnimationLOD() const { return m_animLod; }
+	int							GetAnimationUpdateInterval() const { return m_lodUpdateInterval; }
+
+	static void					GetAnimLodCounters(AnimLodCounters& counters);
+	static void					ResetAnimLodCounters();
+
+	// converts bone matrices to hardware skinning transforms which can be passed to DrawProps::skinningBones
+	void						UpdateSkinningBones();
+	ArrayCRef<RenderBoneTransform> GetSkinningBones() const;
+
+	// world transform used by UpdateIK when updated by animation manager
+	void						SetAnimatingWorldTransform(const Matrix4x4& transform) { m_animatingWorldTransform = transform; }
+	const Matrix4x4&			GetAnimatingWorldTransform() const { return m_animatingWorldTransform; }
+
+	// when enabled AdvanceFrame queues sequence events instead of handling them
+	void						SetDeferredEvents(bool enable);
+	void						DispatchDeferredEvents();
+
 	void						DebugRender(const Matrix4x4& worldTransform);
 protected:
+	struct DeferredEvent
+	{
+		AnimationEvent	type;
+		const char*		parameter;
+	};
 
 	void						RaiseSequenceEvents(sequencetimer_t& timer);
 	void						UpdateIkChain(gikchain_t* pIkChain, float fDt);
@@ -97,11 +138,37 @@ protected:
 	// transition time from previous
 	float						m_transitionTime;
 	float						m_transitionRemTime;
-	qanimframe_t*				m_transitionFrames{ nullptr };
 	qanimframe_t*				m_velocityFrames{ nullptr };
 
+	// SoA pose buffers used by RecalcBoneTransforms
+	float*						m_poseMemory{ nullptr };
+	AnimPose					m_transitionPose;
+	AnimPose					m_finalPose;
+	AnimPose					m_timedPose;
+	AnimPose					m_addPose;
+	AnimPose					m_layerPose;
+	AnimPose					m_blendPose;
+	bool						m_parentsSorted{ true };	// parents precede children, bone matrices computed in single pass
+
+	// animation LOD
+	const CEqStudioGeom*		m_studioGeom{ nullptr };
+	Array<int>					m_lodBones{ PP_SL };		// bones animated by each LOD
+	int							m_lodBoneOffsets[MAX_MODEL_LODS + 1]{ 0 };
+	AnimPose					m_lodPrevPose;
+	AnimPose					m_lodNextPose;
+	int							m_animLod{ 0 };
+	int							m_lodUpdateInterval{ 1 };
+	int							m_lodFramesLeft{ 0 };
+	bool						m_lodPoseValid{ false };	// final pose is displayed pose of current LOD
+
 	// computed ready-to-use matrices
 	Matrix4x4*					m_boneTransforms{ nullptr };
+	RenderBoneTransform*		m_skinningBones{ nullptr };
+	Matrix4x4					m_animatingWorldTransform{ identity4 };
+
+	Array<DeferredEvent>		m_deferredEvents{ PP_SL };
+	bool						m_deferEvents{ false };
+	CAnimationManager*			m_animationManager{ nullptr };	// set while registered
 
 	// local bones/base pose
 	ArrayCRef<studioJoint_t>		m_joints{ nullptr };
@@ -0,0 +1,198 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Parallel animation update of registered animating instances
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/IEqParallelJobs.h"
+#include "core/ConVar.h"
+#include "render/IDebugOverlay.h"
+#include "AnimationManager.h"
+#include "Animating.h"
+
+DECLARE_CVAR(anim_parallel, "1", "Update animated objects on job threads", CV_ARCHIVE);
+DECLARE_CVAR(anim_batchSize, "16", "Number of animated objects updated by single job batch", CV_ARCHIVE);
+DECLARE_CVAR(anim_debugLod, "0", "Show animation LOD counters", CV_CHEAT);
+
+CAnimationManager::~CAnimationManager()
+{
+	EndUpdate();
+
+	// instances may outlive the manager
+	for (CAnimatingEGF* animating : m_instances)
+	{
+		animating->m_animationManager = nullptr;
+		animating->SetDeferredEvents(false);
+	}
+
+	m_instances.clear(true);
+	m_dispatchList.clear(true);
+}
+
+void CAnimationManager::Register(CAnimatingEGF* animating)
+{
+	ASSERT_MSG(!m_updating, "CAnimationManager::Register called during update");
+
+	if (animating->m_animationManager == this)
+		return;
+
+	if (animating->m_animationManager)
+		animating->m_animationManager->Unregister(animating);
+
+	m_instances.append(animating);
+	animating->m_animationManager = this;
+	animating->SetDeferredEvents(true);
+}
+
+void CAnimationManager::Unregister(CAnimatingEGF* animating)
+{
+	ASSERT_MSG(!m_updating, "CAnimationManager::Unregister called during update");
+
+	if (animating->m_animationManager != this)
+		return;
+
+	m_instances.fastRemove(animating);
+	animating->m_animationManager = nullptr;
+
+	// object might be removed by event handler of another object
+	if (m_dispatching)
+	{
+		const int dispatchIdx = arrayFindIndex(m_dispatchList, animating);
+		if (dispatchIdx != -1)
+			m_dispatchList[dispatchIdx] = nullptr;
+	}
+
+	animating->SetDeferredEvents(false);
+}
+
+void CAnimationManager::SetLODViewPosition(const Vector3D& position)
+{
+	m_lodViewPosition = position;
+	m_lodViewPositionSet = true;
+}
+
+void CAnimationManager::ClearLODViewPosition()
+{
+	m_lodViewPositionSet = false;
+}
+
+void CAnimationManager::BeginUpdate(float fDt)
+{
+	ASSERT_MSG(!m_updating, "CAnimationManager::BeginUpdate called twice");
+
+	m_updating = true;
+	m_frameTime = fDt;
+	m_numBatches = 0;
+	m_numJobs = 0;
+
+	CAnimatingEGF::ResetAnimLodCounters();
+
+	if (!m_instances.numElem())
+		return;
+
+	PROF_EVENT("Animation Manager Begin Update");
+
+	m_batchSize = max(1, anim_batchSize.GetInt());
+	m_numBatches = (m_instances.numElem() + m_batchSize - 1) / m_batchSize;
+	Atomic::Store(m_nextBatch, 0);
+
+	// calling thread takes batches as well in EndUpdate
+	if (anim_parallel.GetBool())
+		m_numJobs = min(g_parallelJobs->GetJobThreadsCount(), m_numBatches - 1);
+
+	if (!m_numJobs)
+		return;
+
+	m_updateDone.Clear();
+	Atomic::Store(m_activeJobs, m_numJobs);
+
+	for (int i = 0; i < m_numJobs; ++i)
+	{
+		g_parallelJobs->AddJob(JOB_TYPE_ANY, [this](void*, int) {
+			ProcessBatches();
+
+			if (Atomic::Decrement(m_activeJobs) == 0)
+				m_updateDone.Raise();
+		});
+	}
+	g_parallelJobs->Submit();
+}
+
+void CAnimationManager::EndUpdate()
+{
+	if (!m_updating)
+		return;
+
+	{
+		PROF_EVENT("Animation Manager Wait");
+
+		ProcessBatches();
+
+		if (m_numJobs)
+			m_updateDone.Wait();
+	}
+
+	m_updating = false;
+
+	if (anim_debugLod.GetBool())
+	{
+		AnimLodCounters counters;
+		CAnimatingEGF::GetAnimLodCounters(counters);
+
+		debugoverlay->Text(color_white, "Animation: %d objects, bones evaluated: %d, interpolated: %d, culled: %d, layers skipped: %d",
+			m_instances.numElem(), counters.evaluatedBones, counters.interpolatedBones, counters.culledBones, counters.skippedLayers);
+	}
+
+	PROF_EVENT("Animation Manager Dispatch Events");
+
+	// handlers may unregister objects
+	m_dispatching = true;
+	m_dispatchList.clear(false);
+	m_dispatchList.append(m_instances);
+
+	for (int i = 0; i < m_dispatchList.numElem(); ++i)
+	{
+		if (m_dispatchList[i])
+			m_dispatchList[i]->DispatchDeferredEvents();
+	}
+	m_dispatching = false;
+}
+
+void CAnimationManager::Update(float fDt)
+{
+	BeginUpdate(fDt);
+	EndUpdate();
+}
+
+void CAnimationManager::ProcessBatches()
+{
+	PROF_EVENT("Animation Manager Batches");
+
+	const int numInstances = m_instances.numElem();
+	const float frameTime = m_frameTime;
+
+	while (true)
+	{
+		const int batchIdx = Atomic::Increment(m_nextBatch) - 1;
+		if (batchIdx >= m_numBatches)
+			break;
+
+		const int first = batchIdx * m_batchSize;
+		const int last = min(first + m_batchSize, numInstances);
+
+		for (int i = first; i < last; ++i)
+		{
+			CAnimatingEGF* animating = m_instances[i];
+
+			if (m_lodViewPositionSet)
+				animating->UpdateAnimationLOD(length(animating->GetAnimatingWorldTransform().getTranslationComponent() - m_lodViewPosition));
+
+			animating->AdvanceFrame(frameTime);
+			animating->RecalcBoneTransforms();
+			animating->UpdateIK(frameTime, animating->GetAnimatingWorldTransform());
+			animating->UpdateSkinningBones();
+		}
+	}
+}
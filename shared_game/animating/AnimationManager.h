@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Parallel animation update of registered animating instances
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+class CAnimatingEGF;
+
+//-------------------------------------------------------------------------
+// Runs frame advance, bone setup, IK and skinning transforms of all
+// registered instances as job batches in a single frame phase.
+// Sequence events are deferred and dispatched in EndUpdate on the calling thread.
+// Owner must call Update once per frame, unregistered instances update themselves.
+// Destroying the manager unregisters all instances still registered.
+//-------------------------------------------------------------------------
+class CAnimationManager
+{
+public:
+					~CAnimationManager();
+
+	void			Register(CAnimatingEGF* animating);
+	void			Unregister(CAnimatingEGF* animating);
+	int				GetRegisteredCount() const { return m_instances.numElem(); }
+
+	// starts update of all registered instances
+	void			BeginUpdate(float fDt);
+
+	// waits for update completion and dispatches sequence events
+	void			EndUpdate();
+
+	void			Update(float fDt);
+
+	bool			IsUpdating() const { return m_updating; }
+
+	// animation LOD of registered instances is selected by distance to view
+	void			SetLODViewPosition(const Vector3D& position);
+	void			ClearLODViewPosition();
+
+private:
+	void			ProcessBatches();
+
+	Array<CAnimatingEGF*>	m_instances{ PP_SL };
+	Array<CAnimatingEGF*>	m_dispatchList{ PP_SL };
+	Threading::CEqSignal	m_updateDone;
+
+	Vector3D				m_lodViewPosition{ vec3_zero };
+	bool					m_lodViewPositionSet{ false };
+
+	float					m_frameTime{ 0.0f };
+	int						m_numBatches{ 0 };
+	int						m_batchSize{ 1 };
+	int						m_numJobs{ 0 };
+	volatile int			m_nextBatch{ 0 };
+	volatile int			m_activeJobs{ 0 };
+	bool					m_updating{ false };
+	bool					m_dispatching{ false };
+};
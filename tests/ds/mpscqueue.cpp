@@ -0,0 +1,180 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2023
+//////////////////////////////////////////////////////////////////////////////////
+// Description: MPSC queue tests
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/ConCommand.h"
+#include "ds/mpscqueue.h"
+
+using namespace Threading;
+
+#define MPSC_TEST_CAPACITY		256
+
+static bool MPSCQueueTest_SingleThread()
+{
+	MPSCQueue<int> queue(PP_SL, MPSC_TEST_CAPACITY);
+
+	int value = 0;
+	if (queue.Pop(value))
+	{
+		MsgError("  empty queue returned value\n");
+		return false;
+	}
+
+	// several laps so cell sequences wrap around
+	int nextPush = 0;
+	int nextPop = 0;
+	for (int lap = 0; lap < 4; ++lap)
+	{
+		while (queue.Push(nextPush))
+			++nextPush;
+
+		if (nextPush - nextPop != MPSC_TEST_CAPACITY)
+		{
+			MsgError("  queue was full after %d values, capacity is %d\n", nextPush - nextPop, MPSC_TEST_CAPACITY);
+			return false;
+		}
+
+		// free half so producer goes around
+		for (int i = 0; i < MPSC_TEST_CAPACITY / 2; ++i)
+		{
+			if (!queue.Pop(value) || value != nextPop)
+			{
+				MsgError("  popped %d, expected %d\n", value, nextPop);
+				return false;
+			}
+			++nextPop;
+		}
+	}
+
+	while (queue.Pop(value))
+	{
+		if (value != nextPop)
+		{
+			MsgError("  popped %d, expected %d\n", value, nextPop);
+			return false;
+		}
+		++nextPop;
+	}
+
+	if (nextPop != nextPush)
+	{
+		MsgError("  popped %d values of %d pushed\n", nextPop, nextPush);
+		return false;
+	}
+
+	return true;
+}
+
+struct MPSCTestItem
+{
+	int		producer{ -1 };
+	int		index{ -1 };
+	EqString	text;		// non-trivial value so moves are checked as well
+};
+
+class CMPSCTestProducer : public CEqThread
+{
+public:
+	int Run()
+	{
+		for (int i = 0; i < numItems; ++i)
+		{
+			MPSCTestItem item;
+			item.producer = producer;
+			item.index = i;
+			item.text = EqString::Format("%d:%d", producer, i);
+
+			// consumer is running on other thread
+			while (!queue->Push(std::move(item)))
+				Platform_Sleep(0);
+		}
+		return 0;
+	}
+
+	MPSCQueue<MPSCTestItem>*	queue{ nullptr };
+	int							producer{ 0 };
+	int							numItems{ 0 };
+};
+
+static bool MPSCQueueTest_MultiThread(int numProducers, int numItems)
+{
+	MPSCQueue<MPSCTestItem> queue(PP_SL, MPSC_TEST_CAPACITY);
+
+	Array<CMPSCTestProducer*> producers(PP_SL);
+	Array<int> expectedIndex(PP_SL);
+	expectedIndex.setNum(numProducers);
+
+	for (int i = 0; i < numProducers; ++i)
+	{
+		CMPSCTestProducer* producer = PPNew CMPSCTestProducer();
+		producer->queue = &queue;
+		producer->producer = i;
+		producer->numItems = numItems;
+		producers.append(producer);
+
+		expectedIndex[i] = 0;
+	}
+
+	for (CMPSCTestProducer* producer : producers)
+		producer->StartThread("MPSCTestProducer");
+
+	bool result = true;
+	int numReceived = 0;
+	const int numTotal = numProducers * numItems;
+	while (numReceived < numTotal)
+	{
+		MPSCTestItem item;
+		if (!queue.Pop(item))
+		{
+			Platform_Sleep(0);
+			continue;
+		}
+
+		// items of each producer come in the same order they were pushed
+		if (item.producer < 0 || item.producer >= numProducers)
+		{
+			MsgError("  got item of unknown producer %d\n", item.producer);
+			result = false;
+			++numReceived;
+			continue;
+		}
+
+		if (item.index != expectedIndex[item.producer])
+		{
+			MsgError("  got item %d:%d out of order\n", item.producer, item.index);
+			result = false;
+		}
+		else if (item.text != EqString::Format("%d:%d", item.producer, item.index))
+		{
+			MsgError("  item %d:%d has broken value '%s'\n", item.producer, item.index, item.text.ToCString());
+			result = false;
+		}
+
+		++expectedIndex[item.producer];
+		++numReceived;
+	}
+
+	for (CMPSCTestProducer* producer : producers)
+	{
+		producer->StopThread(true);
+		delete producer;
+	}
+
+	return result;
+}
+
+DECLARE_CMD(test_mpscqueue, "MPSC queue test. Arguments: [number of producers] [items per producer]", 0)
+{
+	const int numProducers = CMD_ARGC > 0 ? max(1, atoi(CMD_ARGV(0).ToCString())) : 4;
+	const int numItems = CMD_ARGC > 1 ? max(1, atoi(CMD_ARGV(1).ToCString())) : 100000;
+
+	const bool singleThreadOk = MPSCQueueTest_SingleThread();
+	MsgInfo("test_mpscqueue: single thread %s\n", singleThreadOk ? "OK" : "FAILED");
+
+	const bool multiThreadOk = MPSCQueueTest_MultiThread(numProducers, numItems);
+	MsgInfo("test_mpscqueue: %d producers, %d items each %s\n", numProducers, numItems, multiThreadOk ? "OK" : "FAILED");
+}
@@ -30,6 +30,7 @@
 
 #include "render/IDebugOverlay.h"
 #include "CAnimatedModel.h"
+#include "animating/AnimationManager.h"
 
 #include "math/Utility.h"
 
@@ -72,6 +73,7 @@ IMaterialSystem*	g_matSystem = nullptr;
 CViewParams			g_pCameraParams(Vector3D(0,0,-100), vec3_zero, 70);
 Matrix4x4			g_mProjMat, g_mViewMat;
 
+CAnimationManager	g_animationManager;
 CAnimatedModel		g_model;
 
 Vector3D			g_camera_rotation(25,225,0);
@@ -1251,7 +1253,13 @@ void CEGFViewFrame::ReDraw()
 
 		physics->Simulate( g_frametime, 1 );
 
-		g_model.Update( g_frametime );
+		// viewer model is updated by animation manager same as game objects
+		if(g_model.m_pModel)
+			g_animationManager.Register(&g_model);
+		else
+			g_animationManager.Unregister(&g_model);
+
+		g_animationManager.Update( g_frametime );
 
 		if(g_model.IsSequencePlaying() )
 		{
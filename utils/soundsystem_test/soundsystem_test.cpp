@@ -108,7 +108,7 @@ void InitSoundSystem( EQWNDHANDLE wnd )
 	g_consoleCommands->ParseFileToCommandBuffer("eqSoundSystemTest.cfg");
 	g_consoleCommands->ExecuteCommandBuffer();
 
-	g_audioSystem->Init();
+	InitAudioSystem();
 	g_sounds->Init(120.0f, s_soundChannels, elementsOf(s_soundChannels));
 	
 	{
@@ -9,10 +9,116 @@
 #include "core/IDkCore.h"
 #include "core/ICommandLine.h"
 #include "core/IFileSystem.h"
+#include "core/IEqParallelJobs.h"
+#include "core/IEqCPUServices.h"
+#include "imaging/ImageLoader.h"
 
 void Usage()
 {
 	MsgWarning("USAGE:\n	texcooker -target <target name>\n");
+	MsgWarning("	texcooker -benchmark [image size]\n");
+}
+
+static void FillBenchmarkImage(CImage& image)
+{
+	ubyte* pixels = image.GetPixels();
+	const int size = image.GetMipMappedSize(0, 1);
+
+	if (image.GetFormat() == FORMAT_RGBA32F)
+	{
+		for (int i = 0; i < size / (int)sizeof(float); ++i)
+			((float*)pixels)[i] = (i % 251) / 250.0f;
+	}
+	else
+	{
+		for (int i = 0; i < size; ++i)
+			pixels[i] = (ubyte)(i * 31);
+	}
+}
+
+static void RunImageBenchmarks(int imageSize)
+{
+	struct {
+		const char*		name;
+		ETextureFormat	format;
+	} formats[] = {
+		{ "RGBA8", FORMAT_RGBA8 },
+		{ "RGB8", FORMAT_RGB8 },
+		{ "RGBA32F", FORMAT_RGBA32F },
+	};
+
+	const int numRuns = 4;
+	const double mpixels = (double)imageSize * imageSize * numRuns / 1000000.0;
+
+	MsgInfo("Image processing with %d job threads, %dx%d images:\n", g_parallelJobs->IsInitialized() ? g_parallelJobs->GetJobThreadsCount() : 0, imageSize, imageSize);
+
+	for (int i = 0; i < elementsOf(formats); ++i)
+	{
+		CImage image;
+		CEqTimer timer;
+
+		double mipTime = 0.0;
+		double swapTime = 0.0;
+		for (int run = 0; run < numRuns; ++run)
+		{
+			image.Free();
+			image.Create(formats[i].format, imageSize, imageSize, 1, 1);
+			FillBenchmarkImage(image);
+
+			timer.GetTime(true);
+			image.CreateMipMaps();
+			mipTime += timer.GetTime(true);
+
+			image.SwapChannels(0, 2);
+			swapTime += timer.GetTime(true);
+		}
+
+		double convertTime = 0.0;
+		const ETextureFormat convertFormat = (formats[i].format == FORMAT_RGB8) ? FORMAT_RGBA8 : FORMAT_RGBA16F;
+		for (int run = 0; run < numRuns; ++run)
+		{
+			image.Free();
+			image.Create(formats[i].format, imageSize, imageSize, 1, 1);
+			FillBenchmarkImage(image);
+
+			timer.GetTime(true);
+			image.Convert(convertFormat);
+			convertTime += timer.GetTime(true);
+		}
+
+		MsgInfo("  %-8s mipmaps: %8.1f MPixels/sec, swap channels: %8.1f MPixels/sec, convert to %s: %8.1f MPixels/sec\n",
+			formats[i].name, mpixels / max(mipTime, 1e-9), mpixels / max(swapTime, 1e-9),
+			GetFormatString(convertFormat), mpixels / max(convertTime, 1e-9));
+	}
+}
+
+static void ImageBenchmark(const char* sizeStr)
+{
+	const int imageSize = (sizeStr && *sizeStr) ? atoi(sizeStr) : 2048;
+	if (!isPowerOf2(imageSize))
+	{
+		MsgError("Benchmark image size must be power of two\n");
+		return;
+	}
+
+	// single-threaded run goes first
+	if (!g_parallelJobs->IsInitialized())
+	{
+		RunImageBenchmarks(imageSize);
+
+		eqJobThreadDesc_t jobTypes[] = {
+			{ JOB_TYPE_ANY, max(1, g_cpuCaps->GetCPUCount() - 1) }
+		};
+
+		if (!g_parallelJobs->Init(elementsOf(jobTypes), jobTypes))
+			return;
+
+		RunImageBenchmarks(imageSize);
+		g_parallelJobs->Shutdown();
+		return;
+	}
+
+	RunImageBenchmarks(imageSize);
 }
 
 extern void CookMaterialsToTarget(const char* pszTargetName);
@@ -41,6 +147,10 @@ int main(int argc, char* argv[])
 		{
 			CookMaterialsToTarget(g_cmdLine->GetArgumentsOf(i));
 		}
+		else if (!argStr.CompareCaseIns("-benchmark"))
+		{
+			ImageBenchmark(g_cmdLine->GetArgumentsOf(i));
+		}
 	}
 
 	g_eqCore->Shutdown();